@@ -8,13 +8,16 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <string>
 #include <memory>
 #include <ostream>
 #include <string_view>
 #include <vector>
+#include "dns_resolver.h"
 #include "endian.h"
 #include "log.h"
 #include "server/endian.h"
+#include "server/hook.h"
 #include "server/log.h"
 
 namespace wtsclwq {
@@ -90,23 +93,42 @@ auto Address::GetAllTypeAddrByHost(std::string_view host, int family, int sock_t
       }
     }
   }
-  addrinfo *addr_list{};
   if (node.empty()) {
     node = host;
   }
-  int ret = getaddrinfo(node.data(), service, &hints, &addr_list);
-  if (ret != 0) {
-    LOG_ERROR(sys_logger) << "getaddrinfo error: " << gai_strerror(ret);
-    return res;
-  }
 
-  addrinfo *cur = addr_list;
-  while (cur != nullptr) {
-    res.push_back(CreateAddr(cur->ai_addr, cur->ai_addrlen));
-    cur = cur->ai_next;
+  // getaddrinfo查询域名服务器时会阻塞整个调度线程，协程中改用DnsResolver解析域名，
+  // 再用解析出的IP地址调用getaddrinfo，此时只处理端口和socket类型，不会访问网络
+  std::vector<std::string> nodes{};
+  in6_addr numeric_addr{};
+  if (CanHookSuspend() && (family == AF_INET || family == AF_INET6 || family == AF_UNSPEC) &&
+      inet_pton(AF_INET, node.c_str(), &numeric_addr) != 1 && inet_pton(AF_INET6, node.c_str(), &numeric_addr) != 1) {
+    nodes = DnsResolverMgr::GetInstance()->Resolve(node, family);
+    if (nodes.empty()) {
+      LOG_ERROR(sys_logger) << "resolve " << node << " error";
+      return res;
+    }
+    hints.ai_flags |= AI_NUMERICHOST;
+  } else {
+    nodes.push_back(node);
   }
 
-  freeaddrinfo(addr_list);
+  for (const auto &curr_node : nodes) {
+    addrinfo *addr_list{};
+    int ret = getaddrinfo(curr_node.data(), service, &hints, &addr_list);
+    if (ret != 0) {
+      LOG_ERROR(sys_logger) << "getaddrinfo error: " << gai_strerror(ret);
+      continue;
+    }
+
+    addrinfo *cur = addr_list;
+    while (cur != nullptr) {
+      res.push_back(CreateAddr(cur->ai_addr, cur->ai_addrlen));
+      cur = cur->ai_next;
+    }
+
+    freeaddrinfo(addr_list);
+  }
   return res;
 }
 
@@ -28,6 +28,7 @@ class Address {
 
   /**
    * @brief 根据host获取满足对应条件的所有地址
+   * @details 在IO调度器的协程中通过DnsResolver异步解析域名，结果按TTL缓存；其他线程中使用阻塞的getaddrinfo
    * @param host 域名、服务器名等，www.baidu.com[:80]，端口可选
    * @param family 协议族，AF_INET、AF_INET6、AF_UNIX
    * @param sock_type socket类型，SOCK_STREAM、SOCK_DGRAM、SOCK_SEQPACKET
@@ -0,0 +1,558 @@
+#include "binary_log.h"
+
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "utils.h"
+
+namespace wtsclwq {
+
+/**
+ * @brief 把一个值按原始字节追加到字符串末尾
+ */
+template <typename T>
+static void AppendRaw(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/**
+ * @brief 追加长度为T类型的字符串
+ */
+template <typename T>
+static void AppendString(std::string *out, std::string_view str) {
+  AppendRaw(out, static_cast<T>(str.size()));
+  out->append(str.data(), str.size());
+}
+
+/**
+ * @brief 追加记录类型，并预留记录总长度的位置，记录写完之后调用FinishRecord填写长度
+ */
+static auto BeginRecord(std::string *out, BinaryRecordType type) -> size_t {
+  size_t begin = out->size();
+  AppendRaw(out, type);
+  AppendRaw<uint32_t>(out, 0);
+  return begin;
+}
+
+static void FinishRecord(std::string *out, size_t begin) {
+  auto size = static_cast<uint32_t>(out->size() - begin);
+  memcpy(&(*out)[begin + 1], &size, sizeof(size));
+}
+
+/**
+ * @brief 按顺序读取记录中的字段，越界时之后的读取都失败
+ */
+class RecordReader {
+ public:
+  explicit RecordReader(std::string_view data) : data_(data) {}
+
+  template <typename T>
+  auto Read(T *value) -> bool {
+    if (!ok_ || data_.size() - pos_ < sizeof(T)) {
+      ok_ = false;
+      return false;
+    }
+    memcpy(value, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  template <typename T>
+  auto ReadString(std::string_view *value) -> bool {
+    T size = 0;
+    if (!Read(&size) || data_.size() - pos_ < size) {
+      ok_ = false;
+      return false;
+    }
+    *value = data_.substr(pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  auto ReadVarint(uint64_t *value) -> bool {
+    *value = 0;
+    for (int shift = 0; ok_ && shift < 64; shift += 7) {
+      uint8_t byte = 0;
+      if (!Read(&byte)) {
+        return false;
+      }
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    ok_ = false;
+    return false;
+  }
+
+  template <typename T>
+  auto ReadVarint(T *value) -> bool {
+    uint64_t v = 0;
+    bool ok = ReadVarint(&v);
+    *value = static_cast<T>(v);
+    return ok;
+  }
+
+  auto ReadVarintString(std::string_view *value) -> bool {
+    uint64_t size = 0;
+    if (!ReadVarint(&size) || data_.size() - pos_ < size) {
+      ok_ = false;
+      return false;
+    }
+    *value = data_.substr(pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  auto Ok() const -> bool { return ok_; }
+
+ private:
+  std::string_view data_{};  // 记录
+  size_t pos_{0};            // 当前读取的位置
+  bool ok_{true};            // 之前的读取是否都成功
+};
+
+void BinaryLogDictionary::AddSite(uint32_t id, BinaryLogSite site) {
+  if (sites_.size() <= id) {
+    sites_.resize(id + 1);
+  }
+  sites_[id] = std::make_unique<BinaryLogSite>(std::move(site));
+}
+
+void BinaryLogDictionary::AddName(uint32_t id, std::string_view name) {
+  if (names_.size() <= id) {
+    names_.resize(id + 1);
+  }
+  names_[id] = std::make_unique<std::string>(name);
+}
+
+auto BinaryLogDictionary::GetSite(uint32_t id) const -> const BinaryLogSite * {
+  return id < sites_.size() ? sites_[id].get() : nullptr;
+}
+
+auto BinaryLogDictionary::GetName(uint32_t id) const -> std::string_view {
+  if (id < names_.size() && names_[id] != nullptr) {
+    return *names_[id];
+  }
+  return "unknown";
+}
+
+void BinaryLogDictionary::Clear() {
+  sites_.clear();
+  names_.clear();
+}
+
+/**
+ * @brief 按照格式字符串把参数写入日志事件的消息中，{}依次替换为参数，多余的参数追加在末尾
+ */
+static auto RenderMessage(const BinaryLogSite &site, RecordReader *reader, LogEvent *event) -> bool {
+  std::ostream &os = event->GetStream();
+  std::string_view format = site.format_;
+  size_t arg_index = 0;
+  auto write_arg = [&site, reader, &os, &arg_index]() -> bool {
+    switch (site.arg_types_[arg_index++]) {
+      case BinaryArgType::Bool: {
+        uint8_t value = 0;
+        reader->Read(&value);
+        os << (value != 0);
+        break;
+      }
+      case BinaryArgType::Char: {
+        char value = 0;
+        reader->Read(&value);
+        os << value;
+        break;
+      }
+      case BinaryArgType::Int: {
+        uint64_t value = 0;
+        reader->ReadVarint(&value);
+        os << ZigZagDecode(value);
+        break;
+      }
+      case BinaryArgType::UInt: {
+        uint64_t value = 0;
+        reader->ReadVarint(&value);
+        os << value;
+        break;
+      }
+      case BinaryArgType::Double: {
+        double value = 0;
+        reader->Read(&value);
+        os << value;
+        break;
+      }
+      case BinaryArgType::String: {
+        std::string_view value;
+        reader->ReadVarintString(&value);
+        os.write(value.data(), static_cast<std::streamsize>(value.size()));
+        break;
+      }
+      default:
+        return false;
+    }
+    return reader->Ok();
+  };
+
+  size_t pos = 0;
+  while (pos < format.size()) {
+    size_t next = format.find_first_of("{}", pos);
+    if (next == std::string_view::npos) {
+      os.write(format.data() + pos, static_cast<std::streamsize>(format.size() - pos));
+      break;
+    }
+    os.write(format.data() + pos, static_cast<std::streamsize>(next - pos));
+    if (next + 1 < format.size() && format[next + 1] == format[next]) {
+      // {{和}}
+      os << format[next];
+      pos = next + 2;
+    } else if (format[next] == '{' && next + 1 < format.size() && format[next + 1] == '}' &&
+               arg_index < site.arg_types_.size()) {
+      if (!write_arg()) {
+        return false;
+      }
+      pos = next + 2;
+    } else {
+      os << format[next];
+      pos = next + 1;
+    }
+  }
+  while (arg_index < site.arg_types_.size()) {
+    os << ' ';
+    if (!write_arg()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto BinaryLogDictionary::Decode(std::string_view record, LogEvent *event) -> bool {
+  RecordReader reader(record);
+  BinaryRecordType type{};
+  uint32_t size = 0;
+  reader.Read(&type);
+  reader.Read(&size);
+  switch (type) {
+    case BinaryRecordType::Session:
+      Clear();
+      return false;
+    case BinaryRecordType::Site: {
+      uint32_t id = 0;
+      int32_t level = 0;
+      uint8_t arg_count = 0;
+      std::string_view file;
+      std::string_view format;
+      BinaryLogSite site;
+      reader.Read(&id);
+      reader.Read(&level);
+      reader.Read(&site.line_);
+      reader.ReadString<uint16_t>(&file);
+      reader.ReadString<uint16_t>(&format);
+      reader.Read(&arg_count);
+      site.arg_types_.resize(arg_count);
+      for (auto &arg_type : site.arg_types_) {
+        reader.Read(&arg_type);
+      }
+      if (reader.Ok()) {
+        site.level_ = static_cast<LogLevel>(level);
+        site.file_ = file;
+        site.format_ = format;
+        AddSite(id, std::move(site));
+      }
+      return false;
+    }
+    case BinaryRecordType::Name: {
+      uint32_t id = 0;
+      std::string_view name;
+      reader.Read(&id);
+      if (reader.ReadString<uint16_t>(&name)) {
+        AddName(id, name);
+      }
+      return false;
+    }
+    case BinaryRecordType::Log: {
+      uint32_t site_id = 0;
+      uint32_t logger_name_id = 0;
+      uint32_t thread_name_id = 0;
+      uint32_t thread_id = 0;
+      uint64_t coroutine_id = 0;
+      uint64_t elapse = 0;
+      uint64_t time = 0;
+      reader.ReadVarint(&site_id);
+      reader.ReadVarint(&logger_name_id);
+      reader.ReadVarint(&thread_name_id);
+      reader.ReadVarint(&thread_id);
+      reader.ReadVarint(&coroutine_id);
+      reader.ReadVarint(&elapse);
+      reader.ReadVarint(&time);
+      const BinaryLogSite *site = GetSite(site_id);
+      if (!reader.Ok() || site == nullptr) {
+        return false;
+      }
+      event->Reset(site->level_, site->file_.c_str(), site->line_, ZigZagDecode(elapse), thread_id, coroutine_id,
+                   GetName(thread_name_id), GetName(logger_name_id), static_cast<time_t>(ZigZagDecode(time)));
+      return RenderMessage(*site, &reader, event);
+    }
+    case BinaryRecordType::Event: {
+      int32_t level = 0;
+      int32_t line = 0;
+      uint32_t file_id = 0;
+      uint32_t logger_name_id = 0;
+      uint32_t thread_name_id = 0;
+      uint32_t thread_id = 0;
+      uint64_t coroutine_id = 0;
+      int64_t elapse = 0;
+      int64_t time = 0;
+      std::string_view message;
+      reader.Read(&level);
+      reader.Read(&line);
+      reader.Read(&file_id);
+      reader.Read(&logger_name_id);
+      reader.Read(&thread_name_id);
+      reader.Read(&thread_id);
+      reader.Read(&coroutine_id);
+      reader.Read(&elapse);
+      reader.Read(&time);
+      reader.ReadString<uint32_t>(&message);
+      if (!reader.Ok() || file_id >= names_.size() || names_[file_id] == nullptr) {
+        return false;
+      }
+      event->Reset(static_cast<LogLevel>(level), names_[file_id]->c_str(), line, elapse, thread_id, coroutine_id,
+                   GetName(thread_name_id), GetName(logger_name_id), time);
+      event->GetStream().write(message.data(), static_cast<std::streamsize>(message.size()));
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+auto BinaryLogRegistry::AddDefinition(std::string definition) -> uint32_t {
+  // 调用时已经持有mutex_
+  auto id = static_cast<uint32_t>(definitions_.size());
+  definitions_.push_back(std::move(definition));
+  definition_count_.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+auto BinaryLogRegistry::RegisterSite(const BinaryLogSiteInfo &info, std::vector<BinaryArgType> arg_types)
+    -> uint32_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto id = static_cast<uint32_t>(definitions_.size());
+  std::string definition;
+  size_t begin = BeginRecord(&definition, BinaryRecordType::Site);
+  AppendRaw(&definition, id);
+  AppendRaw(&definition, static_cast<int32_t>(info.level_));
+  AppendRaw(&definition, info.line_);
+  AppendString<uint16_t>(&definition, info.file_);
+  AppendString<uint16_t>(&definition, info.format_);
+  AppendRaw(&definition, static_cast<uint8_t>(arg_types.size()));
+  for (auto arg_type : arg_types) {
+    AppendRaw(&definition, arg_type);
+  }
+  FinishRecord(&definition, begin);
+  dictionary_.AddSite(id, {info.level_, info.file_, info.line_, info.format_, std::move(arg_types)});
+  return AddDefinition(std::move(definition));
+}
+
+auto BinaryLogRegistry::InternName(std::string_view name) -> uint32_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = name_ids_.find(std::string(name));
+  if (it != name_ids_.end()) {
+    return it->second;
+  }
+  auto id = static_cast<uint32_t>(definitions_.size());
+  std::string definition;
+  size_t begin = BeginRecord(&definition, BinaryRecordType::Name);
+  AppendRaw(&definition, id);
+  AppendString<uint16_t>(&definition, name);
+  FinishRecord(&definition, begin);
+  dictionary_.AddName(id, name);
+  name_ids_.emplace(name, id);
+  return AddDefinition(std::move(definition));
+}
+
+/**
+ * @brief 线程局部的名称缓存，名称没有变化时不需要访问注册中心
+ */
+struct NameIdCache {
+  std::string name_{};       // 上一次注册的名称
+  uint32_t id_{UINT32_MAX};  // 上一次注册得到的id
+
+  auto Get(std::string_view name) -> uint32_t {
+    if (id_ == UINT32_MAX || name != name_) {
+      id_ = BinaryLogRegistryMgr::GetInstance()->InternName(name);
+      name_ = name;
+    }
+    return id_;
+  }
+};
+
+auto BinaryLogRegistry::GetCurrThreadNameId() -> uint32_t {
+  static thread_local NameIdCache t_thread_name_cache;
+  return t_thread_name_cache.Get(GetCurrSysThreadNameView());
+}
+
+void BinaryLogRegistry::EncodeDefinitions(uint32_t begin, uint32_t end, std::string *out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint32_t id = begin; id < end && id < definitions_.size(); id++) {
+    out->append(definitions_[id]);
+  }
+}
+
+auto BinaryLogRegistry::Decode(std::string_view record, LogEvent *event) -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dictionary_.Decode(record, event);
+}
+
+auto GetBinaryLogBuffer() -> LogStreamBuf * {
+  static thread_local LogStreamBuf t_binary_log_buf;
+  return &t_binary_log_buf;
+}
+
+auto WriteBinaryLogHeader(char *p, uint32_t site_id, Logger *logger) -> char * {
+  p = PutRaw(p, BinaryRecordType::Log);
+  p = PutRaw<uint32_t>(p, 0);
+  p = PutVarint(p, site_id);
+  p = PutVarint(p, logger->GetNameId());
+  p = PutVarint(p, BinaryLogRegistryMgr::GetInstance()->GetCurrThreadNameId());
+  p = PutVarint(p, static_cast<uint32_t>(GetCachedSysThreadId()));
+  p = PutVarint(p, GetCurrCouroutineId());
+  p = PutVarint(p, ZigZagEncode(GetElapsedTime() - logger->GetCreateTime()));
+  p = PutVarint(p, ZigZagEncode(time(nullptr)));
+  return p;
+}
+
+/**
+ * @brief 把日志事件编码为Event记录，名称都已经转换为id
+ */
+static void EncodeEventRecord(const LogEvent &event, uint32_t file_id, uint32_t logger_name_id,
+                              uint32_t thread_name_id, std::string *out) {
+  size_t begin = BeginRecord(out, BinaryRecordType::Event);
+  AppendRaw(out, static_cast<int32_t>(event.GetLevel()));
+  AppendRaw(out, static_cast<int32_t>(event.GetLine()));
+  AppendRaw(out, file_id);
+  AppendRaw(out, logger_name_id);
+  AppendRaw(out, thread_name_id);
+  AppendRaw(out, event.GetThreadId());
+  AppendRaw(out, event.GetCoroutineId());
+  AppendRaw(out, event.GetElapse());
+  AppendRaw(out, static_cast<int64_t>(event.GetTime()));
+  AppendString<uint32_t>(out, event.GetContent());
+  FinishRecord(out, begin);
+}
+
+BinaryLogAppender::BinaryLogAppender(std::string_view filename, size_t buffer_size, OverflowPolicy policy)
+    : AsyncLogAppender(filename, buffer_size, policy) {}
+
+BinaryLogAppender::~BinaryLogAppender() {
+  // 刷盘线程会调用BeforeDrain，必须在子类析构之前停止
+  StopFlusher();
+}
+
+void BinaryLogAppender::Log(LogEvent::s_ptr event) {
+  // __FILE__的地址不会改变，按地址缓存文件名的id
+  static thread_local std::unordered_map<const char *, uint32_t> t_file_ids;
+  static thread_local NameIdCache t_logger_name_cache;
+  static thread_local NameIdCache t_thread_name_cache;
+  static thread_local std::string t_record;
+
+  std::string_view file = event->GetFile();
+  auto it = t_file_ids.find(file.data());
+  if (it == t_file_ids.end()) {
+    it = t_file_ids.emplace(file.data(), BinaryLogRegistryMgr::GetInstance()->InternName(file)).first;
+  }
+  t_record.clear();
+  EncodeEventRecord(*event, it->second, t_logger_name_cache.Get(event->GetLoggerName()),
+                    t_thread_name_cache.Get(event->GetThreadName()), &t_record);
+  Append(t_record);
+}
+
+void BinaryLogAppender::LogBinary(std::string_view record) { Append(record); }
+
+void BinaryLogAppender::BeforeDrain(std::string *header) {
+  if (!session_written_) {
+    size_t begin = BeginRecord(header, BinaryRecordType::Session);
+    header->append(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+    FinishRecord(header, begin);
+    session_written_ = true;
+  }
+  // 这一批日志已经取出，它们用到的定义一定已经注册
+  uint32_t count = BinaryLogRegistryMgr::GetInstance()->GetDefinitionCount();
+  if (count > written_definition_count_) {
+    BinaryLogRegistryMgr::GetInstance()->EncodeDefinitions(written_definition_count_, count, header);
+    written_definition_count_ = count;
+  }
+}
+
+auto BinaryLogAppender::EncodeDroppedNotice(uint64_t dropped_count) -> std::string {
+  // 用一个普通的日志事件记录丢弃的条数
+  auto event = std::make_shared<LogEvent>(LogLevel::WARN, __FILE__, __LINE__, 0, GetCachedSysThreadId(),
+                                          GetCurrCouroutineId(), GetCurrSysThreadNameView(), "BinaryLogAppender",
+                                          time(nullptr));
+  event->GetStream() << "BinaryLogAppender dropped " << dropped_count << " log records because the buffer was full";
+  auto *registry = BinaryLogRegistryMgr::GetInstance();
+  std::string record;
+  EncodeEventRecord(*event, registry->InternName(event->GetFile()), registry->InternName(event->GetLoggerName()),
+                    registry->InternName(event->GetThreadName()), &record);
+  // 提示中用到的名称可能是刚刚注册的，和定义一起写在提示之前
+  std::string definitions;
+  uint32_t count = registry->GetDefinitionCount();
+  if (count > written_definition_count_) {
+    registry->EncodeDefinitions(written_definition_count_, count, &definitions);
+    written_definition_count_ = count;
+  }
+  return definitions + record;
+}
+
+auto BinaryLogAppender::FlushConfigToYmal() -> std::string {
+  std::lock_guard<MutexType> lock(mutex_);
+  YAML::Node node;
+  node["type"] = "Binary";
+  node["file"] = GetFile()->GetFilename();
+  node["overflow"] = OverflowPolicyToString(GetOverflowPolicy());
+  node["buffer_size"] = GetBufferSize();
+  std::stringstream ss;
+  ss << node;
+  return ss.str();
+}
+
+BinaryLogReader::BinaryLogReader(const std::string &filename) : ifs_(filename, std::ios::binary) {}
+
+auto BinaryLogReader::Next(LogEvent *event) -> bool {
+  while (!has_error_) {
+    char prefix[BINARY_RECORD_PREFIX_SIZE];
+    if (!ifs_.read(prefix, sizeof(prefix))) {
+      // 正好在记录边界结束是正常的文件结尾
+      has_error_ = ifs_.gcount() != 0;
+      return false;
+    }
+    uint32_t size = 0;
+    memcpy(&size, prefix + 1, sizeof(size));
+    auto type = static_cast<uint8_t>(prefix[0]);
+    if (size < BINARY_RECORD_PREFIX_SIZE || type > static_cast<uint8_t>(BinaryRecordType::Event)) {
+      has_error_ = true;
+      return false;
+    }
+    record_.assign(prefix, sizeof(prefix));
+    record_.resize(size);
+    if (!ifs_.read(&record_[BINARY_RECORD_PREFIX_SIZE], size - BINARY_RECORD_PREFIX_SIZE)) {
+      has_error_ = true;
+      return false;
+    }
+    if (dictionary_.Decode(record_, event)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace wtsclwq
@@ -0,0 +1,349 @@
+#ifndef _WTSCLWQ_BINARY_LOG_
+#define _WTSCLWQ_BINARY_LOG_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "log.h"
+#include "singleton.h"
+
+/**
+ * @brief 二进制日志：格式字符串、文件名、行号等静态信息在每个调用点第一次执行时注册一次，
+ * 之后每次打印日志只写入调用点id和参数的原始字节，不做任何格式化，由log_decode工具离线还原为文本。
+ * 格式字符串中的{}依次替换为参数，{{和}}分别表示{和}，参数支持bool、字符、整数、浮点数和字符串
+ * 例如：BIN_LOG_INFO(logger, "request {} took {} us", id, cost);
+ */
+#define BIN_LEVELED_LOG(logger, level, fmt, ...)                                                            \
+  if ((level) >= (logger)->GetLevel())                                                                      \
+  wtsclwq::WriteBinaryLog(                                                                                  \
+      (logger), [] { return wtsclwq::BinaryLogSiteInfo{(level), __FILE__, __LINE__, (fmt)}; }, ##__VA_ARGS__)
+
+#define BIN_LOG_DEBUG(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_INFO(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::INFO, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_NOTICE(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::NOTICE, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_WARN(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::WARN, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_ERROR(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_CRIT(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::CRIT, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_ALERT(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::ALERT, fmt, ##__VA_ARGS__)
+
+#define BIN_LOG_FATAL(logger, fmt, ...) BIN_LEVELED_LOG(logger, wtsclwq::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
+namespace wtsclwq {
+
+/**
+ * @brief 二进制日志文件中的记录类型，每条记录都以1字节类型和4字节记录总长度开头
+ */
+enum class BinaryRecordType : uint8_t {
+  Session = 0,  // 文件（或一次打开）的开头，之后的id都重新编号
+  Site = 1,     // 调用点定义：级别、文件名、行号、格式字符串、参数类型
+  Name = 2,     // 名称定义：日志器名称、线程名称
+  Log = 3,      // BIN_LOG_*打印的日志：调用点id和参数
+  Event = 4,    // LOG_*打印的日志：消息已经格式化为字符串
+};
+
+/**
+ * @brief 参数在二进制日志中的类型
+ */
+enum class BinaryArgType : uint8_t {
+  Bool,    // 1字节
+  Char,    // 1字节
+  Int,     // zigzag编码之后的变长整数
+  UInt,    // 变长整数
+  Double,  // 8字节浮点数
+  String,  // 变长整数表示的长度加上字符串内容
+};
+
+constexpr char BINARY_LOG_MAGIC[8] = {'W', 'T', 'S', 'B', 'L', 'O', 'G', '1'};  // Session记录的内容
+constexpr size_t BINARY_RECORD_PREFIX_SIZE = 5;                                 // 记录类型和记录总长度
+constexpr size_t MAX_VARINT_SIZE = 10;                                          // 64位变长整数的最大长度
+// Log记录的头部：前缀之后依次是调用点id、日志器名称id、线程名称id、线程id、协程id、累计毫秒数、时间戳，都是变长整数
+constexpr size_t BINARY_LOG_HEADER_MAX_SIZE = BINARY_RECORD_PREFIX_SIZE + 7 * MAX_VARINT_SIZE;
+
+/**
+ * @brief 调用点的静态信息，由BIN_LOG_*宏生成
+ */
+struct BinaryLogSiteInfo {
+  LogLevel level_;
+  const char *file_;
+  int32_t line_;
+  const char *format_;
+};
+
+/**
+ * @brief 注册之后的调用点
+ */
+struct BinaryLogSite {
+  LogLevel level_{LogLevel::UNKNOWN};
+  std::string file_{};
+  int32_t line_{0};
+  std::string format_{};
+  std::vector<BinaryArgType> arg_types_{};
+};
+
+/**
+ * @brief 把一个值按原始字节写入p，返回写入之后的位置
+ */
+template <typename T>
+inline auto PutRaw(char *p, T value) -> char * {
+  memcpy(p, &value, sizeof(T));
+  return p + sizeof(T);
+}
+
+/**
+ * @brief 写入变长整数，每个字节的低7位存储数据，最高位表示后面是否还有字节，小的整数只需要1、2个字节
+ */
+inline auto PutVarint(char *p, uint64_t value) -> char * {
+  while (value >= 0x80) {
+    *p++ = static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = static_cast<char>(value);
+  return p;
+}
+
+/**
+ * @brief 有符号整数的zigzag编码，绝对值小的负数也只需要很少的字节
+ */
+inline auto ZigZagEncode(int64_t value) -> uint64_t {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline auto ZigZagDecode(uint64_t value) -> int64_t {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * @brief 参数类型到二进制日志类型的映射，不支持的类型在编译期报错
+ * @details MaxSize返回编码之后的最大长度，用于预先保证缓冲区足够大
+ */
+template <typename T, typename Enable = void>
+struct BinaryArgTraits {
+  static_assert(sizeof(T) == 0, "unsupported binary log argument type");
+};
+
+template <>
+struct BinaryArgTraits<bool> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::Bool;
+  static auto MaxSize(bool /*value*/) -> size_t { return 1; }
+  static auto Write(char *p, bool value) -> char * { return PutRaw<uint8_t>(p, value ? 1 : 0); }
+};
+
+template <>
+struct BinaryArgTraits<char> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::Char;
+  static auto MaxSize(char /*value*/) -> size_t { return 1; }
+  static auto Write(char *p, char value) -> char * { return PutRaw(p, value); }
+};
+
+template <typename T>
+struct BinaryArgTraits<T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T> &&
+                                           !std::is_same_v<T, char> && !std::is_same_v<T, bool>>> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::Int;
+  static auto MaxSize(T /*value*/) -> size_t { return MAX_VARINT_SIZE; }
+  static auto Write(char *p, T value) -> char * { return PutVarint(p, ZigZagEncode(value)); }
+};
+
+template <typename T>
+struct BinaryArgTraits<T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T> &&
+                                           !std::is_same_v<T, char> && !std::is_same_v<T, bool>>> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::UInt;
+  static auto MaxSize(T /*value*/) -> size_t { return MAX_VARINT_SIZE; }
+  static auto Write(char *p, T value) -> char * { return PutVarint(p, value); }
+};
+
+template <typename T>
+struct BinaryArgTraits<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::Double;
+  static auto MaxSize(T /*value*/) -> size_t { return 8; }
+  static auto Write(char *p, T value) -> char * { return PutRaw(p, static_cast<double>(value)); }
+};
+
+template <typename T>
+struct BinaryArgTraits<T, std::enable_if_t<std::is_convertible_v<const T &, std::string_view>>> {
+  static constexpr BinaryArgType TYPE = BinaryArgType::String;
+  static auto MaxSize(std::string_view value) -> size_t { return MAX_VARINT_SIZE + value.size(); }
+  static auto Write(char *p, std::string_view value) -> char * {
+    p = PutVarint(p, value.size());
+    memcpy(p, value.data(), value.size());
+    return p + value.size();
+  }
+};
+
+/**
+ * @brief 调用点和名称的字典，写入端和解码端各有一份，按照id查找
+ */
+class BinaryLogDictionary {
+ public:
+  void AddSite(uint32_t id, BinaryLogSite site);
+
+  void AddName(uint32_t id, std::string_view name);
+
+  auto GetSite(uint32_t id) const -> const BinaryLogSite *;
+
+  auto GetName(uint32_t id) const -> std::string_view;
+
+  void Clear();
+
+  /**
+   * @brief 解析一条完整的记录，定义记录加入字典，日志记录还原为日志事件
+   * @return 是否还原出了日志事件
+   */
+  auto Decode(std::string_view record, LogEvent *event) -> bool;
+
+ private:
+  std::vector<std::unique_ptr<BinaryLogSite>> sites_{};  // 按id索引的调用点，元素的地址不会改变
+  std::vector<std::unique_ptr<std::string>> names_{};    // 按id索引的名称，元素的地址不会改变
+};
+
+/**
+ * @brief 进程内的二进制日志注册中心，调用点和名称共用一套递增的id，按注册顺序编码为定义记录
+ */
+class BinaryLogRegistry {
+ public:
+  /**
+   * @brief 注册调用点，每个调用点只在第一次执行时注册
+   */
+  auto RegisterSite(const BinaryLogSiteInfo &info, std::vector<BinaryArgType> arg_types) -> uint32_t;
+
+  /**
+   * @brief 注册名称，相同的名称返回相同的id
+   */
+  auto InternName(std::string_view name) -> uint32_t;
+
+  /**
+   * @brief 获取当前线程名称的id，线程名称改变之后重新注册
+   */
+  auto GetCurrThreadNameId() -> uint32_t;
+
+  /**
+   * @brief 获取已经注册的定义个数
+   */
+  auto GetDefinitionCount() const -> uint32_t { return definition_count_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief 把id在[begin, end)之间的定义记录追加到out中
+   */
+  void EncodeDefinitions(uint32_t begin, uint32_t end, std::string *out);
+
+  /**
+   * @brief 在进程内把一条记录还原为日志事件，用于文本日志输出目标
+   */
+  auto Decode(std::string_view record, LogEvent *event) -> bool;
+
+ private:
+  auto AddDefinition(std::string definition) -> uint32_t;
+
+  std::mutex mutex_{};                                    // 保护下面所有成员
+  std::vector<std::string> definitions_{};                // 按id排列的定义记录
+  std::unordered_map<std::string, uint32_t> name_ids_{};  // 名称到id的映射
+  BinaryLogDictionary dictionary_{};                      // 进程内解码使用的字典
+  std::atomic<uint32_t> definition_count_{0};             // 已经注册的定义个数
+};
+
+using BinaryLogRegistryMgr = Singleton<BinaryLogRegistry>;
+
+/**
+ * @brief 获取当前线程用于编码二进制日志的缓冲区
+ */
+auto GetBinaryLogBuffer() -> LogStreamBuf *;
+
+/**
+ * @brief 写入Log记录的头部，记录总长度在写完参数之后填写，返回参数开始的位置
+ */
+auto WriteBinaryLogHeader(char *p, uint32_t site_id, Logger *logger) -> char *;
+
+/**
+ * @brief BIN_LOG_*宏调用的函数，SiteFunc是每个调用点唯一的lambda类型，因此每个调用点都有自己的s_site_id
+ */
+template <typename SiteFunc, typename... Args>
+void WriteBinaryLog(const Logger::s_ptr &logger, SiteFunc site_func, const Args &...args) {
+  static const uint32_t s_site_id = BinaryLogRegistryMgr::GetInstance()->RegisterSite(
+      site_func(), {BinaryArgTraits<std::decay_t<Args>>::TYPE...});
+  size_t max_size = BINARY_LOG_HEADER_MAX_SIZE + (BinaryArgTraits<std::decay_t<Args>>::MaxSize(args) + ... + 0);
+  LogStreamBuf *buf = GetBinaryLogBuffer();
+  buf->Reset();
+  char *begin = buf->PrepareWrite(max_size);
+  char *p = WriteBinaryLogHeader(begin, s_site_id, logger.get());
+  ((p = BinaryArgTraits<std::decay_t<Args>>::Write(p, args)), ...);
+  auto size = static_cast<uint32_t>(p - begin);
+  memcpy(begin + 1, &size, sizeof(size));
+  buf->Commit(size);
+  logger->LogBinary(site_func().level_, buf->View());
+}
+
+/**
+ * @brief 二进制日志输出目标，在AsyncLogAppender的基础上直接写入原始记录，
+ * 刷盘线程在每一批日志之前写入这一批日志用到的、还没有写入文件的定义记录
+ * @details 为了保证文件中的定义记录完整，二进制日志文件不滚动
+ */
+class BinaryLogAppender : public AsyncLogAppender {
+ public:
+  using s_ptr = std::shared_ptr<BinaryLogAppender>;
+
+  explicit BinaryLogAppender(std::string_view filename, size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                             OverflowPolicy policy = OverflowPolicy::Block);
+
+  ~BinaryLogAppender() override;
+
+  /**
+   * @brief LOG_*打印的日志，把消息和事件的各个字段编码为Event记录，不经过格式器
+   */
+  void Log(LogEvent::s_ptr event) override;
+
+  void LogBinary(std::string_view record) override;
+
+  auto FlushConfigToYmal() -> std::string override;
+
+ protected:
+  void BeforeDrain(std::string *header) override;
+
+  auto EncodeDroppedNotice(uint64_t dropped_count) -> std::string override;
+
+ private:
+  bool session_written_{false};           // 是否已经写入Session记录，只在刷盘线程中使用
+  uint32_t written_definition_count_{0};  // 已经写入文件的定义个数，只在刷盘线程中使用
+};
+
+/**
+ * @brief 顺序读取二进制日志文件，逐条还原为日志事件
+ */
+class BinaryLogReader {
+ public:
+  explicit BinaryLogReader(const std::string &filename);
+
+  auto IsOpen() const -> bool { return ifs_.is_open(); }
+
+  /**
+   * @brief 读取下一条日志
+   * @return 文件结束或者文件损坏时返回false
+   */
+  auto Next(LogEvent *event) -> bool;
+
+  /**
+   * @brief 文件是否损坏（不完整的记录、未知的记录类型等）
+   */
+  auto HasError() const -> bool { return has_error_; }
+
+ private:
+  std::ifstream ifs_{};               // 文件流
+  std::string record_{};              // 当前记录
+  BinaryLogDictionary dictionary_{};  // 从文件中读到的字典
+  bool has_error_{false};             // 文件是否损坏
+};
+
+}  // namespace wtsclwq
+#endif
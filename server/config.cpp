@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <algorithm>
 #include <shared_mutex>
+#include <utility>
+#include <vector>
 
 namespace wtsclwq {
 static Logger::s_ptr logger = NAMED_LOGGER("system");
@@ -54,9 +56,10 @@ static void ListAllMember(std::string_view prefix, const YAML::Node &node,
   }
 }
 
-void ConfigManager::LoadFromYaml(const YAML::Node &root) {
+auto ConfigManager::LoadFromYaml(const YAML::Node &root) -> bool {
   std::list<std::pair<std::string, const YAML::Node>> all_nodes;
   ListAllMember("", root, &all_nodes);
+  std::vector<std::pair<ConfigItemBase::s_ptr, std::string>> changes;
   for (auto &i : all_nodes) {
     auto key = i.first;
     if (key.empty()) {
@@ -69,13 +72,41 @@ void ConfigManager::LoadFromYaml(const YAML::Node &root) {
       continue;
     }
     if (i.second.IsScalar()) {
-      item->FromString(i.second.Scalar());
+      changes.emplace_back(item, i.second.Scalar());
     } else {
       std::stringstream ss;
       ss << i.second;
-      item->FromString(ss.str());
+      changes.emplace_back(item, ss.str());
     }
   }
+  // 先校验全部配置项，任何一个不合法都不应用，避免配置只更新了一半
+  for (auto &[item, str] : changes) {
+    if (!item->Validate(str)) {
+      LOG_ERROR(logger) << "Config item " << item->GetName() << " is invalid, config rejected";
+      return false;
+    }
+  }
+  // 值没有变化的配置项不会触发回调函数
+  for (auto &[item, str] : changes) {
+    item->FromString(str);
+  }
+  return true;
+}
+
+auto ConfigManager::LoadFromFile(const std::string &filename) -> bool {
+  YAML::Node root;
+  try {
+    root = YAML::LoadFile(filename);
+  } catch (const std::exception &e) {
+    LOG_ERROR(logger) << "Load conf file: " << filename << " failed: " << e.what();
+    return false;
+  }
+  if (!LoadFromYaml(root)) {
+    LOG_ERROR(logger) << "Load conf file: " << filename << " rejected";
+    return false;
+  }
+  LOG_INFO(logger) << "Load conf file: " << filename << " ok";
+  return true;
 }
 
 static std::unordered_map<std::string, int64_t> file2modifytime;
@@ -98,13 +129,7 @@ void ConfigManager::LoadFromConfDir(std::string_view path, bool force) {
       }
       file2modifytime[i] = st.st_mtime;
     }
-    try {
-      YAML::Node root = YAML::LoadFile(i);
-      LoadFromYaml(root);
-      LOG_INFO(logger) << "Load conf file: " << i << " ok\n";
-    } catch (...) {
-      LOG_ERROR(logger) << "Load conf file: " << i << " failed\n";
-    }
+    LoadFromFile(i);
   }
 }
 
@@ -2,8 +2,10 @@
 #define _WTSCLWQ_CONFIG_
 
 #include <yaml-cpp/node/node.h>
+#include <pthread.h>
 #include <yaml-cpp/yaml.h>
 #include <algorithm>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
 #include <cstdint>
 #include <iostream>
@@ -47,6 +49,12 @@ class ConfigItemBase {
    */
   virtual auto FromString(const std::string &str) -> bool = 0;
 
+  /**
+   * @brief 检查字符串能否转换成合法的值，不修改配置项
+   * @return true 可以使用FromString设置
+   */
+  virtual auto Validate(const std::string &str) -> bool = 0;
+
   /**
    * @brief 获取配置参数的类型名称
    * @return std::string
@@ -80,8 +88,10 @@ template <typename T, typename FromStr = LexicalCast<std::string, T>, typename T
 class ConfigItem : public ConfigItemBase {
  public:
   using s_ptr = std::shared_ptr<ConfigItem>;
-  using MutexType = std::shared_mutex;
+  using MutexType = std::mutex;
   using OnChangeCallback = std::function<void(const T &old_value, const T &new_value)>;
+  using Validator = std::function<bool(const T &value)>;
+  using Snapshot = std::shared_ptr<const T>;
 
   /**
    * @brief 通过参数名、默认值、描述构造配置项
@@ -103,18 +113,36 @@ class ConfigItem : public ConfigItemBase {
    */
   auto FromString(const std::string &str) -> bool override;
 
+  /**
+   * @brief 检查yaml字符串能否转换成T类型，并且通过校验函数
+   */
+  auto Validate(const std::string &str) -> bool override;
+
+  /**
+   * @brief 设置校验函数，FromString和Validate会拒绝校验失败的值，SetValue不做校验
+   */
+  void SetValidator(Validator validator);
+
   /**
    * @brief 返回配置项的类型名称
    */
   auto GetType() const -> std::string override;
 
   /**
-   * @brief 获取配置项的值
+   * @brief 获取配置项的值，返回当前快照的拷贝
    */
   auto GetValue() const -> T;
 
   /**
-   * @brief 设置配置项的值
+   * @brief 获取配置项当前值的只读快照，不拷贝值
+   * @details 每个线程缓存最近读到的快照，版本号没有变化时只有一次原子读取，不加锁；
+   * 之后的修改发布新的快照，不会修改已经发布的快照，旧快照在最后一个持有者释放之后回收
+   * @return 调用者持有的快照，可以跨过挂起和之后的读取继续使用
+   */
+  auto GetSnapshot() const -> Snapshot;
+
+  /**
+   * @brief 设置配置项的值，发布新的快照之后调用所有回调函数
    */
   void SetValue(const T &value);
 
@@ -140,9 +168,40 @@ class ConfigItem : public ConfigItemBase {
   void ClearListener();
 
  private:
-  T val_{};
-  std::unordered_map<uint64_t, OnChangeCallback> cbs_{};
-  mutable MutexType mutex_{};
+  /**
+   * @brief 线程缓存的快照
+   */
+  struct CachedSnapshot {
+    uint64_t version_{0};  // 快照的版本号
+    Snapshot snapshot_{};  // 快照
+  };
+
+  /**
+   * @brief 一个线程缓存的所有配置项快照
+   */
+  struct SnapshotCache {
+    std::unordered_map<const ConfigItem *, CachedSnapshot> entries_{};  // 配置项 -> 缓存的快照
+    const ConfigItem *last_item_{nullptr};  // 上一次读取的配置项，连续读取同一个配置项时不查找哈希表
+    CachedSnapshot *last_entry_{nullptr};   // 上一次读取的配置项对应的缓存
+  };
+
+  /**
+   * @brief 获取当前线程的快照缓存
+   * @details 缓存由pthread key的析构函数释放，它在线程所有thread_local对象析构之后才执行，
+   * 线程退出时析构的thread_local对象（比如共享栈归还到栈池）仍然可以读取配置
+   */
+  static auto GetThreadSnapshotCache() -> SnapshotCache *;
+
+  /**
+   * @brief 生成新的快照版本号，同一种配置项类型内全局唯一，配置项析构之后地址被复用也不会命中旧的线程缓存
+   */
+  static auto NextVersion() -> uint64_t;
+
+  Snapshot curr_{};                                       // 当前发布的快照，通过std::atomic_load/store访问
+  std::atomic<uint64_t> version_{0};                      // 当前快照的版本号
+  std::unordered_map<uint64_t, OnChangeCallback> cbs_{};  // 配置变化回调函数
+  Validator validator_{nullptr};                          // 校验函数，为空表示不校验
+  mutable MutexType mutex_{};                             // 保护写者和回调函数，读者不加锁
 };
 
 /**
@@ -175,8 +234,16 @@ class ConfigManager {
 
   /**
    * @brief 使用YAML::Node初始化配置项
+   * @details 先检查所有配置项的值，只要有一个不合法就整体拒绝，不修改任何配置项
+   * @return 是否应用成功
    */
-  void LoadFromYaml(const YAML::Node &root);
+  auto LoadFromYaml(const YAML::Node &root) -> bool;
+
+  /**
+   * @brief 加载一个配置文件，解析失败或者校验失败时不修改任何配置项
+   * @return 是否加载成功
+   */
+  auto LoadFromFile(const std::string &filename) -> bool;
 
   /**
    * @brief 从path文件夹中加载配置文件
@@ -314,14 +381,15 @@ class LexicalCast<std::unordered_map<std::string, T>, std::string> {
 
 template <typename T, typename FromStr, typename ToStr>
 ConfigItem<T, FromStr, ToStr>::ConfigItem(std::string_view name, const T &default_value, std::string_view description)
-    : ConfigItemBase(name, description), val_(default_value) {}
+    : ConfigItemBase(name, description) {
+  curr_ = std::make_shared<const T>(default_value);
+  version_.store(NextVersion(), std::memory_order_release);
+}
 
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::ToString() -> std::string {
   try {
-    // 读锁
-    std::shared_lock<MutexType> lock(mutex_);
-    return ToStr()(val_);
+    return ToStr()(*GetSnapshot());
   } catch (const std::exception &e) {
     LOG_ERROR(ROOT_LOGGER) << "ConfigVar::toString exception " << e.what() << " convert: " << TypeToName<T>()
                            << " to string"
@@ -333,7 +401,17 @@ auto ConfigItem<T, FromStr, ToStr>::ToString() -> std::string {
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::FromString(const std::string &str) -> bool {
   try {
-    SetValue(FromStr()(str));
+    T value = FromStr()(str);
+    Validator validator;
+    {
+      std::lock_guard<MutexType> lock(mutex_);
+      validator = validator_;
+    }
+    if (validator != nullptr && !validator(value)) {
+      LOG_ERROR(ROOT_LOGGER) << "ConfigVar::fromString invalid value, name=" << name_ << " - " << str;
+      return false;
+    }
+    SetValue(value);
   } catch (const std::exception &e) {
     LOG_ERROR(ROOT_LOGGER) << "ConfigVar::fromString exception " << e.what() << " convert: string to "
                            << TypeToName<T>() << " name=" << name_ << " - " << str << std::endl;
@@ -342,6 +420,29 @@ auto ConfigItem<T, FromStr, ToStr>::FromString(const std::string &str) -> bool {
   return true;
 }
 
+template <typename T, typename FromStr, typename ToStr>
+auto ConfigItem<T, FromStr, ToStr>::Validate(const std::string &str) -> bool {
+  try {
+    T value = FromStr()(str);
+    std::lock_guard<MutexType> lock(mutex_);
+    if (validator_ != nullptr && !validator_(value)) {
+      LOG_ERROR(ROOT_LOGGER) << "ConfigVar::validate invalid value, name=" << name_ << " - " << str;
+      return false;
+    }
+  } catch (const std::exception &e) {
+    LOG_ERROR(ROOT_LOGGER) << "ConfigVar::validate exception " << e.what() << " convert: string to " << TypeToName<T>()
+                           << " name=" << name_ << " - " << str;
+    return false;
+  }
+  return true;
+}
+
+template <typename T, typename FromStr, typename ToStr>
+void ConfigItem<T, FromStr, ToStr>::SetValidator(Validator validator) {
+  std::lock_guard<MutexType> lock(mutex_);
+  validator_ = std::move(validator);
+}
+
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::GetType() const -> std::string {
   return typeid(T).name();
@@ -349,34 +450,73 @@ auto ConfigItem<T, FromStr, ToStr>::GetType() const -> std::string {
 
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::GetValue() const -> T {
-  // 读锁
-  std::shared_lock<MutexType> lock(mutex_);
-  return val_;
+  return *GetSnapshot();
 }
 
 template <typename T, typename FromStr, typename ToStr>
-void ConfigItem<T, FromStr, ToStr>::SetValue(const T &value) {
-  {
-    // 读锁
-    std::shared_lock<MutexType> lock(mutex_);
-    if (val_ == value) {
-      return;
-    }
+auto ConfigItem<T, FromStr, ToStr>::GetSnapshot() const -> Snapshot {
+  // 配置很少变化，绝大多数读取命中线程缓存，只读取共享的版本号，多个核心同时读取不会争抢锁
+  SnapshotCache *cache = GetThreadSnapshotCache();
+  if (cache->last_item_ != this) {
+    cache->last_entry_ = &cache->entries_[this];
+    cache->last_item_ = this;
   }
-  // 写锁
+  auto &cached = *cache->last_entry_;
+  uint64_t version = version_.load(std::memory_order_acquire);
+  if (cached.version_ != version) {
+    // 不持有mutex_，回调函数中也可以读取
+    cached.snapshot_ = std::atomic_load_explicit(&curr_, std::memory_order_acquire);
+    cached.version_ = version;
+  }
+  // 线程缓存会在下一次读取到新版本时被替换，返回它的拷贝
+  return cached.snapshot_;
+}
+
+template <typename T, typename FromStr, typename ToStr>
+void ConfigItem<T, FromStr, ToStr>::SetValue(const T &value) {
   std::lock_guard<MutexType> lock(mutex_);
-  // 发生变动，调用所有回调函数
+  if (*std::atomic_load_explicit(&curr_, std::memory_order_relaxed) == value) {
+    return;
+  }
+  // 旧快照由仍然持有它的读者和线程缓存共同引用，全部释放之后回收
+  Snapshot new_value = std::make_shared<const T>(value);
+  Snapshot old_value = std::atomic_exchange_explicit(&curr_, new_value, std::memory_order_acq_rel);
+  version_.store(NextVersion(), std::memory_order_release);
+  // 发生变动，调用所有回调函数，回调函数中读取到的已经是新值
   for (auto &it : cbs_) {
-    it.second(val_, value);
+    it.second(*old_value, *new_value);
   }
-  val_ = value;
+}
+
+template <typename T, typename FromStr, typename ToStr>
+auto ConfigItem<T, FromStr, ToStr>::GetThreadSnapshotCache() -> SnapshotCache * {
+  static thread_local SnapshotCache *t_cache = nullptr;
+  static pthread_key_t s_key = [] {
+    pthread_key_t key;
+    pthread_key_create(&key, [](void *cache) {
+      delete static_cast<SnapshotCache *>(cache);
+      // 其他pthread key的析构函数中再次读取时重新创建，pthread会再调用一轮析构函数
+      t_cache = nullptr;
+    });
+    return key;
+  }();
+  if (t_cache == nullptr) {
+    t_cache = new SnapshotCache();
+    pthread_setspecific(s_key, t_cache);
+  }
+  return t_cache;
+}
+
+template <typename T, typename FromStr, typename ToStr>
+auto ConfigItem<T, FromStr, ToStr>::NextVersion() -> uint64_t {
+  static std::atomic<uint64_t> s_version{0};
+  return ++s_version;
 }
 
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::AddListener(OnChangeCallback cb) -> uint64_t {
   // key从0开始，每次加1
   static uint64_t key = 0;
-  // 写锁
   std::lock_guard<MutexType> lock(mutex_);
   ++key;
   cbs_.emplace(key, cb);
@@ -385,22 +525,19 @@ auto ConfigItem<T, FromStr, ToStr>::AddListener(OnChangeCallback cb) -> uint64_t
 
 template <typename T, typename FromStr, typename ToStr>
 void ConfigItem<T, FromStr, ToStr>::DelListener(uint64_t key) {
-  // 写锁
   std::lock_guard<MutexType> lock(mutex_);
   cbs_.erase(key);
 }
 
 template <typename T, typename FromStr, typename ToStr>
 auto ConfigItem<T, FromStr, ToStr>::GetListener(uint64_t key) -> OnChangeCallback {
-  // 读锁
-  std::shared_lock<MutexType> lock(mutex_);
+  std::lock_guard<MutexType> lock(mutex_);
   auto it = cbs_.find(key);
   return it == cbs_.end() ? nullptr : it->second;
 }
 
 template <typename T, typename FromStr, typename ToStr>
 void ConfigItem<T, FromStr, ToStr>::ClearListener() {
-  // 写锁
   std::lock_guard<MutexType> lock(mutex_);
   cbs_.clear();
 }
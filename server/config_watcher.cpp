@@ -0,0 +1,185 @@
+#include "config_watcher.h"
+
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "server/config.h"
+#include "server/env.h"
+#include "server/log.h"
+
+namespace wtsclwq {
+static auto sys_logger = NAMED_LOGGER("system");
+
+// 配置文件最后一次变化之后等待多久再加载，编辑器保存一个文件往往会产生多个事件
+static auto config_reload_debounce = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "config.reload_debounce", 200, "ms to wait after the last change of a config file before reloading it");
+
+// 文件写完或者被移动到目录中时加载，新建的子目录需要加入监视
+static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+static auto IsConfigFile(std::string_view name) -> bool {
+  constexpr std::string_view suffix = ".yml";
+  return name.size() > suffix.size() && name.substr(name.size() - suffix.size()) == suffix;
+}
+
+ConfigWatcher::ConfigWatcher(SockIoScheduler::s_ptr io_scheduler, std::string_view path)
+    : io_scheduler_(std::move(io_scheduler)), path_(EnvMgr::GetInstance()->GetAbsoluteSubPath(path)) {}
+
+ConfigWatcher::~ConfigWatcher() { Stop(); }
+
+auto ConfigWatcher::Start() -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (inotify_fd_ >= 0) {
+    return true;
+  }
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    LOG_ERROR(sys_logger) << "ConfigWatcher inotify_init1 failed, errno=" << errno << " " << strerror(errno);
+    return false;
+  }
+  AddWatch(path_);
+  if (wd_dirs_.empty()) {
+    close(inotify_fd_);
+    inotify_fd_ = -1;
+    return false;
+  }
+  // 事件的回调在注册它的线程所属的调度器中执行，所以要在调度器中注册
+  std::weak_ptr<ConfigWatcher> weak_self = shared_from_this();
+  io_scheduler_->Schedule([weak_self] {
+    if (auto self = weak_self.lock()) {
+      std::lock_guard<std::mutex> lock(self->mutex_);
+      self->WaitReadable();
+    }
+  });
+  LOG_INFO(sys_logger) << "ConfigWatcher start watching " << path_;
+  return true;
+}
+
+void ConfigWatcher::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (inotify_fd_ < 0) {
+    return;
+  }
+  if (reload_timer_ != nullptr) {
+    reload_timer_->Cancel();
+    reload_timer_ = nullptr;
+  }
+  pending_files_.clear();
+  wd_dirs_.clear();
+  // 触发等待中的回调，回调发现已经停止之后直接返回
+  io_scheduler_->CloseEventListening(inotify_fd_);
+  close(inotify_fd_);
+  inotify_fd_ = -1;
+}
+
+void ConfigWatcher::AddWatch(const std::string &dir) {
+  int wd = inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_MASK);
+  if (wd < 0) {
+    LOG_ERROR(sys_logger) << "ConfigWatcher watch " << dir << " failed, errno=" << errno << " " << strerror(errno);
+    return;
+  }
+  wd_dirs_[wd] = dir;
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) {
+    return;
+  }
+  struct dirent *dp = nullptr;
+  while ((dp = readdir(d)) != nullptr) {
+    if (dp->d_type == DT_DIR && strcmp(dp->d_name, ".") != 0 && strcmp(dp->d_name, "..") != 0) {
+      AddWatch(dir + "/" + dp->d_name);
+    }
+  }
+  closedir(d);
+}
+
+void ConfigWatcher::WaitReadable() {
+  if (inotify_fd_ < 0) {
+    return;
+  }
+  std::weak_ptr<ConfigWatcher> weak_self = shared_from_this();
+  io_scheduler_->AddEventListening(inotify_fd_, FileDescContext::Read, [weak_self] {
+    if (auto self = weak_self.lock()) {
+      self->OnReadable();
+    }
+  });
+}
+
+void ConfigWatcher::OnReadable() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (inotify_fd_ < 0) {
+    return;
+  }
+  // fd以边缘触发注册，必须读到EAGAIN为止
+  alignas(inotify_event) char buf[4096];
+  bool changed = false;
+  while (true) {
+    ssize_t n = read(inotify_fd_, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    for (char *p = buf; p < buf + n;) {
+      auto *event = reinterpret_cast<inotify_event *>(p);
+      p += sizeof(inotify_event) + event->len;
+      auto it = wd_dirs_.find(event->wd);
+      if (it == wd_dirs_.end() || event->len == 0) {
+        continue;
+      }
+      std::string name = it->second + "/" + event->name;
+      if ((event->mask & IN_ISDIR) != 0) {
+        if ((event->mask & IN_CREATE) != 0) {
+          AddWatch(name);
+        }
+      } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0 && IsConfigFile(event->name)) {
+        pending_files_.insert(name);
+        changed = true;
+      }
+    }
+  }
+
+  if (changed) {
+    // 每次变化都把加载推迟到最后一次变化的debounce毫秒之后
+    auto debounce = static_cast<uint64_t>(std::max(config_reload_debounce->GetValue(), 0));
+    if (reload_timer_ == nullptr || !reload_timer_->Reset(debounce, true)) {
+      std::weak_ptr<ConfigWatcher> weak_self = shared_from_this();
+      // 定时器回调在Idle协程中直接执行，加载和配置项的回调可能很慢、可能做文件IO，作为普通任务调度
+      reload_timer_ = io_scheduler_->AddTimer(debounce, [weak_self] {
+        if (auto self = weak_self.lock()) {
+          self->io_scheduler_->Schedule([self] { self->Reload(); });
+        }
+      });
+    }
+  }
+  WaitReadable();
+}
+
+void ConfigWatcher::Reload() {
+  std::set<std::string> files;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inotify_fd_ < 0) {
+      return;
+    }
+    files.swap(pending_files_);
+    reload_timer_ = nullptr;
+  }
+  // 加载时不持有锁，配置项的回调函数可能很慢，期间发生的变化会安排下一次加载
+  for (auto &file : files) {
+    if (access(file.c_str(), R_OK) != 0) {
+      continue;
+    }
+    if (ConfigMgr::GetInstance()->LoadFromFile(file)) {
+      ++reload_count_;
+    } else {
+      ++reject_count_;
+    }
+  }
+}
+}  // namespace wtsclwq
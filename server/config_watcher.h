@@ -0,0 +1,89 @@
+#ifndef _CONFIG_WATCHER_H_
+#define _CONFIG_WATCHER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "server/noncopyable.h"
+#include "server/sock_io_scheduler.h"
+#include "server/timer.h"
+
+namespace wtsclwq {
+/**
+ * @brief 配置文件监视器，配置目录中的yml文件发生变化时重新加载该文件
+ * @details 把inotify的fd注册到IO调度器上，不需要单独的轮询线程；一段时间内的多次修改合并为一次加载，
+ * 加载时先校验文件中的所有配置项，任何一个不合法都整体拒绝，合法时通过配置项的回调函数应用变化
+ */
+class ConfigWatcher : public std::enable_shared_from_this<ConfigWatcher>, Noncopyable {
+ public:
+  using s_ptr = std::shared_ptr<ConfigWatcher>;
+
+  /**
+   * @brief 构造函数
+   * @param io_scheduler 处理inotify事件和重新加载配置的IO调度器
+   * @param path 配置目录，相对路径相对于程序所在目录，包括所有子目录
+   */
+  ConfigWatcher(SockIoScheduler::s_ptr io_scheduler, std::string_view path);
+
+  ~ConfigWatcher() override;
+
+  /**
+   * @brief 开始监视配置目录
+   * @return 是否成功，目录不存在或者inotify不可用时失败
+   */
+  auto Start() -> bool;
+
+  /**
+   * @brief 停止监视，还没有加载的修改被丢弃
+   */
+  void Stop();
+
+  /**
+   * @brief 成功加载的文件次数
+   */
+  auto GetReloadCount() const -> uint64_t { return reload_count_; }
+
+  /**
+   * @brief 因为解析失败或者校验失败被拒绝的文件次数
+   */
+  auto GetRejectCount() const -> uint64_t { return reject_count_; }
+
+ private:
+  /**
+   * @brief 监视一个目录以及它的所有子目录，调用者需要持有mutex_
+   */
+  void AddWatch(const std::string &dir);
+
+  /**
+   * @brief 等待inotify的fd可读
+   */
+  void WaitReadable();
+
+  /**
+   * @brief 读取所有inotify事件，记录发生变化的文件，并推迟加载的时间
+   */
+  void OnReadable();
+
+  /**
+   * @brief 加载所有发生变化的文件
+   */
+  void Reload();
+
+  SockIoScheduler::s_ptr io_scheduler_{nullptr};    // 处理事件的IO调度器
+  std::string path_{};                              // 配置目录的绝对路径
+  int inotify_fd_{-1};                              // inotify的fd，-1表示没有启动
+  std::unordered_map<int, std::string> wd_dirs_{};  // 监视描述符对应的目录
+  std::set<std::string> pending_files_{};           // 发生变化、等待加载的文件
+  Timer::s_ptr reload_timer_{nullptr};              // 延迟加载的定时器
+  std::atomic<uint64_t> reload_count_{0};           // 成功加载的次数
+  std::atomic<uint64_t> reject_count_{0};           // 被拒绝的次数
+  std::mutex mutex_{};                              // 保护以上状态
+};
+}  // namespace wtsclwq
+
+#endif  // _CONFIG_WATCHER_H_
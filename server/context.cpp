@@ -0,0 +1,192 @@
+#include "context.h"
+#include <cstdint>
+#include "macro.h"
+
+#ifndef WTSCLWQ_USE_UCONTEXT
+extern "C" {
+/**
+ * @brief 将当前的寄存器保存在当前栈上，栈顶写入*from_sp，然后切换到to_sp指向的栈并恢复寄存器
+ */
+__attribute__((visibility("hidden"))) void wtsclwq_context_swap(void **from_sp, void *to_sp);
+
+/**
+ * @brief 新上下文第一次被切换进来时的返回地址，负责调用保存在寄存器中的入口函数
+ */
+__attribute__((visibility("hidden"))) void wtsclwq_context_entry();
+}
+
+#if defined(__x86_64__)
+// 被调用者保存的寄存器：rbx rbp r12-r15，以及MXCSR和x87控制字
+// 栈布局（从高到低）：返回地址 rbp rbx r12 r13 r14 r15 [mxcsr|x87cw]
+asm(R"(
+    .text
+    .globl wtsclwq_context_swap
+    .hidden wtsclwq_context_swap
+    .type wtsclwq_context_swap, @function
+    .align 16
+wtsclwq_context_swap:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size wtsclwq_context_swap, .-wtsclwq_context_swap
+
+    .globl wtsclwq_context_entry
+    .hidden wtsclwq_context_entry
+    .type wtsclwq_context_entry, @function
+    .align 16
+wtsclwq_context_entry:
+    callq *%r12
+    ud2
+    .size wtsclwq_context_entry, .-wtsclwq_context_entry
+)");
+#elif defined(__aarch64__)
+// 被调用者保存的寄存器：x19-x28 fp(x29) lr(x30)，以及d8-d15
+asm(R"(
+    .text
+    .globl wtsclwq_context_swap
+    .hidden wtsclwq_context_swap
+    .type wtsclwq_context_swap, %function
+    .align 4
+wtsclwq_context_swap:
+    sub sp, sp, #160
+    stp x19, x20, [sp, #0]
+    stp x21, x22, [sp, #16]
+    stp x23, x24, [sp, #32]
+    stp x25, x26, [sp, #48]
+    stp x27, x28, [sp, #64]
+    stp x29, x30, [sp, #80]
+    stp d8, d9, [sp, #96]
+    stp d10, d11, [sp, #112]
+    stp d12, d13, [sp, #128]
+    stp d14, d15, [sp, #144]
+    mov x2, sp
+    str x2, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0]
+    ldp x21, x22, [sp, #16]
+    ldp x23, x24, [sp, #32]
+    ldp x25, x26, [sp, #48]
+    ldp x27, x28, [sp, #64]
+    ldp x29, x30, [sp, #80]
+    ldp d8, d9, [sp, #96]
+    ldp d10, d11, [sp, #112]
+    ldp d12, d13, [sp, #128]
+    ldp d14, d15, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size wtsclwq_context_swap, .-wtsclwq_context_swap
+
+    .globl wtsclwq_context_entry
+    .hidden wtsclwq_context_entry
+    .type wtsclwq_context_entry, %function
+    .align 4
+wtsclwq_context_entry:
+    blr x19
+    brk #0
+    .size wtsclwq_context_entry, .-wtsclwq_context_entry
+)");
+#endif
+#endif
+
+namespace wtsclwq {
+#ifdef WTSCLWQ_USE_UCONTEXT
+void Context::InitCurrent() {
+  if (getcontext(&ctx_) != 0) {
+    ASSERT(false);
+  }
+}
+
+void Context::Init(void *stack, size_t stack_size, EntryFunc entry) {
+  if (getcontext(&ctx_) != 0) {
+    ASSERT(false);
+  }
+  ctx_.uc_stack.ss_sp = stack;         // 栈指针 sp
+  ctx_.uc_stack.ss_size = stack_size;  // 栈大小
+  ctx_.uc_link = nullptr;
+  makecontext(&ctx_, entry, 0);
+}
+
+void Context::Swap(Context *from, Context *to) {
+  if (swapcontext(&from->ctx_, &to->ctx_) == -1) {
+    ASSERT(false);
+  }
+}
+
+auto Context::GetStackPointer() const -> void * {
+#if defined(__x86_64__)
+  return reinterpret_cast<void *>(ctx_.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+  return reinterpret_cast<void *>(ctx_.uc_mcontext.sp);
+#else
+  return nullptr;
+#endif
+}
+
+auto Context::GetBackendName() -> const char * { return "ucontext"; }
+#else
+void Context::InitCurrent() {
+  // 正在执行的上下文不需要初始化，第一次被切出时寄存器会保存到它自己的栈上
+  sp_ = nullptr;
+}
+
+void Context::Init(void *stack, size_t stack_size, EntryFunc entry) {
+  // 栈顶按16字节对齐，再预留16字节，保证入口函数被调用时满足ABI的对齐要求
+  auto top = (reinterpret_cast<uintptr_t>(stack) + stack_size) & ~static_cast<uintptr_t>(15);
+  auto *frame = reinterpret_cast<uint64_t *>(top - 16);
+#if defined(__x86_64__)
+  // 与wtsclwq_context_swap的出栈顺序一一对应：[mxcsr|x87cw] r15 r14 r13 r12 rbx rbp 返回地址
+  constexpr uint64_t default_mxcsr = 0x1F80;   // 屏蔽所有浮点异常，就近舍入
+  constexpr uint64_t default_x87_cw = 0x037F;  // 屏蔽所有浮点异常，扩展精度，就近舍入
+  frame -= 8;
+  frame[0] = default_mxcsr | (default_x87_cw << 32);
+  frame[1] = 0;                                     // r15
+  frame[2] = 0;                                     // r14
+  frame[3] = 0;                                     // r13
+  frame[4] = reinterpret_cast<uint64_t>(entry);     // r12，由wtsclwq_context_entry调用
+  frame[5] = 0;                                     // rbx
+  frame[6] = 0;                                     // rbp
+  frame[7] = reinterpret_cast<uint64_t>(&wtsclwq_context_entry);  // 返回地址
+  // ret之后rsp == top - 16，满足16字节对齐，call入口函数之后rsp % 16 == 8，符合ABI
+#elif defined(__aarch64__)
+  // 与wtsclwq_context_swap的出栈顺序一一对应：x19-x28 x29 x30 d8-d15
+  frame -= 20;
+  for (int i = 0; i < 20; i++) {
+    frame[i] = 0;
+  }
+  frame[0] = reinterpret_cast<uint64_t>(entry);                    // x19，由wtsclwq_context_entry调用
+  frame[11] = reinterpret_cast<uint64_t>(&wtsclwq_context_entry);  // x30，ret的目标地址
+#endif
+  sp_ = frame;
+}
+
+void Context::Swap(Context *from, Context *to) { wtsclwq_context_swap(&from->sp_, to->sp_); }
+
+auto Context::GetStackPointer() const -> void * { return sp_; }
+
+auto Context::GetBackendName() -> const char * {
+#if defined(__x86_64__)
+  return "asm-x86_64";
+#else
+  return "asm-aarch64";
+#endif
+}
+#endif
+}  // namespace wtsclwq
@@ -0,0 +1,62 @@
+#ifndef _WTSCLWQ_CONTEXT_
+#define _WTSCLWQ_CONTEXT_
+
+#include <cstddef>
+
+// 只有x86-64和aarch64提供了汇编实现，其他平台退化为ucontext
+#if !defined(__x86_64__) && !defined(__aarch64__) && !defined(WTSCLWQ_USE_UCONTEXT)
+#define WTSCLWQ_USE_UCONTEXT
+#endif
+
+#ifdef WTSCLWQ_USE_UCONTEXT
+#include <ucontext.h>
+#endif
+
+namespace wtsclwq {
+/**
+ * @brief 协程的执行上下文，负责上下文的初始化和切换
+ * @details 默认使用汇编实现，只保存被调用者保存的寄存器以及浮点控制字，不涉及信号掩码，因此切换时没有系统调用；
+ * 编译时定义WTSCLWQ_USE_UCONTEXT（cmake选项USE_UCONTEXT）则使用glibc的ucontext实现
+ */
+class Context {
+ public:
+  using EntryFunc = void (*)();
+
+  /**
+   * @brief 将当前正在执行的线程上下文保存到this，用于线程的主协程
+   */
+  void InitCurrent();
+
+  /**
+   * @brief 初始化一个新的上下文，切换到该上下文时从entry开始执行
+   * @param stack 栈空间的低地址
+   * @param stack_size 栈空间的大小
+   * @param entry 入口函数，不允许返回
+   */
+  void Init(void *stack, size_t stack_size, EntryFunc entry);
+
+  /**
+   * @brief 保存当前上下文到from，并切换到to
+   */
+  static void Swap(Context *from, Context *to);
+
+  /**
+   * @brief 获取上下文被切出时的栈顶指针，上下文正在执行时该值无意义
+   */
+  auto GetStackPointer() const -> void *;
+
+  /**
+   * @brief 获取当前使用的上下文实现的名称
+   */
+  static auto GetBackendName() -> const char *;
+
+ private:
+#ifdef WTSCLWQ_USE_UCONTEXT
+  ucontext_t ctx_{};
+#else
+  void *sp_{nullptr};  // 上下文被切出时的栈顶，寄存器保存在栈上
+#endif
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_CONTEXT_
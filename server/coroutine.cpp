@@ -1,13 +1,15 @@
 #include "coroutine.h"
-#include <ucontext.h>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <utility>
 #include "config.h"
 #include "log.h"
 #include "macro.h"
+#include "stack_pool.h"
+#include "utils.h"
 
 namespace wtsclwq {
 static auto sys_logger = NAMED_LOGGER("system");
@@ -28,57 +30,89 @@ static thread_local Coroutine::s_ptr thread_main_coroutine = nullptr;
 static auto coroutine_stack_size =
     ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem("coroutine.stack_size", 128 * 1024, "fiber stack size");
 
-class MallocStackAlloctor {
+/**
+ * @brief 从栈池中分配带保护页的mmap栈，协程销毁后栈被缓存复用
+ */
+class PooledStackAlloctor {
  public:
-  static auto Alloc(size_t size) -> void * { return std::malloc(size); }
+  static auto Alloc(size_t size) -> void * { return StackPool::GetInstance()->Alloc(size); }
 
-  static void Dealloc(void *p) { free(p); }
+  static void Dealloc(void *p, size_t size) { StackPool::GetInstance()->Dealloc(p, size); }
 };
 
-using StackAlloctor = MallocStackAlloctor;
+using StackAlloctor = PooledStackAlloctor;
+
+// 共享栈的大小，同一个线程内所有共享栈协程共用一个栈
+static auto coroutine_shared_stack_size = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "coroutine.shared_stack_size", 1024 * 1024, "per thread shared stack size for shared stack coroutines");
+
+/**
+ * @brief 线程的共享栈，第一次使用时分配，线程退出时归还到栈池
+ */
+struct SharedStack {
+  void *stack_{nullptr};
+  size_t size_{0};
+  auto Top() -> char * { return static_cast<char *>(stack_) + size_; }
+  ~SharedStack() {
+    if (stack_ != nullptr) {
+      StackAlloctor::Dealloc(stack_, size_);
+    }
+  }
+};
+
+static thread_local SharedStack thread_shared_stack{};
+
+static auto GetThreadSharedStack() -> SharedStack & {
+  if (thread_shared_stack.stack_ == nullptr) {
+    thread_shared_stack.size_ = coroutine_shared_stack_size->GetValue();
+    thread_shared_stack.stack_ = StackAlloctor::Alloc(thread_shared_stack.size_);
+    ASSERT(thread_shared_stack.stack_ != nullptr);
+  }
+  return thread_shared_stack;
+}
 
 Coroutine::Coroutine() {
   // 初始化调用构造函数的线程的主协程
   state_ = Running;
   id_ = next_coroutine_id++;
   ++system_coroutine_count;
-  // 初始化context_t对象，用来swapcontext(见man swapcontext)
-  if (getcontext(&context_) != 0) {
-    ASSERT(false);
-  }
+  // 主协程的上下文就是线程当前的执行上下文
+  context_.InitCurrent();
   LOG_DEBUG(sys_logger) << "Coroutine " << id_ << " created";
 }
 
-Coroutine::Coroutine(std::function<void()> task, uint32_t stack_size, bool has_parent, const s_ptr &parent)
+Coroutine::Coroutine(TaskFunc task, uint32_t stack_size, bool has_parent, const s_ptr &parent,
+                     bool use_shared_stack)
     : id_(next_coroutine_id++),
       stack_size_(stack_size == 0 ? coroutine_stack_size->GetValue() : stack_size),
       task_func_(std::move(task)),
       parent_(parent),
-      has_parent_(has_parent) {
+      has_parent_(has_parent),
+      use_shared_stack_(use_shared_stack) {
   ++system_coroutine_count;
+  if (use_shared_stack_) {
+    // 共享栈协程在第一次Resume时才绑定线程并初始化上下文
+    stack_size_ = 0;
+    LOG_DEBUG(sys_logger) << "Coroutine " << id_ << " created with shared stack";
+    return;
+  }
   stack_ = StackAlloctor::Alloc(stack_size_);
 
   if (stack_ == nullptr) {
     ASSERT(false);
   }
 
-  if (getcontext(&context_) == -1) {
-    ASSERT(false);
-  }
-
-  context_.uc_stack.ss_sp = stack_;         // 栈指针 sp
-  context_.uc_stack.ss_size = stack_size_;  // 栈大小
-  context_.uc_link = nullptr;
-
-  makecontext(&context_, &MainFunc, 0);
+  context_.Init(stack_, stack_size_, &MainFunc);
   LOG_DEBUG(sys_logger) << "Coroutine " << id_ << " created";
 }
 
 Coroutine::~Coroutine() {
-  // stack_非空，说明this是一个子协程，需要释放栈空间并且确保协程结束
-  if (stack_ != nullptr) {
+  // stack_非空或者使用共享栈，说明this是一个子协程，需要释放栈空间并且确保协程结束
+  if (use_shared_stack_) {
+    ASSERT(state_ == State::Stop || !context_inited_);
+  } else if (stack_ != nullptr) {
     ASSERT(state_ == State::Stop);
-    StackAlloctor::Dealloc(stack_);
+    StackAlloctor::Dealloc(stack_, stack_size_);
   } else {
     // stack_为空，说明this是一个主协程
     ASSERT(state_ == State::Running);  // 主协程销毁时，必然处于运行状态·
@@ -94,20 +128,20 @@ Coroutine::~Coroutine() {
   LOG_DEBUG(sys_logger) << "Coroutine " << id_ << " destroyed";
 }
 
-void Coroutine::ResetTaskFunc(std::function<void()> new_task_func) {
-  ASSERT(stack_ != nullptr);  // 只有子协程才能被重置
+void Coroutine::ResetTaskFunc(TaskFunc new_task_func) {
+  ASSERT(stack_ != nullptr || use_shared_stack_);  // 只有子协程才能被重置
 
   task_func_ = std::move(new_task_func);
-  if (getcontext(&context_) == -1) {
-    LOG_ERROR(sys_logger) << "getcontext failed";
-    ASSERT(false);
+  if (use_shared_stack_) {
+    // 共享栈协程解除与线程的绑定，下一次Resume时重新初始化上下文
+    context_inited_ = false;
+    bound_thread_id_ = -1;
+    saved_stack_size_ = 0;
+    state_ = State::Ready;
+    return;
   }
-
   // 重置协程上下文
-  context_.uc_stack.ss_sp = stack_;
-  context_.uc_stack.ss_size = stack_size_;
-  context_.uc_link = nullptr;
-  makecontext(&context_, &MainFunc, 0);
+  context_.Init(stack_, stack_size_, &MainFunc);
 
   state_ = State::Ready;
 }
@@ -122,31 +156,71 @@ void Coroutine::Resume() {
   Coroutine *raw_ptr = parent_ptr.get();
   ASSERT(parent_ptr != nullptr);
   parent_ptr.reset();
-  if (swapcontext(&(raw_ptr->context_), &context_) == -1) {
-    ASSERT(false);
+  if (!use_shared_stack_) {
+    Context::Swap(&(raw_ptr->context_), &context_);
+    MarkReadyAfterYield();
+    return;
+  }
+
+  // 共享栈协程：切换之前把保存的栈内容恢复到共享栈上，切换回来之后再把用到的部分拷贝出去
+  ASSERT(!raw_ptr->use_shared_stack_);  // 父协程不能运行在共享栈上，否则恢复栈内容时会覆盖父协程自己的栈
+  SharedStack &shared_stack = GetThreadSharedStack();
+  if (!context_inited_) {
+    bound_thread_id_ = GetCurrSysThreadId();
+    context_.Init(shared_stack.stack_, shared_stack.size_, &MainFunc);
+    context_inited_ = true;
+  } else {
+    ASSERT(bound_thread_id_ == GetCurrSysThreadId());
+    std::memcpy(shared_stack.Top() - saved_stack_size_, saved_stack_.get(), saved_stack_size_);
+  }
+  Context::Swap(&(raw_ptr->context_), &context_);
+  MarkReadyAfterYield();
+
+  if (state_ == State::Stop) {
+    saved_stack_.reset();
+    saved_stack_size_ = 0;
+    saved_stack_capacity_ = 0;
+    return;
   }
+  auto *sp = static_cast<char *>(context_.GetStackPointer());
+  ASSERT(sp > static_cast<char *>(shared_stack.stack_) && sp <= shared_stack.Top());
+  saved_stack_size_ = shared_stack.Top() - sp;
+  // 保存区按实际使用量分配，栈明显变浅时也收缩，避免长期挂起的协程占用过多内存
+  if (saved_stack_capacity_ < saved_stack_size_ || saved_stack_capacity_ > saved_stack_size_ * 2) {
+    saved_stack_.reset(new char[saved_stack_size_]);
+    saved_stack_capacity_ = saved_stack_size_;
+  }
+  std::memcpy(saved_stack_.get(), sp, saved_stack_size_);
 }
 
 void Coroutine::Yield() {
   ASSERT((state_ == Running || state_ == Stop));
-  if (state_ != Stop) {
-    state_ = State::Ready;
-  }
+  // 这里不能把状态置为Ready，此时寄存器还没有保存，其他线程看到Ready就可能立即Resume这个协程，
+  // 状态由父协程在切换回来之后设置，见MarkReadyAfterYield
   ASSERT(has_parent_);
   auto parent_ptr = parent_.lock();
   Coroutine *raw_ptr = parent_ptr.get();
   ASSERT(parent_ptr != nullptr);
   SetThreadRunningCoroutine(parent_ptr);
   parent_ptr.reset();
-  if (swapcontext(&context_, &(raw_ptr->context_)) == -1) {
-    ASSERT(false);
-  }
+  Context::Swap(&context_, &(raw_ptr->context_));
+}
+
+void Coroutine::MarkReadyAfterYield() {
+  State expected = State::Running;
+  state_.compare_exchange_strong(expected, State::Ready);
 }
 
 auto Coroutine::GetId() const -> uint64_t { return id_; }
 
 auto Coroutine::GetState() const -> State { return state_; }
 
+auto Coroutine::IsSharedStack() const -> bool { return use_shared_stack_; }
+
+auto Coroutine::GetBoundThreadId() const -> int { return bound_thread_id_; }
+
+auto Coroutine::GetSavedStackSize() const -> size_t { return saved_stack_size_; }
+
 void Coroutine::SetParentCoroutine(std::weak_ptr<Coroutine> parent) {
   parent_ = std::move(parent);
   has_parent_ = true;
@@ -2,10 +2,12 @@
 #define _WTSCLWQ_COROUTINE_
 
 #include <sys/types.h>
-#include <ucontext.h>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include "context.h"
+#include "task_func.h"
 #include "thread.h"
 
 namespace wtsclwq {
@@ -24,17 +26,22 @@ class Coroutine : public std::enable_shared_from_this<Coroutine> {
    * @param task 协程要执行的具体任务
    * @param stack_size 协程栈大小
    * @param if_run_in_scheduler 构造函数所在线程是否参与协程调度
+   * @param use_shared_stack 是否使用共享栈模式，此时stack_size被忽略
+   * @details 共享栈模式下，协程运行在线程的共享栈上，Yield之后只把实际使用的那部分栈拷贝出来保存，
+   * 适合大量长期挂起、栈使用很浅的协程。协程第一次Resume之后就绑定在该线程上，之后只能在该线程上Resume，
+   * 并且其他协程不能持有指向它栈上变量的指针
    */
-  explicit Coroutine(std::function<void()> task_func, uint32_t stack_size = 0, bool has_parent = false,
-                     const s_ptr &parent = nullptr);
+  explicit Coroutine(TaskFunc task_func, uint32_t stack_size = 0, bool has_parent = false,
+                     const s_ptr &parent = nullptr, bool use_shared_stack = false);
 
   ~Coroutine();
 
   /**
    * @brief 更新协程的具体任务，达到复用协程对象的目的
+   * @details 复用协程对象时协程栈也被复用，不需要重新分配内存
    * @param new_task
    */
-  void ResetTaskFunc(std::function<void()> new_task_func);
+  void ResetTaskFunc(TaskFunc new_task_func);
 
   /**
    * @brief 将this协程切换到运行状态
@@ -60,6 +67,21 @@ class Coroutine : public std::enable_shared_from_this<Coroutine> {
    */
   auto GetState() const -> State;
 
+  /**
+   * @brief 是否使用共享栈
+   */
+  auto IsSharedStack() const -> bool;
+
+  /**
+   * @brief 获取共享栈协程绑定的线程id，未绑定（包括非共享栈协程）时返回-1
+   */
+  auto GetBoundThreadId() const -> int;
+
+  /**
+   * @brief 获取共享栈协程挂起时保存的栈大小
+   */
+  auto GetSavedStackSize() const -> size_t;
+
   /**
    * @brief 设置父协程
    */
@@ -113,14 +135,27 @@ class Coroutine : public std::enable_shared_from_this<Coroutine> {
    * 表明调用该构造函数的线程进入协程模式
    */
   Coroutine();
+
+  /**
+   * @brief 协程切换回父协程之后，由父协程把仍处于Running的协程置为Ready
+   * @details 此时协程的寄存器已经保存完毕，其他线程可以安全地Resume它
+   */
+  void MarkReadyAfterYield();
+
   uint64_t id_{0};                            // 协程的id
   uint32_t stack_size_{0};                    // 协程栈大小
-  ucontext_t context_{};                      // 协程上下文
-  State state_{State::Ready};                 // 协程状态
+  Context context_{};                         // 协程上下文
+  std::atomic<State> state_{State::Ready};    // 协程状态，其他线程会读取它来判断协程能否被Resume
   void *stack_{nullptr};                      // 协程栈
-  std::function<void()> task_func_{nullptr};  // 协程要执行的具体任务
+  TaskFunc task_func_{nullptr};               // 协程要执行的具体任务
   std::weak_ptr<Coroutine> parent_;           // 父协程
   bool has_parent_{false};                    // 是否有父协程
+  bool use_shared_stack_{false};              // 是否使用共享栈
+  bool context_inited_{false};                // 共享栈协程的上下文是否已经在绑定线程的共享栈上初始化
+  int bound_thread_id_{-1};                   // 共享栈协程绑定的线程id
+  std::unique_ptr<char[]> saved_stack_{};     // 共享栈协程挂起时保存的栈内容
+  size_t saved_stack_size_{0};                // 保存的栈内容的大小
+  size_t saved_stack_capacity_{0};            // saved_stack_的容量
 };
 }  // namespace wtsclwq
 
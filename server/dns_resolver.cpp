@@ -0,0 +1,447 @@
+#include "dns_resolver.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <utility>
+#include "address.h"
+#include "log.h"
+#include "server/config.h"
+#include "server/hook.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+namespace wtsclwq {
+static auto sys_logger = NAMED_LOGGER("system");
+
+// 域名服务器列表，为空时使用/etc/resolv.conf
+static auto dns_nameservers = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.nameservers", std::vector<std::string>{}, "dns servers as ip[:port] or [ipv6]:port, empty for resolv.conf");
+
+// 等待一个域名服务器应答的超时时间
+static auto dns_timeout = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.timeout", 2000, "ms to wait for the answer of one dns server");
+
+// 轮流查询所有域名服务器的轮数
+static auto dns_attempts = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.attempts", 2, "rounds of queries over all dns servers");
+
+// 应答中没有SOA记录时否定缓存的时间
+static auto dns_negative_ttl = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.negative_ttl", 30, "seconds to cache a missing name when the answer has no soa record");
+
+// 缓存时间的上限，应答中的TTL更大时以它为准
+static auto dns_max_ttl = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.max_ttl", 3600, "max seconds to cache a dns answer");
+
+// 缓存的最大记录数
+static auto dns_cache_capacity = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "dns.cache_capacity", 4096, "max entries of the dns cache");
+
+struct DnsResolverIniter {
+  DnsResolverIniter() {
+    dns_timeout->SetValidator([](const int &value) { return value > 0; });
+    dns_attempts->SetValidator([](const int &value) { return value > 0; });
+    dns_negative_ttl->SetValidator([](const int &value) { return value >= 0; });
+    dns_max_ttl->SetValidator([](const int &value) { return value >= 0; });
+    dns_cache_capacity->SetValidator([](const int &value) { return value > 0; });
+  }
+};
+
+static DnsResolverIniter __dns_resolver_initer;  // NOLINT
+
+constexpr uint16_t DNS_PORT = 53;
+constexpr size_t DNS_HEADER_SIZE = 12;
+constexpr size_t DNS_MAX_UDP_SIZE = 512;
+constexpr size_t DNS_MAX_NAME_SIZE = 255;
+constexpr size_t DNS_MAX_LABEL_SIZE = 63;
+constexpr uint16_t DNS_TYPE_A = 1;
+constexpr uint16_t DNS_TYPE_CNAME = 5;
+constexpr uint16_t DNS_TYPE_SOA = 6;
+constexpr uint16_t DNS_TYPE_AAAA = 28;
+constexpr uint16_t DNS_CLASS_IN = 1;
+constexpr uint16_t DNS_FLAG_QR = 0x8000;
+constexpr uint16_t DNS_FLAG_RD = 0x0100;
+constexpr uint16_t DNS_RCODE_MASK = 0x000F;
+constexpr uint16_t DNS_RCODE_NXDOMAIN = 3;
+
+/**
+ * @brief 一次应答的解析结果
+ */
+enum class DnsReply {
+  Mismatch,  // 不是这次查询的应答，继续等待
+  Answer,    // 有地址
+  NoAnswer,  // 域名不存在或者没有这种记录，可以做否定缓存
+  Failure,   // 服务器出错或者应答不合法，换一个服务器重试
+};
+
+static auto ReadU16(const uint8_t *p) -> uint16_t { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+static auto ReadU32(const uint8_t *p) -> uint32_t {
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 8 |
+         p[3];
+}
+
+static void WriteU16(std::string *out, uint16_t value) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xFF));
+}
+
+static auto CacheKey(const std::string &name, uint16_t qtype) -> std::string {
+  return name + (qtype == DNS_TYPE_A ? "/A" : "/AAAA");
+}
+
+/**
+ * @brief 构造开启递归查询的报文
+ * @return 域名不合法时返回空
+ */
+static auto BuildQuery(uint16_t id, const std::string &name, uint16_t qtype) -> std::string {
+  std::string msg;
+  WriteU16(&msg, id);
+  WriteU16(&msg, DNS_FLAG_RD);
+  WriteU16(&msg, 1);
+  WriteU16(&msg, 0);
+  WriteU16(&msg, 0);
+  WriteU16(&msg, 0);
+  size_t begin = 0;
+  while (begin < name.size()) {
+    size_t end = std::min(name.find('.', begin), name.size());
+    size_t len = end - begin;
+    if (len == 0 || len > DNS_MAX_LABEL_SIZE) {
+      return "";
+    }
+    msg.push_back(static_cast<char>(len));
+    msg.append(name, begin, len);
+    begin = end + 1;
+  }
+  msg.push_back('\0');
+  if (msg.size() - DNS_HEADER_SIZE > DNS_MAX_NAME_SIZE) {
+    return "";
+  }
+  WriteU16(&msg, qtype);
+  WriteU16(&msg, DNS_CLASS_IN);
+  return msg;
+}
+
+/**
+ * @brief 跳过报文中pos处的一个域名，域名可能以压缩指针结尾
+ */
+static auto SkipName(const uint8_t *msg, size_t len, size_t *pos) -> bool {
+  while (*pos < len) {
+    uint8_t label = msg[*pos];
+    if ((label & 0xC0) == 0xC0) {
+      *pos += 2;
+      return *pos <= len;
+    }
+    if ((label & 0xC0) != 0) {
+      return false;
+    }
+    *pos += 1 + label;
+    if (label == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief 解析应答，回答部分中所有qtype类型的记录都是结果，递归服务器会把CNAME链上的记录一起返回
+ * @param[out] ttl_s 结果可以缓存的秒数，取所有用到的记录中最小的TTL；否定应答取SOA记录的TTL和MINIMUM中较小的
+ */
+static auto ParseReply(const std::string &query, uint16_t qtype, const uint8_t *msg, size_t len,
+                       std::vector<std::string> *addrs, uint32_t *ttl_s) -> DnsReply {
+  // id和问题部分必须与查询完全一致，否则是之前查询的迟到应答或者伪造的应答
+  if (len < query.size() || memcmp(msg, query.data(), 2) != 0 ||
+      memcmp(msg + DNS_HEADER_SIZE, query.data() + DNS_HEADER_SIZE, query.size() - DNS_HEADER_SIZE) != 0) {
+    return DnsReply::Mismatch;
+  }
+  uint16_t flags = ReadU16(msg + 2);
+  if ((flags & DNS_FLAG_QR) == 0 || ReadU16(msg + 4) != 1) {
+    return DnsReply::Mismatch;
+  }
+  uint16_t rcode = flags & DNS_RCODE_MASK;
+  if (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN) {
+    return DnsReply::Failure;
+  }
+  uint16_t answer_count = ReadU16(msg + 6);
+  uint16_t authority_count = ReadU16(msg + 8);
+  size_t addr_len = qtype == DNS_TYPE_A ? sizeof(in_addr) : sizeof(in6_addr);
+  uint32_t answer_ttl = UINT32_MAX;
+  uint32_t soa_ttl = UINT32_MAX;
+  size_t pos = query.size();
+  for (size_t i = 0; i < static_cast<size_t>(answer_count) + authority_count; i++) {
+    if (!SkipName(msg, len, &pos) || pos + 10 > len) {
+      return DnsReply::Failure;
+    }
+    uint16_t type = ReadU16(msg + pos);
+    uint16_t cls = ReadU16(msg + pos + 2);
+    uint32_t ttl = ReadU32(msg + pos + 4);
+    uint16_t rdata_len = ReadU16(msg + pos + 8);
+    pos += 10;
+    if (pos + rdata_len > len) {
+      return DnsReply::Failure;
+    }
+    if (i < answer_count && cls == DNS_CLASS_IN) {
+      if (type == qtype && rdata_len == addr_len) {
+        char buf[INET6_ADDRSTRLEN] = {0};
+        inet_ntop(qtype == DNS_TYPE_A ? AF_INET : AF_INET6, msg + pos, buf, sizeof(buf));
+        addrs->emplace_back(buf);
+        answer_ttl = std::min(answer_ttl, ttl);
+      } else if (type == DNS_TYPE_CNAME) {
+        answer_ttl = std::min(answer_ttl, ttl);
+      }
+    } else if (i >= answer_count && type == DNS_TYPE_SOA && rdata_len >= 20) {
+      soa_ttl = std::min(ttl, ReadU32(msg + pos + rdata_len - 4));
+    }
+    pos += rdata_len;
+  }
+  if (rcode == 0 && !addrs->empty()) {
+    *ttl_s = answer_ttl;
+    return DnsReply::Answer;
+  }
+  addrs->clear();
+  *ttl_s = soa_ttl != UINT32_MAX ? soa_ttl : static_cast<uint32_t>(dns_negative_ttl->GetValue());
+  return DnsReply::NoAnswer;
+}
+
+/**
+ * @brief 解析配置中的域名服务器地址，ip、ip:port或者[ipv6]:port
+ */
+static auto ParseNameserver(const std::string &server) -> IPAddress::s_ptr {
+  std::string ip = server;
+  std::string port;
+  if (!server.empty() && server[0] == '[') {
+    size_t end = server.find(']');
+    if (end == std::string::npos || (end + 1 < server.size() && server[end + 1] != ':')) {
+      return nullptr;
+    }
+    ip = server.substr(1, end - 1);
+    port = end + 1 < server.size() ? server.substr(end + 2) : "";
+  } else if (std::count(server.begin(), server.end(), ':') == 1) {
+    size_t colon = server.find(':');
+    ip = server.substr(0, colon);
+    port = server.substr(colon + 1);
+  }
+  uint16_t port_num = DNS_PORT;
+  if (!port.empty()) {
+    char *end = nullptr;
+    uint64_t value = strtoul(port.c_str(), &end, 10);
+    if (*end != '\0' || value == 0 || value > UINT16_MAX) {
+      return nullptr;
+    }
+    port_num = static_cast<uint16_t>(value);
+  }
+  return IPAddress::CreateAddr(ip, port_num);
+}
+
+DnsResolver::DnsResolver() {
+  LoadHosts();
+  LoadResolvConf();
+}
+
+auto DnsResolver::Resolve(std::string_view name, int family) -> std::vector<std::string> {
+  // 域名不区分大小写，末尾的点表示绝对域名
+  std::string lower_name = ToLower(name);
+  if (!lower_name.empty() && lower_name.back() == '.') {
+    lower_name.pop_back();
+  }
+  std::vector<std::string> res;
+  if (lower_name.empty()) {
+    return res;
+  }
+  if (family == AF_INET || family == AF_UNSPEC) {
+    res = ResolveType(lower_name, DNS_TYPE_A);
+  }
+  if (family == AF_INET6 || family == AF_UNSPEC) {
+    auto ipv6_addrs = ResolveType(lower_name, DNS_TYPE_AAAA);
+    res.insert(res.end(), ipv6_addrs.begin(), ipv6_addrs.end());
+  }
+  return res;
+}
+
+void DnsResolver::ClearCache() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_.clear();
+}
+
+auto DnsResolver::ResolveType(const std::string &name, uint16_t qtype) -> std::vector<std::string> {
+  std::string key = CacheKey(name, qtype);
+  auto hosts_it = hosts_.find(key);
+  if (hosts_it != hosts_.end()) {
+    return hosts_it->second;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto cache_it = cache_.find(key);
+  if (cache_it != cache_.end()) {
+    if (GetCurrMs() < cache_it->second.expire_ms_) {
+      return cache_it->second.addrs_;
+    }
+    cache_.erase(cache_it);
+  }
+  std::shared_ptr<InFlightQuery> query = nullptr;
+  auto in_flight_it = in_flight_.find(key);
+  if (in_flight_it == in_flight_.end()) {
+    query = std::make_shared<InFlightQuery>();
+    in_flight_.emplace(key, query);
+  } else if (CanHookSuspend()) {
+    // 挂起等待正在进行的查询，唤醒回调在释放锁之前登记，不会错过结果
+    query = in_flight_it->second;
+    SockIoScheduler::GetThreadSockIoScheduler()->WaitForWake([&](std::function<void()> wake) {
+      query->waiters_.push_back(std::move(wake));
+      lock.unlock();
+    });
+    return query->addrs_;
+  }
+  // 不能挂起的线程单独查询，不与正在进行的查询合并
+  lock.unlock();
+
+  uint32_t ttl_s = 0;
+  std::vector<std::string> addrs = Query(name, qtype, &ttl_s);
+
+  std::vector<std::function<void()>> waiters;
+  lock.lock();
+  AddCacheEntry(key, addrs, ttl_s);
+  if (query != nullptr) {
+    query->addrs_ = addrs;
+    waiters.swap(query->waiters_);
+    in_flight_.erase(key);
+  }
+  lock.unlock();
+  for (auto &wake : waiters) {
+    wake();
+  }
+  return addrs;
+}
+
+auto DnsResolver::Query(const std::string &name, uint16_t qtype, uint32_t *ttl_s) const -> std::vector<std::string> {
+  *ttl_s = 0;
+  std::vector<IPAddress::s_ptr> servers;
+  auto configured_servers = dns_nameservers->GetSnapshot();
+  for (const auto &server : configured_servers->empty() ? resolv_conf_servers_ : *configured_servers) {
+    auto server_addr = ParseNameserver(server);
+    if (server_addr == nullptr) {
+      LOG_ERROR(sys_logger) << "invalid dns server: " << server;
+      continue;
+    }
+    servers.push_back(server_addr);
+  }
+  if (servers.empty()) {
+    LOG_ERROR(sys_logger) << "no dns server to resolve " << name;
+    return {};
+  }
+
+  thread_local std::mt19937 engine(std::random_device{}());
+  std::string query = BuildQuery(static_cast<uint16_t>(engine()), name, qtype);
+  if (query.empty()) {
+    LOG_ERROR(sys_logger) << "invalid domain name: " << name;
+    return {};
+  }
+  int timeout_ms = dns_timeout->GetValue();
+  timeval tv{timeout_ms / 1000, timeout_ms % 1000 * 1000};
+  uint8_t reply[DNS_MAX_UDP_SIZE];
+  int attempts = dns_attempts->GetValue();
+  for (int attempt = 0; attempt < attempts; attempt++) {
+    for (const auto &server : servers) {
+      // 经过hook的socket在协程中等待应答时只挂起协程，超时由SO_RCVTIMEO映射到定时器上
+      int fd = socket(server->GetFamily(), SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        LOG_ERROR(sys_logger) << "create dns socket error: " << strerror(errno);
+        return {};
+      }
+      std::vector<std::string> addrs;
+      DnsReply result = DnsReply::Failure;
+      // connect之后内核只接收这个服务器发来的数据报
+      if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+          connect(fd, server->GetSockAddr(), server->GetSockAddrLen()) == 0 &&
+          send(fd, query.data(), query.size(), 0) == static_cast<ssize_t>(query.size())) {
+        while (true) {
+          ssize_t n = recv(fd, reply, sizeof(reply), 0);
+          if (n < 0) {
+            result = DnsReply::Failure;
+            break;
+          }
+          addrs.clear();
+          result = ParseReply(query, qtype, reply, n, &addrs, ttl_s);
+          if (result != DnsReply::Mismatch) {
+            break;
+          }
+        }
+      }
+      close(fd);
+      if (result == DnsReply::Answer || result == DnsReply::NoAnswer) {
+        return addrs;
+      }
+      LOG_WARN(sys_logger) << "dns query for " << name << " to " << server->ToString() << " failed";
+    }
+  }
+  *ttl_s = 0;
+  LOG_ERROR(sys_logger) << "resolve " << name << " failed after " << attempts << " attempts";
+  return {};
+}
+
+void DnsResolver::AddCacheEntry(const std::string &key, std::vector<std::string> addrs, uint32_t ttl_s) {
+  ttl_s = std::min(ttl_s, static_cast<uint32_t>(dns_max_ttl->GetValue()));
+  if (ttl_s == 0) {
+    return;
+  }
+  auto capacity = static_cast<size_t>(dns_cache_capacity->GetValue());
+  uint64_t now = GetCurrMs();
+  if (cache_.size() >= capacity && cache_.find(key) == cache_.end()) {
+    // 先淘汰所有过期的记录，仍然没有空间时淘汰任意一条
+    for (auto it = cache_.begin(); it != cache_.end();) {
+      it = it->second.expire_ms_ <= now ? cache_.erase(it) : std::next(it);
+    }
+    while (cache_.size() >= capacity) {
+      cache_.erase(cache_.begin());
+    }
+  }
+  cache_[key] = CacheEntry{std::move(addrs), now + ttl_s * 1000ULL};
+}
+
+void DnsResolver::LoadHosts() {
+  std::ifstream ifs("/etc/hosts");
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line.substr(0, line.find('#')));
+    std::string ip;
+    std::string host;
+    if (!(iss >> ip)) {
+      continue;
+    }
+    in6_addr buf{};
+    uint16_t qtype = 0;
+    if (inet_pton(AF_INET, ip.c_str(), &buf) == 1) {
+      qtype = DNS_TYPE_A;
+    } else if (inet_pton(AF_INET6, ip.c_str(), &buf) == 1) {
+      qtype = DNS_TYPE_AAAA;
+    } else {
+      continue;
+    }
+    while (iss >> host) {
+      hosts_[CacheKey(ToLower(host), qtype)].push_back(ip);
+    }
+  }
+}
+
+void DnsResolver::LoadResolvConf() {
+  std::ifstream ifs("/etc/resolv.conf");
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::istringstream iss(line);
+    std::string keyword;
+    std::string server;
+    if (iss >> keyword >> server && keyword == "nameserver") {
+      resolv_conf_servers_.push_back(server);
+    }
+  }
+}
+}  // namespace wtsclwq
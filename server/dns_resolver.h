@@ -0,0 +1,98 @@
+#ifndef _WTSCLWQ_DNS_RESOLVER_
+#define _WTSCLWQ_DNS_RESOLVER_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "noncopyable.h"
+#include "singleton.h"
+
+namespace wtsclwq {
+/**
+ * @brief 协程友好的DNS解析器，通过hook之后的UDP socket向域名服务器发送查询，等待应答时只挂起当前协程
+ * @details 先查/etc/hosts，再查缓存，缓存中的结果按照应答中的TTL过期，不存在的域名按照SOA记录的TTL做否定缓存；
+ * 同一个域名同时只有一个查询在进行，其他协程挂起等待它的结果。
+ * 域名服务器由配置dns.nameservers决定，为空时使用/etc/resolv.conf中的nameserver；不支持search域和TCP重试
+ */
+class DnsResolver : Noncopyable {
+ public:
+  DnsResolver();
+
+  ~DnsResolver() override = default;
+
+  /**
+   * @brief 解析域名对应的IP地址
+   * @details 在IO调度器的协程中调用时不会阻塞调度线程；在其他线程中调用时阻塞等待，且不与其他查询合并
+   * @param name 域名，不能是IP地址字符串
+   * @param family AF_INET查询A记录，AF_INET6查询AAAA记录，AF_UNSPEC两者都查询，IPv4地址在前
+   * @return IP地址字符串，解析失败或者域名不存在时为空
+   */
+  auto Resolve(std::string_view name, int family) -> std::vector<std::string>;
+
+  /**
+   * @brief 清空缓存，正在进行的查询不受影响
+   */
+  void ClearCache();
+
+ private:
+  /**
+   * @brief 一条缓存记录，addrs_为空表示否定缓存
+   */
+  struct CacheEntry {
+    std::vector<std::string> addrs_{};  // IP地址字符串
+    uint64_t expire_ms_{0};             // 过期的时间点
+  };
+
+  /**
+   * @brief 一个正在进行的查询，由发起查询的协程完成，其他查询同一个域名的协程挂起等待
+   */
+  struct InFlightQuery {
+    std::vector<std::function<void()>> waiters_{};  // 等待结果的协程的唤醒回调
+    std::vector<std::string> addrs_{};              // 查询的结果，唤醒之前写入
+  };
+
+  /**
+   * @brief 解析一种记录类型，依次查询hosts、缓存、正在进行的查询，都没有时发送查询
+   */
+  auto ResolveType(const std::string &name, uint16_t qtype) -> std::vector<std::string>;
+
+  /**
+   * @brief 向域名服务器发送查询并等待应答
+   * @param ttl_s 输出结果可以缓存的秒数，查询失败时为0
+   */
+  auto Query(const std::string &name, uint16_t qtype, uint32_t *ttl_s) const -> std::vector<std::string>;
+
+  /**
+   * @brief 写入缓存，调用者需要持有mutex_
+   */
+  void AddCacheEntry(const std::string &key, std::vector<std::string> addrs, uint32_t ttl_s);
+
+  /**
+   * @brief 解析/etc/hosts
+   */
+  void LoadHosts();
+
+  /**
+   * @brief 解析/etc/resolv.conf中的nameserver
+   */
+  void LoadResolvConf();
+
+  std::unordered_map<std::string, std::vector<std::string>> hosts_{};  // 域名+记录类型 -> /etc/hosts中的地址
+  std::vector<std::string> resolv_conf_servers_{};                     // /etc/resolv.conf中的域名服务器
+  std::mutex mutex_{};                                                 // 保护cache_和in_flight_
+  std::unordered_map<std::string, CacheEntry> cache_{};                // 域名+记录类型 -> 缓存记录
+  std::unordered_map<std::string, std::shared_ptr<InFlightQuery>> in_flight_{};  // 正在进行的查询
+};
+
+/**
+ * @brief 单例模式
+ */
+using DnsResolverMgr = Singleton<DnsResolver>;
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_DNS_RESOLVER_
@@ -3,17 +3,14 @@
 
 namespace wtsclwq {
 
-FileDescContext::FileDescContext() {
-  read_event_ctx_ = std::make_shared<EventContext>();
-  write_event_ctx_ = std::make_shared<EventContext>();
-}
+FileDescContext::FileDescContext(int fd) : sys_fd_(fd) {}
 
-auto FileDescContext::GetEventContext(EventType event_type) -> FileDescContext::EventContext::s_ptr {
+auto FileDescContext::GetEventContext(EventType event_type) -> FileDescContext::EventContext * {
   switch (event_type) {
     case EventType::Read:
-      return read_event_ctx_;
+      return &read_event_ctx_;
     case EventType::Write:
-      return write_event_ctx_;
+      return &write_event_ctx_;
     default:
       ASSERT(false);
   }
@@ -21,21 +18,29 @@ auto FileDescContext::GetEventContext(EventType event_type) -> FileDescContext::
 }
 
 void FileDescContext::ResetEventContext(EventType event_type) {
-  EventContext::s_ptr target_ctx = GetEventContext(event_type);
-  target_ctx->Reset();
+  GetEventContext(event_type)->Reset();
 }
 
-void FileDescContext::TriggerEvent(EventType event_type) {
+void FileDescContext::TriggerEvent(EventType event_type) { TriggerEvent(event_type, nullptr, nullptr); }
+
+void FileDescContext::TriggerEvent(EventType event_type, std::vector<Scheduler::ScheduleTask> *batch,
+                                   const Scheduler *batch_scheduler) {
   // 要触发的事件必须是注册过的
   ASSERT((registered_event_types_ & event_type) != 0);
 
-  EventContext::s_ptr target_ctx = GetEventContext(event_type);
+  EventContext *target_ctx = GetEventContext(event_type);
   Scheduler::s_ptr scheduler = target_ctx->scheduler_.lock();
   if (scheduler == nullptr) {
     return;
   }
   registered_event_types_ = static_cast<EventType>(registered_event_types_ & (~event_type));
-  if (target_ctx->func_ != nullptr) {
+  if (batch != nullptr && scheduler.get() == batch_scheduler) {
+    if (target_ctx->func_ != nullptr) {
+      batch->emplace_back(std::move(target_ctx->func_), -1);
+    } else {
+      batch->emplace_back(std::move(target_ctx->coroutine_), -1);
+    }
+  } else if (target_ctx->func_ != nullptr) {
     scheduler->Schedule(target_ctx->func_);
   } else {
     scheduler->Schedule(target_ctx->coroutine_);
@@ -48,6 +53,7 @@ void FileDescContext::EventContext::Reset() {
   scheduler_.reset();
   coroutine_.reset();
   func_ = nullptr;
+  owner_ = nullptr;
 }
 
 }  // namespace wtsclwq
\ No newline at end of file
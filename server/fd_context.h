@@ -1,7 +1,9 @@
 #ifndef _WTSCLWQ_FD_CONTEXT_
 #define _WTSCLWQ_FD_CONTEXT_
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include "coroutine.h"
 #include "lock.h"
 #include "scheduler.h"
@@ -14,18 +16,17 @@ struct FileDescContext {
     Write = 0x4,  // 写事件（EPOLLOUT）
   };
 
-  using s_ptr = std::shared_ptr<FileDescContext>;
   using MutexType = SpinLock;
 
-  FileDescContext();
+  explicit FileDescContext(int fd);
   /**
    * @brief 事件上下文，用来存储io事件回调以及执行回调的调度器
    */
   struct EventContext {
-    using s_ptr = std::shared_ptr<EventContext>;
     std::weak_ptr<Scheduler> scheduler_{};  // 事件回调的调度器
     Coroutine::s_ptr coroutine_{nullptr};   // 事件回调协程
     std::function<void()> func_;            // 事件回调函数
+    const void *owner_{nullptr};            // 注册者的标识，撤销注册时只撤销自己的那一次，nullptr表示不区分
     void Reset();
   };
 
@@ -33,7 +34,7 @@ struct FileDescContext {
    * @brief 获取某一个类型的事件上下文
    * @param event_type 读或写
    */
-  auto GetEventContext(EventType event_type) -> EventContext::s_ptr;
+  auto GetEventContext(EventType event_type) -> EventContext *;
 
   /**
    * @brief 重置某一个事件上下文
@@ -46,11 +47,24 @@ struct FileDescContext {
    */
   void TriggerEvent(EventType event_type);
 
-  int sys_fd_{0};                          // 系统fd
-  EventContext::s_ptr read_event_ctx_{};   // fd上的读事件上下文
-  EventContext::s_ptr write_event_ctx_{};  // fd上的写事件上下文
+  /**
+   * @brief 触发某一个事件，如果事件的调度器就是batch_scheduler，那么回调任务放入batch中由调用者批量提交
+   * @param batch 收集回调任务的缓冲区
+   * @param batch_scheduler batch最终提交到的调度器，其他调度器的回调仍然逐个提交
+   */
+  void TriggerEvent(EventType event_type, std::vector<Scheduler::ScheduleTask> *batch,
+                    const Scheduler *batch_scheduler);
+
+  // 每次等待都要访问的标志在前，事件回调在后
+  int sys_fd_{0};                                      // 系统fd
   EventType registered_event_types_{EventType::None};  // 该fd注册了那些事件类型，注意event_type可以通过位运算组合
+  EventType ready_event_types_{EventType::None};       // 没有任务等待时到达的就绪边沿，下一次等待时直接消费
+  int owner_index_{-1};                                // 每线程一个reactor模式下，处理该fd事件的调度线程下标，-1表示还没有分配
+  uint32_t io_scheduler_id_{0};                        // 监听该fd的IO调度器的编号，0表示还没有被监听过
   MutexType mutex_{};                                  // 互斥锁，这里选择SpinLock因为锁的粒度很小
+  bool is_epoll_registered_{false};                    // 是否已经以EPOLLIN|EPOLLOUT|EPOLLET注册到epoll，注册之后直到fd关闭都不再修改
+  EventContext read_event_ctx_{};                      // fd上的读事件上下文
+  EventContext write_event_ctx_{};                     // fd上的写事件上下文
 };
 
 }  // namespace wtsclwq
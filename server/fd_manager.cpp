@@ -3,34 +3,25 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <memory>
-#include <mutex>
-#include <shared_mutex>
 #include "hook.h"
 
 namespace wtsclwq {
 
-FileInfoWrapper::FileInfoWrapper(int fd) : sys_fd_(fd) { Init(); }
-
-FileInfoWrapper::~FileInfoWrapper() {
-  if (sys_fd_ != -1) {
-    close_f(sys_fd_);
-  }
-}
+FileInfoWrapper::FileInfoWrapper(int fd) : sys_fd_(fd) {}
 
 auto FileInfoWrapper::Init() -> bool {
-  if (is_inited_) {
+  if (is_inited_.load(std::memory_order_acquire)) {
     return true;
   }
 
   struct stat fd_stat;
   if (fstat(sys_fd_, &fd_stat) == -1) {
-    is_inited_ = false;
     is_socket_ = false;
-  } else {
-    is_inited_ = true;
-    is_socket_ = S_ISSOCK(fd_stat.st_mode);
+    is_regular_file_ = false;
+    return false;
   }
+  is_socket_ = S_ISSOCK(fd_stat.st_mode);
+  is_regular_file_ = S_ISREG(fd_stat.st_mode) || S_ISBLK(fd_stat.st_mode);
 
   // 如果是sockfd，那么默认设置为非阻塞
   if (is_socket_) {
@@ -48,9 +39,16 @@ auto FileInfoWrapper::Init() -> bool {
   // 所以我们需要记录用户是否手动设置了非阻塞，只有sys和user同时为非阻塞时，才认为是非阻塞
   is_user_non_block_ = false;
   is_closed_ = false;
-  return is_inited_;
+  read_timeout_ms_ = UINT64_MAX;
+  write_timeout_ms_ = UINT64_MAX;
+  ++generation_;
+  // 其余字段都写完之后才发布，无锁读取的线程看到初始化完成时字段一定是新的
+  is_inited_.store(true, std::memory_order_release);
+  return true;
 }
 
+void FileInfoWrapper::Reset() { is_inited_.store(false, std::memory_order_release); }
+
 void FileInfoWrapper::SetTimeout(int type, uint64_t timeout_ms) {
   if (type == SO_RCVTIMEO) {
     read_timeout_ms_ = timeout_ms;
@@ -66,12 +64,16 @@ auto FileInfoWrapper::GetTimeout(int type) -> uint64_t {
   return write_timeout_ms_;
 }
 
-auto FileInfoWrapper::IsInited() -> bool { return is_inited_; }
+auto FileInfoWrapper::IsInited() -> bool { return is_inited_.load(std::memory_order_acquire); }
 
 auto FileInfoWrapper::IsSocket() -> bool { return is_socket_; }
 
+auto FileInfoWrapper::IsRegularFile() -> bool { return is_regular_file_; }
+
 auto FileInfoWrapper::IsClosed() -> bool { return is_closed_; }
 
+void FileInfoWrapper::SetClosed(bool v) { is_closed_ = v; }
+
 void FileInfoWrapper::SetUserLevelNonBlock(bool v) { is_user_non_block_ = v; }
 
 auto FileInfoWrapper::IsUserLevelNonBlock() -> bool { return is_user_non_block_; }
@@ -80,42 +82,65 @@ void FileInfoWrapper::SetSysLevelNonBlock(bool v) { is_sys_non_block_ = v; }
 
 auto FileInfoWrapper::IsSysLevelNonBlock() -> bool { return is_sys_non_block_; }
 
-FileInfoWrapperManager::FileInfoWrapperManager() { fd_infos_.resize(64); }
+auto FileInfoWrapper::GetGeneration() -> uint32_t { return generation_; }
 
-FileInfoWrapperManager::~FileInfoWrapperManager() = default;
+FdEntry::FdEntry(int fd) : info_(fd), event_ctx_(fd) {}
 
-auto FileInfoWrapperManager::Get(int fd, bool auto_create) -> FileInfoWrapper::s_ptr {
-  if (fd < 0) {
+FdEntry::~FdEntry() {
+  // 已经被hook的close关闭的fd不能再关闭一次，它的编号可能已经被复用
+  if (info_.IsInited() && !info_.IsClosed()) {
+    close_f(event_ctx_.sys_fd_);
+  }
+}
+
+auto FileInfoWrapperManager::Get(int fd, bool auto_create) -> FileInfoWrapper * {
+  FdEntry *entry = auto_create ? entries_.GetOrCreate(fd) : entries_.Get(fd);
+  if (entry == nullptr) {
     return nullptr;
   }
-  {
-    std::shared_lock<MutexType> lock(mutex_);
-
-    if (static_cast<size_t>(fd) >= fd_infos_.size()) {
-      if (!auto_create) {
-        return nullptr;
-      }
-    } else {
-      if (fd_infos_[fd] != nullptr || !auto_create) {
-        return fd_infos_[fd];
-      }
-    }
+  if (entry->info_.IsInited()) {
+    return &entry->info_;
   }
-  std::lock_guard<MutexType> lock(mutex_);
-  auto res = std::make_shared<FileInfoWrapper>(fd);
-  if (static_cast<size_t>(fd) >= fd_infos_.size()) {
-    fd_infos_.resize(fd * 2);
+  if (!auto_create) {
+    return nullptr;
+  }
+  // 新创建的fd只由创建它的线程管理，初始化不需要加锁
+  ResetEventState(entry);
+  return entry->info_.Init() ? &entry->info_ : nullptr;
+}
+
+auto FileInfoWrapperManager::Create(int fd) -> FileInfoWrapper * {
+  FdEntry *entry = entries_.GetOrCreate(fd);
+  if (entry == nullptr) {
+    return nullptr;
   }
-  fd_infos_[fd] = res;
-  return res;
+  ResetEventState(entry);
+  entry->info_.Reset();
+  return entry->info_.Init() ? &entry->info_ : nullptr;
+}
+
+void FileInfoWrapperManager::ResetEventState(FdEntry *entry) {
+  // 只清除和fd本身绑定的状态，等待中的任务和调度线程的分配由IO调度器管理
+  std::lock_guard<FileDescContext::MutexType> lock(entry->event_ctx_.mutex_);
+  entry->event_ctx_.is_epoll_registered_ = false;
+  entry->event_ctx_.ready_event_types_ = FileDescContext::EventType::None;
 }
 
 void FileInfoWrapperManager::Remove(int fd) {
-  std::lock_guard<MutexType> lock_guard(mutex_);
-  if (static_cast<size_t>(fd) >= fd_infos_.size()) {
-    return;
+  FdEntry *entry = entries_.Get(fd);
+  if (entry != nullptr) {
+    entry->info_.Reset();
   }
-  fd_infos_[fd].reset();
+}
+
+auto FileInfoWrapperManager::GetEventContext(int fd) -> FileDescContext * {
+  FdEntry *entry = entries_.Get(fd);
+  return entry == nullptr ? nullptr : &entry->event_ctx_;
+}
+
+auto FileInfoWrapperManager::GetOrCreateEventContext(int fd) -> FileDescContext * {
+  FdEntry *entry = entries_.GetOrCreate(fd);
+  return entry == nullptr ? nullptr : &entry->event_ctx_;
 }
 
 }  // namespace wtsclwq
\ No newline at end of file
@@ -1,21 +1,30 @@
 #ifndef _WTSCLWQ_FD_MANAGER_
 #define _WTSCLWQ_FD_MANAGER_
 
+#include <atomic>
 #include <cstdint>
-#include <memory>
-#include <shared_mutex>
-#include <vector>
+#include "server/fd_context.h"
+#include "server/fd_table.h"
 #include "server/singleton.h"
 
 namespace wtsclwq {
 
-class FileInfoWrapper : public std::enable_shared_from_this<FileInfoWrapper> {
+/**
+ * @brief hook层记录的fd状态，直接存放在进程唯一的fd表中，fd编号被复用时原地重新初始化
+ */
+class FileInfoWrapper {
  public:
-  using s_ptr = std::shared_ptr<FileInfoWrapper>;
-
   explicit FileInfoWrapper(int fd);
 
-  ~FileInfoWrapper();
+  /**
+   * @brief 初始化fd：判断是否为socket，socket默认在系统层面设置为非阻塞
+   */
+  auto Init() -> bool;
+
+  /**
+   * @brief fd被关闭之后不再管理它，关闭标志保留，仍在等待的协程醒来之后能看到
+   */
+  void Reset();
 
   /**
    * @brief 是否初始化完成
@@ -27,11 +36,21 @@ class FileInfoWrapper : public std::enable_shared_from_this<FileInfoWrapper> {
    */
   auto IsSocket() -> bool;
 
+  /**
+   * @brief 是否是普通文件或者块设备，读写不会返回EAGAIN，但是会阻塞
+   */
+  auto IsRegularFile() -> bool;
+
   /**
    * @brief 是否已经关闭
    */
   auto IsClosed() -> bool;
 
+  /**
+   * @brief 标记fd已经被关闭，仍在等待该fd的协程被唤醒之后直接返回EBADF
+   */
+  void SetClosed(bool v);
+
   /**
    * @brief 用户手动设置为非阻塞模式
    */
@@ -62,15 +81,18 @@ class FileInfoWrapper : public std::enable_shared_from_this<FileInfoWrapper> {
    */
   auto GetTimeout(int type) -> uint64_t;
 
- private:
   /**
-   * @brief 初始化fd
+   * @brief 获取fd编号的使用代数，编号每被重新使用一次加一
+   * @details 等待中的协程醒来时比较代数，就能发现fd已经被关闭并且编号被新的fd复用
    */
-  auto Init() -> bool;
+  auto GetGeneration() -> uint32_t;
 
+ private:
   int sys_fd_{0};                          // 系统fd
-  bool is_inited_{false};                  // 是否初始化完成
+  uint32_t generation_{0};                 // fd编号的使用代数
+  std::atomic<bool> is_inited_{false};     // 是否初始化完成
   bool is_socket_{false};                  // 是否是socket
+  bool is_regular_file_{false};            // 是否是普通文件或者块设备
   bool is_closed_{false};                  // 是否已经关闭
   bool is_user_non_block_{false};          // 用户手动设置为非阻塞模式
   bool is_sys_non_block_{false};           // 系统设置为非阻塞模式
@@ -78,28 +100,60 @@ class FileInfoWrapper : public std::enable_shared_from_this<FileInfoWrapper> {
   uint64_t write_timeout_ms_{UINT64_MAX};  // 写超时时间
 };
 
+/**
+ * @brief 进程唯一的fd表中的一项，hook层的状态和IO调度器的事件等待状态放在一起
+ * @details hook层每次调用都要读取的标志和超时时间，以及事件的注册和就绪标志位于第一个cache line，
+ * 事件回调放在其后，只有真正需要等待时才会访问
+ */
+struct alignas(64) FdEntry {
+  explicit FdEntry(int fd);
+
+  ~FdEntry();
+
+  FileInfoWrapper info_;       // hook层的状态，初始化完成表示fd被hook层管理
+  FileDescContext event_ctx_;  // IO调度器的事件等待状态，没有被hook层管理的fd也可以使用
+};
+
 class FileInfoWrapperManager {
  public:
-  using s_ptr = std::shared_ptr<FileInfoWrapperManager>;
-  using MutexType = std::shared_mutex;
+  /**
+   * @brief 获取fd对应的FileInfoWrapper，查找不加锁
+   * @param auto_create fd没有被管理时是否开始管理它
+   * @return fd没有被管理或者超出表的范围时返回nullptr，返回的指针在进程的整个生命周期内有效
+   */
+  auto Get(int fd, bool auto_create = false) -> FileInfoWrapper *;
 
-  FileInfoWrapperManager();
+  /**
+   * @brief 新创建了一个fd，重新开始管理它，丢弃这个编号上一次使用时残留的状态
+   * @details 上一个fd可能没有经过IO调度器就被关闭了（hook没有开启的线程、非调度线程或者其他调度器），
+   * 内核已经把它从epoll中移除，但是它的epoll注册标志还在，不清除的话新fd的等待永远不会被唤醒
+   * @return fd超出表的范围时返回nullptr
+   */
+  auto Create(int fd) -> FileInfoWrapper *;
 
-  ~FileInfoWrapperManager();
+  /**
+   * @brief 停止管理fd，它的编号被复用时重新初始化
+   */
+  void Remove(int fd);
 
   /**
-   * @brief 获取fd对应的FileInfoWrapper
+   * @brief 获取fd的事件等待状态，所在的块还没有分配时返回nullptr
    */
-  auto Get(int fd, bool auto_create = false) -> FileInfoWrapper::s_ptr;
+  auto GetEventContext(int fd) -> FileDescContext *;
 
   /**
-   * @brief 删除fd对应的FileInfoWrapper
+   * @brief 获取fd的事件等待状态，所在的块还没有分配时分配它
+   * @return fd超出表的范围时返回nullptr
    */
-  void Remove(int fd);
+  auto GetOrCreateEventContext(int fd) -> FileDescContext *;
 
  private:
-  std::vector<FileInfoWrapper::s_ptr> fd_infos_{};  // fd对应的FileInfoWrapper
-  MutexType mutex_{};                               // 互斥锁
+  /**
+   * @brief fd编号被新的fd使用，清除旧fd在epoll中的注册标志和就绪标志
+   */
+  static void ResetEventState(FdEntry *entry);
+
+  FdTable<FdEntry> entries_{};  // 以fd为下标的表，元素的地址直到进程退出都不变
 };
 
 /**
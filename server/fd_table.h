@@ -0,0 +1,93 @@
+#ifndef _WTSCLWQ_FD_TABLE_
+#define _WTSCLWQ_FD_TABLE_
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include "noncopyable.h"
+
+namespace wtsclwq {
+/**
+ * @brief 以fd为下标的两级表，元素直接存放在按块分配的连续内存中
+ * @details 第一级是固定大小的块指针数组，第二级每块存放CHUNK_SIZE个元素。块第一次被访问时分配并用CAS发布，
+ * 分配之后直到表析构都不会移动或释放，因此查找和扩容都不需要加锁，返回的指针在表的整个生命周期内有效。
+ * T需要可以用fd构造
+ */
+template <typename T, size_t ChunkBits = 10, size_t ChunkCount = 4096>
+class FdTable : Noncopyable {
+ public:
+  static constexpr size_t CHUNK_SIZE = 1 << ChunkBits;
+  static constexpr size_t MAX_FD_COUNT = CHUNK_SIZE * ChunkCount;
+
+  FdTable() {
+    for (auto &chunk : chunks_) {
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~FdTable() override {
+    for (auto &chunk : chunks_) {
+      T *entries = chunk.load(std::memory_order_relaxed);
+      if (entries != nullptr) {
+        FreeChunk(entries);
+      }
+    }
+  }
+
+  /**
+   * @brief 获取fd对应的元素，所在的块还没有分配时返回nullptr
+   */
+  auto Get(int fd) const -> T * {
+    if (fd < 0 || static_cast<size_t>(fd) >= MAX_FD_COUNT) {
+      return nullptr;
+    }
+    T *entries = chunks_[fd >> ChunkBits].load(std::memory_order_acquire);
+    if (entries == nullptr) {
+      return nullptr;
+    }
+    return &entries[fd & (CHUNK_SIZE - 1)];
+  }
+
+  /**
+   * @brief 获取fd对应的元素，所在的块还没有分配时分配它
+   * @return fd超出表的范围时返回nullptr
+   */
+  auto GetOrCreate(int fd) -> T * {
+    if (fd < 0 || static_cast<size_t>(fd) >= MAX_FD_COUNT) {
+      return nullptr;
+    }
+    std::atomic<T *> &chunk = chunks_[fd >> ChunkBits];
+    T *entries = chunk.load(std::memory_order_acquire);
+    if (entries == nullptr) {
+      // 多个线程同时分配同一个块时只有一个能发布成功，其余的释放自己分配的块
+      T *new_entries = AllocChunk(static_cast<int>(fd & ~(CHUNK_SIZE - 1)));
+      if (chunk.compare_exchange_strong(entries, new_entries, std::memory_order_acq_rel)) {
+        entries = new_entries;
+      } else {
+        FreeChunk(new_entries);
+      }
+    }
+    return &entries[fd & (CHUNK_SIZE - 1)];
+  }
+
+ private:
+  static auto AllocChunk(int first_fd) -> T * {
+    auto *entries = static_cast<T *>(::operator new(sizeof(T) * CHUNK_SIZE, std::align_val_t(alignof(T))));
+    for (size_t i = 0; i < CHUNK_SIZE; i++) {
+      new (&entries[i]) T(first_fd + static_cast<int>(i));
+    }
+    return entries;
+  }
+
+  static void FreeChunk(T *entries) {
+    for (size_t i = 0; i < CHUNK_SIZE; i++) {
+      entries[i].~T();
+    }
+    ::operator delete(entries, std::align_val_t(alignof(T)));
+  }
+
+  std::atomic<T *> chunks_[ChunkCount];  // 块指针，nullptr表示该块还没有分配
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_FD_TABLE_
@@ -0,0 +1,106 @@
+#include "file_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include "log.h"
+#include "server/config.h"
+
+namespace wtsclwq {
+static auto sys_logger = NAMED_LOGGER("system");
+
+// 文件IO线程池的线程数
+static auto file_io_thread_count = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "file_io.thread_count", 4, "thread count of the blocking file io pool");
+
+// 文件读写每次交给线程池处理的最大字节数
+static auto file_io_chunk_size = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "file_io.chunk_size", 256 * 1024, "max bytes a file read or write handles before yielding the file io pool");
+
+struct FileIoIniter {
+  FileIoIniter() {
+    file_io_thread_count->SetValidator([](const int &value) { return value > 0; });
+    file_io_chunk_size->SetValidator([](const int &value) { return value > 0; });
+  }
+};
+
+static FileIoIniter __file_io_initer;  // NOLINT
+
+FileIoPool::FileIoPool() {
+  // 线程数在创建时确定，之后修改配置不会影响已经创建的线程池
+  auto thread_count = static_cast<size_t>(file_io_thread_count->GetValue());
+  threads_.reserve(thread_count);
+  for (size_t i = 0; i < thread_count; i++) {
+    threads_.push_back(std::make_unique<Thread>([this] { Run(); }, "file_io_" + std::to_string(i)));
+  }
+  LOG_INFO(sys_logger) << "FileIoPool started with " << thread_count << " threads";
+}
+
+FileIoPool::~FileIoPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    cond_.notify_all();
+  }
+  for (auto &thread : threads_) {
+    thread->Join();
+  }
+}
+
+void FileIoPool::Submit(FileIoRequest *request) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_.push_back(request);
+  cond_.notify_one();
+}
+
+void FileIoPool::Run() {
+  while (true) {
+    FileIoRequest *request = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stopping_ || !requests_.empty(); });
+      // 退出之前把剩余的请求处理完，否则等待它们的协程永远不会被唤醒
+      if (requests_.empty()) {
+        break;
+      }
+      request = requests_.front();
+      requests_.pop_front();
+    }
+    if (!RunChunk(request)) {
+      // 剩余的部分排到队列末尾，让其他请求先执行
+      std::lock_guard<std::mutex> lock(mutex_);
+      requests_.push_back(request);
+      continue;
+    }
+    // 回调会唤醒等待的协程，请求随时可能被销毁，先把回调移出来
+    std::function<void()> on_complete = std::move(request->on_complete_);
+    on_complete();
+  }
+}
+
+auto FileIoPool::RunChunk(FileIoRequest *request) -> bool {
+  size_t length = 0;
+  if (request->total_ != 0) {
+    length = std::min(static_cast<size_t>(*file_io_chunk_size->GetSnapshot()), request->total_ - request->done_);
+  }
+  ssize_t n = 0;
+  do {
+    n = request->op_(request->done_, length);
+  } while (n == -1 && errno == EINTR);
+
+  if (request->total_ == 0) {
+    request->result_ = n;
+  } else if (n < 0) {
+    // 已经处理过一部分时返回处理过的字节数，与短读短写的语义一致
+    request->result_ = request->done_ == 0 ? n : static_cast<ssize_t>(request->done_);
+  } else {
+    request->done_ += n;
+    request->result_ = static_cast<ssize_t>(request->done_);
+    // 读到文件末尾、短写或者全部处理完时结束
+    if (n != 0 && static_cast<size_t>(n) == length && request->done_ != request->total_) {
+      return false;
+    }
+  }
+  request->errno_ = request->result_ < 0 ? errno : 0;
+  return true;
+}
+}  // namespace wtsclwq
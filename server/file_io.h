@@ -0,0 +1,78 @@
+#ifndef _WTSCLWQ_FILE_IO_
+#define _WTSCLWQ_FILE_IO_
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "noncopyable.h"
+#include "singleton.h"
+#include "thread.h"
+
+namespace wtsclwq {
+/**
+ * @brief 一个交给文件IO线程池的阻塞操作，保存在等待它的协程的栈上
+ */
+struct FileIoRequest {
+  /**
+   * @brief 从第offset个字节开始处理最多length个字节，返回值与系统调用相同；不分块的操作忽略这两个参数
+   */
+  using Operation = std::function<ssize_t(size_t offset, size_t length)>;
+
+  FileIoRequest(Operation op, size_t total) : op_(std::move(op)), total_(total) {}
+
+  Operation op_;                       // 在线程池中执行的操作
+  size_t total_{0};                    // 需要分块的读写的总字节数，0表示不分块的操作
+  size_t done_{0};                     // 已经处理的字节数
+  ssize_t result_{0};                  // 操作的结果
+  int errno_{0};                       // 操作失败时的errno
+  std::function<void()> on_complete_;  // 操作完成之后在线程池的线程中调用，调用之后请求可能立即被销毁
+};
+
+/**
+ * @brief 执行阻塞文件IO的线程池，调度线程中的协程把普通文件的读写交给它，自己挂起等待，不会阻塞整个调度线程
+ * @details 线程数由配置file_io.thread_count决定；读写每次最多处理file_io.chunk_size个字节，
+ * 没有处理完的请求重新排到队列末尾，大文件的读写不会长时间独占线程池
+ */
+class FileIoPool : Noncopyable {
+ public:
+  FileIoPool();
+
+  ~FileIoPool() override;
+
+  /**
+   * @brief 把请求交给线程池，完成之后调用请求的on_complete_
+   */
+  void Submit(FileIoRequest *request);
+
+ private:
+  /**
+   * @brief 线程池中线程的主循环
+   */
+  void Run();
+
+  /**
+   * @brief 处理请求的一个分块
+   * @return 请求是否已经完成
+   */
+  static auto RunChunk(FileIoRequest *request) -> bool;
+
+  std::mutex mutex_{};                              // 保护requests_和stopping_
+  std::condition_variable cond_{};                  // 有新请求或者需要停止时唤醒线程
+  std::deque<FileIoRequest *> requests_{};          // 待处理的请求，没有处理完的请求重新排到末尾
+  bool stopping_{false};                            // 是否正在停止
+  std::vector<std::unique_ptr<Thread>> threads_{};  // 线程池中的线程，不开启hook，阻塞的系统调用只阻塞自己
+};
+
+/**
+ * @brief 单例模式，第一次使用时才创建线程
+ */
+using FileIoPoolMgr = Singleton<FileIoPool>;
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_FILE_IO_
@@ -5,19 +5,26 @@
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cstdarg>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <string_view>
+#include <utility>
+#include <vector>
 #include "fd_manager.h"
+#include "file_io.h"
+#include "io_uring.h"
 #include "server/config.h"
 #include "server/coroutine.h"
 #include "server/fd_context.h"
 #include "server/log.h"
 #include "server/sock_io_scheduler.h"
 #include "server/timer.h"
+#include "server/utils.h"
 
 static auto sys_logger = NAMED_LOGGER("system");
 namespace wtsclwq {
@@ -33,6 +40,7 @@ static thread_local bool is_hook_enabled = false;
   FUNC(socket)     \
   FUNC(connect)    \
   FUNC(accept)     \
+  FUNC(accept4)    \
   FUNC(read)       \
   FUNC(readv)      \
   FUNC(recv)       \
@@ -43,6 +51,16 @@ static thread_local bool is_hook_enabled = false;
   FUNC(send)       \
   FUNC(sendto)     \
   FUNC(sendmsg)    \
+  FUNC(poll)       \
+  FUNC(select)     \
+  FUNC(epoll_wait) \
+  FUNC(sendfile)   \
+  FUNC(splice)     \
+  FUNC(pread)      \
+  FUNC(pwrite)     \
+  FUNC(fsync)      \
+  FUNC(open)       \
+  FUNC(stat)       \
   FUNC(close)      \
   FUNC(fcntl)      \
   FUNC(ioctl)      \
@@ -77,11 +95,172 @@ auto IsHookEnabled() -> bool { return is_hook_enabled; }
 
 void SetHookEnabled(bool v) { is_hook_enabled = v; }
 
+auto CanHookSuspend() -> bool {
+  if (!is_hook_enabled || SockIoScheduler::GetThreadSockIoScheduler() == nullptr) {
+    return false;
+  }
+  // 线程的主协程、调度协程和Idle协程不能挂起，Idle协程中直接执行的定时器回调只能阻塞线程
+  auto curr_coroutine = Coroutine::GetThreadRunningCoroutine();
+  return curr_coroutine != nullptr && curr_coroutine != Coroutine::GetThreadMainCoroutine() &&
+         curr_coroutine != Scheduler::GetThreadScheduleCoroutine() &&
+         curr_coroutine.get() != Scheduler::GetThreadIdleCoroutine();
+}
+
 }  // namespace wtsclwq
 
-template <typename OriginFunc, typename... Args>
+/**
+ * @brief 如果当前的IO调度器使用io_uring后端，直接把IO操作提交给内核，挂起当前协程直到操作完成
+ * @param prep 负责填写sqe，返回false表示这次调用无法用io_uring完成
+ * @param[out] result 调用的返回值，失败时同时设置了errno
+ * @return 是否已经通过io_uring完成了这次调用，返回false时调用者继续用epoll等待fd就绪
+ */
+template <typename PrepFunc>
+static auto DoIoUring(int fd, uint64_t timeout_ms, PrepFunc &&prep, ssize_t *result) -> bool {
+  auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
+  if (sock_io_scheduler == nullptr || !sock_io_scheduler->IsIoUringEnabled()) {
+    return false;
+  }
+  io_uring_sqe sqe{};
+  if (!prep(&sqe)) {
+    return false;
+  }
+  int32_t res = 0;
+  do {
+    res = sock_io_scheduler->SubmitIoAndWait(&sqe, timeout_ms);
+  } while (res == -EINTR);
+  // 没有提交成功，或者较老的内核对非阻塞socket直接返回了EAGAIN
+  if (res == -EAGAIN) {
+    return false;
+  }
+  if (res >= 0) {
+    *result = res;
+    return true;
+  }
+  // 操作被CancelIo取消，说明fd在等待期间被关闭了
+  errno = res == -ECANCELED ? EBADF : -res;
+  *result = -1;
+  return true;
+}
+
+/**
+ * @brief io_uring中缓冲区长度是32位的，超过的部分留给调用者下一次读写，与短读短写的语义一致
+ */
+static auto IoUringLength(size_t n) -> uint32_t { return static_cast<uint32_t>(std::min<size_t>(n, INT32_MAX)); }
+
+/**
+ * @brief 当前是否在IO调度器中一个可以挂起等待文件IO的协程里
+ * @details 共享栈协程挂起时栈上的数据会被换出，线程池写入的将是其他协程的栈
+ */
+static auto CanSuspendForFileIo() -> bool {
+  return wtsclwq::CanHookSuspend() && !wtsclwq::Coroutine::GetThreadRunningCoroutine()->IsSharedStack();
+}
+
+/**
+ * @brief 把一个阻塞的文件操作交给文件IO线程池，挂起当前协程直到操作完成，调用者需要先检查CanSuspendForFileIo
+ * @param total 读写的总字节数，按配置file_io.chunk_size分块执行；0表示不分块的操作
+ * @return 与系统调用相同，失败时同时设置了errno
+ */
+static auto OffloadFileIo(size_t total, wtsclwq::FileIoRequest::Operation op) -> ssize_t {
+  wtsclwq::FileIoRequest request(std::move(op), total);
+  wtsclwq::SockIoScheduler::GetThreadSockIoScheduler()->SubmitFileIoAndWait(&request);
+  if (request.result_ < 0) {
+    errno = request.errno_;
+  }
+  return request.result_;
+}
+
+/**
+ * @brief 普通文件的读写不会返回EAGAIN，却会阻塞整个调度线程，在协程中发起时交给io_uring或者文件IO线程池完成
+ * @param prep 负责填写sqe，返回false表示这次调用无法用io_uring完成
+ * @param op 在线程池中执行的操作
+ * @param[out] result 调用的返回值，失败时同时设置了errno
+ * @return 是否已经完成了这次调用，返回false时调用者按原来的方式处理
+ */
+template <typename PrepFunc>
+static auto DoFileIo(int fd, size_t total, PrepFunc &&prep, wtsclwq::FileIoRequest::Operation op, ssize_t *result)
+    -> bool {
+  if (!wtsclwq::IsHookEnabled()) {
+    return false;
+  }
+  auto fd_info_wrapper = wtsclwq::FdWrapperMgr::GetInstance()->Get(fd);
+  if (fd_info_wrapper == nullptr || fd_info_wrapper->IsClosed() || !fd_info_wrapper->IsRegularFile() ||
+      !CanSuspendForFileIo()) {
+    return false;
+  }
+  // io_uring对普通文件的读写由内核的工作线程异步完成，不需要再占用线程池
+  if (DoIoUring(fd, UINT64_MAX, prep, result)) {
+    return true;
+  }
+  *result = OffloadFileIo(total, std::move(op));
+  return true;
+}
+
+/**
+ * @brief 一次IO等待的状态，超时节点直接内嵌其中，和等待的协程放在同一个栈上，等待期间不分配内存
+ */
+struct IoWait : public wtsclwq::TimeoutNode {
+  IoWait(wtsclwq::SockIoScheduler *scheduler, int fd, wtsclwq::FileDescContext::EventType event_type)
+      : TimeoutNode(&IoWait::OnTimeout), scheduler_(scheduler), fd_(fd), event_type_(event_type) {}
+
+  static void OnTimeout(wtsclwq::TimeoutNode *node) {
+    auto *wait = static_cast<IoWait *>(node);
+    // 只有真正唤醒了等待的协程才算超时，IO事件先到达时等待已经结束，这里什么也不做
+    wait->timed_out_ = wait->scheduler_->RemoveAndTriggerEventListening(wait->fd_, wait->event_type_);
+  }
+
+  wtsclwq::SockIoScheduler *scheduler_{nullptr};      // 等待所在的IO调度器
+  int fd_{-1};                                        // 等待的fd
+  wtsclwq::FileDescContext::EventType event_type_{};  // 等待的事件
+  bool timed_out_{false};                             // 是否被超时唤醒
+};
+
+/**
+ * @brief 挂起当前协程，直到fd上的事件就绪或者超时
+ * @details 超时节点在时间轮中时，CancelTimeout直接把它摘下；已经被取出时等待回调执行完毕，
+ * 回调只有在事件仍在等待时才会唤醒协程，因此过期的超时不会误伤之后的等待
+ * @return 0表示事件就绪，-1表示失败，超时时errno为ETIMEDOUT
+ */
+static auto WaitFdEvent(wtsclwq::SockIoScheduler *scheduler, int fd, wtsclwq::FileDescContext::EventType event_type,
+                        uint64_t timeout_ms) -> int {
+  bool has_timeout = timeout_ms != UINT64_MAX;
+  IoWait stack_wait(scheduler, fd, event_type);
+  IoWait *wait = &stack_wait;
+  // 共享栈协程挂起时栈上的数据会被换出，时间轮不能持有指向它的指针，只能把等待状态放在堆上
+  std::unique_ptr<IoWait> heap_wait = nullptr;
+  if (has_timeout && wtsclwq::Coroutine::GetThreadRunningCoroutine()->IsSharedStack()) {
+    heap_wait = std::make_unique<IoWait>(scheduler, fd, event_type);
+    wait = heap_wait.get();
+  }
+
+  if (has_timeout) {
+    scheduler->AddTimeout(wait, timeout_ms);
+  }
+  if (!scheduler->AddEventListening(fd, event_type)) {
+    LOG_ERROR(sys_logger) << "add event listening error, fd = " << fd << ", event_type = " << event_type;
+    if (has_timeout) {
+      scheduler->CancelTimeout(wait);
+    }
+    return -1;
+  }
+  // 超时在注册事件之前就已经触发，没有唤醒任何协程；事件仍然由自己注册着时撤销它，直接返回超时
+  if (has_timeout && wait->fired_ && !wait->timed_out_ && scheduler->RemoveEventListening(fd, event_type)) {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+  wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
+  if (has_timeout) {
+    scheduler->CancelTimeout(wait);
+  }
+  if (wait->timed_out_) {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+  return 0;
+}
+
+template <typename OriginFunc, typename PrepFunc, typename... Args>
 static auto DoIo(int fd, OriginFunc origin_func, std::string_view hook_fun_name, uint32_t event_type, int timeout_type,
-                 Args &&...args) -> ssize_t {
+                 PrepFunc &&prep, Args &&...args) -> ssize_t {
   if (!wtsclwq::IsHookEnabled()) {
     return origin_func(fd, std::forward<Args>(args)...);
   }
@@ -103,11 +282,19 @@ static auto DoIo(int fd, OriginFunc origin_func, std::string_view hook_fun_name,
   }
 
   uint64_t time_out = fd_info_wrapper->GetTimeout(timeout_type);
-  // 条件定时器的条件，如果监听IO事件就绪之前，定时器触发，那么我们需要取消监听事件并返回错误
-  // 反之，如果在定时器触发之前，IO事件就绪了，那么我们需要取消定时器
-  auto timer_triggered = std::make_shared<bool>(false);
+  uint32_t generation = fd_info_wrapper->GetGeneration();
+  // io_uring后端直接提交IO操作本身，不需要先失败一次再等待就绪
+  ssize_t uring_result = 0;
+  if (DoIoUring(fd, time_out, prep, &uring_result)) {
+    return uring_result;
+  }
 
 retry:
+  // 等待期间fd被其他协程关闭了，它的编号甚至可能已经被新的fd复用
+  if (fd_info_wrapper->IsClosed() || fd_info_wrapper->GetGeneration() != generation) {
+    errno = EBADF;
+    return -1;
+  }
   ssize_t len = origin_func(fd, std::forward<Args>(args)...);
   // 如果是EINTR错误，那么我们需要重试
   while (len == -1 && errno == EINTR) {
@@ -116,45 +303,12 @@ retry:
   // 如果是EAGAIN错误，表示当前IO还没有就绪，需要利用SockIoScheduler来等待IO就绪并执行回调（这里的回调协程就是回到当前上下文继续执行）
   if (len == -1 && errno == EAGAIN) {
     auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
-    wtsclwq::Timer::s_ptr timer = nullptr;
-    std::weak_ptr<bool> timer_triggered_weak_ptr(timer_triggered);
-    // 只有该函数返回true，定时器才能执行回调
-    std::function<bool()> cond = [timer_triggered_weak_ptr]() -> bool {
-      auto s_ptr = timer_triggered_weak_ptr.lock();
-      // 条件非空，且没有改变
-      return s_ptr != nullptr && !(*s_ptr);
-    };
-    // 为什么一定要用条件定时器？
-    // 在多线程情况下，有可能出现IO事件还没就绪，所有定时器没有被Cancel，然后被线程A取走。
-    // 在该线程逐个执行定时器的过程中，IO事件就绪，另一个线程B执行了IO事件的回调，即回到这里继续执行，但是它却无法Cancel掉线程A取走的定时器。
-    // 如果不使用条件定时器，那线程A就能够顺利执行定时器的回调，这样就会导致线程B执行了IO事件的回调，线程A也执行了定时器的回调。
-    // 如果使用一个weak_ptr作为条件，当线程B顺利完成IO事件的回调，结束了当前函数时，weak_ptr的宿主就会析构，那么线程A就不会执行定时器的回调了。
-    std::function<void()> timer_cb = [timer_triggered_weak_ptr, &fd, &sock_io_scheduler, &event_type]() {
-      auto s_ptr = timer_triggered_weak_ptr.lock();
-      *s_ptr = true;
-      sock_io_scheduler->RemoveAndTriggerEventListening(fd,
-                                                        static_cast<wtsclwq::FileDescContext::EventType>(event_type));
-    };
-
-    if (time_out != UINT64_MAX) {
-      timer = sock_io_scheduler->AddConditionTimer(time_out, timer_cb, cond);
-    }
-    bool add_sucess =
-        sock_io_scheduler->AddEventListening(fd, static_cast<wtsclwq::FileDescContext::EventType>(event_type));
-    if (!add_sucess) {
-      LOG_ERROR(sys_logger) << "add event listening error, fd = " << fd << ", event_type = " << event_type;
-      if (timer != nullptr) {
-        timer->Cancel();
-      }
-      return -1;
-    }
-    // 为什么这里不需要获取raw_ptr？
-    wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
-    if (timer != nullptr) {
-      timer->Cancel();
+    auto target_event_type = static_cast<wtsclwq::FileDescContext::EventType>(event_type);
+    // 上一次等待之后fd已经又就绪过了（边缘在没有协程等待时到达），直接重试，不需要注册事件和定时器
+    if (sock_io_scheduler->ConsumeReadyEvent(fd, target_event_type)) {
+      goto retry;
     }
-    if (*timer_triggered) {
-      errno = ETIMEDOUT;
+    if (WaitFdEvent(sock_io_scheduler.get(), fd, target_event_type, time_out) != 0) {
       return -1;
     }
     goto retry;
@@ -162,6 +316,121 @@ retry:
   return len;
 }
 
+/**
+ * @brief 一次多路复用等待的状态，任意一个fd的事件或者超时都会唤醒协程，只有第一次唤醒生效
+ * @details 事件回调在等待结束之后仍可能被调度执行，因此状态放在堆上，由回调共同持有
+ */
+struct PollWait : public wtsclwq::TimeoutNode {
+  PollWait(wtsclwq::SockIoScheduler *scheduler, wtsclwq::Coroutine::s_ptr coroutine, int thread_id)
+      : TimeoutNode(&PollWait::OnTimeout),
+        scheduler_(scheduler),
+        coroutine_(std::move(coroutine)),
+        thread_id_(thread_id) {}
+
+  static void OnTimeout(wtsclwq::TimeoutNode *node) { static_cast<PollWait *>(node)->Wake(); }
+
+  void Wake() {
+    if (!woken_.exchange(true)) {
+      scheduler_->Schedule(std::move(coroutine_), thread_id_);
+    }
+  }
+
+  wtsclwq::SockIoScheduler *scheduler_{nullptr};  // 等待所在的IO调度器
+  wtsclwq::Coroutine::s_ptr coroutine_{nullptr};  // 等待的协程，被唤醒时移交给调度器
+  int thread_id_{-1};                             // 协程回到的线程，每线程一个reactor模式下为发起等待的线程
+  std::atomic<bool> woken_{false};                // 协程是否已经被唤醒
+};
+
+/**
+ * @brief 挂起当前协程，直到任意一个fd上关心的事件到达或者超时
+ * @details 就绪通知只说明fd可能就绪，调用者醒来之后需要重新检查；
+ * 同一个fd的同一个事件同时只能有一个协程等待，其他协程正在等待时返回false
+ * @param timeout_ms 超时时间，UINT64_MAX表示不超时
+ * @return 是否成功等待，返回false时没有挂起，调用者退回到阻塞的系统调用
+ */
+static auto WaitAnyFdEvent(wtsclwq::SockIoScheduler *scheduler, const struct pollfd *fds, nfds_t nfds,
+                           uint64_t timeout_ms) -> bool {
+  // POLLERR和POLLHUP总是会被报告，没有关心任何事件的fd也要等待读事件
+  std::vector<std::pair<int, wtsclwq::FileDescContext::EventType>> events;
+  for (nfds_t i = 0; i < nfds; i++) {
+    if (fds[i].fd < 0) {
+      continue;
+    }
+    if ((fds[i].events & POLLOUT) == 0 || (fds[i].events & (POLLIN | POLLPRI | POLLRDHUP)) != 0) {
+      events.emplace_back(fds[i].fd, wtsclwq::FileDescContext::EventType::Read);
+    }
+    if ((fds[i].events & POLLOUT) != 0) {
+      events.emplace_back(fds[i].fd, wtsclwq::FileDescContext::EventType::Write);
+    }
+  }
+  std::sort(events.begin(), events.end());
+  events.erase(std::unique(events.begin(), events.end()), events.end());
+
+  // 每线程一个reactor模式下，协程回到发起等待的线程继续执行
+  int thread_id = scheduler->IsReactorPerThread() ? wtsclwq::GetCurrSysThreadId() : -1;
+  auto wait = std::make_shared<PollWait>(scheduler, wtsclwq::Coroutine::GetThreadRunningCoroutine(), thread_id);
+  bool has_timeout = timeout_ms != UINT64_MAX;
+  if (has_timeout) {
+    scheduler->AddTimeout(wait.get(), timeout_ms);
+  }
+  size_t added = 0;
+  for (; added < events.size(); added++) {
+    if (!scheduler->TryAddEventListening(events[added].first, events[added].second, [wait] { wait->Wake(); },
+                                         wait.get())) {
+      break;
+    }
+  }
+  // 注册失败时撤销已经注册的事件；已经被唤醒时仍然要挂起，把调度器中的这次调度消费掉
+  if (added != events.size() && !wait->woken_.exchange(true)) {
+    if (has_timeout) {
+      scheduler->CancelTimeout(wait.get());
+    }
+    for (size_t i = 0; i < added; i++) {
+      scheduler->RemoveEventListening(events[i].first, events[i].second, wait.get());
+    }
+    return false;
+  }
+  wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
+  if (has_timeout) {
+    scheduler->CancelTimeout(wait.get());
+  }
+  // 已经触发的注册可能被其他协程重新注册，只撤销自己的
+  for (size_t i = 0; i < added; i++) {
+    scheduler->RemoveEventListening(events[i].first, events[i].second, wait.get());
+  }
+  return added == events.size();
+}
+
+/**
+ * @brief 多路复用调用的公共逻辑：先不阻塞地检查一次，没有就绪时挂起协程等待fds上的事件，醒来之后再检查，直到就绪或者超时
+ * @param timeout_ms 超时时间，负数表示不超时
+ * @param try_once 以给定的超时时间调用原始函数，返回0表示没有就绪
+ * @return 与原始函数相同
+ */
+template <typename TryFunc>
+static auto DoPoll(const struct pollfd *fds, nfds_t nfds, int timeout_ms, TryFunc &&try_once) -> int {
+  if (timeout_ms == 0 || !wtsclwq::CanHookSuspend()) {
+    return try_once(timeout_ms);
+  }
+  auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
+  uint64_t deadline = timeout_ms < 0 ? UINT64_MAX : wtsclwq::GetCurrMs() + timeout_ms;
+  while (true) {
+    int ret = try_once(0);
+    if (ret != 0) {
+      return ret;
+    }
+    uint64_t now = wtsclwq::GetCurrMs();
+    if (now >= deadline) {
+      return 0;
+    }
+    uint64_t remaining = deadline == UINT64_MAX ? UINT64_MAX : deadline - now;
+    if (!WaitAnyFdEvent(sock_io_scheduler.get(), fds, nfds, remaining)) {
+      // 有fd不能加入epoll，或者已经有其他协程在等待它的事件，只能阻塞整个线程
+      return try_once(remaining == UINT64_MAX ? -1 : static_cast<int>(remaining));
+    }
+  }
+}
+
 extern "C" {
 #define FUNC(name) name##_func name##_f = nullptr;
 WRAP(FUNC);
@@ -222,7 +491,7 @@ auto socket(int domain, int type, int protocol) -> int {
   if (fd == -1) {
     return fd;
   }
-  wtsclwq::FdWrapperMgr::GetInstance()->Get(fd, true);
+  wtsclwq::FdWrapperMgr::GetInstance()->Create(fd);
   return fd;
 }
 
@@ -245,49 +514,35 @@ auto ConnectWithTimeout(int fd, const struct sockaddr *addr, socklen_t addrlen,
   if (timeout_ms == 0) {
     return connect_f(fd, addr, addrlen);
   }
-  int ret = connect_f(fd, addr, addrlen);
-  if (ret == 0) {
-    return 0;
-  }
-  if (ret != -1 || errno != EINPROGRESS) {
-    return ret;
-  }
-
-  auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
-  wtsclwq::Timer::s_ptr timer = nullptr;
-  std::shared_ptr<bool> timer_triggered = std::make_shared<bool>(false);
-  std::weak_ptr<bool> timer_triggered_weak_ptr(timer_triggered);
-  std::function<bool()> cond = [timer_triggered_weak_ptr]() -> bool {
-    auto s_ptr = timer_triggered_weak_ptr.lock();
-    return s_ptr != nullptr && !(*s_ptr);
-  };
-  std::function<void()> timer_cb = [sock_io_scheduler, fd, timer_triggered_weak_ptr]() {
-    auto s_ptr = timer_triggered_weak_ptr.lock();
-    *s_ptr = true;
-    sock_io_scheduler->RemoveAndTriggerEventListening(fd, wtsclwq::FileDescContext::EventType::Write);
-  };
-  if (timeout_ms != UINT64_MAX) {
-    timer = sock_io_scheduler->AddConditionTimer(timeout_ms, timer_cb, cond);
-  }
-  bool add_success = sock_io_scheduler->AddEventListening(fd, wtsclwq::FileDescContext::EventType::Write);
-  if (add_success) {
-    // 如果事件监听注册成功，那么我们需要让出当前协程的执行权，等待事件就绪后，回到当前上下文继续执行
-    wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
-    // 如果IO事件就绪了，那么我们需要取消定时器
-    if (timer != nullptr) {
-      timer->Cancel();
-    }
-    // 如果在处理IO之前，定时器触发了，那么我们需要返回错误
-    if (*timer_triggered) {
-      errno = ETIMEDOUT;
-      return -1;
+  ssize_t uring_result = 0;
+  bool uring_done = DoIoUring(
+      fd, timeout_ms,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_CONNECT, fd, addr, 0, addrlen);
+        return true;
+      },
+      &uring_result);
+  int ret = 0;
+  if (uring_done) {
+    // 较老的内核对非阻塞socket会直接返回EINPROGRESS，此时连接已经发起，继续用epoll等待可写
+    if (uring_result == 0 || errno != EINPROGRESS) {
+      return static_cast<int>(uring_result);
     }
   } else {
-    // 如果事件监听注册失败，那么我们需要取消定时器
-    if (timer != nullptr) {
-      timer->Cancel();
+    ret = connect_f(fd, addr, addrlen);
+    if (ret == 0) {
+      return 0;
+    }
+    if (ret != -1 || errno != EINPROGRESS) {
+      return ret;
     }
-    LOG_ERROR(sys_logger) << "add event listening error, fd = " << fd;
+  }
+
+  auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
+  // 等待可写，注册失败时直接检查连接的结果
+  if (WaitFdEvent(sock_io_scheduler.get(), fd, wtsclwq::FileDescContext::EventType::Write, timeout_ms) != 0 &&
+      errno == ETIMEDOUT) {
+    return -1;
   }
 
   int error = 0;
@@ -309,53 +564,370 @@ auto connect(int fd, const struct sockaddr *addr, socklen_t len) -> int {
 }
 
 auto accept(int fd, struct sockaddr *addr, socklen_t *len) -> int {
-  int new_socket_fd = DoIo(fd, accept_f, "accept", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, addr, len);
+  int new_socket_fd = DoIo(
+      fd, accept_f, "accept", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_ACCEPT, fd, addr, 0, reinterpret_cast<uint64_t>(len));
+        return true;
+      },
+      addr, len);
   if (new_socket_fd > 0) {
-    wtsclwq::FdWrapperMgr::GetInstance()->Get(new_socket_fd, true);
+    wtsclwq::FdWrapperMgr::GetInstance()->Create(new_socket_fd);
+  }
+  return new_socket_fd;
+}
+
+auto accept4(int fd, struct sockaddr *addr, socklen_t *len, int flags) -> int {
+  int new_socket_fd = DoIo(
+      fd, accept4_f, "accept4", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_ACCEPT, fd, addr, 0, reinterpret_cast<uint64_t>(len));
+        sqe->accept_flags = static_cast<uint32_t>(flags);
+        return true;
+      },
+      addr, len, flags);
+  if (new_socket_fd > 0 && wtsclwq::IsHookEnabled()) {
+    auto fd_info_wrapper = wtsclwq::FdWrapperMgr::GetInstance()->Create(new_socket_fd);
+    // 用户要求的非阻塞需要记录下来，否则之后的读写会替用户等待
+    if (fd_info_wrapper != nullptr && (flags & SOCK_NONBLOCK) != 0) {
+      fd_info_wrapper->SetUserLevelNonBlock(true);
+    }
   }
   return new_socket_fd;
 }
 
 auto read(int fd, void *buf, size_t nbytes) -> ssize_t {
-  return DoIo(fd, read_f, "read", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, buf, nbytes);
+  ssize_t file_result = 0;
+  if (DoFileIo(
+          fd, nbytes,
+          [&](io_uring_sqe *sqe) {
+            wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_READ, fd, buf, IoUringLength(nbytes), -1);
+            return true;
+          },
+          [=](size_t offset, size_t length) { return read_f(fd, static_cast<char *>(buf) + offset, length); },
+          &file_result)) {
+    return file_result;
+  }
+  return DoIo(
+      fd, read_f, "read", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_READ, fd, buf, IoUringLength(nbytes), -1);
+        return true;
+      },
+      buf, nbytes);
 }
 
 auto readv(int fd, const struct iovec *iov, int iovcnt) -> ssize_t {  // NOLINT
-  return DoIo(fd, readv_f, "readv", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, iov, iovcnt);
+  return DoIo(
+      fd, readv_f, "readv", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_READV, fd, iov, iovcnt, -1);
+        return true;
+      },
+      iov, iovcnt);
 }
 
 auto recv(int fd, void *buf, size_t n, int flags) -> ssize_t {
-  return DoIo(fd, recv_f, "recv", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, buf, n, flags);
+  return DoIo(
+      fd, recv_f, "recv", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_RECV, fd, buf, IoUringLength(n), 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      buf, n, flags);
 }
 
 auto recvfrom(int fd, void *buf, size_t n, int flags, struct sockaddr *addr, socklen_t *addr_len) -> ssize_t {
-  return DoIo(fd, recvfrom_f, "recvfrom", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, buf, n, flags, addr,
-              addr_len);
+  return DoIo(
+      fd, recvfrom_f, "recvfrom", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        // 需要对端地址时走epoll，io_uring没有直接对应recvfrom的操作
+        if (addr != nullptr) {
+          return false;
+        }
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_RECV, fd, buf, IoUringLength(n), 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      buf, n, flags, addr, addr_len);
 }
 
 auto recvmsg(int fd, struct msghdr *message, int flags) -> ssize_t {
-  return DoIo(fd, recvmsg_f, "recvmsg", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, message, flags);
+  return DoIo(
+      fd, recvmsg_f, "recvmsg", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_RECVMSG, fd, message, 1, 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      message, flags);
 }
 
 auto write(int fd, const void *buf, size_t n) -> ssize_t {
-  return DoIo(fd, write_f, "write", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, buf, n);
+  ssize_t file_result = 0;
+  if (DoFileIo(
+          fd, n,
+          [&](io_uring_sqe *sqe) {
+            wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_WRITE, fd, buf, IoUringLength(n), -1);
+            return true;
+          },
+          [=](size_t offset, size_t length) { return write_f(fd, static_cast<const char *>(buf) + offset, length); },
+          &file_result)) {
+    return file_result;
+  }
+  return DoIo(
+      fd, write_f, "write", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_WRITE, fd, buf, IoUringLength(n), -1);
+        return true;
+      },
+      buf, n);
 }
 
 auto writev(int fd, const struct iovec *iov, int iovcnt) -> ssize_t {  // NOLINT
-  return DoIo(fd, writev_f, "writev", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, iov, iovcnt);
+  return DoIo(
+      fd, writev_f, "writev", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_WRITEV, fd, iov, iovcnt, -1);
+        return true;
+      },
+      iov, iovcnt);
 }
 
 auto send(int fd, const void *buf, size_t n, int flags) -> ssize_t {
-  return DoIo(fd, send_f, "send", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, buf, n, flags);
+  return DoIo(
+      fd, send_f, "send", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_SEND, fd, buf, IoUringLength(n), 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      buf, n, flags);
 }
 
 auto sendto(int fd, const void *buf, size_t n, int flags, const struct sockaddr *addr, socklen_t addr_len) -> ssize_t {
-  return DoIo(fd, sendto_f, "sendto", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, buf, n, flags, addr,
-              addr_len);
+  return DoIo(
+      fd, sendto_f, "sendto", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [&](io_uring_sqe *sqe) {
+        // 指定了目的地址时走epoll，io_uring没有直接对应sendto的操作
+        if (addr != nullptr) {
+          return false;
+        }
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_SEND, fd, buf, IoUringLength(n), 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      buf, n, flags, addr, addr_len);
 }
 
 auto sendmsg(int fd, const struct msghdr *message, int flags) -> ssize_t {
-  return DoIo(fd, sendmsg_f, "sendmsg", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, message, flags);
+  return DoIo(
+      fd, sendmsg_f, "sendmsg", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [&](io_uring_sqe *sqe) {
+        wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_SENDMSG, fd, message, 1, 0);
+        sqe->msg_flags = flags;
+        return true;
+      },
+      message, flags);
+}
+
+auto poll(struct pollfd *fds, nfds_t nfds, int timeout) -> int {
+  return DoPoll(fds, nfds, timeout, [&](int timeout_ms) { return poll_f(fds, nfds, timeout_ms); });
+}
+
+/**
+ * @brief 转换成poll完成，fd_set只是作为输入输出，就绪的判断规则与内核中select的实现一致
+ */
+auto select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout) -> int {
+  if (!wtsclwq::CanHookSuspend() || nfds < 0 || nfds > FD_SETSIZE ||
+      (timeout != nullptr && (timeout->tv_sec < 0 || timeout->tv_usec < 0))) {
+    return select_f(nfds, readfds, writefds, exceptfds, timeout);
+  }
+  std::vector<struct pollfd> fds;
+  for (int fd = 0; fd < nfds; fd++) {
+    int16_t events = 0;
+    if (readfds != nullptr && FD_ISSET(fd, readfds)) {
+      events |= POLLIN;
+    }
+    if (writefds != nullptr && FD_ISSET(fd, writefds)) {
+      events |= POLLOUT;
+    }
+    if (exceptfds != nullptr && FD_ISSET(fd, exceptfds)) {
+      events |= POLLPRI;
+    }
+    if (events != 0) {
+      fds.push_back({fd, events, 0});
+    }
+  }
+  int timeout_ms = -1;
+  uint64_t begin = wtsclwq::GetCurrMs();
+  if (timeout != nullptr) {
+    timeout_ms = static_cast<int>(std::min<uint64_t>(timeout->tv_sec * 1000 + timeout->tv_usec / 1000, INT32_MAX));
+  }
+  int ret = DoPoll(fds.data(), fds.size(), timeout_ms,
+                   [&](int wait_ms) { return poll_f(fds.data(), fds.size(), wait_ms); });
+  if (ret < 0) {
+    return ret;
+  }
+  for (const auto &pfd : fds) {
+    if ((pfd.revents & POLLNVAL) != 0) {
+      errno = EBADF;
+      return -1;
+    }
+  }
+  ret = 0;
+  for (const auto &pfd : fds) {
+    bool readable = (pfd.events & POLLIN) != 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    bool writable = (pfd.events & POLLOUT) != 0 && (pfd.revents & (POLLOUT | POLLERR)) != 0;
+    bool exceptional = (pfd.events & POLLPRI) != 0 && (pfd.revents & POLLPRI) != 0;
+    ret += static_cast<int>(readable) + static_cast<int>(writable) + static_cast<int>(exceptional);
+    if (readfds != nullptr && !readable) {
+      FD_CLR(pfd.fd, readfds);
+    }
+    if (writefds != nullptr && !writable) {
+      FD_CLR(pfd.fd, writefds);
+    }
+    if (exceptfds != nullptr && !exceptional) {
+      FD_CLR(pfd.fd, exceptfds);
+    }
+  }
+  // 与Linux的select一样，返回时timeout中是剩余的时间
+  if (timeout != nullptr) {
+    uint64_t elapsed = wtsclwq::GetCurrMs() - begin;
+    uint64_t total = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
+    uint64_t remaining = total > elapsed ? total - elapsed : 0;
+    timeout->tv_sec = static_cast<time_t>(remaining / 1000);
+    timeout->tv_usec = static_cast<suseconds_t>(remaining % 1000 * 1000);
+  }
+  return ret;
+}
+
+/**
+ * @brief epoll fd本身在有就绪事件时可读，等待它的读事件即可
+ */
+auto epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) -> int {
+  struct pollfd pfd = {epfd, POLLIN, 0};
+  return DoPoll(&pfd, 1, timeout,
+                [&](int timeout_ms) { return epoll_wait_f(epfd, events, maxevents, timeout_ms); });
+}
+
+/**
+ * @brief 等待out_fd可写，in_fd通常是普通文件，读取它不会返回EAGAIN
+ */
+auto sendfile(int out_fd, int in_fd, off_t *offset, size_t count) -> ssize_t {
+  return DoIo(
+      out_fd, sendfile_f, "sendfile", wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO,
+      [](io_uring_sqe * /*sqe*/) { return false; }, in_fd, offset, count);
+}
+
+/**
+ * @brief 哪一端是由hook管理的socket就等待哪一端，两端都不是时按原样调用
+ */
+auto splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) -> ssize_t {
+  auto no_uring = [](io_uring_sqe * /*sqe*/) { return false; };
+  if (!wtsclwq::IsHookEnabled()) {
+    return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+  }
+  auto in_info_wrapper = wtsclwq::FdWrapperMgr::GetInstance()->Get(fd_in);
+  if (in_info_wrapper != nullptr && in_info_wrapper->IsSocket()) {
+    return DoIo(fd_in, splice_f, "splice", wtsclwq::FileDescContext::EventType::Read, SO_RCVTIMEO, no_uring, off_in,
+                fd_out, off_out, len, flags);
+  }
+  auto out_info_wrapper = wtsclwq::FdWrapperMgr::GetInstance()->Get(fd_out);
+  if (out_info_wrapper != nullptr && out_info_wrapper->IsSocket()) {
+    return DoIo(
+        fd_out,
+        [&](int fd) { return splice_f(fd_in, off_in, fd, off_out, len, flags); }, "splice",
+        wtsclwq::FileDescContext::EventType::Write, SO_SNDTIMEO, no_uring);
+  }
+  return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+auto pread(int fd, void *buf, size_t nbytes, off_t offset) -> ssize_t {
+  ssize_t file_result = 0;
+  if (DoFileIo(
+          fd, nbytes,
+          [&](io_uring_sqe *sqe) {
+            wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_READ, fd, buf, IoUringLength(nbytes), offset);
+            return true;
+          },
+          [=](size_t done, size_t length) {
+            return pread_f(fd, static_cast<char *>(buf) + done, length, offset + static_cast<off_t>(done));
+          },
+          &file_result)) {
+    return file_result;
+  }
+  return pread_f(fd, buf, nbytes, offset);
+}
+
+auto pwrite(int fd, const void *buf, size_t n, off_t offset) -> ssize_t {
+  ssize_t file_result = 0;
+  if (DoFileIo(
+          fd, n,
+          [&](io_uring_sqe *sqe) {
+            wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_WRITE, fd, buf, IoUringLength(n), offset);
+            return true;
+          },
+          [=](size_t done, size_t length) {
+            return pwrite_f(fd, static_cast<const char *>(buf) + done, length, offset + static_cast<off_t>(done));
+          },
+          &file_result)) {
+    return file_result;
+  }
+  return pwrite_f(fd, buf, n, offset);
+}
+
+auto fsync(int fd) -> int {
+  ssize_t file_result = 0;
+  if (DoFileIo(
+          fd, 0,
+          [&](io_uring_sqe *sqe) {
+            wtsclwq::IoUring::PrepareRw(sqe, IORING_OP_FSYNC, fd, nullptr, 0, 0);
+            return true;
+          },
+          [=](size_t /*offset*/, size_t /*length*/) { return fsync_f(fd); }, &file_result)) {
+    return static_cast<int>(file_result);
+  }
+  return fsync_f(fd);
+}
+
+/**
+ * @brief hook了open，打开文件时路径查找和磁盘读取都可能阻塞，在协程中发起时交给文件IO线程池
+ */
+auto open(const char *file, int oflag, ...) -> int {
+  mode_t mode = 0;
+  if ((oflag & O_CREAT) != 0 || (oflag & O_TMPFILE) == O_TMPFILE) {
+    va_list arg_list;
+    va_start(arg_list, oflag);
+    mode = va_arg(arg_list, mode_t);
+    va_end(arg_list);
+  }
+  if (!wtsclwq::IsHookEnabled()) {
+    return open_f(file, oflag, mode);
+  }
+  int fd = -1;
+  if (CanSuspendForFileIo()) {
+    fd = static_cast<int>(OffloadFileIo(0, [=](size_t /*offset*/, size_t /*length*/) {
+      return static_cast<ssize_t>(open_f(file, oflag, mode));
+    }));
+  } else {
+    fd = open_f(file, oflag, mode);
+  }
+  if (fd == -1) {
+    return fd;
+  }
+  // 之后在这个fd上的读写才能知道它是普通文件
+  wtsclwq::FdWrapperMgr::GetInstance()->Create(fd);
+  return fd;
+}
+
+auto stat(const char *file, struct stat *buf) -> int {
+  if (!CanSuspendForFileIo()) {
+    return stat_f(file, buf);
+  }
+  return static_cast<int>(OffloadFileIo(
+      0, [=](size_t /*offset*/, size_t /*length*/) { return static_cast<ssize_t>(stat_f(file, buf)); }));
 }
 
 auto close(int fd) -> int {
@@ -364,15 +936,25 @@ auto close(int fd) -> int {
   }
   auto fd_info_wrapper = wtsclwq::FdWrapperMgr::GetInstance()->Get(fd);
   if (fd_info_wrapper == nullptr) {
+    // 不由hook管理的fd也可能被poll加入了epoll，同样要在编号被复用之前移除
+    auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
+    if (sock_io_scheduler != nullptr) {
+      sock_io_scheduler->CloseEventListening(fd);
+    }
     return close_f(fd);
   }
 
+  // 先标记关闭，被唤醒的协程重试时直接返回EBADF，不会在fd关闭前后重新注册事件
+  fd_info_wrapper->SetClosed(true);
+  auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
+  if (sock_io_scheduler != nullptr) {
+    // io_uring中的操作持有文件的引用，close不会唤醒它们，需要在fd失效之前主动取消
+    sock_io_scheduler->CancelIo(fd);
+    // fd在epoll中的注册是持久的，需要在fd编号被复用之前移除
+    sock_io_scheduler->CloseEventListening(fd);
+  }
   auto ret = close_f(fd);
   if (ret == 0) {
-    auto sock_io_scheduler = wtsclwq::SockIoScheduler::GetThreadSockIoScheduler();
-    if (sock_io_scheduler != nullptr) {
-      sock_io_scheduler->RemoveAndTriggerAllTypeEventListening(fd);
-    }
     wtsclwq::FdWrapperMgr::GetInstance()->Remove(fd);
   }
   return ret;
@@ -2,8 +2,13 @@
 #define _WTSCLWQ_HOOK_
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <cstdint>
@@ -15,6 +20,9 @@ auto IsHookEnabled() -> bool;
 
 // 启用当前线程的hook io
 void SetHookEnabled(bool v);
+
+// 当前是否在IO调度器中一个可以挂起的任务协程里，hook之后的调用只在这种情况下挂起协程，否则阻塞线程
+auto CanHookSuspend() -> bool;
 }  // namespace wtsclwq
 
 extern "C" {
@@ -38,6 +46,9 @@ extern connect_func connect_f;
 using accept_func = int (*)(int, struct sockaddr *, socklen_t *);
 extern accept_func accept_f;
 
+using accept4_func = int (*)(int, struct sockaddr *, socklen_t *, int);
+extern accept4_func accept4_f;
+
 // read系列
 using read_func = ssize_t (*)(int, void *, size_t);
 extern read_func read_f;
@@ -70,6 +81,39 @@ extern sendto_func sendto_f;
 using sendmsg_func = ssize_t (*)(int, const struct msghdr *, int);
 extern sendmsg_func sendmsg_f;
 
+// 多路复用系列
+using poll_func = int (*)(struct pollfd *, nfds_t, int);
+extern poll_func poll_f;
+
+using select_func = int (*)(int, fd_set *, fd_set *, fd_set *, struct timeval *);
+extern select_func select_f;
+
+using epoll_wait_func = int (*)(int, struct epoll_event *, int, int);
+extern epoll_wait_func epoll_wait_f;
+
+// 零拷贝系列
+using sendfile_func = ssize_t (*)(int, int, off_t *, size_t);
+extern sendfile_func sendfile_f;
+
+using splice_func = ssize_t (*)(int, loff_t *, int, loff_t *, size_t, unsigned int);
+extern splice_func splice_f;
+
+// 文件系列
+using pread_func = ssize_t (*)(int, void *, size_t, off_t);
+extern pread_func pread_f;
+
+using pwrite_func = ssize_t (*)(int, const void *, size_t, off_t);
+extern pwrite_func pwrite_f;
+
+using fsync_func = int (*)(int);
+extern fsync_func fsync_f;
+
+using open_func = int (*)(const char *, int, ...);
+extern open_func open_f;
+
+using stat_func = int (*)(const char *, struct stat *);
+extern stat_func stat_f;
+
 // close系列
 using close_func = int (*)(int);
 extern close_func close_f;
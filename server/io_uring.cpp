@@ -0,0 +1,168 @@
+#include "io_uring.h"
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "log.h"
+
+namespace wtsclwq {
+static auto sys_logger = NAMED_LOGGER("system");
+
+static auto SysIoUringSetup(uint32_t entries, io_uring_params *params) -> int {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static auto SysIoUringEnter(int ring_fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) -> int {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+template <typename T>
+static auto RingField(void *ring_ptr, uint32_t offset) -> T * {
+  return reinterpret_cast<T *>(static_cast<char *>(ring_ptr) + offset);
+}
+
+auto IoUring::Create(uint32_t entries) -> u_ptr {
+  io_uring_params params{};
+  params.flags = IORING_SETUP_CLAMP;
+  int ring_fd = SysIoUringSetup(entries, &params);
+  if (ring_fd < 0) {
+    LOG_WARN(sys_logger) << "io_uring_setup failed, errno: " << errno << ", errstr: " << strerror(errno);
+    return nullptr;
+  }
+
+  u_ptr ring(new IoUring());
+  ring->ring_fd_ = ring_fd;
+  ring->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  ring->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    ring->sq_ring_size_ = std::max(ring->sq_ring_size_, ring->cq_ring_size_);
+    ring->cq_ring_size_ = ring->sq_ring_size_;
+  }
+
+  ring->sq_ring_ptr_ = mmap(nullptr, ring->sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                            IORING_OFF_SQ_RING);
+  if (ring->sq_ring_ptr_ == MAP_FAILED) {
+    ring->sq_ring_ptr_ = nullptr;
+    LOG_WARN(sys_logger) << "mmap io_uring sq ring failed, errno: " << errno << ", errstr: " << strerror(errno);
+    return nullptr;
+  }
+  if (single_mmap) {
+    ring->cq_ring_ptr_ = ring->sq_ring_ptr_;
+  } else {
+    ring->cq_ring_ptr_ = mmap(nullptr, ring->cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ring_fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring_ptr_ == MAP_FAILED) {
+      ring->cq_ring_ptr_ = nullptr;
+      LOG_WARN(sys_logger) << "mmap io_uring cq ring failed, errno: " << errno << ", errstr: " << strerror(errno);
+      return nullptr;
+    }
+  }
+  ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                    IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    LOG_WARN(sys_logger) << "mmap io_uring sqes failed, errno: " << errno << ", errstr: " << strerror(errno);
+    return nullptr;
+  }
+  ring->sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  ring->sq_head_ = RingField<std::atomic<uint32_t>>(ring->sq_ring_ptr_, params.sq_off.head);
+  ring->sq_tail_ = RingField<std::atomic<uint32_t>>(ring->sq_ring_ptr_, params.sq_off.tail);
+  ring->sq_mask_ = *RingField<uint32_t>(ring->sq_ring_ptr_, params.sq_off.ring_mask);
+  ring->sq_entries_ = *RingField<uint32_t>(ring->sq_ring_ptr_, params.sq_off.ring_entries);
+  ring->sq_array_ = RingField<uint32_t>(ring->sq_ring_ptr_, params.sq_off.array);
+  ring->cq_head_ = RingField<std::atomic<uint32_t>>(ring->cq_ring_ptr_, params.cq_off.head);
+  ring->cq_tail_ = RingField<std::atomic<uint32_t>>(ring->cq_ring_ptr_, params.cq_off.tail);
+  ring->cq_mask_ = *RingField<uint32_t>(ring->cq_ring_ptr_, params.cq_off.ring_mask);
+  ring->cqes_ = RingField<io_uring_cqe>(ring->cq_ring_ptr_, params.cq_off.cqes);
+  return ring;
+}
+
+IoUring::~IoUring() {
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ptr_ != nullptr && cq_ring_ptr_ != sq_ring_ptr_) {
+    munmap(cq_ring_ptr_, cq_ring_size_);
+  }
+  if (sq_ring_ptr_ != nullptr) {
+    munmap(sq_ring_ptr_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+  }
+}
+
+auto IoUring::Submit(const io_uring_sqe *sqes, uint32_t n) -> bool {
+  std::lock_guard<std::mutex> lock(submit_mutex_);
+  // 每次提交都会让内核取走所有的sqe，因此提交队列在这里总是空的，只需要检查n是否超过队列长度
+  uint32_t tail = sq_tail_->load(std::memory_order_relaxed);
+  uint32_t head = sq_head_->load(std::memory_order_acquire);
+  if (n == 0 || n > sq_entries_ - (tail - head)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t index = (tail + i) & sq_mask_;
+    sqes_[index] = sqes[i];
+    sq_array_[index] = index;
+  }
+  uint32_t new_tail = tail + n;
+  sq_tail_->store(new_tail, std::memory_order_release);
+
+  while (true) {
+    head = sq_head_->load(std::memory_order_acquire);
+    if (head == new_tail) {
+      return true;
+    }
+    int ret = SysIoUringEnter(ring_fd_, new_tail - head, 0, 0);
+    if (ret >= 0 || errno == EINTR) {
+      continue;
+    }
+    if (sq_head_->load(std::memory_order_acquire) == tail) {
+      // 内核一个sqe都没有取走（例如完成队列溢出时返回EBUSY），撤销这次提交，由调用者选择其他方式完成IO
+      sq_tail_->store(tail, std::memory_order_release);
+      LOG_WARN(sys_logger) << "io_uring_enter failed, errno: " << errno << ", errstr: " << strerror(errno);
+      return false;
+    }
+    // 已经取走了一部分，剩下的必须也提交出去，否则链接在一起的sqe会被拆开
+    sched_yield();
+  }
+}
+
+auto IoUring::PeekCompletions(io_uring_cqe *cqes, uint32_t max) -> uint32_t {
+  uint32_t count = 0;
+  while (count < max) {
+    std::unique_lock<std::mutex> lock(reap_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      break;
+    }
+    uint32_t head = cq_head_->load(std::memory_order_relaxed);
+    uint32_t tail = cq_tail_->load(std::memory_order_acquire);
+    while (head != tail && count < max) {
+      cqes[count++] = cqes_[head & cq_mask_];
+      ++head;
+    }
+    cq_head_->store(head, std::memory_order_release);
+    lock.unlock();
+    // 持有锁期间到达的cqe唤醒的其他线程可能因为拿不到锁而直接返回了，释放之后再检查一次，
+    // 否则这些cqe要等到下一个完成事件才会被收割
+    if (cq_tail_->load(std::memory_order_acquire) == head) {
+      break;
+    }
+  }
+  return count;
+}
+
+void IoUring::PrepareRw(io_uring_sqe *sqe, uint8_t opcode, int fd, const void *addr, uint32_t len, uint64_t offset) {
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(addr);
+  sqe->len = len;
+  sqe->off = offset;
+}
+}  // namespace wtsclwq
@@ -0,0 +1,80 @@
+#ifndef _WTSCLWQ_IO_URING_
+#define _WTSCLWQ_IO_URING_
+
+#include <linux/io_uring.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "noncopyable.h"
+
+namespace wtsclwq {
+/**
+ * @brief 对io_uring系统调用的最小封装，不依赖liburing
+ * @details 提交队列由多个线程共享，提交时加锁；完成队列同一时刻只允许一个线程收割。
+ * 环形队列的fd可以被epoll监听，有新的完成事件时变为可读
+ */
+class IoUring : public Noncopyable {
+ public:
+  using u_ptr = std::unique_ptr<IoUring>;
+
+  /**
+   * @brief 创建一个io_uring实例
+   * @param entries 提交队列的长度，内核会向上取整到2的幂
+   * @return 失败（内核不支持或者被禁用）返回nullptr
+   */
+  static auto Create(uint32_t entries) -> u_ptr;
+
+  ~IoUring();
+
+  /**
+   * @brief 获取环形队列的fd，用于注册到epoll中
+   */
+  auto GetFd() const -> int { return ring_fd_; }
+
+  /**
+   * @brief 将n个sqe按顺序放入提交队列并提交给内核
+   * @details 同一次调用中的sqe在提交队列中是连续的，因此可以用IOSQE_IO_LINK把它们连接起来
+   * @return 是否提交成功，失败时sqe不会留在提交队列中
+   */
+  auto Submit(const io_uring_sqe *sqes, uint32_t n) -> bool;
+
+  /**
+   * @brief 尝试从完成队列中取出最多max个cqe
+   * @details 如果其他线程正在收割完成队列，直接返回0，
+   * 该线程在释放之后会再次检查完成队列，持有锁期间到达的完成事件不会被遗漏
+   * @return 取出的cqe数量
+   */
+  auto PeekCompletions(io_uring_cqe *cqes, uint32_t max) -> uint32_t;
+
+  /**
+   * @brief 初始化一个读写类的sqe，与liburing中的io_uring_prep_rw含义相同
+   */
+  static void PrepareRw(io_uring_sqe *sqe, uint8_t opcode, int fd, const void *addr, uint32_t len, uint64_t offset);
+
+ private:
+  IoUring() = default;
+
+  int ring_fd_{-1};                      // io_uring实例的fd
+  void *sq_ring_ptr_{nullptr};           // 提交队列环形缓冲区的映射地址
+  size_t sq_ring_size_{0};               // 提交队列环形缓冲区的映射大小
+  void *cq_ring_ptr_{nullptr};           // 完成队列环形缓冲区的映射地址，内核支持SINGLE_MMAP时与sq_ring_ptr_相同
+  size_t cq_ring_size_{0};               // 完成队列环形缓冲区的映射大小
+  io_uring_sqe *sqes_{nullptr};          // sqe数组
+  size_t sqes_size_{0};                  // sqe数组的映射大小
+  std::atomic<uint32_t> *sq_head_{};     // 提交队列头，由内核更新
+  std::atomic<uint32_t> *sq_tail_{};     // 提交队列尾，由我们更新
+  uint32_t sq_mask_{0};                  // 提交队列掩码
+  uint32_t sq_entries_{0};               // 提交队列长度
+  uint32_t *sq_array_{nullptr};          // 提交队列中保存的是sqe数组的下标
+  std::atomic<uint32_t> *cq_head_{};     // 完成队列头，由我们更新
+  std::atomic<uint32_t> *cq_tail_{};     // 完成队列尾，由内核更新
+  uint32_t cq_mask_{0};                  // 完成队列掩码
+  io_uring_cqe *cqes_{nullptr};          // cqe数组
+  std::mutex submit_mutex_{};            // 保护提交队列
+  std::mutex reap_mutex_{};              // 保证同一时刻只有一个线程收割完成队列
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_IO_URING_
@@ -1,9 +1,17 @@
 #include "log.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <yaml-cpp/node/node.h>
+#include <zlib.h>
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -13,6 +21,7 @@
 #include <string_view>
 #include <utility>
 #include <vector>
+#include "binary_log.h"
 #include "config.h"
 #include "env.h"
 #include "utils.h"
@@ -71,143 +80,157 @@ static auto FromString(std::string_view str) -> LogLevel {
   return LogLevel::UNKNOWN;
 }
 
-LogEvent::LogEvent(LogLevel level, const char *file, int32_t line, int64_t elapse, uint32_t thread_id,
-                   uint64_t coroutine_id, std::string_view thread_name, std::string_view logger_name, time_t time)
-    : level_(level),
-      file_(file),
-      line_(line),
-      elapse_(elapse),
-      thread_id_(thread_id),
-      coroutine_id_(coroutine_id),
-      thread_name_(thread_name),
-      logger_name_(logger_name),  // Fixed order of initialization
-      time_(time) {}
+LogStreamBuf::LogStreamBuf() { Reset(); }
 
-void LogEvent::Printf(const char *fmt...) {
-  va_list args;
-  va_start(args, fmt);
-  auto formatted_string = StringUtil::Formatv(fmt, args);
-  va_end(args);
+void LogStreamBuf::Reset() { setp(inline_buffer_.data(), inline_buffer_.data() + inline_buffer_.size()); }
 
-  ss_ << formatted_string;
+void LogStreamBuf::Grow(size_t min_free) {
+  size_t used = pptr() - pbase();
+  size_t capacity = std::max(heap_buffer_.size(), inline_buffer_.size() * 2);
+  while (capacity - used < min_free) {
+    capacity *= 2;
+  }
+  if (pbase() == inline_buffer_.data()) {
+    // 从内联缓冲区转移到堆上
+    if (heap_buffer_.size() < capacity) {
+      heap_buffer_.resize(capacity);
+    }
+    memcpy(heap_buffer_.data(), inline_buffer_.data(), used);
+  } else if (heap_buffer_.size() < capacity) {
+    heap_buffer_.resize(capacity);
+  }
+  setp(heap_buffer_.data(), heap_buffer_.data() + heap_buffer_.size());
+  pbump(static_cast<int>(used));
 }
 
-class MessageFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit MessageFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetContent(); }
-};
-
-class LevelFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit LevelFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << ToString(event->GetLevel()); }
-};
-
-class ElapseFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit ElapseFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetElapse(); }
-};
-
-class ThreadIdFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit ThreadIdFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetThreadId(); }
-};
+auto LogStreamBuf::overflow(int_type ch) -> int_type {
+  if (traits_type::eq_int_type(ch, traits_type::eof())) {
+    return traits_type::not_eof(ch);
+  }
+  Grow(1);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
 
-class CoroutineIdFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit CoroutineIdFormatItem(std::string_view str) {}
+auto LogStreamBuf::xsputn(const char_type *s, std::streamsize count) -> std::streamsize {
+  auto size = static_cast<size_t>(count);
+  if (static_cast<size_t>(epptr() - pptr()) < size) {
+    Grow(size);
+  }
+  memcpy(pptr(), s, size);
+  pbump(static_cast<int>(size));
+  return count;
+}
 
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetCoroutineId(); }
-};
+LogEvent::LogEvent() = default;
 
-class ThreadNameFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit ThreadNameFormatItem(std::string_view str) {}
+LogEvent::LogEvent(LogLevel level, const char *file, int32_t line, int64_t elapse, uint32_t thread_id,
+                   uint64_t coroutine_id, std::string_view thread_name, std::string_view logger_name, time_t time) {
+  Reset(level, file, line, elapse, thread_id, coroutine_id, thread_name, logger_name, time);
+}
 
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetThreadName(); }
-};
+void LogEvent::Reset(LogLevel level, const char *file, int32_t line, int64_t elapse, uint32_t thread_id,
+                     uint64_t coroutine_id, std::string_view thread_name, std::string_view logger_name, time_t time) {
+  level_ = level;
+  file_ = file;
+  line_ = line;
+  elapse_ = elapse;
+  thread_id_ = thread_id;
+  coroutine_id_ = coroutine_id;
+  thread_name_len_ = std::min(thread_name.size(), thread_name_.size() - 1);
+  memcpy(thread_name_.data(), thread_name.data(), thread_name_len_);
+  logger_name_ = logger_name;
+  time_ = time;
+  // 清空消息，并恢复上一次使用时可能被修改的流状态和格式
+  buf_.Reset();
+  stream_.clear();
+  stream_.flags(std::ios_base::dec | std::ios_base::skipws);
+  stream_.precision(6);
+  stream_.width(0);
+  stream_.fill(' ');
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit DateTimeFormatItem(std::string_view format = "%Y-%m-%d %H:%M:%S") : format_(format) {
-    if (format.empty()) {
-      format_ = "%Y-%m-%d %H:%M:%S";
+auto LogEvent::Acquire() -> s_ptr {
+  // 同一个线程中同时存在的日志事件很少（日志语句中调用的函数又打了日志，或者协程在日志语句中切换），几个就够用
+  static thread_local std::array<s_ptr, 4> t_event_pool;
+  for (auto &event : t_event_pool) {
+    if (event == nullptr) {
+      event = std::make_shared<LogEvent>();
+      return event;
+    }
+    if (event.use_count() == 1) {
+      return event;
     }
   }
+  return std::make_shared<LogEvent>();
+}
 
-  void Format(std::ostream &os, LogEvent::s_ptr event) override {
-    struct tm tm;
-    time_t time = event->GetTime();
-    localtime_r(&time, &tm);
-    char buf[64];
-    strftime(buf, sizeof(buf), format_.c_str(), &tm);
-    os << buf;
+void LogEvent::Printf(const char *fmt...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list args_copy;
+  va_copy(args_copy, args);
+  // 大部分日志都不长，先尝试格式化到栈上的缓冲区
+  char buf[512];
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  if (n >= 0 && static_cast<size_t>(n) < sizeof(buf)) {
+    stream_.write(buf, n);
+  } else {
+    stream_ << StringUtil::Formatv(fmt, args_copy);
   }
+  va_end(args_copy);
+  va_end(args);
+}
 
- private:
-  std::string format_{};
-};
-
-class FilenameFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit FilenameFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetFile(); }
-};
-
-class LineFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit LineFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetLine(); }
-};
-
-class NewLineFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit NewLineFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << std::endl; }
-};
-
-class StringFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit StringFormatItem(std::string_view str) : str_(str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << str_; }
-
- private:
-  std::string str_;
-};
-
-class TabFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit TabFormatItem(std::string_view str) {}
-
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << "\t"; }
-};
+// 两位十进制数字的查找表，每次处理两位数字，减少除法次数
+static constexpr char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
 
-class PercentFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit PercentFormatItem(std::string_view str) {}
+/**
+ * @brief 把无符号整数转换为十进制字符串写入out，不经过std::ostream
+ * @return 写入之后的位置
+ */
+static auto WriteUInt(uint64_t value, char *out) -> char * {
+  char tmp[20];
+  char *end = tmp + sizeof(tmp);
+  char *p = end;
+  while (value >= 100) {
+    uint64_t index = (value % 100) * 2;
+    value /= 100;
+    p -= 2;
+    p[0] = DIGIT_PAIRS[index];
+    p[1] = DIGIT_PAIRS[index + 1];
+  }
+  if (value >= 10) {
+    p -= 2;
+    p[0] = DIGIT_PAIRS[value * 2];
+    p[1] = DIGIT_PAIRS[value * 2 + 1];
+  } else {
+    *--p = static_cast<char>('0' + value);
+  }
+  memcpy(out, p, end - p);
+  return out + (end - p);
+}
 
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << "%"; }
-};
+static auto WriteInt(int64_t value, char *out) -> char * {
+  if (value < 0) {
+    *out++ = '-';
+    return WriteUInt(~static_cast<uint64_t>(value) + 1, out);
+  }
+  return WriteUInt(static_cast<uint64_t>(value), out);
+}
 
-class LoggerNameFormatItem : public LogFormatter::FormatItem {
- public:
-  explicit LoggerNameFormatItem(std::string_view str) {}
+static auto WriteString(std::string_view str, char *out) -> char * {
+  memcpy(out, str.data(), str.size());
+  return out + str.size();
+}
 
-  void Format(std::ostream &os, LogEvent::s_ptr event) override { os << event->GetLoggerName(); }
-};
+static std::atomic<uint64_t> s_formatter_id{0};
 
-LogFormatter::LogFormatter(std::string_view pattern) : pattern_(pattern) { Init(); }
+LogFormatter::LogFormatter(std::string_view pattern) : pattern_(pattern), id_(++s_formatter_id) { Init(); }
 
 void LogFormatter::Init() {
   // 按顺序存储解析到的pattern项
@@ -289,41 +312,60 @@ void LogFormatter::Init() {
     tmp.clear();
   }
 
-  static std::unordered_map<std::string, std::function<FormatItem::s_ptr(const std::string &str)>> s_format_items = {
-#define KV(str, C)                                                             \
-  {                                                                            \
-    #str, [](const std::string &fmt) { return FormatItem::s_ptr(new C(fmt)); } \
-  }
-      KV(m, MessageFormatItem),      // m:消息
-      KV(p, LevelFormatItem),        // p:日志级别
-      KV(c, LoggerNameFormatItem),   // c:日志器名称
-      KV(d, DateTimeFormatItem),     // d:日期时间
-      KV(r, ElapseFormatItem),       // r:累计毫秒数
-      KV(f, FilenameFormatItem),     // f:文件名
-      KV(l, LineFormatItem),         // l:行号
-      KV(t, ThreadIdFormatItem),     // t:线程号
-      KV(C, CoroutineIdFormatItem),  // C:协程号
-      KV(N, ThreadNameFormatItem),   // N:线程名称
-      KV(%, PercentFormatItem),      // %:百分号
-      KV(T, TabFormatItem),          // T:制表符
-      KV(n, NewLineFormatItem),      // n:换行符
-#undef KV
+  static std::unordered_map<std::string, OpCode> s_op_codes = {
+      {"m", OpCode::Message},      // m:消息
+      {"p", OpCode::Level},        // p:日志级别
+      {"c", OpCode::LoggerName},   // c:日志器名称
+      {"d", OpCode::DateTime},     // d:日期时间
+      {"r", OpCode::Elapse},       // r:累计毫秒数
+      {"f", OpCode::File},         // f:文件名
+      {"l", OpCode::Line},         // l:行号
+      {"t", OpCode::ThreadId},     // t:线程号
+      {"C", OpCode::CoroutineId},  // C:协程号
+      {"N", OpCode::ThreadName},   // N:线程名称
   };
 
+  // 把解析出的模板项编译为指令列表，%%、%T、%n和常规字符串都是固定的文本，相邻的合并为一条指令
+  instructions_.clear();
+  literals_.clear();
+  fixed_size_ = 0;
+  string_field_count_ = 0;
+  date_format_ = dateformat.empty() ? "%Y-%m-%d %H:%M:%S" : dateformat;
   for (auto &v : patterns) {
     if (v.first == 0) {
-      items_.push_back(FormatItem::s_ptr(new StringFormatItem(v.second)));
-    } else if (v.second == "d") {
-      items_.push_back(FormatItem::s_ptr(new DateTimeFormatItem(dateformat)));
+      AddLiteral(v.second);
+    } else if (v.second == "%") {
+      AddLiteral("%");
+    } else if (v.second == "T") {
+      AddLiteral("\t");
+    } else if (v.second == "n") {
+      AddLiteral("\n");
+      has_new_line_ = true;
     } else {
-      auto it = s_format_items.find(v.second);
-      if (it == s_format_items.end()) {
+      auto it = s_op_codes.find(v.second);
+      if (it == s_op_codes.end()) {
         error = true;
         break;
       }
-      items_.push_back(it->second(v.second));
+      instructions_.push_back({it->second, 0, 0});
+      switch (it->second) {
+        case OpCode::Message:
+        case OpCode::LoggerName:
+        case OpCode::File:
+        case OpCode::ThreadName:
+          string_field_count_++;
+          break;
+        case OpCode::DateTime:
+          fixed_size_ += MAX_DATE_TIME_SIZE;
+          break;
+        default:
+          // 日志级别和整数都不超过20个字符
+          fixed_size_ += MAX_INTEGER_SIZE;
+          break;
+      }
     }
   }
+  fixed_size_ += literals_.size();
 
   if (error) {
     has_error_ = true;
@@ -331,17 +373,117 @@ void LogFormatter::Init() {
   }
 }
 
-auto LogFormatter::Format(const LogEvent::s_ptr &event) -> std::string {
-  std::stringstream ss;
-  for (auto &item : items_) {
-    item->Format(ss, event);
+void LogFormatter::AddLiteral(std::string_view str) {
+  if (!instructions_.empty() && instructions_.back().op_ == OpCode::Literal) {
+    instructions_.back().length_ += str.size();
+  } else {
+    instructions_.push_back(
+        {OpCode::Literal, static_cast<uint32_t>(literals_.size()), static_cast<uint32_t>(str.size())});
   }
-  return ss.str();
+  literals_.append(str);
+}
+
+auto LogFormatter::WriteDateTime(time_t time, char *out) const -> char * {
+  /**
+   * @brief 线程局部的日期缓存，同一秒内的日志直接复制上一次格式化的结果
+   */
+  struct DateCache {
+    uint64_t formatter_id_{0};         // 所属格式器的id，0表示空闲
+    time_t time_{0};                   // 缓存的时间戳
+    size_t length_{0};                 // 格式化结果的长度
+    char text_[MAX_DATE_TIME_SIZE]{};  // 格式化结果
+  };
+  static thread_local std::array<DateCache, 4> t_date_caches;
+  static thread_local size_t t_next_cache = 0;
+
+  DateCache *cache = nullptr;
+  for (auto &c : t_date_caches) {
+    if (c.formatter_id_ == id_) {
+      cache = &c;
+      break;
+    }
+  }
+  if (cache == nullptr) {
+    // 同一个线程交替使用超过4个格式器时轮流替换
+    cache = &t_date_caches[t_next_cache];
+    t_next_cache = (t_next_cache + 1) % t_date_caches.size();
+    cache->formatter_id_ = id_;
+    cache->time_ = time - 1;
+  }
+  if (cache->time_ != time) {
+    struct tm tm;
+    localtime_r(&time, &tm);
+    cache->length_ = strftime(cache->text_, sizeof(cache->text_), date_format_.c_str(), &tm);
+    cache->time_ = time;
+  }
+  memcpy(out, cache->text_, cache->length_);
+  return out + cache->length_;
+}
+
+void LogFormatter::FormatTo(const LogEvent &event, LogStreamBuf *buf) const {
+  std::string_view content = event.GetContent();
+  std::string_view file = event.GetFile();
+  std::string_view logger_name = event.GetLoggerName();
+  std::string_view thread_name = event.GetThreadName();
+  // 预先保证缓冲区足够大，之后直接写入，不再逐项检查容量
+  size_t max_field_size = std::max({content.size(), file.size(), logger_name.size(), thread_name.size()});
+  char *begin = buf->PrepareWrite(fixed_size_ + string_field_count_ * max_field_size);
+  char *p = begin;
+  for (const auto &ins : instructions_) {
+    switch (ins.op_) {
+      case OpCode::Literal:
+        p = WriteString({literals_.data() + ins.offset_, ins.length_}, p);
+        break;
+      case OpCode::Message:
+        p = WriteString(content, p);
+        break;
+      case OpCode::Level:
+        p = WriteString(ToString(event.GetLevel()), p);
+        break;
+      case OpCode::LoggerName:
+        p = WriteString(logger_name, p);
+        break;
+      case OpCode::DateTime:
+        p = WriteDateTime(event.GetTime(), p);
+        break;
+      case OpCode::Elapse:
+        p = WriteInt(event.GetElapse(), p);
+        break;
+      case OpCode::File:
+        p = WriteString(file, p);
+        break;
+      case OpCode::Line:
+        p = WriteInt(event.GetLine(), p);
+        break;
+      case OpCode::ThreadId:
+        p = WriteUInt(event.GetThreadId(), p);
+        break;
+      case OpCode::CoroutineId:
+        p = WriteUInt(event.GetCoroutineId(), p);
+        break;
+      case OpCode::ThreadName:
+        p = WriteString(thread_name, p);
+        break;
+    }
+  }
+  buf->Commit(p - begin);
+}
+
+auto LogFormatter::Format(const LogEvent::s_ptr &event) -> std::string {
+  LogStreamBuf buf;
+  FormatTo(*event, &buf);
+  return std::string(buf.View());
 }
 
 auto LogFormatter::Format(const LogEvent::s_ptr &event, std::ostream &os) -> std::ostream & {
-  for (auto &item : items_) {
-    item->Format(os, event);
+  static thread_local LogStreamBuf t_buf;
+  t_buf.Reset();
+  FormatTo(*event, &t_buf);
+  std::string_view text = t_buf.View();
+  os.write(text.data(), static_cast<std::streamsize>(text.size()));
+  if (has_new_line_) {
+    // 和之前的%n使用std::endl保持一致，每条日志都刷新流
+    os.flush();
   }
   return os;
 }
@@ -358,14 +500,25 @@ auto LogAppender::GetFormatter() const -> LogFormatter::s_ptr {
   return formatter_ == nullptr ? default_formatter_ : formatter_;
 }
 
+void LogAppender::LogBinary(std::string_view record) {
+  auto event = LogEvent::Acquire();
+  if (BinaryLogRegistryMgr::GetInstance()->Decode(record, event.get())) {
+    Log(event);
+  }
+}
+
 StdoutLogAppender::StdoutLogAppender() : LogAppender(std::make_shared<LogFormatter>()) {}
 
 void StdoutLogAppender::Log(LogEvent::s_ptr event) {
-  if (formatter_ != nullptr) {
-    formatter_->Format(event, std::cout);
-  } else {
-    default_formatter_->Format(event, std::cout);
-  }
+  // 先在线程局部的缓冲区中格式化完整的一条日志，再一次写入，多个线程的日志不会交错
+  static thread_local LogStreamBuf t_record_buf;
+  // 所有标准输出目标共享同一个std::cout
+  static std::mutex s_stdout_mutex;
+  t_record_buf.Reset();
+  GetFormatter()->FormatTo(*event, &t_record_buf);
+  std::string_view record = t_record_buf.View();
+  std::lock_guard<std::mutex> lock(s_stdout_mutex);
+  std::cout.write(record.data(), static_cast<std::streamsize>(record.size()));
 }
 
 auto StdoutLogAppender::FlushConfigToYmal() -> std::string {
@@ -378,81 +531,603 @@ auto StdoutLogAppender::FlushConfigToYmal() -> std::string {
   return ss.str();
 }
 
-FileLogAppender::FileLogAppender(std::string_view filename)
-    : LogAppender(std::make_shared<LogFormatter>()), filename_(filename) {
+/**
+ * @brief 后台的日志滚动线程，所有日志文件的滚动任务都在这个线程中按顺序执行，第一次提交任务时才创建线程
+ */
+class LogRotateWorker {
+ public:
+  static auto GetInstance() -> LogRotateWorker * {
+    static LogRotateWorker s_worker;
+    return &s_worker;
+  }
+
+  void Submit(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+    if (thread_ == nullptr) {
+      thread_ = std::make_unique<Thread>([this] { Run(); }, "log_rotator");
+    }
+    cond_.notify_one();
+  }
+
+  ~LogRotateWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      cond_.notify_one();
+    }
+    if (thread_ != nullptr) {
+      thread_->Join();
+    }
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        // 退出之前把剩余的任务执行完
+        if (tasks_.empty()) {
+          break;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_{};                        // 保护tasks_和stopping_
+  std::condition_variable cond_{};            // 有新任务或者需要停止时唤醒滚动线程
+  std::list<std::function<void()>> tasks_{};  // 待执行的滚动任务
+  bool stopping_{false};                      // 是否正在停止
+  std::unique_ptr<Thread> thread_{};          // 滚动线程
+};
+
+LogFile::LogFile(std::string_view filename, const LogRotatePolicy &policy) : filename_(filename), policy_(policy) {
+  time_t now = time(nullptr);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  utc_offset_ = tm.tm_gmtoff;
   Reopen();
-  if (open_error_) {
+}
+
+LogFile::~LogFile() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+auto LogFile::Reopen() -> bool {
+  int fd = open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
     std::cout << "open file " << filename_ << " failed" << std::endl;
+    return false;
+  }
+  struct stat st {};
+  fstat(fd, &st);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ >= 0) {
+    close(fd_);
   }
+  fd_ = fd;
+  regular_ = S_ISREG(st.st_mode);
+  size_ = regular_ ? static_cast<uint64_t>(st.st_size) : 0;
+  // 已有内容的文件按最后修改时间计算所属周期，程序重启时也能滚动掉上一个周期留下的文件
+  period_ = GetPeriod(size_ > 0 ? st.st_mtime : time(nullptr));
+  return true;
 }
 
-void FileLogAppender::Log(LogEvent::s_ptr event) {
-  uint64_t now = event->GetTime();
-  if (now >= (last_time_ + 3)) {
-    Reopen();
-    if (open_error_) {
-      std::cout << "open file " << filename_ << " failed" << std::endl;
+auto LogFile::Write(const char *data, size_t size, time_t now) -> bool {
+  iovec iov{const_cast<char *>(data), size};
+  return Write(&iov, 1, now);
+}
+
+auto LogFile::Write(iovec *iovs, size_t count, time_t now) -> bool {
+  bool ok = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 分批写入，每次最多IOV_MAX个iovec，处理部分写入的情况
+    size_t index = 0;
+    while (index < count) {
+      if (fd_ < 0) {
+        ok = false;
+        break;
+      }
+      int batch = static_cast<int>(std::min<size_t>(count - index, IOV_MAX));
+      ssize_t n = writev(fd_, &iovs[index], batch);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ok = false;
+        break;
+      }
+      auto written = static_cast<size_t>(n);
+      size_ += written;
+      while (index < count && written >= iovs[index].iov_len) {
+        written -= iovs[index].iov_len;
+        index++;
+      }
+      if (written > 0) {
+        iovs[index].iov_base = static_cast<char *>(iovs[index].iov_base) + written;
+        iovs[index].iov_len -= written;
+      }
     }
-    last_time_ = now;
   }
+  CheckRotate(now);
+  return ok;
+}
+
+auto LogFile::GetPeriod(time_t now) const -> uint64_t {
+  if (policy_.interval_ == 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(now + utc_offset_) / policy_.interval_;
+}
 
-  if (open_error_) {
+void LogFile::CheckRotate(time_t now) {
+  if (!regular_ || !policy_.Enabled()) {
+    return;
+  }
+  bool need_rotate = (policy_.max_size_ != 0 && size_ >= policy_.max_size_) ||
+                     (policy_.interval_ != 0 && GetPeriod(now) != period_);
+  if (!need_rotate || rotating_.exchange(true)) {
     return;
   }
+  period_ = GetPeriod(now);
+  LogRotateWorker::GetInstance()->Submit([self = shared_from_this()] { self->Rotate(); });
+}
 
-  std::lock_guard<MutexType> lock(mutex_);
-  if (formatter_ != nullptr) {
-    if (!formatter_->Format(event, file_stream_)) {
-      std::cout << "format log event failed" << std::endl;
+auto LogFile::GetHistoryName(uint32_t index, bool compressed) const -> std::string {
+  return filename_ + "." + std::to_string(index) + (compressed ? ".gz" : "");
+}
+
+void LogFile::Rotate() {
+  // 依次把filename.i移动为filename.i+1，超出保留个数的最旧的文件被删除
+  for (uint32_t i = policy_.max_files_; i >= 1; i--) {
+    for (bool compressed : {false, true}) {
+      std::string name = GetHistoryName(i, compressed);
+      if (i == policy_.max_files_) {
+        unlink(name.c_str());
+      } else {
+        rename(name.c_str(), GetHistoryName(i + 1, compressed).c_str());
+      }
+    }
+  }
+  // 当前文件移动为filename.1，在替换文件描述符之前写入的日志仍然写到这个文件中
+  std::string history = GetHistoryName(1, false);
+  rename(filename_.c_str(), history.c_str());
+  int fd = open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd >= 0) {
+    int old_fd = -1;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      old_fd = fd_;
+      fd_ = fd;
+      size_ = 0;
+    }
+    if (old_fd >= 0) {
+      close(old_fd);
     }
   } else {
-    if (!default_formatter_->Format(event, file_stream_)) {
-      std::cout << "format log event failed" << std::endl;
+    std::cout << "open file " << filename_ << " failed" << std::endl;
+  }
+  rotating_ = false;
+
+  if (policy_.max_files_ == 0) {
+    unlink(history.c_str());
+  } else if (policy_.compress_) {
+    Compress(history);
+  }
+  ++rotate_count_;
+}
+
+auto LogFile::Compress(const std::string &filename) -> bool {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  // 先写入临时文件，压缩完成之后再重命名，避免留下不完整的压缩文件
+  std::string tmp_name = filename + ".gz.tmp";
+  gzFile gz = gzopen(tmp_name.c_str(), "wb");
+  if (gz == nullptr) {
+    close(fd);
+    return false;
+  }
+  bool ok = true;
+  std::unique_ptr<char[]> buf(new char[64 * 1024]);
+  while (true) {
+    ssize_t n = read(fd, buf.get(), 64 * 1024);
+    if (n < 0 && errno == EINTR) {
+      continue;
     }
+    if (n <= 0) {
+      ok = n == 0;
+      break;
+    }
+    if (gzwrite(gz, buf.get(), static_cast<unsigned>(n)) != n) {
+      ok = false;
+      break;
+    }
+  }
+  close(fd);
+  ok = gzclose(gz) == Z_OK && ok;
+  if (!ok || rename(tmp_name.c_str(), (filename + ".gz").c_str()) != 0) {
+    unlink(tmp_name.c_str());
+    return false;
   }
+  unlink(filename.c_str());
+  return true;
 }
 
-auto FileLogAppender::Reopen() -> bool {
-  std::lock_guard<MutexType> lock(mutex_);
-  if (file_stream_.is_open()) {
-    file_stream_.close();
+FileLogAppender::FileLogAppender(std::string_view filename, const LogRotatePolicy &policy)
+    : LogAppender(std::make_shared<LogFormatter>()), file_(std::make_shared<LogFile>(filename, policy)) {}
+
+void FileLogAppender::Log(LogEvent::s_ptr event) {
+  // 复用线程局部的缓冲区格式化日志，格式化不需要持有锁
+  static thread_local LogStreamBuf t_record_buf;
+  t_record_buf.Reset();
+  GetFormatter()->FormatTo(*event, &t_record_buf);
+  std::string_view record = t_record_buf.View();
+  file_->Write(record.data(), record.size(), event->GetTime());
+}
+
+auto FileLogAppender::Reopen() -> bool { return file_->Reopen(); }
+
+/**
+ * @brief 把滚动策略写入yaml节点，没有开启滚动时不写入
+ */
+static void RotatePolicyToYaml(const LogRotatePolicy &policy, YAML::Node *node) {
+  if (!policy.Enabled()) {
+    return;
+  }
+  if (policy.max_size_ != 0) {
+    (*node)["max_size"] = policy.max_size_;
   }
-  file_stream_.open(filename_, std::ios::app);
-  open_error_ = !file_stream_.is_open();
-  return !open_error_;
+  if (policy.interval_ != 0) {
+    (*node)["rotate_interval"] = policy.interval_;
+  }
+  (*node)["max_files"] = policy.max_files_;
+  (*node)["compress"] = policy.compress_;
 }
 
 auto FileLogAppender::FlushConfigToYmal() -> std::string {
   std::lock_guard<MutexType> lock(mutex_);
   YAML::Node node;
   node["type"] = "File";
-  node["file"] = filename_;
+  node["file"] = file_->GetFilename();
   node["pattern"] = formatter_ == nullptr ? "" : formatter_->GetPattern();
+  RotatePolicyToYaml(file_->GetPolicy(), &node);
   std::stringstream ss;
   ss << node;
   return ss.str();
 }
 
+/**
+ * @brief 单个线程独占的环形字节缓冲区，所属线程是唯一的生产者，刷盘线程是唯一的消费者
+ * @details head_和tail_只增不减，对容量取模得到下标。一条日志只有在完整写入之后才会推进tail_，
+ * 因此消费者看到的总是若干条完整的日志
+ */
+class AsyncLogAppender::ThreadBuffer {
+ public:
+  ThreadBuffer(uint64_t owner_id, size_t capacity)
+      : owner_id_(owner_id), data_(new char[capacity]), capacity_(capacity) {}
+
+  auto GetOwnerId() const -> uint64_t { return owner_id_; }
+
+  auto GetCapacity() const -> size_t { return capacity_; }
+
+  auto IsOrphaned() const -> bool { return orphaned_.load(std::memory_order_acquire); }
+
+  void SetOrphaned() { orphaned_.store(true, std::memory_order_release); }
+
+  auto GetTail() const -> uint64_t { return tail_.load(std::memory_order_acquire); }
+
+  auto GetHead() const -> uint64_t { return head_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief 写入一条日志，空间不足时不写入
+   * @param[out] used 写入之后缓冲区中已使用的字节数
+   */
+  auto Push(std::string_view record, size_t *used) -> bool {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (record.size() > capacity_ - (tail - head)) {
+      return false;
+    }
+    size_t pos = tail & (capacity_ - 1);
+    size_t first = std::min(record.size(), capacity_ - pos);
+    memcpy(data_.get() + pos, record.data(), first);
+    memcpy(data_.get(), record.data() + first, record.size() - first);
+    tail_.store(tail + record.size(), std::memory_order_release);
+    *used = tail + record.size() - head;
+    return true;
+  }
+
+  /**
+   * @brief 获取当前可读的数据，环形缓冲区回绕时需要两个iovec
+   * @return 可读的字节数
+   */
+  auto Peek(std::vector<iovec> *iovs) -> size_t {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    size_t size = tail - head;
+    if (size == 0) {
+      return 0;
+    }
+    size_t pos = head & (capacity_ - 1);
+    size_t first = std::min(size, capacity_ - pos);
+    iovs->push_back({data_.get() + pos, first});
+    if (size > first) {
+      iovs->push_back({data_.get(), size - first});
+    }
+    return size;
+  }
+
+  /**
+   * @brief 释放已经写入文件的数据
+   */
+  void Consume(size_t size) { head_.fetch_add(size, std::memory_order_release); }
+
+ private:
+  uint64_t owner_id_{0};                       // 所属输出目标的id
+  std::unique_ptr<char[]> data_{};             // 缓冲区
+  size_t capacity_{0};                         // 缓冲区大小，2的幂
+  std::atomic<bool> orphaned_{false};          // 所属输出目标是否已经析构
+  alignas(64) std::atomic<uint64_t> head_{0};  // 消费者读到的位置
+  alignas(64) std::atomic<uint64_t> tail_{0};  // 生产者写到的位置
+};
+
+static std::atomic<uint64_t> s_async_appender_id{0};
+
+AsyncLogAppender::AsyncLogAppender(std::string_view filename, size_t buffer_size, OverflowPolicy policy,
+                                   const LogRotatePolicy &rotate_policy)
+    : LogAppender(std::make_shared<LogFormatter>()),
+      file_(std::make_shared<LogFile>(filename, rotate_policy)),
+      policy_(policy),
+      id_(++s_async_appender_id) {
+  buffer_size_ = 4096;
+  while (buffer_size_ < buffer_size) {
+    buffer_size_ <<= 1;
+  }
+}
+
+AsyncLogAppender::~AsyncLogAppender() {
+  StopFlusher();
+  std::lock_guard<std::mutex> lock(buffers_mutex_);
+  for (auto &buffer : buffers_) {
+    buffer->SetOrphaned();
+  }
+}
+
+void AsyncLogAppender::StopFlusher() {
+  std::unique_ptr<Thread> flusher;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    stopping_ = true;
+    flusher = std::move(flusher_);
+  }
+  if (flusher != nullptr) {
+    WakeFlusher();
+    flusher->Join();
+  }
+}
+
+auto AsyncLogAppender::GetThreadBuffer() -> ThreadBuffer * {
+  // 当前线程在各个异步输出目标中的缓冲区
+  static thread_local std::vector<std::shared_ptr<ThreadBuffer>> t_async_log_buffers;
+  for (auto &buffer : t_async_log_buffers) {
+    if (buffer->GetOwnerId() == id_) {
+      return buffer.get();
+    }
+  }
+  // 顺便清理已经析构的输出目标留下的缓冲区
+  t_async_log_buffers.erase(std::remove_if(t_async_log_buffers.begin(), t_async_log_buffers.end(),
+                                           [](const std::shared_ptr<ThreadBuffer> &buffer) {
+                                             return buffer->IsOrphaned();
+                                           }),
+                            t_async_log_buffers.end());
+  auto buffer = std::make_shared<ThreadBuffer>(id_, buffer_size_);
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    buffers_.push_back(buffer);
+    // 第一条日志到来时才启动刷盘线程，此时子类已经构造完成，刷盘线程可以安全地调用虚函数
+    if (flusher_ == nullptr && !stopping_) {
+      flusher_ = std::make_unique<Thread>([this] { FlushLoop(); }, "log_flusher");
+    }
+  }
+  t_async_log_buffers.push_back(buffer);
+  return buffer.get();
+}
+
+void AsyncLogAppender::Log(LogEvent::s_ptr event) {
+  // 复用线程局部的缓冲区格式化日志，稳态下不分配内存
+  static thread_local LogStreamBuf t_record_buf;
+  t_record_buf.Reset();
+  GetFormatter()->FormatTo(*event, &t_record_buf);
+  Append(t_record_buf.View());
+}
+
+void AsyncLogAppender::Append(std::string_view record) {
+  ThreadBuffer *buffer = GetThreadBuffer();
+  if (record.size() > buffer->GetCapacity()) {
+    // 单条日志比整个缓冲区还大，无论如何都写不进去
+    ++dropped_count_;
+    return;
+  }
+  size_t used = 0;
+  while (!buffer->Push(record, &used)) {
+    if (policy_ != OverflowPolicy::Block || stopping_) {
+      ++dropped_count_;
+      return;
+    }
+    WakeFlusher();
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    drained_cond_.wait_for(lock, std::chrono::milliseconds(1));
+  }
+  // 缓冲区使用量刚超过一半时提前唤醒刷盘线程，避免在刷盘间隔内写满
+  if (used >= buffer_size_ / 2 && used - record.size() < buffer_size_ / 2) {
+    WakeFlusher();
+  }
+}
+
+void AsyncLogAppender::Flush() {
+  std::vector<std::pair<std::shared_ptr<ThreadBuffer>, uint64_t>> targets;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (auto &buffer : buffers_) {
+      targets.emplace_back(buffer, buffer->GetTail());
+    }
+  }
+  auto flushed = [&targets] {
+    return std::all_of(targets.begin(), targets.end(),
+                       [](const auto &target) { return target.first->GetHead() >= target.second; });
+  };
+  while (!flushed()) {
+    WakeFlusher();
+    std::unique_lock<std::mutex> lock(flush_mutex_);
+    drained_cond_.wait_for(lock, std::chrono::milliseconds(10));
+  }
+}
+
+void AsyncLogAppender::WakeFlusher() {
+  flush_requested_ = true;
+  flush_cond_.notify_one();
+}
+
+void AsyncLogAppender::FlushLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(flush_mutex_);
+      flush_cond_.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS),
+                           [this] { return flush_requested_ || stopping_; });
+      flush_requested_ = false;
+    }
+    // 先读取stopping_再刷盘，保证停止之前写入的日志都会被写入文件
+    bool stopping = stopping_;
+    DrainBuffers();
+    drained_cond_.notify_all();
+    if (stopping) {
+      break;
+    }
+  }
+}
+
+void AsyncLogAppender::DrainBuffers() {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    // 所属线程已经退出并且数据已经写完的缓冲区不再需要
+    buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                  [](const std::shared_ptr<ThreadBuffer> &buffer) {
+                                    return buffer.use_count() == 1 && buffer->GetHead() == buffer->GetTail();
+                                  }),
+                   buffers_.end());
+    buffers = buffers_;
+  }
+
+  std::vector<iovec> iovs;
+  std::vector<size_t> sizes(buffers.size());
+  for (size_t i = 0; i < buffers.size(); i++) {
+    sizes[i] = buffers[i]->Peek(&iovs);
+  }
+  std::string header;
+  BeforeDrain(&header);
+  if (!header.empty()) {
+    iovs.insert(iovs.begin(), {header.data(), header.size()});
+  }
+  std::string dropped_notice;
+  uint64_t dropped_count = dropped_count_;
+  if (policy_ == OverflowPolicy::CountDropped && dropped_count > reported_dropped_count_) {
+    dropped_notice = EncodeDroppedNotice(dropped_count - reported_dropped_count_);
+    iovs.push_back({dropped_notice.data(), dropped_notice.size()});
+    reported_dropped_count_ = dropped_count;
+  }
+
+  // 写入失败时同样丢弃这一批日志，避免缓冲区一直被占满
+  if (!iovs.empty()) {
+    file_->Write(iovs.data(), iovs.size(), time(nullptr));
+  }
+
+  for (size_t i = 0; i < buffers.size(); i++) {
+    if (sizes[i] > 0) {
+      buffers[i]->Consume(sizes[i]);
+    }
+  }
+}
+
+auto AsyncLogAppender::EncodeDroppedNotice(uint64_t dropped_count) -> std::string {
+  return "AsyncLogAppender dropped " + std::to_string(dropped_count) + " log records because the buffer was full\n";
+}
+
+auto AsyncLogAppender::FlushConfigToYmal() -> std::string {
+  std::lock_guard<MutexType> lock(mutex_);
+  YAML::Node node;
+  node["type"] = "File";
+  node["file"] = file_->GetFilename();
+  node["pattern"] = formatter_ == nullptr ? "" : formatter_->GetPattern();
+  node["async"] = true;
+  node["overflow"] = OverflowPolicyToString(policy_);
+  node["buffer_size"] = buffer_size_;
+  RotatePolicyToYaml(file_->GetPolicy(), &node);
+  std::stringstream ss;
+  ss << node;
+  return ss.str();
+}
+
+auto AsyncLogAppender::OverflowPolicyToString(OverflowPolicy policy) -> const char * {
+  switch (policy) {
+    case OverflowPolicy::Block:
+      return "block";
+    case OverflowPolicy::Drop:
+      return "drop";
+    case OverflowPolicy::CountDropped:
+      return "count";
+    default:
+      return "block";
+  }
+}
+
+auto AsyncLogAppender::OverflowPolicyFromString(std::string_view str) -> OverflowPolicy {
+  if (str == "drop" || str == "DROP") {
+    return OverflowPolicy::Drop;
+  }
+  if (str == "count" || str == "COUNT") {
+    return OverflowPolicy::CountDropped;
+  }
+  return OverflowPolicy::Block;
+}
+
 Logger::Logger(std::string_view name) : name_(name), level_(LogLevel::INFO), create_time_(GetElapsedTime()) {}
 
 void Logger::AddAppender(LogAppender::s_ptr appender) {
   std::lock_guard<MutexType> lock(mutex_);
-  appenders_.emplace_back(std::move(appender));
+  auto appenders = std::make_shared<AppenderList>(*appenders_);
+  appenders->emplace_back(std::move(appender));
+  appenders_ = std::move(appenders);
 }
 
 void Logger::RemoveAppender(const LogAppender::s_ptr &appender) {
   std::lock_guard<MutexType> lock(mutex_);
-  for (auto it = appenders_.begin(); it != appenders_.end(); it++) {
-    if (*it == appender) {
-      appenders_.erase(it);
-      break;
-    }
+  auto appenders = std::make_shared<AppenderList>(*appenders_);
+  auto it = std::find(appenders->begin(), appenders->end(), appender);
+  if (it != appenders->end()) {
+    appenders->erase(it);
+    appenders_ = std::move(appenders);
   }
 }
 
 void Logger::ClearAppenders() {
   std::lock_guard<MutexType> lock(mutex_);
-  appenders_.clear();
+  appenders_ = std::make_shared<const AppenderList>();
+}
+
+auto Logger::GetAppenders() const -> std::shared_ptr<const AppenderList> {
+  std::lock_guard<MutexType> lock(mutex_);
+  return appenders_;
 }
 
 void Logger::SetLevel(LogLevel level) {
@@ -465,27 +1140,46 @@ auto Logger::GetLevel() const -> LogLevel {
   return level_;
 }
 
-auto Logger::GetName() const -> std::string { return name_; }
+auto Logger::GetName() const -> const std::string & { return name_; }
 
 auto Logger::GetCreateTime() const -> time_t { return create_time_; }
 
 void Logger::Log(const LogEvent::s_ptr &event) {
   if (event->GetLevel() >= level_) {
-    // 保证线程安全
-    std::lock_guard<MutexType> lock(mutex_);
-    for (auto &appender : appenders_) {
+    // 输出目标各自保证线程安全，不持有日志器的锁，多个线程可以同时格式化和写入；快照不分配内存
+    auto appenders = GetAppenders();
+    for (const auto &appender : *appenders) {
       appender->Log(event);
     }
   }
 }
 
+void Logger::LogBinary(LogLevel level, std::string_view record) {
+  if (level >= level_) {
+    auto appenders = GetAppenders();
+    for (const auto &appender : *appenders) {
+      appender->LogBinary(record);
+    }
+  }
+}
+
+auto Logger::GetNameId() -> uint32_t {
+  uint32_t id = name_id_.load(std::memory_order_relaxed);
+  if (id == UINT32_MAX) {
+    // 日志器的名称不会改变，重复注册得到的是同一个id
+    id = BinaryLogRegistryMgr::GetInstance()->InternName(name_);
+    name_id_.store(id, std::memory_order_relaxed);
+  }
+  return id;
+}
+
 auto Logger::FlushConfigToYmal() -> std::string {
   std::lock_guard<MutexType> lock(mutex_);
   YAML::Node node;
   node["name"] = name_;
   node["level"] = ToString(level_);
   node["appenders"] = YAML::Load("[]");
-  for (auto &i : appenders_) {
+  for (const auto &i : *appenders_) {
     node["appenders"].push_back(YAML::Load(i->FlushConfigToYmal()));
   }
   std::stringstream ss;
@@ -496,6 +1190,12 @@ auto Logger::FlushConfigToYmal() -> std::string {
 LogEventWrap::LogEventWrap(Logger::s_ptr logger, LogEvent::s_ptr event)
     : logger_(std::move(logger)), event_(std::move(event)) {}
 
+LogEventWrap::LogEventWrap(Logger::s_ptr logger, LogLevel level, const char *file, int32_t line)
+    : logger_(std::move(logger)), event_(LogEvent::Acquire()) {
+  event_->Reset(level, file, line, GetElapsedTime() - logger_->GetCreateTime(), GetCachedSysThreadId(),
+                GetCurrCouroutineId(), GetCurrSysThreadNameView(), logger_->GetName(), time(nullptr));
+}
+
 LogEventWrap::~LogEventWrap() { logger_->Log(event_); }
 
 LoggerManager::LoggerManager() {
@@ -540,12 +1240,19 @@ auto LoggerManager::FlushConfigToYmal() -> std::string {
  *
  */
 struct LogAppenderDefine {
-  int type_ = 0;  // 1:File, 2:Stdout
+  int type_ = 0;  // 1:File, 2:Stdout, 3:Binary
   std::string pattern_;
   std::string filename_;
+  bool async_ = false;      // 文件日志是否异步写入
+  std::string overflow_;    // 异步写入时缓冲区写满的处理策略：block、drop、count
+  size_t buffer_size_ = 0;  // 异步写入时每个线程的缓冲区大小，0表示使用默认值
+  LogRotatePolicy rotate_;  // 文件日志的滚动策略
 
   auto operator==(const LogAppenderDefine &other) const -> bool {
-    return type_ == other.type_ && pattern_ == other.pattern_ && filename_ == other.filename_;
+    return type_ == other.type_ && pattern_ == other.pattern_ && filename_ == other.filename_ &&
+           async_ == other.async_ && overflow_ == other.overflow_ && buffer_size_ == other.buffer_size_ &&
+           rotate_.max_size_ == other.rotate_.max_size_ && rotate_.interval_ == other.rotate_.interval_ &&
+           rotate_.max_files_ == other.rotate_.max_files_ && rotate_.compress_ == other.rotate_.compress_;
   }
 };
 
@@ -595,6 +1302,40 @@ class LexicalCast<std::string, LoggerDefine> {
           if (a["pattern"].IsDefined()) {
             lad.pattern_ = a["pattern"].as<std::string>();
           }
+          if (a["async"].IsDefined()) {
+            lad.async_ = a["async"].as<bool>();
+          }
+          if (a["overflow"].IsDefined()) {
+            lad.overflow_ = a["overflow"].as<std::string>();
+          }
+          if (a["buffer_size"].IsDefined()) {
+            lad.buffer_size_ = a["buffer_size"].as<size_t>();
+          }
+          if (a["max_size"].IsDefined()) {
+            lad.rotate_.max_size_ = a["max_size"].as<uint64_t>();
+          }
+          if (a["rotate_interval"].IsDefined()) {
+            lad.rotate_.interval_ = a["rotate_interval"].as<uint64_t>();
+          }
+          if (a["max_files"].IsDefined()) {
+            lad.rotate_.max_files_ = a["max_files"].as<uint32_t>();
+          }
+          if (a["compress"].IsDefined()) {
+            lad.rotate_.compress_ = a["compress"].as<bool>();
+          }
+        } else if (type == "Binary") {
+          lad.type_ = 3;
+          if (!a["file"].IsDefined()) {
+            std::cout << "log appender config error: binary appender file is null, " << a << std::endl;
+            continue;
+          }
+          lad.filename_ = a["file"].as<std::string>();
+          if (a["overflow"].IsDefined()) {
+            lad.overflow_ = a["overflow"].as<std::string>();
+          }
+          if (a["buffer_size"].IsDefined()) {
+            lad.buffer_size_ = a["buffer_size"].as<size_t>();
+          }
         } else if (type == "Stdout") {
           lad.type_ = 2;
           if (a["pattern"].IsDefined()) {
@@ -623,8 +1364,27 @@ class LexicalCast<LoggerDefine, std::string> {
       if (a.type_ == 1) {
         na["type"] = "File";
         na["file"] = a.filename_;
+        if (a.async_) {
+          na["async"] = true;
+          if (!a.overflow_.empty()) {
+            na["overflow"] = a.overflow_;
+          }
+          if (a.buffer_size_ != 0) {
+            na["buffer_size"] = a.buffer_size_;
+          }
+        }
+        RotatePolicyToYaml(a.rotate_, &na);
       } else if (a.type_ == 2) {
         na["type"] = "Stdout";
+      } else if (a.type_ == 3) {
+        na["type"] = "Binary";
+        na["file"] = a.filename_;
+        if (!a.overflow_.empty()) {
+          na["overflow"] = a.overflow_;
+        }
+        if (a.buffer_size_ != 0) {
+          na["buffer_size"] = a.buffer_size_;
+        }
       }
       if (!a.pattern_.empty()) {
         na["pattern"] = a.pattern_;
@@ -662,8 +1422,16 @@ struct LogIniter {
         logger->ClearAppenders();
         for (auto &a : i.appenders_) {
           LogAppender::s_ptr appender;
-          if (a.type_ == 1) {
-            appender = std::make_shared<FileLogAppender>(a.filename_);
+          if (a.type_ == 1 && a.async_) {
+            appender = std::make_shared<AsyncLogAppender>(
+                a.filename_, a.buffer_size_ == 0 ? AsyncLogAppender::DEFAULT_BUFFER_SIZE : a.buffer_size_,
+                AsyncLogAppender::OverflowPolicyFromString(a.overflow_), a.rotate_);
+          } else if (a.type_ == 1) {
+            appender = std::make_shared<FileLogAppender>(a.filename_, a.rotate_);
+          } else if (a.type_ == 3) {
+            appender = std::make_shared<BinaryLogAppender>(
+                a.filename_, a.buffer_size_ == 0 ? AsyncLogAppender::DEFAULT_BUFFER_SIZE : a.buffer_size_,
+                AsyncLogAppender::OverflowPolicyFromString(a.overflow_));
           } else if (a.type_ == 2) {
             //  如果以守护进程方式运行，则不需要stdout
             if (!EnvMgr::GetInstance()->CheckArg("daemonize")) {
@@ -2,32 +2,35 @@
 #define _WTSCLWQ_LOG_
 
 #include <bits/types/time_t.h>
+#include <sys/uio.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <sstream>
+#include <streambuf>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 #include "lock.h"
 #include "singleton.h"
+#include "thread.h"
 #include "utils.h"
 
 #define ROOT_LOGGER wtsclwq::LoggerMgr::GetInstance()->GetRoot()
 
 #define NAMED_LOGGER(name) wtsclwq::LoggerMgr::GetInstance()->GetLogger(name)
 
-#define LEVELED_LOG(logger, level)                                                                                    \
-  if ((level) >= (logger)->GetLevel())                                                                                \
-  wtsclwq::LogEventWrap(logger, std::make_shared<wtsclwq::LogEvent>(                                                  \
-                                    level, __FILE__, __LINE__, wtsclwq::GetElapsedTime() - (logger)->GetCreateTime(), \
-                                    wtsclwq::GetCurrSysThreadId(), wtsclwq::GetCurrCouroutineId(),                    \
-                                    wtsclwq::GetCurrSysThreadName(), (logger)->GetName(), time(0)))                   \
-      .GetEvent()                                                                                                     \
-      ->GetStream()
+#define LEVELED_LOG(logger, level)     \
+  if ((level) >= (logger)->GetLevel()) \
+  wtsclwq::LogEventWrap(logger, level, __FILE__, __LINE__).GetEvent()->GetStream()
 
 #define LOG_DEBUG(logger) LEVELED_LOG(logger, wtsclwq::LogLevel::DEBUG)
 
@@ -45,15 +48,9 @@
 
 #define LOG_FATAL(logger) LEVELED_LOG(logger, wtsclwq::LogLevel::FATAL)
 
-#define FMT_LEVELED_LOG(logger, level, fmt, ...)                                                                    \
-  if ((level) >= (logger)->GetLevel())                                                                              \
-  wtsclwq::LogEventWrap(                                                                                            \
-      (logger), std::make_shared<wtsclwq::LogEvent>(level, __FILE__, __LINE__,                                      \
-                                                    wtsclwq::GetElapsedTime() - (logger)->GetCreateTime(),          \
-                                                    wtsclwq::GetCurrSysThreadId(), wtsclwq::GetCurrCouroutineId(),  \
-                                                    wtsclwq::GetCurrSysThreadName(), (logger)->GetName(), time(0))) \
-      .GetEvent()                                                                                                   \
-      ->Printf((fmt), ##__VA_ARGS__)
+#define FMT_LEVELED_LOG(logger, level, fmt, ...) \
+  if ((level) >= (logger)->GetLevel())           \
+  wtsclwq::LogEventWrap((logger), level, __FILE__, __LINE__).GetEvent()->Printf((fmt), ##__VA_ARGS__)
 
 #define FMT_LOG_DEBUG(logger, fmt, ...) FMT_LEVELED_LOG(logger, wtsclwq::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
 
@@ -100,18 +97,101 @@ static auto ToString(LogLevel level) -> const char *;
  */
 static auto FromString(std::string_view str) -> LogLevel;
 
+/**
+ * @brief 日志消息的字符缓冲区
+ * @details 消息写入内联的固定大小缓冲区，不分配内存；只有超长的消息才会转移到堆上，
+ * 堆上的缓冲区在Reset之后也会保留下来，因此复用同一个缓冲区时稳态下不会再分配内存
+ */
+class LogStreamBuf : public std::streambuf {
+ public:
+  static constexpr size_t INLINE_SIZE = 1024;  // 内联缓冲区大小
+
+  LogStreamBuf();
+
+  /**
+   * @brief 清空缓冲区，重新从内联缓冲区开始写入
+   */
+  void Reset();
+
+  /**
+   * @brief 获取已经写入的内容
+   */
+  auto View() const -> std::string_view { return {pbase(), static_cast<size_t>(pptr() - pbase())}; }
+
+  /**
+   * @brief 追加一段字符串，不经过std::ostream
+   */
+  void Append(std::string_view str) {
+    if (static_cast<size_t>(epptr() - pptr()) < str.size()) {
+      Grow(str.size());
+    }
+    memcpy(pptr(), str.data(), str.size());
+    pbump(static_cast<int>(str.size()));
+  }
+
+  /**
+   * @brief 保证至少还能写入size个字符，返回写入位置，写入之后需要调用Commit
+   */
+  auto PrepareWrite(size_t size) -> char * {
+    if (static_cast<size_t>(epptr() - pptr()) < size) {
+      Grow(size);
+    }
+    return pptr();
+  }
+
+  /**
+   * @brief 确认通过PrepareWrite写入了size个字符
+   */
+  void Commit(size_t size) { pbump(static_cast<int>(size)); }
+
+ protected:
+  auto overflow(int_type ch) -> int_type override;
+
+  auto xsputn(const char_type *s, std::streamsize count) -> std::streamsize override;
+
+ private:
+  /**
+   * @brief 扩容，保证至少还能写入min_free个字符
+   */
+  void Grow(size_t min_free);
+
+  std::array<char, INLINE_SIZE> inline_buffer_{};  // 内联缓冲区
+  std::string heap_buffer_{};                      // 超长消息使用的堆上缓冲区
+};
+
 class LogEvent {
  public:
   using s_ptr = std::shared_ptr<LogEvent>;
 
+  /**
+   * @brief 构造一个空的日志事件，之后通过Reset填充，用于线程局部的事件复用
+   */
+  LogEvent();
+
+  /**
+   * @brief 构造函数
+   * @details file和logger_name不会被复制，需要保证它们比日志事件活得更久（__FILE__和日志器的名称都满足）
+   */
   LogEvent(LogLevel level, const char *file, int32_t line, int64_t elapse, uint32_t thread_id, uint64_t coroutine_id,
            std::string_view thread_name, std::string_view logger_name, time_t time);
 
   ~LogEvent() = default;
 
+  /**
+   * @brief 重新填充日志事件的各个字段，并清空消息
+   */
+  void Reset(LogLevel level, const char *file, int32_t line, int64_t elapse, uint32_t thread_id,
+             uint64_t coroutine_id, std::string_view thread_name, std::string_view logger_name, time_t time);
+
+  /**
+   * @brief 从当前线程的事件池中取出一个空闲的日志事件，池中的事件都在使用中时才会新分配一个
+   * @details 事件被使用时引用计数大于1，所有使用者释放之后自动回到空闲状态
+   */
+  static auto Acquire() -> s_ptr;
+
   auto GetLevel() const -> LogLevel { return level_; }
 
-  auto GetContent() const -> std::string { return ss_.str(); }
+  auto GetContent() const -> std::string_view { return buf_.View(); }
 
   auto GetElapse() const -> int64_t { return elapse_; }
 
@@ -119,11 +199,11 @@ class LogEvent {
 
   auto GetCoroutineId() const -> uint64_t { return coroutine_id_; }
 
-  auto GetThreadName() const -> std::string { return thread_name_; }
+  auto GetThreadName() const -> std::string_view { return {thread_name_.data(), thread_name_len_}; }
 
-  auto GetLoggerName() const -> std::string { return logger_name_; }
+  auto GetLoggerName() const -> std::string_view { return logger_name_; }
 
-  auto GetFile() const -> std::string { return file_; }
+  auto GetFile() const -> std::string_view { return file_; }
 
   auto GetLine() const -> int { return line_; }
 
@@ -132,9 +212,9 @@ class LogEvent {
   /**
    * @brief 获取字符流，用于流式写入日志
    *
-   * @return std::stringstream&
+   * @return std::ostream&
    */
-  auto GetStream() -> std::stringstream & { return ss_; }
+  auto GetStream() -> std::ostream & { return stream_; }
 
   /**
    * @brief C风格，printf格式化写入日志
@@ -145,16 +225,20 @@ class LogEvent {
   void Printf(const char *fmt, ...);
 
  private:
-  LogLevel level_{0};          // 事件级别
-  std::stringstream ss_{};     // 字符流，存储日志内存
-  std::string file_{};         // 用文件输出时的文件名
-  int line_{0};                // 日志事件发生处的行号
-  int64_t elapse_{0};          // 程序启动(日志器创建）到现在的毫秒数
-  uint32_t thread_id_{0};      // 日志事件发生的线程id
-  uint64_t coroutine_id_{0};   // 日志事件发生的协程id
-  std::string thread_name_{};  // 日志事件发生的线程名称
-  std::string logger_name_{};  // 日志器名称
-  time_t time_{};              // 日志发生的时间戳
+  static constexpr size_t THREAD_NAME_SIZE = 16;  // 线程名称最长15个字符
+
+  LogLevel level_{0};                                 // 事件级别
+  LogStreamBuf buf_{};                                // 消息缓冲区，存储日志内容
+  std::ostream stream_{&buf_};                        // 写入buf_的字符流
+  std::string_view file_{};                           // 用文件输出时的文件名
+  int line_{0};                                       // 日志事件发生处的行号
+  int64_t elapse_{0};                                 // 程序启动(日志器创建）到现在的毫秒数
+  uint32_t thread_id_{0};                             // 日志事件发生的线程id
+  uint64_t coroutine_id_{0};                          // 日志事件发生的协程id
+  std::array<char, THREAD_NAME_SIZE> thread_name_{};  // 日志事件发生的线程名称
+  size_t thread_name_len_{0};                         // 线程名称的长度
+  std::string_view logger_name_{};                    // 日志器名称
+  time_t time_{};                                     // 日志发生的时间戳
 };
 
 class LogFormatter {
@@ -220,21 +304,63 @@ class LogFormatter {
   auto Format(const LogEvent::s_ptr &event, std::ostream &os) -> std::ostream &;
 
   /**
-   * @brief 日志格式项基类，通过不同的派生类实现对日志事件不同字段的格式化
+   * @brief 对日志事件，按照模板格式化并追加到字符缓冲区中，不经过std::ostream，也不分配内存
+   *
+   * @param event 要格式化的日志事件
+   * @param buf 要写入的缓冲区
    */
-  class FormatItem {
-   public:
-    using s_ptr = std::shared_ptr<FormatItem>;
+  void FormatTo(const LogEvent &event, LogStreamBuf *buf) const;
 
-    virtual ~FormatItem() = default;
+ private:
+  /**
+   * @brief 模板编译后的指令类型
+   */
+  enum class OpCode : uint8_t {
+    Literal,      // 常规字符串，包括%T、%n、%%
+    Message,      // 消息
+    Level,        // 日志级别
+    LoggerName,   // 日志器名称
+    DateTime,     // 日期时间
+    Elapse,       // 累计运行毫秒数
+    File,         // 文件名
+    Line,         // 行号
+    ThreadId,     // 线程id
+    CoroutineId,  // 协程id
+    ThreadName,   // 线程名称
+  };
 
-    virtual void Format(std::ostream &os, LogEvent::s_ptr event) = 0;
+  /**
+   * @brief 模板编译后的一条指令，格式化时按顺序执行即可
+   */
+  struct Instruction {
+    OpCode op_{OpCode::Literal};  // 指令类型
+    uint32_t offset_{0};          // 常规字符串在literals_中的起始位置
+    uint32_t length_{0};          // 常规字符串的长度
   };
 
- private:
-  std::string pattern_{};                   // 日志格式模板
-  std::vector<FormatItem::s_ptr> items_{};  // 日志格式模板解析后的日志格式项
-  bool has_error_{false};                   // 解析过程是否出现错误
+  /**
+   * @brief 追加一条常规字符串指令，和前一条常规字符串指令相邻时直接合并
+   */
+  void AddLiteral(std::string_view str);
+
+  /**
+   * @brief 把格式化后的日期时间写入out，同一个线程在同一秒内只调用一次strftime
+   * @return 写入之后的位置
+   */
+  auto WriteDateTime(time_t time, char *out) const -> char *;
+
+  static constexpr size_t MAX_DATE_TIME_SIZE = 64;  // 日期时间格式化之后的最大长度
+  static constexpr size_t MAX_INTEGER_SIZE = 20;    // 整数格式化之后的最大长度
+
+  std::string pattern_{};                    // 日志格式模板
+  std::vector<Instruction> instructions_{};  // 日志格式模板编译后的指令
+  std::string literals_{};                   // 所有常规字符串拼接在一起
+  std::string date_format_{};                // 日期格式
+  size_t fixed_size_{0};                     // 格式化结果中除字符串字段之外部分的最大长度
+  size_t string_field_count_{0};             // 模板中字符串字段（消息、文件名、日志器名称、线程名称）的数量
+  uint64_t id_{0};                           // 格式器的唯一id，用于区分线程局部的日期缓存
+  bool has_new_line_{false};                 // 模板中是否有换行，写入流时需要和std::endl一样刷新
+  bool has_error_{false};                    // 解析过程是否出现错误
 };
 
 class LogAppender {
@@ -252,6 +378,12 @@ class LogAppender {
 
   virtual void Log(LogEvent::s_ptr event) = 0;
 
+  /**
+   * @brief 记录一条二进制日志（见binary_log.h）
+   * @details 默认在当前线程中把记录还原为日志事件，再调用Log按格式器输出，二进制输出目标会直接写入原始字节
+   */
+  virtual void LogBinary(std::string_view record);
+
   virtual auto FlushConfigToYmal() -> std::string = 0;
 
  protected:
@@ -273,11 +405,98 @@ class StdoutLogAppender : public LogAppender {
   auto FlushConfigToYmal() -> std::string override;
 };
 
+/**
+ * @brief 日志文件的滚动策略，大小和时间间隔都为0时不滚动
+ */
+struct LogRotatePolicy {
+  uint64_t max_size_{0};   // 单个日志文件的最大字节数，超过之后滚动，0表示不按大小滚动
+  uint64_t interval_{0};   // 按本地时间对齐的滚动间隔（秒），例如86400表示每天零点滚动，0表示不按时间滚动
+  uint32_t max_files_{7};  // 保留的历史文件个数，历史文件依次命名为filename.1、filename.2...，0表示不保留
+  bool compress_{false};   // 是否在后台把滚动出来的历史文件压缩为gzip格式
+
+  auto Enabled() const -> bool { return max_size_ != 0 || interval_ != 0; }
+};
+
+/**
+ * @brief 支持滚动的日志文件
+ * @details 写入线程只负责写入和判断是否需要滚动。重命名历史文件、打开新文件、压缩都由后台的滚动线程完成，
+ * 滚动线程只在替换文件描述符的瞬间持有锁，因此滚动不会阻塞写日志的线程。
+ * 滚动完成之前写入的日志仍然写到旧文件（此时已经被重命名为filename.1）中
+ */
+class LogFile : public std::enable_shared_from_this<LogFile> {
+ public:
+  using s_ptr = std::shared_ptr<LogFile>;
+
+  LogFile(std::string_view filename, const LogRotatePolicy &policy);
+
+  ~LogFile();
+
+  auto GetFilename() const -> const std::string & { return filename_; }
+
+  auto GetPolicy() const -> const LogRotatePolicy & { return policy_; }
+
+  /**
+   * @brief 打开（或重新打开）日志文件，可以用于日志文件被外部工具移走之后
+   */
+  auto Reopen() -> bool;
+
+  /**
+   * @brief 写入数据，处理部分写入的情况，写入之后检查是否需要滚动
+   * @param now 当前时间，用于按时间滚动
+   * @return 是否全部写入
+   */
+  auto Write(const char *data, size_t size, time_t now) -> bool;
+
+  auto Write(iovec *iovs, size_t count, time_t now) -> bool;
+
+  /**
+   * @brief 获取已经完成的滚动次数，包括历史文件的压缩
+   */
+  auto GetRotateCount() const -> uint64_t { return rotate_count_; }
+
+ private:
+  /**
+   * @brief 检查是否需要滚动，需要时把滚动任务交给后台线程
+   */
+  void CheckRotate(time_t now);
+
+  /**
+   * @brief 执行滚动，只在后台的滚动线程中调用
+   */
+  void Rotate();
+
+  /**
+   * @brief 把历史文件压缩为filename.gz，成功后删除原文件，只在后台的滚动线程中调用
+   */
+  static auto Compress(const std::string &filename) -> bool;
+
+  /**
+   * @brief 获取第index个历史文件的文件名
+   */
+  auto GetHistoryName(uint32_t index, bool compressed) const -> std::string;
+
+  /**
+   * @brief 计算now所在的滚动周期，按本地时间对齐
+   */
+  auto GetPeriod(time_t now) const -> uint64_t;
+
+  std::string filename_{};                // 日志文件名
+  LogRotatePolicy policy_{};              // 滚动策略
+  std::mutex mutex_{};                    // 保护fd_，写入和替换文件描述符时持有
+  int fd_{-1};                            // 日志文件描述符
+  bool regular_{false};                   // 是否是普通文件，/dev/null之类的特殊文件不滚动
+  std::atomic<uint64_t> size_{0};         // 当前文件已经写入的字节数
+  std::atomic<uint64_t> period_{0};       // 当前文件所属的滚动周期
+  std::atomic<bool> rotating_{false};     // 是否已经提交了滚动任务，避免重复提交
+  std::atomic<uint64_t> rotate_count_{0}; // 已经完成的滚动次数
+  int64_t utc_offset_{0};                 // 本地时区相对UTC的秒数，用于按本地时间对齐滚动周期
+};
+
 class FileLogAppender : public LogAppender {
  public:
   using s_ptr = std::shared_ptr<FileLogAppender>;
 
-  explicit FileLogAppender(std::string_view filename);
+  explicit FileLogAppender(std::string_view filename, const LogRotatePolicy &policy = {});
 
   ~FileLogAppender() override = default;
 
@@ -287,11 +506,137 @@ class FileLogAppender : public LogAppender {
 
   auto Reopen() -> bool;
 
+  auto GetFile() const -> const LogFile::s_ptr & { return file_; }
+
+ private:
+  LogFile::s_ptr file_{};  // 日志文件
+};
+
+/**
+ * @brief 异步文件日志输出目标
+ * @details 调用Log的线程只负责格式化日志，并把格式化后的文本追加到自己独占的环形缓冲区中（单生产者单消费者，无锁），
+ * 后台的刷盘线程定期把所有线程的缓冲区一次性用writev批量写入文件，避免磁盘IO阻塞IO线程。
+ * 缓冲区写满时的行为由OverflowPolicy决定
+ */
+class AsyncLogAppender : public LogAppender {
+ public:
+  using s_ptr = std::shared_ptr<AsyncLogAppender>;
+
+  /**
+   * @brief 缓冲区写满时的处理策略
+   */
+  enum class OverflowPolicy {
+    Block,         // 阻塞当前线程，直到刷盘线程腾出空间
+    Drop,          // 直接丢弃这条日志
+    CountDropped,  // 丢弃这条日志并计数，刷盘线程会在文件中记录丢弃了多少条日志
+  };
+
+  static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;  // 每个线程的缓冲区默认大小
+  static constexpr uint64_t FLUSH_INTERVAL_MS = 100;      // 刷盘线程的最大刷盘间隔
+
+  /**
+   * @brief 构造函数，创建刷盘线程
+   * @param filename 日志文件名
+   * @param buffer_size 每个线程的缓冲区大小，会向上取整为2的幂
+   * @param policy 缓冲区写满时的处理策略
+   * @param rotate_policy 日志文件的滚动策略
+   */
+  explicit AsyncLogAppender(std::string_view filename, size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                            OverflowPolicy policy = OverflowPolicy::Block,
+                            const LogRotatePolicy &rotate_policy = {});
+
+  /**
+   * @brief 析构函数，停止刷盘线程，并把缓冲区中剩余的日志全部写入文件
+   */
+  ~AsyncLogAppender() override;
+
+  void Log(LogEvent::s_ptr event) override;
+
+  auto FlushConfigToYmal() -> std::string override;
+
+  /**
+   * @brief 阻塞直到调用之前所有线程写入的日志都已经写入文件
+   */
+  void Flush();
+
+  /**
+   * @brief 获取因为缓冲区写满而被丢弃的日志条数
+   */
+  auto GetDroppedCount() const -> uint64_t { return dropped_count_; }
+
+  auto GetFile() const -> const LogFile::s_ptr & { return file_; }
+
+  auto GetOverflowPolicy() const -> OverflowPolicy { return policy_; }
+
+  auto GetBufferSize() const -> size_t { return buffer_size_; }
+
+  static auto OverflowPolicyToString(OverflowPolicy policy) -> const char *;
+
+  /**
+   * @brief 字符串转缓冲区写满时的处理策略，无法识别时返回Block
+   */
+  static auto OverflowPolicyFromString(std::string_view str) -> OverflowPolicy;
+
+ protected:
+  /**
+   * @brief 把一条已经格式化（编码）好的日志追加到当前线程的缓冲区，缓冲区写满时按OverflowPolicy处理
+   */
+  void Append(std::string_view record);
+
+  /**
+   * @brief 刷盘线程每一轮写入之前调用，header中的数据会写在这一批日志之前
+   * @details 调用时这一批日志已经从缓冲区中取出，在此之前发生的事情对这一批日志都可见
+   */
+  virtual void BeforeDrain(std::string *header) {}
+
+  /**
+   * @brief 生成记录丢弃条数的提示，子类可以改为自己的文件格式
+   */
+  virtual auto EncodeDroppedNotice(uint64_t dropped_count) -> std::string;
+
+  /**
+   * @brief 停止刷盘线程，并把缓冲区中剩余的日志全部写入文件，可以重复调用
+   * @details 刷盘线程会调用虚函数，重写了虚函数的子类需要在自己的析构函数中先调用
+   */
+  void StopFlusher();
+
  private:
-  std::string filename_{};       // 日志文件名
-  std::ofstream file_stream_{};  // 日志文件流
-  uint64_t last_time_{0};        // 上次打开文件的时间
-  bool open_error_{false};       // 打开文件是否出错
+  class ThreadBuffer;
+
+  /**
+   * @brief 获取当前线程在该输出目标中的缓冲区，第一次调用时创建并注册到buffers_，有缓冲区之后才启动刷盘线程
+   */
+  auto GetThreadBuffer() -> ThreadBuffer *;
+
+  /**
+   * @brief 刷盘线程的主循环
+   */
+  void FlushLoop();
+
+  /**
+   * @brief 把所有线程的缓冲区中的日志写入文件，只在刷盘线程中调用
+   */
+  void DrainBuffers();
+
+  /**
+   * @brief 唤醒刷盘线程
+   */
+  void WakeFlusher();
+
+  LogFile::s_ptr file_{};                                 // 日志文件，只在刷盘线程中写入
+  size_t buffer_size_{DEFAULT_BUFFER_SIZE};               // 每个线程的缓冲区大小
+  OverflowPolicy policy_{OverflowPolicy::Block};          // 缓冲区写满时的处理策略
+  uint64_t id_{0};                                        // 输出目标的唯一id，用于查找线程局部的缓冲区
+  std::mutex buffers_mutex_{};                            // 保护buffers_
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_{};  // 所有线程的缓冲区
+  std::mutex flush_mutex_{};                              // 配合条件变量使用
+  std::condition_variable flush_cond_{};                  // 唤醒刷盘线程
+  std::condition_variable drained_cond_{};                // 刷盘线程完成一轮写入后唤醒等待者
+  std::atomic<bool> flush_requested_{false};              // 是否有线程要求立即刷盘
+  std::atomic<bool> stopping_{false};                     // 是否正在停止
+  std::atomic<uint64_t> dropped_count_{0};                // 被丢弃的日志条数
+  uint64_t reported_dropped_count_{0};                    // 已经记录到文件中的丢弃条数
+  std::unique_ptr<Thread> flusher_{};                     // 刷盘线程，受buffers_mutex_保护
 };
 
 class Logger {
@@ -303,7 +648,7 @@ class Logger {
 
   ~Logger() = default;
 
-  auto GetName() const -> std::string;
+  auto GetName() const -> const std::string &;
 
   auto GetLevel() const -> LogLevel;
 
@@ -338,6 +683,16 @@ class Logger {
    */
   void Log(const LogEvent::s_ptr &event);
 
+  /**
+   * @brief 记录一条二进制日志，交给每个日志输出目标的LogBinary
+   */
+  void LogBinary(LogLevel level, std::string_view record);
+
+  /**
+   * @brief 获取日志器名称在二进制日志字典中的id，第一次调用时注册
+   */
+  auto GetNameId() -> uint32_t;
+
   /**
    * @brief 将日期器的配置转换为yaml格式的字符串
    *
@@ -346,11 +701,20 @@ class Logger {
   auto FlushConfigToYmal() -> std::string;
 
  private:
+  using AppenderList = std::vector<LogAppender::s_ptr>;
+
+  /**
+   * @brief 获取当前的日志输出目标集合快照
+   */
+  auto GetAppenders() const -> std::shared_ptr<const AppenderList>;
+
   std::string name_{};                         // 日志器名称
   LogLevel level_{LogLevel::DEBUG};            // 日志器级别
-  std::list<LogAppender::s_ptr> appenders_{};  // 日志器的日志输出目标集合
+  // 日志输出目标集合的不可变快照，修改时复制一份新的替换，写日志时只在取快照的瞬间持有锁
+  std::shared_ptr<const AppenderList> appenders_{std::make_shared<const AppenderList>()};
   time_t create_time_;                         // 日志器创建时间
-  mutable MutexType mutex_{};                  // 互斥锁
+  std::atomic<uint32_t> name_id_{UINT32_MAX};  // 日志器名称在二进制日志字典中的id
+  mutable MutexType mutex_{};                  // 互斥锁，保护level_和appenders_
 };
 
 /**
@@ -360,6 +724,11 @@ class LogEventWrap {
  public:
   LogEventWrap(Logger::s_ptr logger, LogEvent::s_ptr event);
 
+  /**
+   * @brief 从当前线程的事件池中取出一个日志事件，并用当前的线程、协程、时间等信息填充，不分配内存
+   */
+  LogEventWrap(Logger::s_ptr logger, LogLevel level, const char *file, int32_t line);
+
   ~LogEventWrap();
 
   auto GetEvent() const -> LogEvent::s_ptr { return event_; }
@@ -0,0 +1,86 @@
+#ifndef _WTSCLWQ_RING_QUEUE_
+#define _WTSCLWQ_RING_QUEUE_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "macro.h"
+
+namespace wtsclwq {
+/**
+ * @brief 基于连续内存的环形双端队列，容量为2的幂，只在写满时翻倍扩容
+ * @details 和std::list、std::deque相比，稳态下入队出队都不会分配内存，适合作为任务队列。
+ * 出队之后的元素槽位保留移动后的空对象，因此T需要可以默认构造
+ */
+template <typename T>
+class RingQueue {
+ public:
+  explicit RingQueue(size_t init_capacity = 16) {
+    size_t capacity = 1;
+    while (capacity < init_capacity) {
+      capacity <<= 1;
+    }
+    buffer_.resize(capacity);
+  }
+
+  auto Size() const -> size_t { return size_; }
+
+  auto Empty() const -> bool { return size_ == 0; }
+
+  auto Capacity() const -> size_t { return buffer_.size(); }
+
+  auto Front() -> T & {
+    ASSERT(size_ > 0);
+    return buffer_[head_];
+  }
+
+  auto Back() -> T & {
+    ASSERT(size_ > 0);
+    return buffer_[(head_ + size_ - 1) & (buffer_.size() - 1)];
+  }
+
+  void PushBack(T &&value) {
+    if (size_ == buffer_.size()) {
+      Grow();
+    }
+    buffer_[(head_ + size_) & (buffer_.size() - 1)] = std::move(value);
+    size_++;
+  }
+
+  /**
+   * @brief 移出队头元素
+   */
+  auto PopFront() -> T {
+    ASSERT(size_ > 0);
+    T value = std::move(buffer_[head_]);
+    head_ = (head_ + 1) & (buffer_.size() - 1);
+    size_--;
+    return value;
+  }
+
+  /**
+   * @brief 移出队尾元素
+   */
+  auto PopBack() -> T {
+    ASSERT(size_ > 0);
+    size_--;
+    return std::move(buffer_[(head_ + size_) & (buffer_.size() - 1)]);
+  }
+
+ private:
+  void Grow() {
+    std::vector<T> new_buffer(buffer_.size() * 2);
+    for (size_t i = 0; i < size_; i++) {
+      new_buffer[i] = std::move(buffer_[(head_ + i) & (buffer_.size() - 1)]);
+    }
+    buffer_.swap(new_buffer);
+    head_ = 0;
+  }
+
+  std::vector<T> buffer_{};  // 环形缓冲区，大小始终为2的幂
+  size_t head_{0};           // 队头元素的下标
+  size_t size_{0};           // 队列中元素的数量
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_RING_QUEUE_
@@ -1,8 +1,10 @@
 #include "scheduler.h"
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <mutex>
 #include <vector>
+#include "config.h"
 #include "coroutine.h"
 #include "hook.h"
 #include "log.h"
@@ -18,8 +20,36 @@ static thread_local Scheduler::s_ptr thread_scheduler = nullptr;
 // 当前线程的调度协程，对于线程池中的线程来说，调度协程==主协程， 对于creator线程来说，调度协程 != 主协程
 static thread_local Coroutine::s_ptr thread_schedule_coroutine = nullptr;
 
+// 当前线程的Idle协程，由Run持有，这里只记录指针
+static thread_local Coroutine *thread_idle_coroutine = nullptr;
+
+// 当前线程在所属调度器中的下标，-1表示当前线程不是调度线程
+static thread_local int thread_worker_index = -1;
+
+// 窃取任务时的临时缓冲区，避免同时持有两个本地队列的锁
+static thread_local std::vector<Scheduler::ScheduleTask> thread_steal_buffer{};
+
+// ScheduleBatch使用的缓冲区
+static thread_local std::vector<Scheduler::ScheduleTask> thread_batch_buffer{};
+
+// ScheduleBulk中每个任务对应的信箱下标，-1表示不指定线程
+static thread_local std::vector<int> thread_bulk_worker_indexes{};
+
+// ScheduleBulk中按信箱分桶的任务下标，以及每个桶在其中的结束位置
+static thread_local std::vector<size_t> thread_bulk_order{};
+static thread_local std::vector<size_t> thread_bulk_bucket_ends{};
+
+// 每个调度线程本地任务队列的容量上限，超出之后任务会溢出到全局队列
+static auto local_queue_capacity =
+    ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem("scheduler.local_queue_capacity", 256,
+                                                          "scheduler per thread local task queue capacity");
+
+// 函数任务是否运行在共享栈协程中，开启后挂起的任务只占用实际使用的栈空间
+static auto scheduler_use_shared_stack = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "scheduler.use_shared_stack", false, "run function tasks in shared stack coroutines");
+
 Scheduler::Scheduler(size_t thread_num, bool use_creator, std::string_view name)
-    : name_(name), use_creator_thread_(use_creator) {
+    : name_(name), use_creator_thread_(use_creator), use_shared_stack_(scheduler_use_shared_stack->GetValue()) {
   ASSERT(thread_num > 0);
   if (use_creator_thread_) {
     thread_num--;
@@ -27,6 +57,22 @@ Scheduler::Scheduler(size_t thread_num, bool use_creator, std::string_view name)
     creator_thread_id_ = -1;
   }
   thread_count_ = thread_num;
+  local_queue_capacity_ = std::max(local_queue_capacity->GetValue(), 1);
+
+  // 线程池中的线程使用[0, thread_count_)，creator线程使用thread_count_
+  size_t worker_count = thread_count_ + (use_creator_thread_ ? 1 : 0);
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; i++) {
+    workers_.emplace_back(std::make_unique<WorkerQueue>());
+    // 本地队列的长度不会超过容量上限，预先分配好，之后不会再扩容
+    workers_.back()->tasks_ = RingQueue<ScheduleTask>(local_queue_capacity_);
+  }
+  // creator线程就是构造调度器的线程，提前登记，使得Start之前就可以向creator线程投递任务
+  if (use_creator_thread_) {
+    int creator_id = GetCurrSysThreadId();
+    workers_[thread_count_]->thread_id_ = creator_id;
+    worker_index_map_[creator_id] = thread_count_;
+  }
 }
 
 Scheduler::~Scheduler() {
@@ -47,28 +93,286 @@ auto Scheduler::HasIdleThread() -> bool { return idle_thread_count_ > 0; }
 
 auto Scheduler::GetThreadScheduleCoroutine() -> Coroutine::s_ptr { return thread_schedule_coroutine; }
 
-template <typename Scheduleable>
-void Scheduler::Schedule(Scheduleable sa, int target_thread_id) {
-  bool need_tickle = false;
-  {
+auto Scheduler::GetThreadIdleCoroutine() -> Coroutine * { return thread_idle_coroutine; }
+
+auto Scheduler::GetThreadWorkerIndex() -> int { return thread_worker_index; }
+
+auto Scheduler::GetWorkerCount() const -> size_t { return workers_.size(); }
+
+auto Scheduler::GetWorkerThreadId(size_t worker_index) const -> int {
+  ASSERT(worker_index < workers_.size());
+  return workers_[worker_index]->thread_id_;
+}
+
+auto Scheduler::GetWorkerIndex(int thread_id) const -> int {
+  // 快速路径：调度线程给自己投递任务时无需查表
+  if (thread_worker_index >= 0 && thread_scheduler.get() == this &&
+      workers_[thread_worker_index]->thread_id_ == thread_id) {
+    return thread_worker_index;
+  }
+  ReadLockGuard lock(worker_map_mutex_);
+  auto iter = worker_index_map_.find(thread_id);
+  return iter == worker_index_map_.end() ? -1 : static_cast<int>(iter->second);
+}
+
+void Scheduler::ScheduleImpl(ScheduleTask &&task) {
+  if (task.target_thread_id_ != -1) {
+    int worker_index = GetWorkerIndex(task.target_thread_id_);
+    if (worker_index >= 0) {
+      ScheduleOnWorkerImpl(std::move(task), worker_index);
+      return;
+    }
+    // 目标线程不属于该调度器，任务永远不会被执行，退化为不指定线程
+    LOG_WARN(sys_logger) << "Scheduler " << name_ << " has no thread " << task.target_thread_id_
+                         << ", task is scheduled to any thread";
+    task.target_thread_id_ = -1;
+  }
+  if (!TryScheduleLocal(task)) {
     std::lock_guard<MutexType> lock(mutex_);
-    need_tickle = NonLockScheduleImpl(sa, target_thread_id);
+    NonLockScheduleImpl(std::move(task));
   }
-  if (need_tickle) {
+  // 本地队列和全局队列中的任务可以被任意线程取走，因此只要存在空闲线程就需要通知
+  if (HasIdleThread()) {
     Tickle();
   }
 }
 
-template <typename Scheduleable>
-auto Scheduler::NonLockScheduleImpl(Scheduleable sa, int target_thread_id) -> bool {
-  bool need_tickle = task_queue_.empty();
-  ScheduleTask task(sa, target_thread_id);
-  if (task.coroutine_ != nullptr || task.func_ != nullptr) {
-    task_queue_.emplace_back(std::move(task));
+void Scheduler::ScheduleOnWorkerImpl(ScheduleTask &&task, size_t worker_index) {
+  if (task.coroutine_ != nullptr && task.coroutine_->GetBoundThreadId() != -1) {
+    // 共享栈协程只能回到绑定的线程执行
+    int bound_index = GetWorkerIndex(task.coroutine_->GetBoundThreadId());
+    if (bound_index >= 0) {
+      worker_index = bound_index;
+    }
+  }
+  ASSERT(worker_index < workers_.size());
+  WorkerQueue &worker = *workers_[worker_index];
+  task.target_thread_id_ = worker.thread_id_;
+  {
+    std::lock_guard<SpinLock> lock(worker.mutex_);
+    worker.mailbox_.PushBack(std::move(task));
+    ++worker.mailbox_count_;
+    ++pending_task_count_;
+  }
+  // 只有目标线程处于空闲状态时才需要唤醒，且只唤醒目标线程
+  if (worker.is_idle_) {
+    TickleWorker(worker_index);
+  }
+}
+
+auto Scheduler::GetThreadBatchBuffer() -> std::vector<ScheduleTask> & { return thread_batch_buffer; }
+
+void Scheduler::ScheduleBulk(std::vector<ScheduleTask> &&tasks) {
+  auto &indexes = thread_bulk_worker_indexes;
+  auto &order = thread_bulk_order;
+  auto &bucket_ends = thread_bulk_bucket_ends;
+  bucket_ends.assign(workers_.size() + 1, 0);
+  size_t untargeted_count = 0;
+  for (auto &task : tasks) {
+    int worker_index = -1;
+    if (task.target_thread_id_ != -1) {
+      worker_index = GetWorkerIndex(task.target_thread_id_);
+      if (worker_index < 0) {
+        LOG_WARN(sys_logger) << "Scheduler " << name_ << " has no thread " << task.target_thread_id_
+                             << ", task is scheduled to any thread";
+        task.target_thread_id_ = -1;
+      }
+    }
+    if (!task.Empty()) {
+      if (worker_index < 0) {
+        untargeted_count++;
+      } else {
+        bucket_ends[worker_index + 1]++;
+      }
+    }
+    indexes.emplace_back(worker_index);
+  }
+
+  // 计数排序，把指定了线程的任务按信箱分桶，保持同一个信箱中任务的提交顺序
+  for (size_t w = 0; w < workers_.size(); w++) {
+    bucket_ends[w + 1] += bucket_ends[w];
+  }
+  order.resize(bucket_ends.back());
+  for (size_t i = 0; i < tasks.size(); i++) {
+    if (indexes[i] >= 0 && !tasks[i].Empty()) {
+      order[bucket_ends[indexes[i]]++] = i;
+    }
+  }
+
+  // 指定了线程的任务，每个信箱只加一次锁，目标线程空闲时才需要唤醒
+  size_t tickled_count = 0;
+  for (size_t w = 0; w < workers_.size(); w++) {
+    size_t begin = w == 0 ? 0 : bucket_ends[w - 1];
+    if (begin == bucket_ends[w]) {
+      continue;
+    }
+    WorkerQueue &worker = *workers_[w];
+    {
+      std::lock_guard<SpinLock> lock(worker.mutex_);
+      for (size_t k = begin; k < bucket_ends[w]; k++) {
+        ScheduleTask &task = tasks[order[k]];
+        task.target_thread_id_ = worker.thread_id_;
+        worker.mailbox_.PushBack(std::move(task));
+        ++worker.mailbox_count_;
+        ++pending_task_count_;
+      }
+    }
+    if (worker.is_idle_) {
+      TickleWorker(w);
+      tickled_count++;
+    }
+  }
+
+  // 未指定线程的任务，调度线程自己提交时先放入本地队列，放不下的和外部线程提交的一起在一次加锁中放入全局队列
+  if (untargeted_count > 0) {
+    size_t i = 0;
+    if (thread_worker_index >= 0 && thread_scheduler.get() == this) {
+      WorkerQueue &worker = *workers_[thread_worker_index];
+      std::lock_guard<SpinLock> lock(worker.mutex_);
+      for (; i < tasks.size() && worker.tasks_.Size() < local_queue_capacity_; i++) {
+        if (indexes[i] < 0 && !tasks[i].Empty()) {
+          worker.tasks_.PushBack(std::move(tasks[i]));
+          ++stealable_task_count_;
+          ++pending_task_count_;
+        }
+      }
+    }
+    if (i < tasks.size()) {
+      std::lock_guard<MutexType> lock(mutex_);
+      for (; i < tasks.size(); i++) {
+        if (indexes[i] < 0 && !tasks[i].Empty()) {
+          NonLockScheduleImpl(std::move(tasks[i]));
+        }
+      }
+    }
+    // 最多唤醒min(N, 空闲线程数)个线程，已经被信箱唤醒的线程不再重复唤醒
+    size_t idle_count = idle_thread_count_;
+    size_t need_tickle = idle_count > tickled_count ? std::min(untargeted_count, idle_count - tickled_count) : 0;
+    for (size_t t = 0; t < need_tickle; t++) {
+      Tickle();
+    }
   }
+  indexes.clear();
+  order.clear();
+  tasks.clear();
+}
+
+auto Scheduler::NonLockScheduleImpl(ScheduleTask &&task) -> bool {
+  bool need_tickle = task_queue_.Empty();
+  task_queue_.PushBack(std::move(task));
+  ++stealable_task_count_;
+  ++pending_task_count_;
   return need_tickle;
 }
 
+auto Scheduler::TryScheduleLocal(ScheduleTask &task) -> bool {
+  // 只有该调度器自己的调度线程才拥有本地队列，外部线程提交的任务一律进入全局队列
+  if (thread_worker_index < 0 || thread_scheduler.get() != this) {
+    return false;
+  }
+  WorkerQueue &worker = *workers_[thread_worker_index];
+  std::lock_guard<SpinLock> lock(worker.mutex_);
+  if (worker.tasks_.Size() >= local_queue_capacity_) {
+    return false;
+  }
+  worker.tasks_.PushBack(std::move(task));
+  ++stealable_task_count_;
+  ++pending_task_count_;
+  return true;
+}
+
+auto Scheduler::PopMailboxTask(size_t worker_index, ScheduleTask *task) -> bool {
+  WorkerQueue &worker = *workers_[worker_index];
+  if (worker.mailbox_count_ == 0) {
+    return false;
+  }
+  std::lock_guard<SpinLock> lock(worker.mutex_);
+  if (worker.mailbox_.Empty()) {
+    return false;
+  }
+  *task = worker.mailbox_.PopFront();
+  --worker.mailbox_count_;
+  --pending_task_count_;
+  return true;
+}
+
+auto Scheduler::HasRunnableTask(size_t worker_index) -> bool {
+  return workers_[worker_index]->mailbox_count_ > 0 || stealable_task_count_ > 0;
+}
+
+auto Scheduler::PopLocalTask(size_t worker_index, ScheduleTask *task) -> bool {
+  WorkerQueue &worker = *workers_[worker_index];
+  std::lock_guard<SpinLock> lock(worker.mutex_);
+  if (worker.tasks_.Empty()) {
+    return false;
+  }
+  *task = worker.tasks_.PopFront();
+  --stealable_task_count_;
+  --pending_task_count_;
+  return true;
+}
+
+auto Scheduler::PopGlobalTask(size_t worker_index, ScheduleTask *task) -> bool {
+  auto &batch = thread_steal_buffer;
+  {
+    std::lock_guard<MutexType> lock(mutex_);
+    if (task_queue_.Empty()) {
+      return false;
+    }
+    // 全局队列中只有未指定线程的任务，队头的任务直接取走执行
+    *task = task_queue_.PopFront();
+    --stealable_task_count_;
+    --pending_task_count_;
+    // 每次从全局队列中搬运平均每个线程应得的任务量，但不超过本地队列容量的一半
+    size_t batch_size = std::min(task_queue_.Size() / workers_.size(), local_queue_capacity_ / 2);
+    for (size_t i = 0; i < batch_size; i++) {
+      batch.emplace_back(task_queue_.PopFront());
+    }
+  }
+  if (!batch.empty()) {
+    WorkerQueue &worker = *workers_[worker_index];
+    std::lock_guard<SpinLock> lock(worker.mutex_);
+    for (auto &t : batch) {
+      worker.tasks_.PushBack(std::move(t));
+    }
+  }
+  batch.clear();
+  return true;
+}
+
+auto Scheduler::StealTask(size_t worker_index, ScheduleTask *task) -> bool {
+  auto &stolen = thread_steal_buffer;
+  size_t worker_count = workers_.size();
+  for (size_t i = 1; i < worker_count; i++) {
+    WorkerQueue &victim = *workers_[(worker_index + i) % worker_count];
+    {
+      std::lock_guard<SpinLock> lock(victim.mutex_);
+      size_t steal_count = (victim.tasks_.Size() + 1) / 2;
+      for (size_t j = 0; j < steal_count; j++) {
+        stolen.emplace_back(victim.tasks_.PopBack());
+      }
+    }
+    if (stolen.empty()) {
+      continue;
+    }
+    // 窃取到的任务按照从新到旧的顺序排列，最旧的那个直接执行，其余的按照原有顺序放入自己的本地队列
+    *task = std::move(stolen.back());
+    stolen.pop_back();
+    --stealable_task_count_;
+    --pending_task_count_;
+    if (!stolen.empty()) {
+      WorkerQueue &self = *workers_[worker_index];
+      std::lock_guard<SpinLock> lock(self.mutex_);
+      for (auto it = stolen.rbegin(); it != stolen.rend(); it++) {
+        self.tasks_.PushBack(std::move(*it));
+      }
+    }
+    stolen.clear();
+    return true;
+  }
+  return false;
+}
+
 void Scheduler::Start() {
   LOG_DEBUG(sys_logger) << "Scheduler " << name_ << " is starting";
   std::lock_guard<MutexType> lock(mutex_);
@@ -85,28 +389,31 @@ void Scheduler::Start() {
 
     // 将创建者线程设置为协程模式
     Coroutine::InitThreadToCoMod();
-    creator_schedule_coroutine_ =
-        std::make_shared<Coroutine>([this] { Run(); }, 0, true, Coroutine::GetThreadMainCoroutine());
+    creator_schedule_coroutine_ = std::make_shared<Coroutine>([this] { Run(thread_count_); }, 0, true,
+                                                              Coroutine::GetThreadMainCoroutine());
     creator_thread_id_ = GetCurrSysThreadId();
-    thread_ids_.emplace_back(creator_thread_id_);
   }
 
   ASSERT(thread_pool_.empty());
   thread_pool_.reserve(thread_count_);
   for (size_t i = 0; i < thread_count_; i++) {
-    auto thread = std::make_shared<Thread>([this] { Run(); }, name_ + "_" + std::to_string(i));
+    auto thread = std::make_shared<Thread>([this, i] { Run(i); }, name_ + "_" + std::to_string(i));
     thread_pool_.emplace_back(thread);
-    thread_ids_.emplace_back(thread->GetId());
+    // Thread的构造函数会等待线程真正启动，此时线程id已经可用
+    workers_[i]->thread_id_ = thread->GetId();
+    WriteLockGuard map_lock(worker_map_mutex_);
+    worker_index_map_[thread->GetId()] = i;
   }
 }
 
 auto Scheduler::IsStopable() -> bool {
-  std::lock_guard<MutexType> lock(mutex_);
-  return is_stoped_ && task_queue_.empty() && active_thread_count_ == 0;
+  return is_stoped_ && pending_task_count_ == 0 && active_thread_count_ == 0;
 }
 
 void Scheduler::Tickle() { LOG_DEBUG(sys_logger) << "Scheduler " << name_ << " is tickling"; }
 
+void Scheduler::TickleWorker(size_t worker_index) { Tickle(); }
+
 void Scheduler::Idle() {
   LOG_DEBUG(sys_logger) << "Thread " << GetCurrSysThreadId() << " is idling";
   while (!IsStopable()) {
@@ -124,7 +431,7 @@ void Scheduler::Stop() {
 
   // 全都唤醒一次，让所有线程都从Idle中退出
   for (size_t i = 0; i < thread_count_; i++) {
-    Tickle();
+    TickleWorker(i);
   }
 
   if (use_creator_thread_) {
@@ -142,13 +449,19 @@ void Scheduler::Stop() {
   }
 }
 
-void Scheduler::Run() {
+void Scheduler::Run(size_t worker_index) {
   LOG_DEBUG(sys_logger) << "Thread " << GetCurrSysThreadId() << " is running";
   SetHookEnabled(true);
   InitThreadScheduler();
+  thread_worker_index = static_cast<int>(worker_index);
+  // 一次搬运或者窃取的任务数量不会超过本地队列的容量，预先分配好缓冲区，之后不会再扩容
+  thread_steal_buffer.reserve(local_queue_capacity_);
+  const int curr_thread_id = GetCurrSysThreadId();
+  WorkerQueue &self = *workers_[worker_index];
+  self.thread_id_ = curr_thread_id;
 
   // 如果当前线程不是调度器创建者线程，也就是说当前线程是线程池中的线程，那么需要先为其启动协程模式
-  if (GetCurrSysThreadId() != creator_thread_id_) {
+  if (curr_thread_id != creator_thread_id_) {
     Coroutine::InitThreadToCoMod();
   }
   // 对于线程池中的线程，其RuningCoroutine必然等于主协程
@@ -157,6 +470,7 @@ void Scheduler::Run() {
 
   // 创建一个Idle协程，用于线程从Run进入Idle
   auto idle_coroutine = std::make_shared<Coroutine>([this] { Idle(); }, 0, true, GetThreadScheduleCoroutine());
+  thread_idle_coroutine = idle_coroutine.get();
   // 任务协程，用于取到func任务之后，将func封装进该协程，然后Resume该协程
   Coroutine::s_ptr func_task_coroutine = nullptr;
   // 存储取到的任务
@@ -166,35 +480,27 @@ void Scheduler::Run() {
   while (true) {
     // 清空task
     task.Clear();
-    bool tickle_other_thread = false;
-    {
-      std::lock_guard<MutexType> lock(mutex_);
-      for (auto t = task_queue_.begin(); t != task_queue_.end(); t++) {
-        // 如果任务的目标线程不是当前线程，那么通知一下其他线程（碰运气随机tickle）
-        if (t->target_thread_id_ != -1 && t->target_thread_id_ != GetCurrSysThreadId()) {
-          tickle_other_thread = true;
-          continue;
-        }
-        // 取到了任务
-        ASSERT(!t->Empty());
-        // BUG: hook
-        // IO相关的系统调用时，在检测到IO未就绪的情况下，会先添加对应的读写事件，再yield当前协程，等IO就绪后再resume当前协程
-        // 多线程高并发情境下，有可能发生刚添加事件就被触发的情况，如果此时当前协程还未来得及yield，则这里就有可能出现协程状态仍为RUNNING的情况
-        // 这里简单地跳过这种情况，以损失一点性能为代价，否则整个协程框架都要大改
-        if (t->coroutine_ != nullptr && t->coroutine_->GetState() == Coroutine::State::Running) {
-          continue;
-        }
-
-        // 顺利取到可执行的任务
-        task = *t;
-        task_queue_.erase(t);
-        break;
+    // 取任务的顺序：自己的信箱 -> 自己的本地队列 -> 全局队列 -> 窃取其他线程的本地队列
+    bool has_task = PopMailboxTask(worker_index, &task) ||
+                    (stealable_task_count_ > 0 && (PopLocalTask(worker_index, &task) ||
+                                                   PopGlobalTask(worker_index, &task) || StealTask(worker_index, &task)));
+
+    // BUG: hook
+    // IO相关的系统调用时，在检测到IO未就绪的情况下，会先添加对应的读写事件，再yield当前协程，等IO就绪后再resume当前协程
+    // 多线程高并发情境下，有可能发生刚添加事件就被触发的情况，如果此时当前协程还未来得及yield，则这里就有可能出现协程状态仍为RUNNING的情况
+    // 这里简单地将任务放回原来的队列，以损失一点性能为代价，否则整个协程框架都要大改
+    if (has_task && task.coroutine_ != nullptr && task.coroutine_->GetState() == Coroutine::State::Running) {
+      if (task.target_thread_id_ != -1) {
+        ScheduleOnWorkerImpl(std::move(task), worker_index);
+      } else {
+        ScheduleImpl(std::move(task));
       }
-      // 如果取完任务之后，任务队列非空，那么通知其他线程（碰运气随机tickle）
-      tickle_other_thread |= !task_queue_.empty();
+      continue;
     }
 
-    if (tickle_other_thread) {
+    // 如果取完任务之后，仍然有可以被其他线程取走的任务，那么通知空闲线程
+    // 信箱中的任务在投递时已经精确唤醒了目标线程，这里不需要再通知
+    if (has_task && stealable_task_count_ > 0 && HasIdleThread()) {
       Tickle();
     }
 
@@ -205,11 +511,21 @@ void Scheduler::Run() {
       task.coroutine_->Resume();
       --active_thread_count_;
     } else if (task.func_ != nullptr) {
-      func_task_coroutine.reset(new Coroutine(std::move(task.func_), 0, true, GetThreadScheduleCoroutine()));
+      // 复用上一个已经执行完毕的任务协程，避免每个函数任务都重新分配协程对象和协程栈
+      if (func_task_coroutine != nullptr && func_task_coroutine->GetState() == Coroutine::State::Stop) {
+        func_task_coroutine->ResetTaskFunc(std::move(task.func_));
+      } else {
+        func_task_coroutine.reset(new Coroutine(std::move(task.func_), 0, true, GetThreadScheduleCoroutine(),
+                                                use_shared_stack_));
+      }
       // 执行封装之后的func_task_coroutine
       ++active_thread_count_;
       func_task_coroutine->Resume();
       --active_thread_count_;
+      // 任务协程没有执行完毕，说明它已经被其他地方（IO事件、定时器等）持有并等待再次调度，不能复用
+      if (func_task_coroutine->GetState() != Coroutine::State::Stop) {
+        func_task_coroutine.reset();
+      }
     } else {
       // 能够进入这个分支，代表没有取到Task，或者Task中coroutine和func都为空（异常现象）, 那么进入Idle协程
       if (idle_coroutine->GetState() == Coroutine::State::Stop) {
@@ -218,19 +534,25 @@ void Scheduler::Run() {
         LOG_DEBUG(sys_logger) << "Idle coroutine end";
         break;
       }
-      // 进入Idle协程，Resume返回时，表明线程在Idle协程内收到了通知，需要回来继续取任务执行
+      // 先标记为空闲再检查一次任务，与投递任务时"先入队再检查空闲标记"的顺序配合，避免丢失唤醒
+      self.is_idle_ = true;
       ++idle_thread_count_;
+      if (HasRunnableTask(worker_index)) {
+        --idle_thread_count_;
+        self.is_idle_ = false;
+        continue;
+      }
+      // 进入Idle协程，Resume返回时，表明线程在Idle协程内收到了通知，需要回来继续取任务执行
       idle_coroutine->Resume();
       --idle_thread_count_;
+      self.is_idle_ = false;
     }
   }
+  thread_worker_index = -1;
+  thread_idle_coroutine = nullptr;
+  // creator线程在调度器停止之后继续运行，之后的IO不能再挂起到已经停止的调度器上
+  SetHookEnabled(false);
   LOG_DEBUG(sys_logger) << "Thread" << GetCurrSysThreadId() << "Run() is end";
 }
 
-template void Scheduler::Schedule(Coroutine::s_ptr sa, int target_thread_id);
-template void Scheduler::Schedule(std::function<void()> sa, int target_thread_id);
-
-template auto Scheduler::NonLockScheduleImpl(Coroutine::s_ptr sa, int target_thread_id) -> bool;
-template auto Scheduler::NonLockScheduleImpl(std::function<void()> sa, int target_thread_id) -> bool;
-
 }  // namespace wtsclwq
@@ -2,12 +2,17 @@
 #define _WTSCLWQ_SCHEDULER_
 
 #include <atomic>
-#include <functional>
-#include <list>
 #include <memory>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include "coroutine.h"
+#include "lock.h"
 #include "log.h"
+#include "ring_queue.h"
+#include "task_func.h"
 #include "thread.h"
 
 namespace wtsclwq {
@@ -16,6 +21,33 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
   using s_ptr = std::shared_ptr<Scheduler>;
   using MutexType = std::mutex;
 
+  /**
+   * @brief 调度任务，协程对象或者函数对象二选一，可以指定执行任务的目标线程
+   * @details 只能移动，函数对象的捕获直接内联存放在TaskFunc中，构造和移动都不需要分配内存
+   */
+  struct ScheduleTask {
+    Coroutine::s_ptr coroutine_{nullptr};
+    TaskFunc func_{nullptr};
+    int target_thread_id_{-1};
+    ScheduleTask(Coroutine::s_ptr coroutine, int thread_id)
+        : coroutine_(std::move(coroutine)), target_thread_id_(thread_id) {
+      // 共享栈协程的栈内容只能恢复到绑定线程的共享栈上，必须回到绑定的线程执行
+      if (target_thread_id_ == -1 && coroutine_ != nullptr) {
+        target_thread_id_ = coroutine_->GetBoundThreadId();
+      }
+    }
+    template <typename Func,
+              typename = std::enable_if_t<!std::is_convertible_v<std::decay_t<Func>, Coroutine::s_ptr>>>
+    ScheduleTask(Func &&func, int thread_id) : func_(std::forward<Func>(func)), target_thread_id_(thread_id) {}
+    ScheduleTask() = default;
+    void Clear() {
+      coroutine_ = nullptr;
+      func_ = nullptr;
+      target_thread_id_ = -1;
+    }
+    auto Empty() -> bool { return coroutine_ == nullptr && func_ == nullptr; }
+  };
+
   explicit Scheduler(size_t thread_num = 1, bool use_creator = true, std::string_view name = "DefaultScheduler");
 
   virtual ~Scheduler();
@@ -33,12 +65,80 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
    */
   static auto GetThreadScheduleCoroutine() -> Coroutine::s_ptr;
 
+  /**
+   * @brief 获取当前线程的Idle协程，不是调度线程时返回nullptr
+   * @details Idle协程在没有任务时由Run直接恢复，不能在其中挂起等待，否则会在等待的操作完成之前被恢复
+   */
+  static auto GetThreadIdleCoroutine() -> Coroutine *;
+
   /**
    * @brief 将协程对象或者函数对象加入到任务队列中
-   * @details 在.cpp文件中实现，在.h文件中显示实例化Coroutine和函数对象版本
+   * @details 函数对象可以是任意无参可调用对象，捕获不超过TaskFunc::INLINE_SIZE时，稳态下不会分配内存
    */
   template <typename Scheduleable>
-  void Schedule(Scheduleable sa, int target_thread_id = -1);
+  void Schedule(Scheduleable &&sa, int target_thread_id = -1) {
+    ScheduleTask task(std::forward<Scheduleable>(sa), target_thread_id);
+    if (!task.Empty()) {
+      ScheduleImpl(std::move(task));
+    }
+  }
+
+  /**
+   * @brief 将任务直接投递到指定调度线程的信箱中，只会唤醒该线程
+   * @param worker_index 调度线程的下标，可以通过GetWorkerIndex获取并缓存，避免每次按线程id查找
+   */
+  template <typename Scheduleable>
+  void ScheduleOnWorker(Scheduleable &&sa, size_t worker_index) {
+    ScheduleTask task(std::forward<Scheduleable>(sa), -1);
+    if (!task.Empty()) {
+      ScheduleOnWorkerImpl(std::move(task), worker_index);
+    }
+  }
+
+  /**
+   * @brief 批量提交任务，只获取一次队列锁，并且最多唤醒min(N, 空闲线程数)个线程
+   * @details 迭代器指向的元素可以是ScheduleTask（保留其目标线程），也可以是协程对象或者函数对象（不指定线程），
+   * 元素会被移动到任务队列中
+   */
+  template <typename Iterator>
+  void ScheduleBatch(Iterator begin, Iterator end) {
+    using Item = std::decay_t<decltype(*begin)>;
+    std::vector<ScheduleTask> &batch = GetThreadBatchBuffer();
+    for (auto iter = begin; iter != end; ++iter) {
+      if constexpr (std::is_same_v<Item, ScheduleTask>) {
+        batch.emplace_back(std::move(*iter));
+      } else {
+        batch.emplace_back(std::move(*iter), -1);
+      }
+    }
+    ScheduleBulk(std::move(batch));
+  }
+
+  /**
+   * @brief 批量提交任务，语义同ScheduleBatch，调用返回之后tasks被清空但保留容量，可以重复使用
+   */
+  void ScheduleBulk(std::vector<ScheduleTask> &&tasks);
+
+  /**
+   * @brief 根据线程id获取调度线程的下标
+   * @return 线程不属于该调度器时返回-1
+   */
+  auto GetWorkerIndex(int thread_id) const -> int;
+
+  /**
+   * @brief 获取调度线程下标对应的线程id，线程尚未启动时返回-1
+   */
+  auto GetWorkerThreadId(size_t worker_index) const -> int;
+
+  /**
+   * @brief 获取参与调度的线程数量（包括creator线程）
+   */
+  auto GetWorkerCount() const -> size_t;
+
+  /**
+   * @brief 获取当前线程在其所属调度器中的下标，当前线程不是调度线程时返回-1
+   */
+  static auto GetThreadWorkerIndex() -> int;
 
   /**
    * @brief 启动调度器
@@ -56,10 +156,17 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
    */
   virtual void Tickle();
 
+  /**
+   * @brief 唤醒指定的调度线程，使其处理自己信箱中的任务
+   * @details 默认实现退化为Tickle()，子类可以重写以实现精确唤醒
+   */
+  virtual void TickleWorker(size_t worker_index);
+
   /**
    * @brief 线程调度任务的主逻辑，线程池中的线程会在这里取得任务并执行
+   * @param worker_index 当前线程在调度器中的下标，用于定位线程私有的本地任务队列
    */
-  void Run();
+  void Run(size_t worker_index);
 
   /**
    * @brief 线程空闲等待的主逻辑，线程池中的空闲线程会在这里等待任务队列就绪
@@ -84,47 +191,87 @@ class Scheduler : public std::enable_shared_from_this<Scheduler> {
 
  private:
   /**
-   * @brief 将协程对象加入到任务队列中，具体逻辑，无锁实现
+   * @brief 将未指定线程或者指定了线程的任务分发到对应的队列中，并按需唤醒线程
    */
-  template <typename Scheduleable>
-  auto NonLockScheduleImpl(Scheduleable sa, int target_thread_id) -> bool;
+  void ScheduleImpl(ScheduleTask &&task);
 
-  struct ScheduleTask {
-    Coroutine::s_ptr coroutine_;
-    std::function<void()> func_;
-    int target_thread_id_;
-    ScheduleTask(Coroutine::s_ptr coroutine, int thread_id) {
-      coroutine_ = std::move(coroutine);
-      target_thread_id_ = thread_id;
-    }
-    ScheduleTask(std::function<void()> func, int thread_id) {
-      func_ = std::move(func);
-      target_thread_id_ = thread_id;
-    }
-    ScheduleTask() {
-      coroutine_ = nullptr;
-      func_ = nullptr;
-      target_thread_id_ = -1;
-    }
-    void Clear() {
-      coroutine_ = nullptr;
-      func_ = nullptr;
-      target_thread_id_ = -1;
-    }
-    auto Empty() -> bool { return coroutine_ == nullptr && func_ == nullptr; }
+  /**
+   * @brief 将任务放入worker_index对应的信箱中，并按需唤醒该线程
+   */
+  void ScheduleOnWorkerImpl(ScheduleTask &&task, size_t worker_index);
+
+  /**
+   * @brief ScheduleBatch使用的线程局部缓冲区，避免每次批量提交都分配内存
+   */
+  static auto GetThreadBatchBuffer() -> std::vector<ScheduleTask> &;
+
+  /**
+   * @brief 将任务加入到全局任务队列中，具体逻辑，无锁实现，调用者需持有mutex_
+   */
+  auto NonLockScheduleImpl(ScheduleTask &&task) -> bool;
+
+  /**
+   * @brief 线程池中每个线程私有的本地任务队列
+   * @details 本地队列有容量上限，所属线程从尾部放入、从头部取出，其他空闲线程从尾部窃取，锁只在所属线程和窃取者之间竞争
+   */
+  struct WorkerQueue {
+    RingQueue<ScheduleTask> tasks_{};        // 本地任务，只存放没有指定目标线程的任务
+    RingQueue<ScheduleTask> mailbox_{};      // 信箱，存放指定由该线程执行的任务，不允许被窃取
+    std::atomic<size_t> mailbox_count_{0};   // 信箱中的任务数量，用于无锁判断信箱是否为空
+    std::atomic<int> thread_id_{-1};         // 该下标对应的线程id
+    std::atomic<bool> is_idle_{false};       // 该线程是否处于Idle状态，只有空闲线程才需要被唤醒
+    SpinLock mutex_{};                       // 本地队列和信箱的锁，粒度很小，选择SpinLock
   };
+
+  /**
+   * @brief 从worker_index对应的信箱中取出一个任务
+   */
+  auto PopMailboxTask(size_t worker_index, ScheduleTask *task) -> bool;
+
+  /**
+   * @brief 当前线程是否有可以执行的任务，用于进入Idle之前的最后一次检查，避免丢失唤醒
+   */
+  auto HasRunnableTask(size_t worker_index) -> bool;
+
+  /**
+   * @brief 将任务放入当前线程的本地队列
+   * @return 本地队列已满或者当前线程不属于该调度器时返回false，此时任务需要放入全局队列
+   */
+  auto TryScheduleLocal(ScheduleTask &task) -> bool;
+
+  /**
+   * @brief 从worker_index对应的本地队列头部取出一个任务
+   */
+  auto PopLocalTask(size_t worker_index, ScheduleTask *task) -> bool;
+
+  /**
+   * @brief 从全局队列中取出一个任务，并顺带搬运一批任务到本地队列，减少对全局锁的争用
+   */
+  auto PopGlobalTask(size_t worker_index, ScheduleTask *task) -> bool;
+
+  /**
+   * @brief 从其他线程的本地队列尾部窃取一半的任务，取出其中一个返回，其余放入自己的本地队列
+   */
+  auto StealTask(size_t worker_index, ScheduleTask *task) -> bool;
+
   std::string name_{};                                    // 调度器名称
   std::vector<Thread::s_ptr> thread_pool_{};              // 线程池
-  std::vector<int> thread_ids_{};                         // 线程池中线程的id
+  std::unordered_map<int, size_t> worker_index_map_{};    // 线程id到调度线程下标的映射
+  mutable std::shared_mutex worker_map_mutex_{};          // 保护worker_index_map_的读写锁
   size_t thread_count_{0};                                // 线程池中线程的数量
-  std::list<ScheduleTask> task_queue_{};                  // 任务队列
+  RingQueue<ScheduleTask> task_queue_{};                  // 全局任务队列，存放外部线程提交的以及溢出的任务
+  std::vector<std::unique_ptr<WorkerQueue>> workers_{};  // 每个调度线程的本地任务队列，creator线程（如果参与调度）位于末尾
+  size_t local_queue_capacity_{0};                        // 本地任务队列的容量上限
+  std::atomic<size_t> pending_task_count_{0};             // 所有队列中尚未取出的任务数量
+  std::atomic<size_t> stealable_task_count_{0};           // 全局队列和本地队列中尚未取出的任务数量（不含信箱）
   std::atomic<size_t> active_thread_count_{0};            // 活跃线程数量
   std::atomic<size_t> idle_thread_count_{0};              // 空闲线程数量
   bool use_creator_thread_{false};                        // 是否使用创建者线程参与任务调度
+  bool use_shared_stack_{false};                          // 函数任务是否运行在共享栈协程中
   Coroutine::s_ptr creator_schedule_coroutine_{nullptr};  // 创建者线程的调度协程
   int creator_thread_id_{-1};                             // 创建者线程的id
-  bool is_stoped_{false};                                 // 是否已经停止
-  MutexType mutex_{};                                     // 互斥锁
+  std::atomic<bool> is_stoped_{false};                    // 是否已经停止
+  MutexType mutex_{};                                     // 全局任务队列的互斥锁
 };
 
 }  // namespace wtsclwq
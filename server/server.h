@@ -4,9 +4,11 @@
 #include "address.h"
 #include "config.h"
 #include "coroutine.h"
+#include "dns_resolver.h"
 #include "env.h"
 #include "fd_context.h"
 #include "fd_manager.h"
+#include "file_io.h"
 #include "hook.h"
 #include "lock.h"
 #include "log.h"
@@ -1,109 +1,294 @@
 #include "sock_io_scheduler.h"
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <shared_mutex>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include "io_uring.h"
 #include "log.h"
 #include "macro.h"
+#include "server/config.h"
 #include "server/coroutine.h"
 #include "server/fd_context.h"
+#include "server/fd_manager.h"
+#include "server/file_io.h"
+#include "server/hook.h"
 #include "server/timer.h"
 
 namespace wtsclwq {
 static auto sys_logger = NAMED_LOGGER("system");
 
-SockIoScheduler::SockIoScheduler(size_t thread_num, bool use_creator, std::string_view name)
-    : Scheduler(thread_num, use_creator, name) {
+// 构造时没有指定IO后端的调度器使用的后端，epoll或者io_uring
+static auto sock_io_backend = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "sock_io_scheduler.io_backend", std::string("epoll"), "io backend of SockIoScheduler, epoll or io_uring");
+
+// io_uring提交队列的长度
+static auto io_uring_entries = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "sock_io_scheduler.io_uring_entries", 256, "io_uring submission queue entries of SockIoScheduler");
+
+// 构造时没有指定reactor模式的调度器使用的模式，shared或者per_thread
+static auto sock_io_reactor_mode = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "sock_io_scheduler.reactor_mode", std::string("shared"), "reactor mode of SockIoScheduler, shared or per_thread");
+
+// 每线程一个reactor模式下，新的fd如何分配给调度线程，round_robin或者least_loaded
+static auto sock_io_reactor_balance = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "sock_io_scheduler.reactor_balance", std::string("round_robin"),
+    "how SockIoScheduler assigns fds to per thread reactors, round_robin or least_loaded");
+
+struct SockIoSchedulerIniter {
+  SockIoSchedulerIniter() {
+    // 热加载配置时拒绝不认识的后端，避免拼写错误被悄悄当作epoll
+    sock_io_backend->SetValidator([](const std::string &value) { return value == "epoll" || value == "io_uring"; });
+    sock_io_reactor_mode->SetValidator(
+        [](const std::string &value) { return value == "shared" || value == "per_thread"; });
+    sock_io_reactor_balance->SetValidator(
+        [](const std::string &value) { return value == "round_robin" || value == "least_loaded"; });
+  }
+};
+
+static SockIoSchedulerIniter __sock_io_scheduler_initer;  // NOLINT
+
+// link timeout的sqe和IO操作的sqe指向同一个请求，用user_data的最低位区分
+static constexpr uint64_t LINK_TIMEOUT_TAG = 1;
+
+// 调度器编号生成器，从1开始，fd上下文中的0表示还没有被任何调度器监听过
+static std::atomic<uint32_t> s_io_scheduler_id{0};
+
+/**
+ * @brief 一个提交给io_uring的IO操作，保存在等待它的协程的栈上
+ */
+struct IoUringRequest {
+  Coroutine::s_ptr coroutine_{nullptr};    // 等待该操作完成的协程
+  int thread_id_{-1};                      // 协程完成后回到的线程，每线程一个reactor模式下为发起操作的线程
+  int32_t result_{0};                      // IO操作的结果
+  int32_t timeout_result_{0};              // link timeout的结果，-ETIME表示超时触发
+  std::atomic<int> pending_cqe_count_{0};  // 还没有收到的cqe数量，全部收到之后才能唤醒协程
+};
+
+SockIoScheduler::SockIoScheduler(size_t thread_num, bool use_creator, std::string_view name, IoBackend backend,
+                                 ReactorMode reactor_mode)
+    : Scheduler(thread_num, use_creator, name), id_(++s_io_scheduler_id) {
   // 初始化epoll, 新版本的epoll不需要传入size，取而代之的是flag标志位， 目前仅支持EPOLL_CLOEXEC表示在exec时关闭epoll_fd
   epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
   ASSERT(epoll_fd_ > 0);
 
-  // 初始化管道
-  int ret = pipe(tickle_pipe_fds_);
-  ASSERT(ret == 0);
+  if (reactor_mode == ReactorMode::Default) {
+    reactor_mode = *sock_io_reactor_mode->GetSnapshot() == "per_thread" ? ReactorMode::PerThread : ReactorMode::Shared;
+  }
+  if (reactor_mode == ReactorMode::PerThread) {
+    reactors_.reserve(GetWorkerCount());
+    for (size_t i = 0; i < GetWorkerCount(); i++) {
+      reactors_.emplace_back(std::make_unique<Reactor>());
+      reactors_.back()->epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+      ASSERT(reactors_.back()->epoll_fd_ > 0);
+      reactors_.back()->timer_manager_ = std::make_shared<TimerManager>();
+    }
+  }
+
+  // 每个调度线程一个阻塞的eventfd，Parked线程阻塞读取它；轮询线程共用一个注册在epoll中的非阻塞eventfd
+  // 每线程一个reactor模式下，线程的eventfd注册在它自己的epoll中，因此是非阻塞的
+  int waiter_flags = reactors_.empty() ? EFD_CLOEXEC : EFD_NONBLOCK | EFD_CLOEXEC;
+  waiters_.reserve(GetWorkerCount());
+  for (size_t i = 0; i < GetWorkerCount(); i++) {
+    waiters_.emplace_back(std::make_unique<IdleWaiter>());
+    waiters_.back()->event_fd_ = eventfd(0, waiter_flags);
+    ASSERT(waiters_.back()->event_fd_ >= 0);
+  }
+  poller_event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  ASSERT(poller_event_fd_ >= 0);
 
   timer_manager_ = std::make_shared<TimerManager>();
+
+  if (backend == IoBackend::Default) {
+    backend = *sock_io_backend->GetSnapshot() == "io_uring" ? IoBackend::IoUring : IoBackend::Epoll;
+  }
+  if (backend == IoBackend::IoUring) {
+    io_uring_ = IoUring::Create(static_cast<uint32_t>(std::max(io_uring_entries->GetValue(), 1)));
+    if (io_uring_ == nullptr) {
+      LOG_WARN(sys_logger) << "SockIoScheduler " << name << " create io_uring failed, fall back to epoll";
+    }
+  }
 }
 
 SockIoScheduler::~SockIoScheduler() {
   close(epoll_fd_);
-  close(tickle_pipe_fds_[0]);
-  close(tickle_pipe_fds_[1]);
+  close(poller_event_fd_);
+  for (auto &waiter : waiters_) {
+    close(waiter->event_fd_);
+  }
+  for (auto &reactor : reactors_) {
+    close(reactor->epoll_fd_);
+  }
 }
 
 void SockIoScheduler::Start() {
-  // 启动定时器
-  // pipe有两端，我们让epoll监听读端的可读事件，这样当我们往写端写入数据时，epoll_wait就会返回，从而唤醒阻塞在epoll_wait的线程
+  // 往poller_event_fd_写入数据时，阻塞在epoll_wait中的轮询线程被唤醒
   epoll_event event_info{};
-  event_info.data.fd = tickle_pipe_fds_[0];  // 监听管道读端fd
-  event_info.events = EPOLLIN | EPOLLET;     // 读事件、边缘触发
-
-  // 第二个参数是此次操作的类型，F_SETFL表示设置文件状态标志，第三个参数是要设置的标志，O_NONBLOCK表示非阻塞
-  int ret = fcntl(tickle_pipe_fds_[0], F_SETFL, O_NONBLOCK);  // 设置为非阻塞
+  event_info.data.ptr = &poller_event_fd_;
+  event_info.events = EPOLLIN | EPOLLET;  // 读事件、边缘触发
+  int ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, poller_event_fd_, &event_info);
   ASSERT(ret == 0);
 
-  ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, tickle_pipe_fds_[0], &event_info);
-  ASSERT(ret == 0);
+  // 每线程一个reactor模式下，往线程的eventfd写入数据时，阻塞在它自己epoll中的线程被唤醒
+  for (size_t i = 0; i < reactors_.size(); i++) {
+    epoll_event waiter_event_info{};
+    waiter_event_info.data.ptr = waiters_[i].get();
+    waiter_event_info.events = EPOLLIN | EPOLLET;
+    ret = epoll_ctl(reactors_[i]->epoll_fd_, EPOLL_CTL_ADD, waiters_[i]->event_fd_, &waiter_event_info);
+    ASSERT(ret == 0);
+  }
 
-  ContextVecResize(32);
+  // io_uring的完成队列中有新的cqe时，它的fd变为可读，空闲线程在epoll_wait中被唤醒之后负责收割
+  // 每线程一个reactor模式下所有线程共用一个ring，它注册在每个线程的epoll中，任何一个空闲线程都可以收割，
+  // 不会因为某一个线程忙碌而耽误其他线程的请求，收割到的协程按照thread_id_回到提交它的线程
+  if (io_uring_ != nullptr) {
+    epoll_event ring_event_info{};
+    ring_event_info.data.ptr = io_uring_.get();
+    ring_event_info.events = EPOLLIN | EPOLLET;
+    if (reactors_.empty()) {
+      ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, io_uring_->GetFd(), &ring_event_info);
+      ASSERT(ret == 0);
+    }
+    for (auto &reactor : reactors_) {
+      ret = epoll_ctl(reactor->epoll_fd_, EPOLL_CTL_ADD, io_uring_->GetFd(), &ring_event_info);
+      ASSERT(ret == 0);
+    }
+  }
 
   Scheduler::Start();
 }
 
-void SockIoScheduler::ContextVecResize(size_t size) {
-  fd_contexts_.resize(size);
-  for (size_t i = 0; i < fd_contexts_.size(); ++i) {
-    if (fd_contexts_[i] == nullptr) {
-      fd_contexts_[i] = std::make_shared<FileDescContext>();
-      fd_contexts_[i]->sys_fd_ = i;
+auto SockIoScheduler::AssignFdToWorker(int target_fd) -> int {
+  if (reactors_.empty()) {
+    return -1;
+  }
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = AdoptFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return -1;
+  }
+  if (fd_ctx->owner_index_ < 0) {
+    // 显式分配时不考虑调用者所在的线程，接收连接的线程不应该把所有连接都留给自己
+    size_t index = 0;
+    if (*sock_io_reactor_balance->GetSnapshot() == "least_loaded") {
+      for (size_t i = 1; i < reactors_.size(); i++) {
+        if (reactors_[i]->fd_count_ < reactors_[index]->fd_count_) {
+          index = i;
+        }
+      }
+    } else {
+      index = next_reactor_++ % reactors_.size();
     }
+    fd_ctx->owner_index_ = static_cast<int>(index);
+    ++reactors_[index]->fd_count_;
+  }
+  return fd_ctx->owner_index_;
+}
+
+auto SockIoScheduler::LockFdContext(int target_fd, std::unique_lock<FileDescContext::MutexType> *lock)
+    -> FileDescContext * {
+  FileDescContext *fd_ctx = FdWrapperMgr::GetInstance()->GetEventContext(target_fd);
+  if (fd_ctx == nullptr) {
+    return nullptr;
+  }
+  *lock = std::unique_lock<FileDescContext::MutexType>(fd_ctx->mutex_);
+  if (fd_ctx->io_scheduler_id_ != id_) {
+    lock->unlock();
+    return nullptr;
+  }
+  return fd_ctx;
+}
+
+auto SockIoScheduler::AdoptFdContext(int target_fd, std::unique_lock<FileDescContext::MutexType> *lock)
+    -> FileDescContext * {
+  FileDescContext *fd_ctx = FdWrapperMgr::GetInstance()->GetOrCreateEventContext(target_fd);
+  if (fd_ctx == nullptr) {
+    return nullptr;
+  }
+  *lock = std::unique_lock<FileDescContext::MutexType>(fd_ctx->mutex_);
+  if (fd_ctx->io_scheduler_id_ != id_) {
+    // 上一个调度器的epoll注册和线程分配对本调度器无效，它可能已经析构，留下的状态相当于随调度器一起销毁
+    fd_ctx->io_scheduler_id_ = id_;
+    fd_ctx->registered_event_types_ = FileDescContext::EventType::None;
+    fd_ctx->ready_event_types_ = FileDescContext::EventType::None;
+    fd_ctx->is_epoll_registered_ = false;
+    fd_ctx->owner_index_ = -1;
+    fd_ctx->ResetEventContext(FileDescContext::EventType::Read);
+    fd_ctx->ResetEventContext(FileDescContext::EventType::Write);
+  }
+  return fd_ctx;
+}
+
+auto SockIoScheduler::AssignOwner(FileDescContext *fd_ctx) -> int {
+  if (fd_ctx->owner_index_ >= 0) {
+    return fd_ctx->owner_index_;
+  }
+  // 由本调度器的调度线程第一次监听的fd留在该线程，外部线程监听的fd轮流分配
+  int index = GetThreadScheduler().get() == this ? GetThreadWorkerIndex() : -1;
+  if (index < 0) {
+    index = static_cast<int>(next_reactor_++ % reactors_.size());
+  }
+  fd_ctx->owner_index_ = index;
+  ++reactors_[index]->fd_count_;
+  return index;
+}
+
+auto SockIoScheduler::GetEpollFd(const FileDescContext *fd_ctx) const -> int {
+  if (reactors_.empty() || fd_ctx->owner_index_ < 0) {
+    return epoll_fd_;
   }
+  return reactors_[fd_ctx->owner_index_]->epoll_fd_;
 }
 
 auto SockIoScheduler::AddEventListening(int target_fd, FileDescContext::EventType target_event_type,
                                         std::function<void()> cb_func) -> bool {
-  FileDescContext::s_ptr fd_ctx = nullptr;
-  {
-    mutex_.lock_shared();  // 读锁
-    if (fd_contexts_.size() > static_cast<size_t>(target_fd)) {
-      // 如果fd_contexts_中已经存在了target_fd的fd_context，那么直接取出来
-      fd_ctx = fd_contexts_[target_fd];
-      mutex_.unlock_shared();  // 释放读锁
-    } else {
-      mutex_.unlock_shared();                   // 释放读锁
-      std::lock_guard<MutexType> lock(mutex_);  // 范围写锁
-      ContextVecResize(target_fd * 1.5);
-      fd_ctx = fd_contexts_[target_fd];
-    }
+  return AddEventListeningImpl(target_fd, target_event_type, std::move(cb_func), nullptr, false);
+}
+
+auto SockIoScheduler::TryAddEventListening(int target_fd, FileDescContext::EventType target_event_type,
+                                           std::function<void()> cb_func, const void *owner) -> bool {
+  return AddEventListeningImpl(target_fd, target_event_type, std::move(cb_func), owner, true);
+}
+
+auto SockIoScheduler::AddEventListeningImpl(int target_fd, FileDescContext::EventType target_event_type,
+                                            std::function<void()> cb_func, const void *owner,
+                                            bool fail_if_registered) -> bool {
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = AdoptFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    LOG_ERROR(sys_logger) << "fd: " << target_fd << " is out of range of the fd context table";
+    return false;
   }
 
-  std::lock_guard<FileDescContext::MutexType> lock(fd_ctx->mutex_);
   // 不允许在上一次注册的事件还未触发时，重复注册该事件
   if ((fd_ctx->registered_event_types_ & target_event_type) != 0) {
+    if (fail_if_registered) {
+      return false;
+    }
     LOG_ERROR(sys_logger) << "fd: " << target_fd << " has already registered event: " << target_event_type;
     ASSERT(false)
   }
-  // 如果该fd从未注册过事件，那么操作类型就是ADD，否则就是MOD
-  int op = fd_ctx->registered_event_types_ == FileDescContext::EventType::None ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
 
   // 先更新FDContext的状态，因为如果先向epoll注册了时间，有一种极限状态是事件触发了，但是我们的FDContext还没有更新，这样就会导致事件回调函数找不到
   //
   // 更新fd_context的状态
   fd_ctx->registered_event_types_ =
       static_cast<FileDescContext::EventType>(fd_ctx->registered_event_types_ | target_event_type);
-  FileDescContext::EventContext::s_ptr event_ctx = fd_ctx->GetEventContext(target_event_type);
+  FileDescContext::EventContext *event_ctx = fd_ctx->GetEventContext(target_event_type);
   // 可以确保：每个事件的上下文，在每次触发之后都会重置，因此如果该事件没有注册过，或者注册过但是已经触发过了，那么此时得到的event_ctx是空的
   ASSERT(event_ctx->scheduler_.lock() == nullptr && event_ctx->coroutine_ == nullptr && event_ctx->func_ == nullptr);
   event_ctx->scheduler_ = GetThreadScheduler();
+  event_ctx->owner_ = owner;
   // 如果传入的cb_func为空，那么就将当前执行上下文封装成协程，作为回调
   if (cb_func == nullptr) {
     Coroutine::InitThreadToCoMod();
@@ -113,16 +298,40 @@ auto SockIoScheduler::AddEventListening(int target_fd, FileDescContext::EventTyp
     event_ctx->func_ = std::move(cb_func);
   }
 
-  epoll_event event_info{};
-  // event_info.data.fd = target_fd;  // 似乎可有可无？
-  event_info.events = EPOLLET | static_cast<uint32_t>(fd_ctx->registered_event_types_ | target_event_type);  // 边缘触发
-  event_info.data.ptr = fd_ctx.get();  // 事件触发后，可以通过该指针获取到fd_context，从而获取到事件回调函数
-  int ret = epoll_ctl(epoll_fd_, op, target_fd, &event_info);
-  if (ret != 0) {
-    LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << op
-                          << ", event_type: " << target_event_type << ", errno: " << errno
-                          << ", errstr: " << strerror(errno);
-    return false;
+  // 上一次等待之后该事件已经就绪过，不需要再等待，直接触发回调
+  if ((fd_ctx->ready_event_types_ & target_event_type) != 0) {
+    fd_ctx->ready_event_types_ =
+        static_cast<FileDescContext::EventType>(fd_ctx->ready_event_types_ & (~target_event_type));
+    fd_ctx->TriggerEvent(target_event_type);
+    return true;
+  }
+
+  // fd在整个生命周期中只注册一次，同时监听读写事件，之后的等待不再需要epoll_ctl
+  if (!fd_ctx->is_epoll_registered_) {
+    if (!reactors_.empty()) {
+      AssignOwner(fd_ctx);
+    }
+    int epoll_fd = GetEpollFd(fd_ctx);
+    epoll_event event_info{};
+    event_info.events = EPOLLIN | EPOLLOUT | EPOLLET;  // 边缘触发
+    event_info.data.ptr = fd_ctx;  // 事件触发后，可以通过该指针获取到fd_context，从而获取到事件回调函数
+    int op = EPOLL_CTL_ADD;
+    int ret = epoll_ctl(epoll_fd, op, target_fd, &event_info);
+    if (ret != 0 && errno == EEXIST) {
+      // fd没有经过hook的close就被复用了，epoll中残留着旧的注册，覆盖它
+      op = EPOLL_CTL_MOD;
+      ret = epoll_ctl(epoll_fd, op, target_fd, &event_info);
+    }
+    if (ret != 0) {
+      LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << op
+                            << ", event_type: " << target_event_type << ", errno: " << errno
+                            << ", errstr: " << strerror(errno);
+      fd_ctx->registered_event_types_ =
+          static_cast<FileDescContext::EventType>(fd_ctx->registered_event_types_ & (~target_event_type));
+      fd_ctx->ResetEventContext(target_event_type);
+      return false;
+    }
+    fd_ctx->is_epoll_registered_ = true;
   }
 
   // 待触发的事件数量+1
@@ -131,81 +340,63 @@ auto SockIoScheduler::AddEventListening(int target_fd, FileDescContext::EventTyp
   return true;
 }
 
-auto SockIoScheduler::RemoveEventListening(int target_fd, FileDescContext::EventType target_event_type) -> bool {
-  FileDescContext::s_ptr fd_ctx = nullptr;
-  {
-    std::shared_lock<MutexType> lock(mutex_);
-    if (fd_contexts_.size() <= static_cast<size_t>(target_fd)) {
-      return false;
-    }
-    fd_ctx = fd_contexts_[target_fd];
+auto SockIoScheduler::ConsumeReadyEvent(int target_fd, FileDescContext::EventType target_event_type) -> bool {
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = LockFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return false;
+  }
+
+  if ((fd_ctx->ready_event_types_ & target_event_type) == 0) {
+    return false;
+  }
+  fd_ctx->ready_event_types_ =
+      static_cast<FileDescContext::EventType>(fd_ctx->ready_event_types_ & (~target_event_type));
+  return true;
+}
+
+auto SockIoScheduler::RemoveEventListening(int target_fd, FileDescContext::EventType target_event_type,
+                                           const void *owner) -> bool {
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = LockFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return false;
   }
 
-  std::lock_guard<FileDescContext::MutexType> lock(fd_ctx->mutex_);
   // 如果目标事件没有注册过，那么直接返回
   if ((fd_ctx->registered_event_types_ & target_event_type) == 0) {
     return false;
   }
-
-  // 清除epoll中目标fd上的目标事件
-  auto new_event_types =
-      static_cast<FileDescContext::EventType>(fd_ctx->registered_event_types_ & (~target_event_type));
-  // 如果清除之后，fd上没有任何事件了，那么就从epoll中DEL该fd，否则是MOD
-  int op = new_event_types == FileDescContext::EventType::None ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-  epoll_event event_info{};
-  // event_info.data.fd = target_fd;
-  event_info.events = EPOLLET | static_cast<uint32_t>(new_event_types);
-  event_info.data.ptr = fd_ctx.get();
-  int ret = epoll_ctl(epoll_fd_, op, target_fd, &event_info);
-  if (ret != 0) {
-    LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << op
-                          << ", event_type: " << target_event_type << ", errno: " << errno
-                          << ", errstr: " << strerror(errno);
+  // 自己的注册已经被触发，现在的注册属于其他任务
+  if (owner != nullptr && fd_ctx->GetEventContext(target_event_type)->owner_ != owner) {
     return false;
   }
 
+  // fd仍然留在epoll中，只是不再有任务等待该事件，之后到达的就绪边沿会被记录下来
+
   // 待触发的事件数量-1
   --pending_event_count_;
 
   // 更新fd_context的状态
-  fd_ctx->registered_event_types_ = new_event_types;
+  fd_ctx->registered_event_types_ =
+      static_cast<FileDescContext::EventType>(fd_ctx->registered_event_types_ & (~target_event_type));
   fd_ctx->ResetEventContext(target_event_type);
   return true;
 }
 
 auto SockIoScheduler::RemoveAndTriggerEventListening(int target_fd, FileDescContext::EventType target_event_type)
     -> bool {
-  FileDescContext::s_ptr fd_ctx = nullptr;
-  {
-    std::shared_lock<MutexType> lock(mutex_);
-    if (fd_contexts_.size() <= static_cast<size_t>(target_fd)) {
-      return false;
-    }
-    fd_ctx = fd_contexts_[target_fd];
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = LockFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return false;
   }
 
-  std::lock_guard<FileDescContext::MutexType> lock(fd_ctx->mutex_);
   // 如果目标事件没有注册过，那么直接返回
   if ((fd_ctx->registered_event_types_ & target_event_type) == 0) {
     return false;
   }
 
-  auto new_event_types =
-      static_cast<FileDescContext::EventType>(fd_ctx->registered_event_types_ & (~target_event_type));
-  // 如果清除之后，fd上没有任何事件了，那么就从epoll中DEL该fd，否则是MOD
-  int op = new_event_types == FileDescContext::EventType::None ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-  epoll_event event_info{};
-  // event_info.data.fd = target_fd;
-  event_info.events = EPOLLET | static_cast<uint32_t>(new_event_types);
-  event_info.data.ptr = fd_ctx.get();
-  int ret = epoll_ctl(epoll_fd_, op, target_fd, &event_info);
-  if (ret != 0) {
-    LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << op
-                          << ", event_type: " << target_event_type << ", errno: " << errno
-                          << ", errstr: " << strerror(errno);
-    return false;
-  }
-
   // 待触发的事件数量-1
   --pending_event_count_;
   // 触发事件
@@ -214,35 +405,47 @@ auto SockIoScheduler::RemoveAndTriggerEventListening(int target_fd, FileDescCont
 }
 
 auto SockIoScheduler::RemoveAndTriggerAllTypeEventListening(int target_fd) -> bool {
-  FileDescContext::s_ptr fd_ctx = nullptr;
-  {
-    std::shared_lock<MutexType> lock(mutex_);
-    if (fd_contexts_.size() <= static_cast<size_t>(target_fd)) {
-      return false;
-    }
-    fd_ctx = fd_contexts_[target_fd];
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = LockFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return false;
   }
 
-  std::lock_guard<FileDescContext::MutexType> lock(fd_ctx->mutex_);
   // 如果目标事件没有注册过，那么直接返回
   if (fd_ctx->registered_event_types_ == FileDescContext::EventType::None) {
     return false;
   }
+  TriggerAllEvents(fd_ctx);
+  return true;
+}
 
-  // 清除epoll中目标fd上的所有事件
-  int op = EPOLL_CTL_DEL;
-  epoll_event event_info{};
-  // event_info.data.fd = target_fd;
-  event_info.events = EPOLLET;
-  event_info.data.ptr = fd_ctx.get();
-  int ret = epoll_ctl(epoll_fd_, op, target_fd, &event_info);
-  if (ret != 0) {
-    LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << op
-                          << ", event_type: " << fd_ctx->registered_event_types_ << ", errno: " << errno
-                          << ", errstr: " << strerror(errno);
-    return false;
+void SockIoScheduler::CloseEventListening(int target_fd) {
+  std::unique_lock<FileDescContext::MutexType> lock;
+  FileDescContext *fd_ctx = LockFdContext(target_fd, &lock);
+  if (fd_ctx == nullptr) {
+    return;
+  }
+
+  if (fd_ctx->is_epoll_registered_) {
+    // fd关闭之后编号会被复用，必须在关闭之前从epoll中移除，否则dup出来的fd仍会把事件报告到这个fd_context上
+    epoll_event event_info{};
+    int ret = epoll_ctl(GetEpollFd(fd_ctx), EPOLL_CTL_DEL, target_fd, &event_info);
+    if (ret != 0 && errno != EBADF && errno != ENOENT) {
+      LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << target_fd << ", op: " << EPOLL_CTL_DEL
+                            << ", errno: " << errno << ", errstr: " << strerror(errno);
+    }
+    fd_ctx->is_epoll_registered_ = false;
+  }
+  // 编号被复用之后是一个新的fd，重新分配调度线程
+  if (fd_ctx->owner_index_ >= 0) {
+    --reactors_[fd_ctx->owner_index_]->fd_count_;
+    fd_ctx->owner_index_ = -1;
   }
+  fd_ctx->ready_event_types_ = FileDescContext::EventType::None;
+  TriggerAllEvents(fd_ctx);
+}
 
+void SockIoScheduler::TriggerAllEvents(FileDescContext *fd_ctx) {
   // 触发事件
   if ((fd_ctx->registered_event_types_ & FileDescContext::EventType::Read) != 0) {
     fd_ctx->TriggerEvent(FileDescContext::EventType::Read);
@@ -253,64 +456,194 @@ auto SockIoScheduler::RemoveAndTriggerAllTypeEventListening(int target_fd) -> bo
     --pending_event_count_;
   }
   ASSERT(fd_ctx->registered_event_types_ == FileDescContext::EventType::None);
-
-  return true;
 }
 
 auto SockIoScheduler::GetThreadSockIoScheduler() -> SockIoScheduler::s_ptr {
   return std::dynamic_pointer_cast<SockIoScheduler>(GetThreadScheduler());
 }
 
+static void WriteEventFd(int fd) {
+  uint64_t value = 1;
+  ssize_t n = write(fd, &value, sizeof(value));
+  ASSERT(n == sizeof(value));
+}
+
 void SockIoScheduler::Tickle() {
-  LOG_DEBUG(sys_logger) << "SockIoScheduler::Tickle";
   if (!HasIdleThread()) {
     return;
   }
+  // 优先唤醒Parked线程，不打断正在等待IO事件的轮询线程
+  if (NotifyLongestParked()) {
+    return;
+  }
+  TicklePoller();
+}
+
+void SockIoScheduler::TickleWorker(size_t worker_index) { NotifyWorker(worker_index); }
+
+void SockIoScheduler::TicklePoller() {
+  int poller_index = poller_index_;
+  if (poller_index >= 0) {
+    NotifyWorker(poller_index);
+  }
+}
+
+auto SockIoScheduler::NotifyWorker(size_t worker_index) -> bool {
+  ASSERT(worker_index < waiters_.size());
+  IdleWaiter &waiter = *waiters_[worker_index];
+  if (waiter.notified_.exchange(true)) {
+    return false;
+  }
+  // 先设置notified_再读取state_，与等待方"先设置state_再检查notified_"的顺序配合，两者至少有一方能看到对方
+  switch (waiter.state_.load()) {
+    case IdleWaiter::State::Parked:
+      WriteEventFd(waiter.event_fd_);
+      break;
+    case IdleWaiter::State::Polling:
+      WriteEventFd(poller_event_fd_);
+      break;
+    default:
+      // 线程正在运行，在下一次等待之前会看到notified_
+      break;
+  }
+  return true;
+}
+
+auto SockIoScheduler::NotifyLongestParked() -> bool {
+  // 每次失败都说明有一个线程刚刚被其他人通知，最多重试线程数次
+  for (size_t retry = 0; retry < waiters_.size(); retry++) {
+    int target = -1;
+    uint64_t min_seq = UINT64_MAX;
+    for (size_t i = 0; i < waiters_.size(); i++) {
+      IdleWaiter &waiter = *waiters_[i];
+      if (waiter.state_ == IdleWaiter::State::Parked && !waiter.notified_ && waiter.park_seq_ < min_seq) {
+        min_seq = waiter.park_seq_;
+        target = static_cast<int>(i);
+      }
+    }
+    if (target < 0) {
+      return false;
+    }
+    if (NotifyWorker(target)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  // 往管道写端写入数据，唤醒阻塞在epoll_wait的线程
-  uint8_t data = 1;
-  ssize_t n = write(tickle_pipe_fds_[1], &data, sizeof(data));
-  ASSERT(n == sizeof(data));
+void SockIoScheduler::Park(IdleWaiter *waiter) {
+  waiter->park_seq_ = ++park_seq_;
+  waiter->state_ = IdleWaiter::State::Parked;
+  // 轮询线程先清空poller_index_再查找Parked线程，这里先设置Parked再检查poller_index_，
+  // 保证轮询线程离开时要么能看到当前线程并把轮询交给它，要么当前线程能看到没有轮询线程而不阻塞
+  if (!waiter->notified_.exchange(false) && poller_index_ != -1) {
+    uint64_t value = 0;
+    while (read(waiter->event_fd_, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+    waiter->notified_ = false;
+  }
+  waiter->state_ = IdleWaiter::State::Running;
 }
 
 auto SockIoScheduler::IsStopable() -> bool {
   // 1. 没有需要触发的定时器
   // 2. 没有待触发的IO事件
   // 3. 线程池中的线程都是空闲的（Scheduler::IsStopable）
-  return timer_manager_->GetRecentTriggerTime() == UINT64_MAX && pending_event_count_ == 0 && Scheduler::IsStopable();
+  // 每个空闲线程都会检查所有reactor的定时器，Empty不加锁也不修改状态，不会和定时器所属的线程竞争
+  if (!timer_manager_->Empty()) {
+    return false;
+  }
+  for (auto &reactor : reactors_) {
+    if (!reactor->timer_manager_->Empty()) {
+      return false;
+    }
+  }
+  return pending_event_count_ == 0 && Scheduler::IsStopable();
+}
+
+// 最大超时时间为5s，如果距离下一个定时器触发的时间大于5s，那么epoll_wait就等待5s
+static constexpr uint64_t MAX_EPOLL_TIMEOUT = 5000;
+
+static auto EpollWait(int epoll_fd, epoll_event *events, int max_events, uint64_t timeout) -> int {
+  timeout = std::min(timeout, MAX_EPOLL_TIMEOUT);
+  int ret = 0;
+  do {
+    ret = epoll_wait_f(epoll_fd, events, max_events, static_cast<int>(timeout));
+    // EINTR代表epoll_wait被信号中断，需要重新调用
+  } while (ret == -1 && errno == EINTR);
+  return ret;
+}
+
+auto SockIoScheduler::WaitShared(IdleWaiter *waiter, int worker_index, epoll_event *events, int max_events) -> int {
+  // 已经有轮询线程时，阻塞在自己的eventfd上，醒来之后回到Run取任务
+  int expected = -1;
+  if (!poller_index_.compare_exchange_strong(expected, worker_index)) {
+    Park(waiter);
+    return -1;
+  }
+
+  // 成为轮询线程，先设置Polling再检查notified_，之后的通知都会写poller_event_fd_
+  waiter->state_ = IdleWaiter::State::Polling;
+  uint64_t next_timeout = waiter->notified_.exchange(false) ? 0 : timer_manager_->GetRecentTriggerTime();
+  int ret = EpollWait(epoll_fd_, events, max_events, next_timeout);
+
+  // 离开轮询之前把轮询交给等待最久的Parked线程，当前线程处理事件和执行任务期间仍然有线程等待IO事件
+  poller_index_ = -1;
+  waiter->state_ = IdleWaiter::State::Running;
+  waiter->notified_ = false;
+  NotifyLongestParked();
+  return ret;
+}
+
+auto SockIoScheduler::WaitReactor(IdleWaiter *waiter, int worker_index, epoll_event *events, int max_events) -> int {
+  // 每个线程只等待自己的epoll，不需要竞争和交接轮询，通知总是写线程自己的eventfd
+  waiter->park_seq_ = ++park_seq_;
+  waiter->state_ = IdleWaiter::State::Parked;
+  TimerManager &timer_manager = *reactors_[worker_index]->timer_manager_;
+  uint64_t next_timeout = waiter->notified_.exchange(false) ? 0 : timer_manager.GetRecentTriggerTime();
+  int ret = EpollWait(reactors_[worker_index]->epoll_fd_, events, max_events, next_timeout);
+  waiter->state_ = IdleWaiter::State::Running;
+  waiter->notified_ = false;
+  return ret;
 }
 
 void SockIoScheduler::Idle() {
   LOG_INFO(sys_logger) << "SockIoScheduler::Idle";
   const uint64_t max_events = 256;
-  const int max_pipe_read_size = 256;
   // 为什么要用new，因为协程栈空间有限，如果用栈上的数组，那么可能会导致栈溢出
   // 为什么要用unique_ptr，因为shared_ptr默认使用delete，而不是delete[]，因此会导致内存泄漏
   // 但是c++14为unique_ptr新增了T[]的特化，因此可以用unique_ptr来管理数组
   std::unique_ptr<epoll_event[]> ready_events(new epoll_event[max_events]);
   std::vector<std::function<void()>> timer_cb_funcs;
+  // 一次epoll_wait中被唤醒的回调任务，处理完所有就绪事件之后批量提交，只加一次锁、只唤醒必要数量的线程
+  std::vector<ScheduleTask> triggered_tasks;
+  const int worker_index = GetThreadWorkerIndex();
+  ASSERT(worker_index >= 0 && static_cast<size_t>(worker_index) < waiters_.size());
+  IdleWaiter &waiter = *waiters_[worker_index];
+  const bool per_thread = !reactors_.empty();
+  TimerManager &timer_manager = per_thread ? *reactors_[worker_index]->timer_manager_ : *timer_manager_;
+  const int thread_id = GetCurrSysThreadId();
   while (true) {
     if (IsStopable()) {
       LOG_DEBUG(sys_logger) << "SockIoScheduler::Idle, stopable exit";
-      break;
-    }
-    uint64_t next_timeout = timer_manager_->GetRecentTriggerTime();
-    int ret = 0;
-    do {
-      // 最大超时时间为5s，如果距离下一个定时器触发的时间大于5s，那么epoll_wait就等待5s
-      const uint64_t max_timeout = 5000;
-      next_timeout = std::min(next_timeout, max_timeout);
-      ret = epoll_wait(epoll_fd_, ready_events.get(), max_events, next_timeout);
-      if (ret == -1 && errno == EINTR) {
-        // EINTR代表epoll_wait被信号中断，需要重新调用
-        continue;
+      // 其他空闲线程可能阻塞在epoll_wait或者eventfd上，通知它们一起退出，不必等到超时
+      for (size_t i = 0; i < waiters_.size(); i++) {
+        if (static_cast<int>(i) != worker_index) {
+          NotifyWorker(i);
+        }
       }
-      // epoll_wait成功（超时前有时间就绪或者超时），跳出循环等待
       break;
-    } while (true);
+    }
+
+    int ret = per_thread ? WaitReactor(&waiter, worker_index, ready_events.get(), max_events)
+                         : WaitShared(&waiter, worker_index, ready_events.get(), max_events);
+    if (ret < 0) {
+      Coroutine::GetThreadRunningCoroutine()->Yield();
+      continue;
+    }
 
     // 取出所有需要触发的定时器回调函数
-    timer_cb_funcs = timer_manager_->GetAllTriggeringTimerFuncs();
+    timer_manager.GetAllTriggeringTimerFuncs(&timer_cb_funcs);
     // 执行所有定时器回调函数
     for (const auto &timer_cb_func : timer_cb_funcs) {
       timer_cb_func();
@@ -320,29 +653,25 @@ void SockIoScheduler::Idle() {
     // 遍历所有就绪的事件，根据epoll_event中的data.ptr获取到fd_context，然后执行回调
     for (int i = 0; i < ret; i++) {
       epoll_event &event_info = ready_events[i];
-      // 如果是用来唤醒空闲线程的管道，那么就丢弃管道中的数据，然后忽略这个事件
-      if (event_info.data.fd == tickle_pipe_fds_[0]) {
-        std::unique_ptr<uint8_t[]> dummy_data(new uint8_t[max_pipe_read_size]);
-        while (read(tickle_pipe_fds_[0], dummy_data.get(), max_pipe_read_size) > 0) {
+      // io_uring的完成事件在遍历结束之后统一收割
+      if (io_uring_ != nullptr && event_info.data.ptr == io_uring_.get()) {
+        continue;
+      }
+      // 唤醒轮询线程或者reactor线程的eventfd，一次读取就可以清空计数
+      if (event_info.data.ptr == &poller_event_fd_ || event_info.data.ptr == &waiter) {
+        int event_fd = event_info.data.ptr == &waiter ? waiter.event_fd_ : poller_event_fd_;
+        uint64_t value = 0;
+        while (read(event_fd, &value, sizeof(value)) < 0 && errno == EINTR) {
         }
         continue;
       }
       auto *fd_ctx = static_cast<FileDescContext *>(event_info.data.ptr);
       std::lock_guard<FileDescContext::MutexType> lock(fd_ctx->mutex_);
-      // 如果fd上没有注册任何事件，那么直接忽略
-      if (fd_ctx->registered_event_types_ == FileDescContext::EventType::None) {
+      // fd已经被关闭并从epoll中移除，或者已经被其他调度器接管，忽略残留的事件
+      if (!fd_ctx->is_epoll_registered_ || fd_ctx->io_scheduler_id_ != id_) {
         continue;
       }
 
-      if ((event_info.events & (EPOLLERR | EPOLLHUP)) != 0) {
-        // EPOLLERR：IO出错，比如写一个已经关闭的socket/pipe
-        // EPOLLHUB：对端关闭连接
-        // 此时
-        // 一般来说，如果出现了，那么手动设置该fd上的读写事件都触发，然后尝试执行回调
-        event_info.events |=
-            static_cast<uint32_t>(FileDescContext::EventType::Read | FileDescContext::EventType::Write) &
-            fd_ctx->registered_event_types_;
-      }
       int real_events = FileDescContext::EventType::None;
       if ((event_info.events & EPOLLIN) != 0) {
         real_events |= FileDescContext::EventType::Read;
@@ -350,33 +679,44 @@ void SockIoScheduler::Idle() {
       if ((event_info.events & EPOLLOUT) != 0) {
         real_events |= FileDescContext::EventType::Write;
       }
-      if ((fd_ctx->registered_event_types_ & real_events) == 0) {
-        // 如果fd上注册的事件和实际触发的事件不匹配，那么直接忽略
-        continue;
+      if ((event_info.events & (EPOLLERR | EPOLLHUP)) != 0) {
+        // EPOLLERR：IO出错，比如写一个已经关闭的socket/pipe
+        // EPOLLHUB：对端关闭连接
+        // 此时读写都不会再阻塞，让等待读写的任务都去执行一次系统调用拿到错误
+        real_events |= FileDescContext::EventType::Read | FileDescContext::EventType::Write;
       }
 
-      // 剔除已经触发的事件，将未触发的事件重新注册到epoll中
-      int left_events = fd_ctx->registered_event_types_ & (~real_events);
-      int op = left_events == FileDescContext::EventType::None ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
-      event_info.events = EPOLLET | static_cast<uint32_t>(left_events);
-      int ret2 = epoll_ctl(epoll_fd_, op, fd_ctx->sys_fd_, &event_info);
-      if (ret2 != 0) {
-        LOG_ERROR(sys_logger) << "epoll_ctl failed, fd: " << fd_ctx->sys_fd_ << ", op: " << op
-                              << ", event_type: " << fd_ctx->registered_event_types_ << ", errno: " << errno
-                              << ", errstr: " << strerror(errno);
-        continue;
-      }
+      // fd一直注册在epoll中，不需要重新注册；有任务在等待的事件直接触发，没有任务等待的事件记录下来留给下一次等待
+      int waiting_events = fd_ctx->registered_event_types_ & real_events;
+      fd_ctx->ready_event_types_ =
+          static_cast<FileDescContext::EventType>(fd_ctx->ready_event_types_ | (real_events & (~waiting_events)));
 
       // 触发事件回调
-      if ((real_events & FileDescContext::EventType::Read) != 0) {
-        fd_ctx->TriggerEvent(FileDescContext::EventType::Read);
+      if ((waiting_events & FileDescContext::EventType::Read) != 0) {
+        fd_ctx->TriggerEvent(FileDescContext::EventType::Read, &triggered_tasks, this);
         --pending_event_count_;
       }
-      if ((real_events & FileDescContext::EventType::Write) != 0) {
-        fd_ctx->TriggerEvent(FileDescContext::EventType::Write);
+      if ((waiting_events & FileDescContext::EventType::Write) != 0) {
+        fd_ctx->TriggerEvent(FileDescContext::EventType::Write, &triggered_tasks, this);
         --pending_event_count_;
       }
     }
+    // 每线程一个reactor模式下，fd的回调投递到当前线程的信箱，连接始终在同一个线程中处理，不会被其他线程窃取
+    if (per_thread) {
+      for (auto &task : triggered_tasks) {
+        if (task.target_thread_id_ == -1) {
+          task.target_thread_id_ = thread_id;
+        }
+      }
+    }
+    if (io_uring_ != nullptr) {
+      ReapIoCompletions(&triggered_tasks);
+    }
+    if (!triggered_tasks.empty()) {
+      ScheduleBulk(std::move(triggered_tasks));
+    }
+    // 投递给自己的任务会在Yield之后立即执行，不需要让下一次等待因为这些通知而提前返回
+    waiter.notified_ = false;
 
     // 处理完了所有定时器和IO事件，那么就线程可以尝试去执行线程池任务队列中的任务了
     // 因为其实TriggerEvent只是将任务放入了线程池的任务队列中，而没有真正执行
@@ -388,23 +728,159 @@ void SockIoScheduler::Idle() {
   }
 }
 
-auto SockIoScheduler::AddTimer(uint64_t interval_time, std::function<void()> func, bool recurring) -> Timer::s_ptr {
-  auto res = timer_manager_->AddTimer(interval_time, std::move(func), recurring);
-  if (timer_manager_->NeedTickle()) {
-    Tickle();
-    timer_manager_->SetTickled();
+auto SockIoScheduler::GetTimerManager(int *worker_index) -> TimerManager * {
+  *worker_index = -1;
+  if (reactors_.empty()) {
+    return timer_manager_.get();
+  }
+  // 调度线程添加的定时器由它自己处理，外部线程添加的定时器轮流分配
+  int index = GetThreadScheduler().get() == this ? GetThreadWorkerIndex() : -1;
+  if (index < 0) {
+    index = static_cast<int>(next_reactor_++ % reactors_.size());
   }
+  *worker_index = index;
+  return reactors_[index]->timer_manager_.get();
+}
+
+void SockIoScheduler::TickleTimer(TimerManager *timer_manager, int worker_index) {
+  if (timer_manager->NeedTickle()) {
+    if (worker_index >= 0) {
+      NotifyWorker(worker_index);
+    } else {
+      TicklePoller();
+    }
+    timer_manager->SetTickled();
+  }
+}
+
+auto SockIoScheduler::AddTimer(uint64_t interval_time, std::function<void()> func, bool recurring) -> Timer::s_ptr {
+  int worker_index = -1;
+  TimerManager *timer_manager = GetTimerManager(&worker_index);
+  auto res = timer_manager->AddTimer(interval_time, std::move(func), recurring);
+  TickleTimer(timer_manager, worker_index);
   return res;
 }
 
 auto SockIoScheduler::AddConditionTimer(uint64_t interval_time, const std::function<void()> &func,
                                         const std::function<bool()> &cond, bool recurring) -> Timer::s_ptr {
-  auto res = timer_manager_->AddConditionTimer(interval_time, func, cond, recurring);
-  if (timer_manager_->NeedTickle()) {
-    Tickle();
-    timer_manager_->SetTickled();
-  }
+  int worker_index = -1;
+  TimerManager *timer_manager = GetTimerManager(&worker_index);
+  auto res = timer_manager->AddConditionTimer(interval_time, func, cond, recurring);
+  TickleTimer(timer_manager, worker_index);
   return res;
 }
 
+void SockIoScheduler::AddTimeout(TimeoutNode *node, uint64_t interval_time) {
+  int worker_index = -1;
+  TimerManager *timer_manager = GetTimerManager(&worker_index);
+  timer_manager->AddTimeout(node, interval_time);
+  TickleTimer(timer_manager, worker_index);
+}
+
+auto SockIoScheduler::CancelTimeout(TimeoutNode *node) -> bool { return node->manager_->CancelTimeout(node); }
+
+auto SockIoScheduler::SubmitIoAndWait(io_uring_sqe *sqe, uint64_t timeout_ms) -> int32_t {
+  auto curr_coroutine = Coroutine::GetThreadRunningCoroutine();
+  // 共享栈协程挂起时栈上的数据会被换出，内核写入的将是其他协程的栈
+  if (io_uring_ == nullptr || curr_coroutine->IsSharedStack()) {
+    return -EAGAIN;
+  }
+
+  IoUringRequest request;
+  request.coroutine_ = curr_coroutine;
+  // 每线程一个reactor模式下，完成事件可能被其他线程收割，协程仍然回到发起操作的线程继续执行
+  request.thread_id_ = reactors_.empty() ? -1 : GetCurrSysThreadId();
+  io_uring_sqe sqes[2];
+  sqes[0] = *sqe;
+  sqes[0].user_data = reinterpret_cast<uint64_t>(&request);
+  uint32_t sqe_count = 1;
+  __kernel_timespec timeout{};
+  if (timeout_ms != UINT64_MAX) {
+    // 超时通过链接在IO操作之后的link timeout实现，超时触发时IO操作以-ECANCELED完成
+    sqes[0].flags |= IOSQE_IO_LINK;
+    timeout.tv_sec = static_cast<int64_t>(timeout_ms / 1000);
+    timeout.tv_nsec = static_cast<int64_t>(timeout_ms % 1000 * 1000 * 1000);
+    IoUring::PrepareRw(&sqes[1], IORING_OP_LINK_TIMEOUT, -1, &timeout, 1, 0);
+    sqes[1].user_data = reinterpret_cast<uint64_t>(&request) | LINK_TIMEOUT_TAG;
+    sqe_count = 2;
+  }
+  request.pending_cqe_count_.store(static_cast<int>(sqe_count));
+
+  // 先增加待触发的事件数量，避免操作在提交之后立刻完成时计数出现负数
+  ++pending_event_count_;
+  if (!io_uring_->Submit(sqes, sqe_count)) {
+    --pending_event_count_;
+    return -EAGAIN;
+  }
+  curr_coroutine->Yield();
+
+  if (request.result_ == -ECANCELED && request.timeout_result_ == -ETIME) {
+    return -ETIMEDOUT;
+  }
+  return request.result_;
+}
+
+void SockIoScheduler::CancelIo(int target_fd) {
+  if (io_uring_ == nullptr) {
+    return;
+  }
+  io_uring_sqe sqe{};
+  IoUring::PrepareRw(&sqe, IORING_OP_ASYNC_CANCEL, target_fd, nullptr, 0, 0);
+  sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe.user_data = 0;
+  io_uring_->Submit(&sqe, 1);
+}
+
+void SockIoScheduler::SubmitFileIoAndWait(FileIoRequest *request) {
+  WaitForWake([request](std::function<void()> wake) {
+    request->on_complete_ = std::move(wake);
+    FileIoPoolMgr::GetInstance()->Submit(request);
+  });
+}
+
+void SockIoScheduler::WaitForWake(const std::function<void(std::function<void()> wake)> &register_wake) {
+  Coroutine::s_ptr curr_coroutine = Coroutine::GetThreadRunningCoroutine();
+  // 每线程一个reactor模式下，协程回到发起等待的线程继续执行
+  int thread_id = reactors_.empty() ? -1 : GetCurrSysThreadId();
+  ++pending_event_count_;
+  register_wake([this, curr_coroutine, thread_id] {
+    Schedule(curr_coroutine, thread_id);
+    // 先调度协程再减少计数，调度器不会在两者之间被判定为可以停止；
+    // 协程可能在计数减少之前就已经执行完，此时空闲线程看到的计数不为0，需要唤醒一个重新检查
+    if (--pending_event_count_ == 0) {
+      Tickle();
+    }
+  });
+  curr_coroutine->Yield();
+}
+
+void SockIoScheduler::ReapIoCompletions(std::vector<ScheduleTask> *batch) {
+  const uint32_t max_cqes = 64;
+  io_uring_cqe cqes[max_cqes];
+  while (true) {
+    uint32_t count = io_uring_->PeekCompletions(cqes, max_cqes);
+    for (uint32_t i = 0; i < count; i++) {
+      // user_data为0的是CancelIo提交的取消请求，没有协程在等待它
+      if (cqes[i].user_data == 0) {
+        continue;
+      }
+      auto *request = reinterpret_cast<IoUringRequest *>(cqes[i].user_data & ~LINK_TIMEOUT_TAG);
+      if ((cqes[i].user_data & LINK_TIMEOUT_TAG) != 0) {
+        request->timeout_result_ = cqes[i].res;
+      } else {
+        request->result_ = cqes[i].res;
+      }
+      // 同一个请求的两个cqe可能被不同的线程收割，只有收到最后一个cqe的线程负责唤醒协程
+      // 请求保存在协程栈上，唤醒之后不能再访问request
+      if (request->pending_cqe_count_.fetch_sub(1) == 1) {
+        --pending_event_count_;
+        batch->emplace_back(std::move(request->coroutine_), request->thread_id_);
+      }
+    }
+    if (count < max_cqes) {
+      break;
+    }
+  }
+}
+
 }  // namespace wtsclwq
\ No newline at end of file
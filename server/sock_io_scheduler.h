@@ -1,11 +1,11 @@
 #ifndef _SOCK_IO_SCHEDULER_H_
 #define _SOCK_IO_SCHEDULER_H_
 
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <shared_mutex>
 #include <vector>
 #include "coroutine.h"
 #include "fd_context.h"
@@ -13,19 +13,45 @@
 #include "scheduler.h"
 #include "timer.h"
 
+struct io_uring_sqe;
+struct epoll_event;
+
 namespace wtsclwq {
+class IoUring;
+struct FileIoRequest;
+
 class SockIoScheduler : public Scheduler {
  public:
   using s_ptr = std::shared_ptr<SockIoScheduler>;
-  using MutexType = std::shared_mutex;
+
+  /**
+   * @brief IO后端类型
+   */
+  enum class IoBackend {
+    Default,  // 由配置sock_io_scheduler.io_backend决定
+    Epoll,    // epoll只通知fd就绪，就绪之后由调用者重新发起系统调用
+    IoUring,  // 把IO操作本身提交给io_uring，完成之后带着结果唤醒等待的协程
+  };
+
+  /**
+   * @brief reactor模式
+   */
+  enum class ReactorMode {
+    Default,    // 由配置sock_io_scheduler.reactor_mode决定
+    Shared,     // 所有调度线程共享一个epoll，同一时间由一个空闲线程轮询，事件的回调可以在任意线程执行
+    PerThread,  // 每个调度线程拥有自己的epoll和定时器，fd分配给一个线程之后，它的事件始终由该线程处理
+  };
 
   /**
    * @brief 构造函数
    * @param thread_num 线程数量
    * @param use_creator 是否使用调用构造函数的创建者线程参与调度
    * @param name  调度器名称
+   * @param backend IO后端，内核不支持io_uring时退化为epoll
+   * @param reactor_mode reactor模式
    */
-  explicit SockIoScheduler(size_t thread_num = 1, bool use_creator = true, std::string_view name = "SockIoScheduler");
+  explicit SockIoScheduler(size_t thread_num = 1, bool use_creator = true, std::string_view name = "SockIoScheduler",
+                           IoBackend backend = IoBackend::Default, ReactorMode reactor_mode = ReactorMode::Default);
 
   /**
    * @brief 析构函数，这里要override
@@ -39,6 +65,8 @@ class SockIoScheduler : public Scheduler {
 
   /**
    * @brief 向调度器添加一个fd上的某一个事件的监听任务
+   * @details fd第一次被监听时以EPOLLIN|EPOLLOUT|EPOLLET注册到epoll，直到关闭都不再修改；
+   * 如果该事件在上一次等待之后已经就绪过，回调会被立即调度
    * @param target_fd 目标fd
    * @param event_type 目标事件类型
    * @param cb_func 事件回调函数，如果为空则默认将注册时线程的上下文封装成协程，表示事件发生时继续执行注册时的逻辑
@@ -47,13 +75,28 @@ class SockIoScheduler : public Scheduler {
   auto AddEventListening(int target_fd, FileDescContext::EventType target_event_type,
                          std::function<void()> cb_func = nullptr) -> bool;
 
+  /**
+   * @brief 与AddEventListening相同，但该事件已经有其他任务在等待时不注册，返回false
+   * @param owner 注册者的标识，撤销时传给RemoveEventListening，避免撤销掉其他任务之后的注册
+   */
+  auto TryAddEventListening(int target_fd, FileDescContext::EventType target_event_type, std::function<void()> cb_func,
+                            const void *owner) -> bool;
+
+  /**
+   * @brief 如果fd上的某一个事件在上一次等待之后已经就绪过，消费掉这个就绪标志
+   * @return 是否已经就绪，返回true时调用者应该直接重试IO而不是等待
+   */
+  auto ConsumeReadyEvent(int target_fd, FileDescContext::EventType target_event_type) -> bool;
+
   /**
    * @brief 从调度器中移除一个fd上的某一个事件的监听任务
    * @param target_fd 目标fd
    * @param target_event_type 目标事件类型
+   * @param owner 不为nullptr时，只移除由它注册的监听任务
    * @return bool 是否移除成功
    */
-  auto RemoveEventListening(int target_fd, FileDescContext::EventType target_event_type) -> bool;
+  auto RemoveEventListening(int target_fd, FileDescContext::EventType target_event_type,
+                            const void *owner = nullptr) -> bool;
 
   /**
    * @brief 移除并触发一个fd上的某一个事件的监听任务
@@ -70,16 +113,41 @@ class SockIoScheduler : public Scheduler {
    */
   auto RemoveAndTriggerAllTypeEventListening(int target_fd) -> bool;
 
+  /**
+   * @brief fd即将被关闭：将它从epoll中移除，清空就绪标志，并触发它上面所有的监听任务
+   * @details 必须在close之前调用，关闭之后fd的编号可能立即被复用
+   */
+  void CloseEventListening(int target_fd);
+
+  /**
+   * @brief 是否为每线程一个reactor的模式
+   */
+  auto IsReactorPerThread() const -> bool { return !reactors_.empty(); }
+
+  /**
+   * @brief 把fd分配给一个调度线程，之后该fd上的事件都由这个线程等待和处理，直到CloseEventListening
+   * @details 按照配置sock_io_scheduler.reactor_balance轮流分配或者分配给fd最少的线程；已经分配过的fd返回原来的线程。
+   * 没有预先分配的fd在第一次被监听时分配，监听它的如果是本调度器的调度线程，就分配给该线程
+   * @return 调度线程的下标，共享epoll的模式下返回-1
+   */
+  auto AssignFdToWorker(int target_fd) -> int;
+
   /**
    * @brief 获取当前线程中的IO调度器指针
    */
   static auto GetThreadSockIoScheduler() -> s_ptr;
 
   /**
-   * @brief 唤醒线程池中的空闲线程
+   * @brief 唤醒一个空闲线程：优先唤醒阻塞最久的Parked线程，没有时唤醒正在等待IO事件的轮询线程
+   * @details 已经被通知但还没有醒来的线程不会被重复通知，多次Tickle会依次唤醒不同的线程
    */
   void Tickle() override;
 
+  /**
+   * @brief 只唤醒指定的调度线程，线程正在运行时只记录通知，不产生系统调用
+   */
+  void TickleWorker(size_t worker_index) override;
+
   /**
    * @brief 判断当前调度器的状态是否可以停止
    */
@@ -97,24 +165,177 @@ class SockIoScheduler : public Scheduler {
    */
   auto IsStopableWithTime(uint64_t *timeout) -> bool;
 
-  /**
-   * @brief 扩容fd容器
-   * @details 调度器管理的fd越来越多，自然需要扩容
-   */
-  void ContextVecResize(size_t size);
-
   auto AddTimer(uint64_t interval_time, std::function<void()> func, bool recurring = false) -> Timer::s_ptr;
 
   auto AddConditionTimer(uint64_t interval_time, const std::function<void()> &func, const std::function<bool()> &cond,
                          bool recurring = false) -> Timer::s_ptr;
 
+  /**
+   * @brief 添加一个侵入式超时节点，不分配内存，由当前线程对应的定时器管理器负责
+   */
+  void AddTimeout(TimeoutNode *node, uint64_t interval_time);
+
+  /**
+   * @brief 取消侵入式超时节点，返回之后节点可以被释放
+   * @return 是否在触发之前取消
+   */
+  auto CancelTimeout(TimeoutNode *node) -> bool;
+
+  /**
+   * @brief 是否使用io_uring后端
+   */
+  auto IsIoUringEnabled() const -> bool { return io_uring_ != nullptr; }
+
+  /**
+   * @brief 把一个IO操作提交给io_uring，挂起当前协程直到操作完成
+   * @details 只能在io_uring后端下、非共享栈的协程中调用，因为内核会在协程挂起期间直接读写它栈上的数据
+   * @param sqe 已经填好操作码、fd和缓冲区的sqe，user_data和flags由调度器设置
+   * @param timeout_ms 超时时间，UINT64_MAX表示不超时
+   * @return 与系统调用返回值相同，失败时为-errno，超时为-ETIMEDOUT；没有提交成功时返回-EAGAIN
+   */
+  auto SubmitIoAndWait(io_uring_sqe *sqe, uint64_t timeout_ms) -> int32_t;
+
+  /**
+   * @brief 取消fd上所有提交给io_uring且尚未完成的IO操作，被取消的操作返回-ECANCELED
+   * @details 必须在close之前调用，io_uring按照fd对应的文件来查找操作
+   */
+  void CancelIo(int target_fd);
+
+  /**
+   * @brief 把一个阻塞的文件操作交给文件IO线程池，挂起当前协程直到操作完成
+   * @details 只能在非共享栈的协程中调用，因为线程池会在协程挂起期间直接读写它栈上的数据；
+   * 等待期间调度器不会被判定为可以停止
+   */
+  void SubmitFileIoAndWait(FileIoRequest *request);
+
+  /**
+   * @brief 挂起当前协程，直到唤醒回调被调用
+   * @details register_wake在挂起之前调用，负责把唤醒回调交给会在之后调用它的一方；
+   * 唤醒回调只能调用一次，可以在任意线程中调用，等待期间调度器不会被判定为可以停止
+   */
+  void WaitForWake(const std::function<void(std::function<void()> wake)> &register_wake);
+
  private:
+  /**
+   * @brief 每个调度线程的空闲等待状态
+   * @details 同一时间最多只有一个空闲线程（轮询线程）阻塞在epoll_wait中等待IO事件和定时器，
+   * 其余空闲线程（Parked）阻塞在各自的eventfd上，只有被精确通知时才会醒来
+   */
+  struct IdleWaiter {
+    enum class State {
+      Running,  // 正在执行任务，或者在Idle中处理事件
+      Parked,   // 阻塞在自己的event_fd_上，每线程一个reactor模式下阻塞在自己的epoll中
+      Polling,  // 作为轮询线程阻塞在epoll_wait中，通过poller_event_fd_唤醒
+    };
+    int event_fd_{-1};                          // 线程私有的eventfd，每线程一个reactor模式下注册在自己的epoll中
+    std::atomic<State> state_{State::Running};  // 线程当前的状态
+    std::atomic<bool> notified_{false};         // 已经被通知但还没有醒来，用于合并重复的通知
+    std::atomic<uint64_t> park_seq_{0};         // 进入Parked状态的序号，越小表示等待得越久
+  };
+
+  /**
+   * @brief 收割io_uring完成队列，把IO已经完成的协程放入batch
+   */
+  void ReapIoCompletions(std::vector<ScheduleTask> *batch);
+
+  /**
+   * @brief 获取fd的上下文并加锁，fd不是由本调度器监听时返回nullptr
+   */
+  auto LockFdContext(int target_fd, std::unique_lock<FileDescContext::MutexType> *lock) -> FileDescContext *;
+
+  /**
+   * @brief 获取fd的上下文并加锁，fd上一次由其他调度器监听时，丢弃那个调度器留下的注册、就绪标志和线程分配
+   * @return fd超出fd表的范围时返回nullptr
+   */
+  auto AdoptFdContext(int target_fd, std::unique_lock<FileDescContext::MutexType> *lock) -> FileDescContext *;
+
+  /**
+   * @brief AddEventListening和TryAddEventListening的公共实现
+   * @param fail_if_registered 该事件已经被注册时返回false，否则断言失败
+   */
+  auto AddEventListeningImpl(int target_fd, FileDescContext::EventType target_event_type, std::function<void()> cb_func,
+                             const void *owner, bool fail_if_registered) -> bool;
+
+  /**
+   * @brief 为还没有分配的fd选择调度线程，调用者需要持有fd_ctx的锁
+   */
+  auto AssignOwner(FileDescContext *fd_ctx) -> int;
+
+  /**
+   * @brief fd注册在哪个epoll中，调用者需要持有fd_ctx的锁
+   */
+  auto GetEpollFd(const FileDescContext *fd_ctx) const -> int;
+
+  /**
+   * @brief 当前线程添加定时器时使用的定时器管理器
+   * @param[out] worker_index 定时器由哪个调度线程处理，共享epoll的模式下为-1
+   */
+  auto GetTimerManager(int *worker_index) -> TimerManager *;
+
+  /**
+   * @brief 新添加的定时器成为最早触发的定时器时，唤醒负责它的线程重新计算epoll_wait的超时时间
+   */
+  void TickleTimer(TimerManager *timer_manager, int worker_index);
+
+  /**
+   * @brief 共享epoll模式下的空闲等待：竞争成为轮询线程，失败时Park
+   * @return 就绪事件的数量，Park之后没有轮询时返回-1
+   */
+  auto WaitShared(IdleWaiter *waiter, int worker_index, epoll_event *events, int max_events) -> int;
+
+  /**
+   * @brief 每线程一个reactor模式下的空闲等待：阻塞在自己的epoll中，自己的eventfd也注册在其中
+   * @return 就绪事件的数量
+   */
+  auto WaitReactor(IdleWaiter *waiter, int worker_index, epoll_event *events, int max_events) -> int;
+
+  /**
+   * @brief 触发fd上所有已注册的监听任务，调用者需要持有fd_ctx的锁
+   */
+  void TriggerAllEvents(FileDescContext *fd_ctx);
+
+  /**
+   * @brief 通知一个调度线程，根据它的状态写对应的eventfd
+   * @return 线程之前已经被通知过时返回false
+   */
+  auto NotifyWorker(size_t worker_index) -> bool;
+
+  /**
+   * @brief 通知阻塞最久并且还没有被通知的Parked线程
+   * @return 没有可以通知的Parked线程时返回false
+   */
+  auto NotifyLongestParked() -> bool;
+
+  /**
+   * @brief 通知轮询线程，使其重新计算epoll_wait的超时时间，没有轮询线程时什么也不做
+   */
+  void TicklePoller();
+
+  /**
+   * @brief 阻塞在当前线程的eventfd上，直到被通知
+   */
+  void Park(IdleWaiter *waiter);
+
+  /**
+   * @brief 每线程一个reactor模式下，一个调度线程私有的epoll和定时器
+   */
+  struct Reactor {
+    int epoll_fd_{-1};                            // 分配给该线程的fd注册在这里
+    TimerManager::s_ptr timer_manager_{nullptr};  // 该线程添加的定时器
+    std::atomic<size_t> fd_count_{0};             // 分配给该线程的fd数量
+  };
+
+  uint32_t id_{0};  // 调度器的编号，fd的上下文在进程内共享，用它区分是哪个调度器在监听
   int epoll_fd_{0};
-  int tickle_pipe_fds_[2]{};
+  std::vector<std::unique_ptr<IdleWaiter>> waiters_{};  // 每个调度线程的空闲等待状态，下标与调度线程下标相同
+  int poller_event_fd_{-1};                             // 唤醒轮询线程的eventfd，注册在epoll中
+  std::atomic<int> poller_index_{-1};                   // 轮询线程的下标，-1表示没有轮询线程
+  std::atomic<uint64_t> park_seq_{0};                   // Parked序号生成器
   TimerManager::s_ptr timer_manager_{nullptr};
   std::atomic<size_t> pending_event_count_{0};
-  std::vector<FileDescContext::s_ptr> fd_contexts_{};
-  std::shared_mutex mutex_{};
+  std::unique_ptr<IoUring> io_uring_{nullptr};  // io_uring后端，为空表示使用epoll后端
+  std::vector<std::unique_ptr<Reactor>> reactors_{};  // 每个调度线程的reactor，为空表示所有线程共享epoll_fd_
+  std::atomic<size_t> next_reactor_{0};               // 轮流分配时下一个调度线程的下标
 };
 }  // namespace wtsclwq
 
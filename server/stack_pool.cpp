@@ -0,0 +1,127 @@
+#include "stack_pool.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include "config.h"
+#include "log.h"
+
+namespace wtsclwq {
+static auto sys_logger = NAMED_LOGGER("system");
+
+// 栈池中最多缓存的栈数量，超出之后归还的栈直接munmap
+static auto stack_pool_max_cached = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "coroutine.stack_pool.max_cached", 10000, "max count of cached coroutine stacks");
+
+// 栈归还到池中时保留常驻的字节数（从栈顶算起），其余部分通过madvise(MADV_DONTNEED)释放，<0表示不释放
+static auto stack_pool_resident_watermark = ConfigMgr::GetInstance() -> GetOrAddDefaultConfigItem(
+    "coroutine.stack_pool.resident_watermark", 16 * 1024, "resident bytes kept for each cached coroutine stack");
+
+auto StackPool::GetInstance() -> StackPool * {
+  static auto *instance = new StackPool();
+  return instance;
+}
+
+auto StackPool::GetPageSize() -> size_t {
+  static const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return page_size;
+}
+
+auto StackPool::RoundUpToPage(size_t size) -> size_t {
+  size_t page_size = GetPageSize();
+  return (size + page_size - 1) / page_size * page_size;
+}
+
+auto StackPool::Alloc(size_t size) -> void * {
+  size = RoundUpToPage(size);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++alloc_count_;
+    auto iter = free_stacks_.find(size);
+    if (iter != free_stacks_.end() && !iter->second.empty()) {
+      void *stack = iter->second.back();
+      iter->second.pop_back();
+      ++hit_count_;
+      --cached_count_;
+      cached_bytes_ -= size;
+      ++in_use_count_;
+      return stack;
+    }
+  }
+
+  // 缓存未命中，映射一块新的栈，最低的一页作为保护页
+  size_t page_size = GetPageSize();
+  void *base = mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (base == MAP_FAILED) {
+    LOG_ERROR(sys_logger) << "mmap coroutine stack failed, size: " << size << ", errno: " << errno
+                          << ", errstr: " << strerror(errno);
+    return nullptr;
+  }
+  if (mprotect(base, page_size, PROT_NONE) != 0) {
+    LOG_ERROR(sys_logger) << "mprotect coroutine stack guard page failed, errno: " << errno
+                          << ", errstr: " << strerror(errno);
+    munmap(base, size + page_size);
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++in_use_count_;
+  return static_cast<char *>(base) + page_size;
+}
+
+void StackPool::Dealloc(void *stack, size_t size) {
+  if (stack == nullptr) {
+    return;
+  }
+  size = RoundUpToPage(size);
+  bool cache = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_use_count_;
+    cache = cached_count_ < static_cast<size_t>(std::max(stack_pool_max_cached->GetValue(), 0));
+    if (cache) {
+      // 先占住缓存名额，避免并发归还时超出上限
+      ++cached_count_;
+    }
+  }
+  if (!cache) {
+    size_t page_size = GetPageSize();
+    munmap(static_cast<char *>(stack) - page_size, size + page_size);
+    return;
+  }
+
+  // 栈从高地址向低地址增长，保留栈顶附近最常用的部分，释放其余部分占用的物理内存
+  int watermark = stack_pool_resident_watermark->GetValue();
+  if (watermark >= 0) {
+    size_t resident = RoundUpToPage(static_cast<size_t>(watermark));
+    if (resident < size) {
+      madvise(stack, size - resident, MADV_DONTNEED);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_stacks_[size].emplace_back(stack);
+  cached_bytes_ += size;
+}
+
+auto StackPool::GetStats() -> Stats {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats;
+  stats.cached_count = cached_count_;
+  stats.cached_bytes = cached_bytes_;
+  stats.in_use_count = in_use_count_;
+  stats.alloc_count = alloc_count_;
+  stats.hit_count = hit_count_;
+  return stats;
+}
+
+auto StackPool::ToString() -> std::string {
+  Stats stats = GetStats();
+  std::stringstream ss;
+  ss << "StackPool[cached: " << stats.cached_count << ", cached_bytes: " << stats.cached_bytes
+     << ", in_use: " << stats.in_use_count << ", alloc: " << stats.alloc_count << ", hit: " << stats.hit_count
+     << ", hit_rate: " << stats.HitRate() << "]";
+  return ss.str();
+}
+}  // namespace wtsclwq
@@ -0,0 +1,86 @@
+#ifndef _WTSCLWQ_STACK_POOL_
+#define _WTSCLWQ_STACK_POOL_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "noncopyable.h"
+
+namespace wtsclwq {
+/**
+ * @brief 协程栈池，所有协程栈都通过mmap分配并在释放后缓存起来复用
+ * @details 每个栈的低地址端有一个PROT_NONE的保护页，栈溢出会立即触发SIGSEGV而不是悄悄破坏堆；
+ * 映射时使用MAP_NORESERVE，只有真正被访问到的页才占用物理内存。
+ * 栈归还到池中时，距栈顶超过resident_watermark的部分会被madvise(MADV_DONTNEED)释放，
+ * 因此缓存中的栈只占用少量常驻内存
+ */
+class StackPool : public Noncopyable {
+ public:
+  /**
+   * @brief 栈池的统计信息
+   */
+  struct Stats {
+    size_t cached_count{0};   // 池中缓存的栈数量
+    size_t cached_bytes{0};   // 池中缓存的栈占用的虚拟地址空间（不含保护页）
+    size_t in_use_count{0};   // 正在被协程使用的栈数量
+    uint64_t alloc_count{0};  // 累计分配次数
+    uint64_t hit_count{0};    // 累计命中缓存的次数
+    auto HitRate() const -> double {
+      return alloc_count == 0 ? 0.0 : static_cast<double>(hit_count) / static_cast<double>(alloc_count);
+    }
+  };
+
+  /**
+   * @brief 获取全局的栈池
+   * @details 栈池永远不会被析构，保证在静态对象析构阶段释放的协程也能安全归还栈
+   */
+  static auto GetInstance() -> StackPool *;
+
+  /**
+   * @brief 分配一个可用大小至少为size的栈
+   * @return 栈的低地址（保护页之上），失败返回nullptr
+   */
+  auto Alloc(size_t size) -> void *;
+
+  /**
+   * @brief 归还一个栈，size必须与Alloc时相同
+   */
+  void Dealloc(void *stack, size_t size);
+
+  /**
+   * @brief 获取统计信息
+   */
+  auto GetStats() -> Stats;
+
+  /**
+   * @brief 将统计信息格式化为字符串，便于日志输出
+   */
+  auto ToString() -> std::string;
+
+  /**
+   * @brief 获取保护页（系统页）的大小
+   */
+  static auto GetPageSize() -> size_t;
+
+ private:
+  StackPool() = default;
+
+  /**
+   * @brief 将size向上对齐到页大小
+   */
+  static auto RoundUpToPage(size_t size) -> size_t;
+
+  std::unordered_map<size_t, std::vector<void *>> free_stacks_{};  // 按栈大小分类的空闲栈
+  size_t cached_count_{0};                                         // 池中缓存的栈数量
+  size_t cached_bytes_{0};                                         // 池中缓存的栈占用的地址空间
+  size_t in_use_count_{0};                                         // 正在使用的栈数量
+  uint64_t alloc_count_{0};                                        // 累计分配次数
+  uint64_t hit_count_{0};                                          // 累计命中缓存的次数
+  std::mutex mutex_{};                                             // 保护以上所有成员
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_STACK_POOL_
@@ -0,0 +1,138 @@
+#ifndef _WTSCLWQ_TASK_FUNC_
+#define _WTSCLWQ_TASK_FUNC_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace wtsclwq {
+/**
+ * @brief 只能移动的无参可调用对象，用于替代std::function<void()>
+ * @details 捕获列表不超过INLINE_SIZE字节的可调用对象直接存放在对象内部，不需要分配堆内存，
+ * 超出的部分才退化为堆上分配。由于只能移动，可以保存std::unique_ptr等只能移动的捕获
+ */
+class TaskFunc {
+ public:
+  static constexpr size_t INLINE_SIZE = 48;  // 内联存储的大小，足够放下std::function以及若干个智能指针
+
+  TaskFunc() = default;
+
+  TaskFunc(std::nullptr_t) {}  // NOLINT 允许隐式转换，便于和std::function一样使用nullptr赋值
+
+  template <typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, TaskFunc> &&
+                                                       std::is_invocable_v<std::decay_t<Func> &>>>
+  TaskFunc(Func &&func) {  // NOLINT 允许隐式转换，便于直接传入lambda
+    using Fn = std::decay_t<Func>;
+    if (IsNullCallable(func)) {
+      return;
+    }
+    if constexpr (IsInlineable<Fn>()) {
+      new (storage_) Fn(std::forward<Func>(func));
+      ops_ = &inline_ops<Fn>;
+    } else {
+      *reinterpret_cast<Fn **>(storage_) = new Fn(std::forward<Func>(func));
+      ops_ = &heap_ops<Fn>;
+    }
+  }
+
+  TaskFunc(TaskFunc &&other) noexcept { MoveFrom(other); }
+
+  auto operator=(TaskFunc &&other) noexcept -> TaskFunc & {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  auto operator=(std::nullptr_t) -> TaskFunc & {
+    Reset();
+    return *this;
+  }
+
+  TaskFunc(const TaskFunc &) = delete;
+
+  auto operator=(const TaskFunc &) -> TaskFunc & = delete;
+
+  ~TaskFunc() { Reset(); }
+
+  void operator()() { ops_->invoke(storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  friend auto operator==(const TaskFunc &func, std::nullptr_t) -> bool { return func.ops_ == nullptr; }
+
+  friend auto operator!=(const TaskFunc &func, std::nullptr_t) -> bool { return func.ops_ != nullptr; }
+
+  /**
+   * @brief 销毁保存的可调用对象，之后this为空
+   */
+  void Reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+ private:
+  /**
+   * @brief 类型擦除之后的操作表，每种可调用对象类型对应一个静态实例
+   */
+  struct Ops {
+    void (*invoke)(void *storage);
+    void (*move)(void *dst, void *src);  // 将src中的对象移动到dst中，并销毁src中的对象
+    void (*destroy)(void *storage);
+  };
+
+  template <typename Fn>
+  static constexpr auto IsInlineable() -> bool {
+    return sizeof(Fn) <= INLINE_SIZE && alignof(std::max_align_t) % alignof(Fn) == 0 &&
+           std::is_nothrow_move_constructible_v<Fn>;
+  }
+
+  /**
+   * @brief 空的函数指针和空的std::function不保存，使得构造之后的TaskFunc同样为空
+   */
+  template <typename Fn>
+  static auto IsNullCallable(const Fn &func) -> bool {
+    if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn> ||
+                  std::is_same_v<Fn, std::function<void()>>) {
+      return func == nullptr;
+    } else {
+      return false;
+    }
+  }
+
+  template <typename Fn>
+  static constexpr Ops inline_ops = {
+      [](void *storage) { std::invoke(*static_cast<Fn *>(storage)); },
+      [](void *dst, void *src) {
+        new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+        static_cast<Fn *>(src)->~Fn();
+      },
+      [](void *storage) { static_cast<Fn *>(storage)->~Fn(); },
+  };
+
+  template <typename Fn>
+  static constexpr Ops heap_ops = {
+      [](void *storage) { std::invoke(**static_cast<Fn **>(storage)); },
+      [](void *dst, void *src) { *static_cast<Fn **>(dst) = *static_cast<Fn **>(src); },
+      [](void *storage) { delete *static_cast<Fn **>(storage); },
+  };
+
+  void MoveFrom(TaskFunc &other) {
+    if (other.ops_ != nullptr) {
+      other.ops_->move(storage_, other.storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE]{};  // 可调用对象的存储空间，或者指向堆上对象的指针
+  const Ops *ops_{nullptr};                                        // 为空表示没有保存可调用对象
+};
+}  // namespace wtsclwq
+
+#endif  // _WTSCLWQ_TASK_FUNC_
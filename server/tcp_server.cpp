@@ -91,7 +91,14 @@ auto TcpServer::OneServerSocketStartAccept(const SocketWrap::s_ptr &server_socke
                          << server_socket->GetLocalAddress()->ToString()
                          << ", client addr: " << client_socket->GetRemoteAddress()->ToString();
     client_socket->SetReadTimeout(read_timeout_);
-    io_scheduler_->Schedule(std::function<void()>([this, client_socket]() { HandleAccept(client_socket); }));
+    std::function<void()> handle_func([this, client_socket]() { HandleAccept(client_socket); });
+    // 每线程一个reactor模式下，连接在整个生命周期中都由分配到的调度线程处理
+    int worker_index = io_scheduler_->AssignFdToWorker(client_socket->GetSocket());
+    if (worker_index >= 0) {
+      io_scheduler_->ScheduleOnWorker(std::move(handle_func), worker_index);
+    } else {
+      io_scheduler_->Schedule(std::move(handle_func));
+    }
   }
 }
 
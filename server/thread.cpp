@@ -54,7 +54,7 @@ auto Thread::RealProcess(void *args) -> void * {
 
   // 设置this的成员变量
   thread->id_ = wtsclwq::GetCurrSysThreadId();
-  pthread_setname_np(pthread_self(), thread->name_.c_str());
+  SetCurrSysThreadName(thread->name_);
 
   // 将this->task_保存到局部变量中，然后清空this->task_，避免在执行task_时，由于this被析构，导致task_被析构，进而导致任务执行异常
   std::function<void()> task; // 用于保存this->task_
@@ -1,11 +1,11 @@
 #include "timer.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <regex>
-#include <shared_mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "macro.h"
@@ -13,13 +13,9 @@
 
 namespace wtsclwq {
 Timer::Timer(uint64_t interval_time, bool recurring, std::function<void()> func, std::weak_ptr<TimerManager> manager)
-    : interval_time_(interval_time),
-      next_time_(GetElapsedTime() + interval_time),
-      recurring_(recurring),
-      func_(std::move(func)),
-      manager_(std::move(manager)) {}
-
-Timer::Timer(uint64_t next_time) : next_time_(next_time) {}
+    : interval_time_(interval_time), recurring_(recurring), func_(std::move(func)), manager_(std::move(manager)) {
+  next_time_ = GetElapsedTime() + interval_time;
+}
 
 auto Timer::Cancel() -> bool {
   auto manager_ptr = manager_.lock();
@@ -27,9 +23,10 @@ auto Timer::Cancel() -> bool {
   std::lock_guard<TimerManager::MutexType> lock(manager_ptr->mutex_);
   if (func_ != nullptr) {
     func_ = nullptr;
-    auto it = manager_ptr->timer_quque_.find(shared_from_this());
-    if (it != manager_ptr->timer_quque_.end()) {
-      manager_ptr->timer_quque_.erase(it);
+    if (level_ >= 0) {
+      manager_ptr->RemoveFromWheel(this);
+      // 释放时间轮持有的自身引用，延迟到函数返回时析构，避免this在函数中途失效
+      auto self = std::move(self_);
       return true;
     }
   }
@@ -40,16 +37,13 @@ auto Timer::Refresh() -> bool {
   auto manager_ptr = manager_.lock();
   ASSERT(manager_ptr != nullptr);
   std::lock_guard<TimerManager::MutexType> lock(manager_ptr->mutex_);
-  if (func_ == nullptr) {
-    return false;
-  }
-  auto it = manager_ptr->timer_quque_.find(shared_from_this());
-  if (it == manager_ptr->timer_quque_.end()) {
+  if (func_ == nullptr || level_ < 0) {
     return false;
   }
-  manager_ptr->timer_quque_.erase(it);
+  manager_ptr->RemoveFromWheel(this);
+  manager_ptr->RebaseIfEmpty();
   next_time_ = GetElapsedTime() + interval_time_;
-  manager_ptr->timer_quque_.insert(shared_from_this());
+  manager_ptr->AddToWheel(this);
   return true;
 }
 
@@ -66,14 +60,13 @@ auto Timer::Reset(uint64_t new_interval_time, bool from_now) -> bool {
     return false;
   }
 
-  // 如果查找不到，说明已经被其他线程触发或者取消
-  auto it = manager_ptr->timer_quque_.find(shared_from_this());
-  if (it == manager_ptr->timer_quque_.end()) {
+  // 如果不在时间轮中，说明已经被其他线程触发或者取消
+  if (level_ < 0) {
     return false;
   }
 
-  // 从定时器队列中删除
-  manager_ptr->timer_quque_.erase(it);
+  // 从时间轮中删除
+  manager_ptr->RemoveFromWheel(this);
 
   // 重新设置定时器的间隔时间以及下次执行时间
   uint64_t start_time = 0;
@@ -85,44 +78,133 @@ auto Timer::Reset(uint64_t new_interval_time, bool from_now) -> bool {
   interval_time_ = new_interval_time;
   next_time_ = start_time + new_interval_time;
 
-  // 重新插入定时器队列
-  auto ret_it = manager_ptr->timer_quque_.insert(shared_from_this()).first;
-  manager_ptr->has_new_front_timer_ = (ret_it == manager_ptr->timer_quque_.begin());
+  // 重新放入时间轮
+  manager_ptr->RebaseIfEmpty();
+  manager_ptr->AddToWheel(this);
+  manager_ptr->UpdateEarliestTime(next_time_);
   return true;
 }
 
 TimerManager::TimerManager() {
-  // 初始化定时器队列
-  std::function<bool(Timer::s_ptr, Timer::s_ptr)> cmp = [](const Timer::s_ptr &lhs, const Timer::s_ptr &rhs) -> bool {
-    if (lhs == nullptr && rhs == nullptr) {
-      return false;
-    }
-    if (lhs == nullptr) {
-      return true;
-    }
-    if (rhs == nullptr) {
-      return false;
+  // 每个槽位都是一个空的循环链表
+  for (auto &slot : root_wheel_) {
+    slot.prev_ = &slot;
+    slot.next_ = &slot;
+  }
+  for (auto &wheel : wheels_) {
+    for (auto &slot : wheel) {
+      slot.prev_ = &slot;
+      slot.next_ = &slot;
     }
-    if (lhs->next_time_ < rhs->next_time_) {
-      return true;
+  }
+  next_tick_ = GetElapsedTime();
+}
+
+TimerManager::~TimerManager() {
+  // 释放时间轮中定时器对自身的引用，打破循环引用
+  for (int level = 0; level < WHEEL_LEVEL_COUNT; level++) {
+    uint64_t size = level == 0 ? ROOT_WHEEL_SIZE : WHEEL_SIZE;
+    for (uint64_t index = 0; index < size; index++) {
+      TimerNode *slot = GetSlot(level, index);
+      while (slot->next_ != slot) {
+        TimerNode *node = slot->next_;
+        RemoveFromWheel(node);
+        if (!node->intrusive_) {
+          static_cast<Timer *>(node)->self_.reset();
+        }
+      }
     }
-    if (lhs->next_time_ > rhs->next_time_) {
-      return false;
+  }
+}
+
+auto TimerManager::GetSlot(int level, uint64_t index) -> TimerNode * {
+  if (level == 0) {
+    return &root_wheel_[index];
+  }
+  return &wheels_[level - 1][index];
+}
+
+void TimerManager::AddToWheel(TimerNode *timer) {
+  // 已经过期的定时器放在下一个要处理的时刻，下一次处理时立即触发
+  uint64_t expire = std::max(timer->next_time_, next_tick_);
+  uint64_t delta = expire - next_tick_;
+  // 超出时间轮范围的定时器先放在最高层的最远处，下降时会根据真实的触发时间重新放置
+  if (delta > MAX_WHEEL_SPAN) {
+    delta = MAX_WHEEL_SPAN;
+    expire = next_tick_ + delta;
+  }
+  int level = 0;
+  uint64_t index = 0;
+  if (delta < ROOT_WHEEL_SIZE) {
+    index = expire & (ROOT_WHEEL_SIZE - 1);
+  } else {
+    level = 1;
+    while (level < WHEEL_LEVEL_COUNT - 1 && delta >= (1ULL << (ROOT_WHEEL_BITS + level * WHEEL_BITS))) {
+      ++level;
     }
-    return lhs.get() < rhs.get();
-  };
-  timer_quque_ = std::set<Timer::s_ptr, decltype(cmp)>(cmp);
-  previouse_trigger_time_ = GetElapsedTime();
+    index = (expire >> (ROOT_WHEEL_BITS + (level - 1) * WHEEL_BITS)) & (WHEEL_SIZE - 1);
+  }
+
+  // 插入到槽位链表的尾部
+  TimerNode *slot = GetSlot(level, index);
+  timer->prev_ = slot->prev_;
+  timer->next_ = slot;
+  slot->prev_->next_ = timer;
+  slot->prev_ = timer;
+  timer->level_ = level;
+  ++level_timer_count_[level];
+  ++timer_count_;
+}
+
+void TimerManager::RemoveFromWheel(TimerNode *timer) {
+  timer->prev_->next_ = timer->next_;
+  timer->next_->prev_ = timer->prev_;
+  timer->prev_ = nullptr;
+  timer->next_ = nullptr;
+  --level_timer_count_[timer->level_];
+  --timer_count_;
+  timer->level_ = -1;
+}
+
+void TimerManager::RebaseIfEmpty() {
+  if (timer_count_ == 0) {
+    next_tick_ = std::max(next_tick_, static_cast<uint64_t>(GetElapsedTime()));
+  }
 }
 
-TimerManager::~TimerManager() = default;
+auto TimerManager::NextCascadeTime() const -> uint64_t {
+  int level = 1;
+  while (level < WHEEL_LEVEL_COUNT - 1 && level_timer_count_[level] == 0) {
+    ++level;
+  }
+  uint64_t mask = (1ULL << (ROOT_WHEEL_BITS + (level - 1) * WHEEL_BITS)) - 1;
+  return (next_tick_ + mask) & ~mask;
+}
+
+auto TimerManager::Cascade(int level, uint64_t index) -> uint64_t {
+  TimerNode *slot = GetSlot(level, index);
+  while (slot->next_ != slot) {
+    TimerNode *node = slot->next_;
+    RemoveFromWheel(node);
+    AddToWheel(node);
+  }
+  return index;
+}
+
+void TimerManager::UpdateEarliestTime(uint64_t next_time) {
+  if (next_time < earliest_time_) {
+    earliest_time_ = next_time;
+    has_new_front_timer_ = true;
+  }
+}
 
 auto TimerManager::AddTimer(uint64_t interval_time, std::function<void()> func, bool recurring) -> Timer::s_ptr {
-  std::lock_guard<MutexType> lock(mutex_);
   Timer::s_ptr new_timer(new Timer(interval_time, recurring, std::move(func), shared_from_this()));
-  auto ret_it = timer_quque_.insert(new_timer).first;
-
-  has_new_front_timer_ = (ret_it == timer_quque_.begin());
+  std::lock_guard<MutexType> lock(mutex_);
+  new_timer->self_ = new_timer;
+  RebaseIfEmpty();
+  AddToWheel(new_timer.get());
+  UpdateEarliestTime(new_timer->next_time_);
   return new_timer;
 }
 
@@ -139,81 +221,146 @@ auto TimerManager::AddConditionTimer(uint64_t interval_time, const std::function
       interval_time, [cond, func] { return ConditionTimerFuncWrap(cond, func); }, recurring);
 }
 
+void TimerManager::AddTimeout(TimeoutNode *node, uint64_t interval_time) {
+  ASSERT(node->level_ < 0);
+  node->manager_ = this;
+  node->fired_.store(false, std::memory_order_relaxed);
+  node->next_time_ = GetElapsedTime() + interval_time;
+  std::lock_guard<MutexType> lock(mutex_);
+  RebaseIfEmpty();
+  AddToWheel(node);
+  UpdateEarliestTime(node->next_time_);
+}
+
+auto TimerManager::CancelTimeout(TimeoutNode *node) -> bool {
+  {
+    std::lock_guard<MutexType> lock(mutex_);
+    if (node->level_ >= 0) {
+      RemoveFromWheel(node);
+      return true;
+    }
+  }
+  // 节点已经被取出，回调可能正在其他线程中执行，它返回之前节点不能被释放
+  while (!node->fired_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  return false;
+}
+
 auto TimerManager::GetRecentTriggerTime() -> uint64_t {
-  std::shared_lock<MutexType> lock(mutex_);
+  std::lock_guard<MutexType> lock(mutex_);
+  recently_tickled_ = false;
 
-  if (timer_quque_.empty()) {
+  if (timer_count_ == 0) {
+    earliest_time_ = UINT64_MAX;
     return UINT64_MAX;
   }
 
-  auto recent_timer = *timer_quque_.begin();
+  // 第0层中的定时器的触发时间都在[next_tick_, next_tick_ + 256)之内，找到第一个非空的槽位即可
+  uint64_t recent_time = UINT64_MAX;
+  if (level_timer_count_[0] > 0) {
+    for (uint64_t offset = 0; offset < ROOT_WHEEL_SIZE; offset++) {
+      TimerNode *slot = GetSlot(0, (next_tick_ + offset) & (ROOT_WHEEL_SIZE - 1));
+      if (slot->next_ != slot) {
+        recent_time = next_tick_ + offset;
+        break;
+      }
+    }
+  }
+  // 更高层的定时器不会早于它们下降的时刻触发
+  if (timer_count_ > level_timer_count_[0]) {
+    recent_time = std::min(recent_time, NextCascadeTime());
+  }
+  earliest_time_ = recent_time;
+
   uint64_t curr_time = GetElapsedTime();
   // 如果当前时间已经超过了最近一个定时器的执行时间，那么就返回0，表示需要立即执行
-  if (curr_time >= recent_timer->next_time_) {
+  if (curr_time >= recent_time) {
     return 0;
   }
   // 否则返回一个时间间隔，从而让线程可以休眠一段时间，避免空转
-  return recent_timer->next_time_ - curr_time;
+  return recent_time - curr_time;
 }
 
 auto TimerManager::GetAllTriggeringTimerFuncs() -> std::vector<std::function<void()>> {
-  uint64_t curr_time = GetElapsedTime();
-  std::vector<Timer::s_ptr> expired_timers;
-  {
-    std::shared_lock<MutexType> lock(mutex_);
-    if (timer_quque_.empty()) {
-      return {};
-    }
-  }
+  std::vector<std::function<void()>> res{};
+  GetAllTriggeringTimerFuncs(&res);
+  return res;
+}
 
+void TimerManager::GetAllTriggeringTimerFuncs(std::vector<std::function<void()>> *funcs) {
+  uint64_t curr_time = GetElapsedTime();
   std::lock_guard<MutexType> lock(mutex_);
-  if (timer_quque_.empty()) {
-    return {};
+  if (timer_count_ == 0) {
+    next_tick_ = std::max(next_tick_, curr_time + 1);
+    return;
   }
 
   // bool rollover = DetectSysClockRollover(); 由于使用了CLOCK_MONOTONIC_RAW，应该不会出现时间回退的问题
 
-  // 如果队列头部的触发时间大于当前时间，表明没有定时器需要触发
-  if (auto it = timer_quque_.begin(); (*it)->next_time_ > curr_time) {
-    return {};
-  }
-
-  // 触发时间为当前时间的定时器
-  Timer::s_ptr curr_timer(new Timer(curr_time));
-  // 利用当前时间找到所有需要触发的定时器，但是由于这里查找的是lower_bound，需要继续向后查找，避免错过触发时间相同的定时器
-  auto target_it = timer_quque_.lower_bound(curr_timer);
-  while (target_it != timer_quque_.end() && (*target_it)->next_time_ == curr_time) {
-    ++target_it;
+  std::vector<std::function<void()>> &res = *funcs;
+  std::vector<Timer *> recurring_timers{};
+  while (next_tick_ <= curr_time) {
+    // 第0层为空时，直接跳到下一次需要下降高层定时器的时刻或者当前时间，跳过中间空转的边界
+    if (level_timer_count_[0] == 0) {
+      uint64_t cascade_time = NextCascadeTime();
+      if (cascade_time > next_tick_) {
+        next_tick_ = std::min(curr_time + 1, cascade_time);
+        continue;
+      }
+    }
+    uint64_t index = next_tick_ & (ROOT_WHEEL_SIZE - 1);
+    // 第0层转完一圈，把上一层对应槽位中的定时器下降下来，逐层向上
+    if (index == 0) {
+      for (int level = 1; level < WHEEL_LEVEL_COUNT; level++) {
+        uint64_t level_index =
+            (next_tick_ >> (ROOT_WHEEL_BITS + (level - 1) * WHEEL_BITS)) & (WHEEL_SIZE - 1);
+        if (Cascade(level, level_index) != 0) {
+          break;
+        }
+      }
+    }
+    ++next_tick_;
+
+    // 取出这一时刻需要触发的所有定时器
+    TimerNode *slot = GetSlot(0, index);
+    while (slot->next_ != slot) {
+      TimerNode *node = slot->next_;
+      RemoveFromWheel(node);
+      if (node->intrusive_) {
+        // 只捕获一个指针，std::function不会为它分配内存
+        auto *timeout = static_cast<TimeoutNode *>(node);
+        res.emplace_back([timeout] {
+          timeout->callback_(timeout);
+          timeout->fired_.store(true, std::memory_order_release);
+        });
+        continue;
+      }
+      auto *timer = static_cast<Timer *>(node);
+      if (timer->recurring_) {
+        // 循环定时器在处理完所有时刻之后再放回时间轮，避免在这次循环中被重复触发
+        res.push_back(timer->func_);
+        recurring_timers.push_back(timer);
+      } else {
+        res.push_back(std::move(timer->func_));
+        timer->func_ = nullptr;
+        timer->self_.reset();
+      }
+    }
   }
 
-  expired_timers.insert(expired_timers.end(), timer_quque_.begin(), target_it);
-  timer_quque_.erase(timer_quque_.begin(), target_it);
-
-  std::vector<std::function<void()>> res{};
-  res.reserve(expired_timers.size());
-  for (auto &t : expired_timers) {
-    res.push_back(t->func_);
-    // 如果是循环定时器，那么就需要重新插入队列
-    if (t->recurring_) {
-      t->next_time_ = curr_time + t->interval_time_;
-      timer_quque_.insert(t);
-    } else {
-      t->func_ = nullptr;
-    }
+  for (auto *timer : recurring_timers) {
+    timer->next_time_ = curr_time + timer->interval_time_;
+    AddToWheel(timer);
   }
   // 重置has_new_front_timer_标志位，下次再有新的定时器插入队列头部时，才会唤醒空闲线程
   has_new_front_timer_ = false;
-
-  return res;
 }
 
-auto TimerManager::Empty() -> bool {
-  std::shared_lock<MutexType> lock(mutex_);
-  return timer_quque_.empty();
-}
+auto TimerManager::Empty() const -> bool { return timer_count_.load(std::memory_order_acquire) == 0; }
 
 auto TimerManager::NeedTickle() -> bool { return has_new_front_timer_ && !recently_tickled_; }
 
 void TimerManager::SetTickled() { recently_tickled_ = true; }
 
-}  // namespace wtsclwq
\ No newline at end of file
+}  // namespace wtsclwq
@@ -1,15 +1,43 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
-#include <set>
-#include <shared_mutex>
+#include <mutex>
 #include <vector>
 namespace wtsclwq {
 class TimerManager;
-class Timer : public std::enable_shared_from_this<Timer> {
+
+/**
+ * @brief 时间轮槽位中侵入式双向链表的节点，槽位本身是一个哨兵节点
+ */
+struct TimerNode {
+  TimerNode *prev_{nullptr};
+  TimerNode *next_{nullptr};
+  uint64_t next_time_{0};  // 下次执行时间
+  int level_{-1};          // 所在时间轮的层级，-1表示不在时间轮中
+  bool intrusive_{false};  // 是否为TimeoutNode，否则为Timer
+};
+
+/**
+ * @brief 侵入式的一次性超时节点，内存由使用者提供（通常在等待的协程栈上），添加、取消、触发都不分配内存
+ * @details 节点在锁内从时间轮中取出，回调在锁外执行；CancelTimeout发现节点已经被取出时会等待回调执行完毕，
+ * 因此CancelTimeout返回之后使用者就可以释放节点
+ */
+struct TimeoutNode : public TimerNode {
+  using Callback = void (*)(TimeoutNode *node);
+
+  explicit TimeoutNode(Callback callback) : callback_(callback) { intrusive_ = true; }
+
+  Callback callback_{nullptr};      // 超时回调，使用者通过static_cast取得包含节点的对象
+  TimerManager *manager_{nullptr};  // 节点所在的定时器管理器
+  std::atomic<bool> fired_{false};  // 回调是否已经执行完毕
+};
+
+class Timer : public TimerNode, public std::enable_shared_from_this<Timer> {
   friend class TimerManager;
 
  public:
@@ -35,21 +63,26 @@ class Timer : public std::enable_shared_from_this<Timer> {
 
  private:
   Timer(uint64_t interval_time, bool recurring, std::function<void()> func, std::weak_ptr<TimerManager> manager);
-  explicit Timer(uint64_t next);
 
   uint64_t interval_time_{0};              // 间隔时间
-  uint64_t next_time_{0};                  // 下次执行时间
   bool recurring_{false};                  // 是否循环
   std::function<void()> func_{};           // 回调函数
   std::weak_ptr<TimerManager> manager_{};  // 所属定时器管理器
+  s_ptr self_{nullptr};                    // 在时间轮中时持有自身，保证槽位链表中的裸指针有效
 };
 
+/**
+ * @brief 定时器管理器，内部是一个分层时间轮，添加、取消定时器都是O(1)
+ * @details 时间精度为1ms。第0层有256个槽位，每个槽位对应1ms；之后每一层有64个槽位，
+ * 每个槽位对应下一层转一圈的时间，共5层，可以覆盖2^32ms（约49天），更远的定时器先放在最高层，
+ * 随着时间推进逐层下降（cascade），到达第0层之后在对应的毫秒被触发
+ */
 class TimerManager : public std::enable_shared_from_this<TimerManager> {
   friend class Timer;
 
  public:
   using s_ptr = std::shared_ptr<TimerManager>;
-  using MutexType = std::shared_mutex;
+  using MutexType = std::mutex;
 
   TimerManager();
 
@@ -65,8 +98,20 @@ class TimerManager : public std::enable_shared_from_this<TimerManager> {
 
   auto AddConditionTimer(uint64_t interval_time, const std::function<void()> &func, const std::function<bool()> &cond,
                          bool recurring = false) -> Timer::s_ptr;
+
+  /**
+   * @brief 添加一个侵入式超时节点，节点在触发或者取消之前不能被释放，也不能重复添加
+   */
+  void AddTimeout(TimeoutNode *node, uint64_t interval_time);
+
+  /**
+   * @brief 取消侵入式超时节点，节点已经被取出时等待它的回调执行完毕
+   * @return 是否在触发之前取消，返回false说明回调已经执行过
+   */
+  auto CancelTimeout(TimeoutNode *node) -> bool;
   /**
    * @brief 获取最近距离最近一个定时器触发的时间
+   * @details 最近的定时器还在高层时间轮中时，返回的是它下降到第0层的时间，一定不晚于它的触发时间
    */
   auto GetRecentTriggerTime() -> uint64_t;
 
@@ -75,26 +120,79 @@ class TimerManager : public std::enable_shared_from_this<TimerManager> {
    */
   auto GetAllTriggeringTimerFuncs() -> std::vector<std::function<void()>>;
 
+  /**
+   * @brief 把当前时间所有需要触发的定时器回调追加到funcs中，调用者复用funcs时稳态下不分配内存
+   */
+  void GetAllTriggeringTimerFuncs(std::vector<std::function<void()>> *funcs);
+
   /**
    * @brief 定时器列表是否为空
+   * @details 不加锁，其他线程可以随时查询，结果只反映调用时刻的状态
    */
-  auto Empty() -> bool;
+  auto Empty() const -> bool;
 
   auto NeedTickle() -> bool;
 
   void SetTickled();
 
  private:
-  // 定时器队列
-  std::set<Timer::s_ptr, std::function<bool(Timer::s_ptr, Timer::s_ptr)>> timer_quque_{};
+  static constexpr int WHEEL_LEVEL_COUNT = 5;                       // 时间轮层数
+  static constexpr int ROOT_WHEEL_BITS = 8;                         // 第0层槽位数量的位数
+  static constexpr int WHEEL_BITS = 6;                              // 其他层槽位数量的位数
+  static constexpr uint64_t ROOT_WHEEL_SIZE = 1 << ROOT_WHEEL_BITS;  // 第0层槽位数量
+  static constexpr uint64_t WHEEL_SIZE = 1 << WHEEL_BITS;            // 其他层槽位数量
+  static constexpr uint64_t MAX_WHEEL_SPAN = (1ULL << (ROOT_WHEEL_BITS + (WHEEL_LEVEL_COUNT - 1) * WHEEL_BITS)) - 1;
+
+  /**
+   * @brief 获取某一层的某一个槽位
+   */
+  auto GetSlot(int level, uint64_t index) -> TimerNode *;
+
+  /**
+   * @brief 根据定时器的触发时间，把它放入对应层级的槽位，调用者需要持有锁
+   */
+  void AddToWheel(TimerNode *timer);
+
+  /**
+   * @brief 把定时器从它所在的槽位中摘下，调用者需要持有锁
+   */
+  void RemoveFromWheel(TimerNode *timer);
+
+  /**
+   * @brief 把第level层index槽位中的定时器重新放入时间轮，它们会落到更低的层级
+   * @return index，为0时说明这一层也转完了一圈，需要继续下降上一层
+   */
+  auto Cascade(int level, uint64_t index) -> uint64_t;
+
+  /**
+   * @brief 时间轮为空时把next_tick_推进到当前时间，调用者需要持有锁
+   * @details 长时间空闲之后next_tick_可能远远落后，新定时器相对于它放置会落到过高的层级，处理时还要从它开始追赶
+   */
+  void RebaseIfEmpty();
+
+  /**
+   * @brief 高层定时器下一次下降的时刻，调用者需要持有锁，且第1层及以上至少有一个定时器
+   * @details 比最低的非空层更低的层级都是空的，下降只会发生在最低非空层的槽位边界上，中间的边界可以直接跳过
+   */
+  auto NextCascadeTime() const -> uint64_t;
+
+  /**
+   * @brief 记录一个新定时器的触发时间，如果它比空闲线程正在等待的时间更早，需要唤醒空闲线程
+   */
+  void UpdateEarliestTime(uint64_t next_time);
+
+  std::array<TimerNode, ROOT_WHEEL_SIZE> root_wheel_{};                            // 第0层时间轮
+  std::array<std::array<TimerNode, WHEEL_SIZE>, WHEEL_LEVEL_COUNT - 1> wheels_{};  // 第1层及以上的时间轮
+  std::array<size_t, WHEEL_LEVEL_COUNT> level_timer_count_{};                      // 每一层中的定时器数量
+  std::atomic<size_t> timer_count_{0};                                             // 定时器总数，只在持有锁时修改，Empty可以不加锁读取
+  uint64_t next_tick_{0};               // 下一个需要处理的时刻，之前的时刻都已经处理过了
+  uint64_t earliest_time_{UINT64_MAX};  // 空闲线程最近一次计算出的等待截止时间
   // 是否需要唤醒空闲线程
-  bool recently_tickled_{false};
-  bool has_new_front_timer_{false};
-  // 上次执行时间
-  uint64_t previouse_trigger_time_{0};
+  std::atomic<bool> recently_tickled_{false};
+  std::atomic<bool> has_new_front_timer_{false};
   // 互斥锁
   MutexType mutex_{};
 };
 }  // namespace wtsclwq
 
-#endif  // _TIMER_H_
\ No newline at end of file
+#endif  // _TIMER_H_
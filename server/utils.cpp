@@ -3,6 +3,7 @@
 #include <cxxabi.h>  // for abi::__cxa_demangle()
 #include <dirent.h>
 #include <execinfo.h>  // for backtrace()
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -24,13 +25,44 @@ auto GetCurrSysThreadId() -> pid_t { return syscall(SYS_gettid); }
 // TODO(wtsclwq)
 auto GetCurrCouroutineId() -> uint64_t { return Coroutine::GetThreadRunningCoroutineId(); }
 
+static thread_local pid_t t_cached_thread_id = 0;
+static thread_local char t_cached_thread_name[16] = {0};
+static thread_local size_t t_cached_thread_name_len = 0;
+static thread_local bool t_cached_thread_name_valid = false;
+
+auto GetCachedSysThreadId() -> pid_t {
+  if (t_cached_thread_id == 0) {
+    // fork之后子进程中只剩下调用fork的线程，它的线程id变了，需要清除缓存
+    static bool atfork_registered = [] { return pthread_atfork(nullptr, nullptr, [] { t_cached_thread_id = 0; }) == 0; }();
+    (void)atfork_registered;
+    t_cached_thread_id = GetCurrSysThreadId();
+  }
+  return t_cached_thread_id;
+}
+
 auto GetCurrSysThreadName() -> std::string {
   char name[16] = {0};
   pthread_getname_np(pthread_self(), name, sizeof(name));
   return name;
 }
 
-void SetCurrSysThreadName(std::string_view name) { pthread_setname_np(pthread_self(), name.substr(0, 15).data()); }
+auto GetCurrSysThreadNameView() -> std::string_view {
+  if (!t_cached_thread_name_valid) {
+    pthread_getname_np(pthread_self(), t_cached_thread_name, sizeof(t_cached_thread_name));
+    t_cached_thread_name_len = strlen(t_cached_thread_name);
+    t_cached_thread_name_valid = true;
+  }
+  return {t_cached_thread_name, t_cached_thread_name_len};
+}
+
+void SetCurrSysThreadName(std::string_view name) {
+  // 线程名最长15个字符，std::string_view不保证以'\0'结尾，先复制一份
+  t_cached_thread_name_len = std::min<size_t>(name.size(), sizeof(t_cached_thread_name) - 1);
+  memcpy(t_cached_thread_name, name.data(), t_cached_thread_name_len);
+  t_cached_thread_name[t_cached_thread_name_len] = '\0';
+  t_cached_thread_name_valid = true;
+  pthread_setname_np(pthread_self(), t_cached_thread_name);
+}
 
 static auto Demangle(std::string_view str) -> std::string {
   size_t size = 0;
@@ -27,6 +27,17 @@ auto GetCurrCouroutineId() -> uint64_t;
  */
 auto GetCurrSysThreadName() -> std::string;
 
+/**
+ * @brief 获取当前线程的名称，第一次调用后缓存在线程局部变量中，不分配内存
+ * @details 只有通过SetCurrSysThreadName修改的线程名才会更新缓存
+ */
+auto GetCurrSysThreadNameView() -> std::string_view;
+
+/**
+ * @brief 获取当前线程的pthread id，缓存在线程局部变量中，避免每次都发起系统调用
+ */
+auto GetCachedSysThreadId() -> pid_t;
+
 /**
  * @brief 设置当前线程的名称
  */
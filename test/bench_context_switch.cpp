@@ -0,0 +1,90 @@
+#include <ucontext.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include "server/context.h"
+#include "server/coroutine.h"
+#include "server/log.h"
+#include "server/server.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr size_t STACK_SIZE = 128 * 1024;
+
+static uint64_t switch_count = 1000000;
+
+// ucontext基准：主上下文和子上下文之间来回切换
+static ucontext_t uctx_main;
+static ucontext_t uctx_co;
+
+static void UcontextEntry() {
+  while (true) {
+    swapcontext(&uctx_co, &uctx_main);
+  }
+}
+
+// Context基准：与ucontext基准完全相同的切换模式
+static wtsclwq::Context ctx_main;
+static wtsclwq::Context ctx_co;
+
+static void ContextEntry() {
+  while (true) {
+    wtsclwq::Context::Swap(&ctx_co, &ctx_main);
+  }
+}
+
+/**
+ * @brief 执行func，返回平均每次切换的耗时（纳秒），每轮循环包含两次切换
+ */
+template <typename Func>
+static auto Measure(Func &&func) -> double {
+  auto begin = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < switch_count; i++) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+  return static_cast<double>(ns) / static_cast<double>(switch_count * 2);
+}
+
+auto main(int argc, char **argv) -> int {
+  if (argc > 1) {
+    switch_count = std::strtoull(argv[1], nullptr, 10);
+  }
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::FATAL);
+
+  std::unique_ptr<char[]> uctx_stack(new char[STACK_SIZE]);
+  getcontext(&uctx_co);
+  uctx_co.uc_stack.ss_sp = uctx_stack.get();
+  uctx_co.uc_stack.ss_size = STACK_SIZE;
+  uctx_co.uc_link = nullptr;
+  makecontext(&uctx_co, &UcontextEntry, 0);
+  double uctx_ns = Measure([] { swapcontext(&uctx_main, &uctx_co); });
+
+  std::unique_ptr<char[]> ctx_stack(new char[STACK_SIZE]);
+  ctx_main.InitCurrent();
+  ctx_co.Init(ctx_stack.get(), STACK_SIZE, &ContextEntry);
+  double ctx_ns = Measure([] { wtsclwq::Context::Swap(&ctx_main, &ctx_co); });
+
+  // 完整的协程Resume/Yield，包括状态维护和线程局部变量的更新
+  wtsclwq::Coroutine::InitThreadToCoMod();
+  auto co = std::make_shared<wtsclwq::Coroutine>(
+      [] {
+        while (true) {
+          wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
+        }
+      },
+      STACK_SIZE, true, wtsclwq::Coroutine::GetThreadMainCoroutine());
+  auto *co_ptr = co.get();
+  double co_ns = Measure([co_ptr] { co_ptr->Resume(); });
+
+  LOG_INFO(root_logger) << "switch count: " << switch_count * 2;
+  LOG_INFO(root_logger) << "ucontext swapcontext: " << uctx_ns << " ns/switch";
+  LOG_INFO(root_logger) << "Context::Swap (" << wtsclwq::Context::GetBackendName() << "): " << ctx_ns
+                        << " ns/switch";
+  LOG_INFO(root_logger) << "Coroutine Resume/Yield: " << co_ns << " ns/switch";
+
+  // 协程中的任务永远不会结束，直接退出进程，跳过协程的析构检查
+  std::_Exit(0);
+}
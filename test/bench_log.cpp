@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include "server/binary_log.h"
+#include "server/log.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+static uint64_t line_count = 1000000;
+
+/**
+ * @brief 执行func line_count次，返回平均每次的耗时（纳秒）
+ */
+template <typename Func>
+static auto Measure(Func &&func) -> double {
+  auto begin = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < line_count; i++) {
+    func(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+  return static_cast<double>(ns) / static_cast<double>(line_count);
+}
+
+auto main(int argc, char **argv) -> int {
+  if (argc > 1) {
+    line_count = std::strtoull(argv[1], nullptr, 10);
+  }
+
+  // 只格式化：使用默认格式，把同一个日志事件反复格式化到内存中
+  auto formatter = std::make_shared<wtsclwq::LogFormatter>();
+  auto event = std::make_shared<wtsclwq::LogEvent>(wtsclwq::LogLevel::INFO, __FILE__, __LINE__, 123456, 4321, 42,
+                                                   "bench_thread", "bench", time(nullptr));
+  event->GetStream() << "GET /index.html HTTP/1.1 200 1024 bytes in 12 us";
+  wtsclwq::LogStreamBuf buf;
+  std::ostream os(&buf);
+  double format_ns = Measure([&formatter, &event, &buf, &os](uint64_t /*i*/) {
+    buf.Reset();
+    formatter->Format(event, os);
+  });
+
+  double format_to_ns = Measure([&formatter, &event, &buf](uint64_t /*i*/) {
+    buf.Reset();
+    formatter->FormatTo(*event, &buf);
+  });
+
+  // 完整的日志语句：构造事件、格式化、写入/dev/null
+  auto logger = std::make_shared<wtsclwq::Logger>("bench");
+  auto appender = std::make_shared<wtsclwq::FileLogAppender>("/dev/null");
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>());
+  logger->AddAppender(appender);
+  double log_ns = Measure([&logger](uint64_t i) {
+    LOG_INFO(logger) << "GET /index.html HTTP/1.1 200 " << i << " bytes in " << 12 << " us";
+  });
+
+  // 二进制日志：只写入参数的原始字节，由刷盘线程写入/dev/null
+  auto bin_logger = std::make_shared<wtsclwq::Logger>("bench_binary");
+  auto bin_appender = std::make_shared<wtsclwq::BinaryLogAppender>("/dev/null");
+  bin_logger->AddAppender(bin_appender);
+  double bin_log_ns = Measure([&bin_logger](uint64_t i) {
+    BIN_LOG_INFO(bin_logger, "GET /index.html HTTP/1.1 200 {} bytes in {} us", i, 12);
+  });
+  bin_appender->Flush();
+
+  LOG_INFO(root_logger) << "line count: " << line_count;
+  LOG_INFO(root_logger) << "LogFormatter::Format: " << format_ns << " ns/line, " << 1e9 / format_ns << " lines/s";
+  LOG_INFO(root_logger) << "LogFormatter::FormatTo: " << format_to_ns << " ns/line, " << 1e9 / format_to_ns
+                        << " lines/s";
+  LOG_INFO(root_logger) << "LOG_INFO to /dev/null: " << log_ns << " ns/line, " << 1e9 / log_ns << " lines/s";
+  LOG_INFO(root_logger) << "BIN_LOG_INFO to /dev/null: " << bin_log_ns << " ns/line, " << 1e9 / bin_log_ns
+                        << " lines/s";
+  return 0;
+}
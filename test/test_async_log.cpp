@@ -0,0 +1,171 @@
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "server/config.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/thread.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int THREAD_COUNT = 4;
+constexpr int LINE_COUNT = 20000;
+
+/**
+ * @brief 统计日志文件中每个线程写入的行数，并检查每个线程的日志是否按顺序写入
+ */
+auto CheckFile(const std::string &filename, bool *in_order) -> std::map<std::string, int> {
+  std::map<std::string, int> counts;
+  std::map<std::string, int> last_seq;
+  *in_order = true;
+  std::ifstream ifs(filename);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    // 日志格式为"线程名 序号"
+    auto pos = line.find(' ');
+    if (pos == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, pos);
+    if (name == "AsyncLogAppender") {
+      // 丢弃日志的提示
+      counts[name]++;
+      continue;
+    }
+    int seq = std::stoi(line.substr(pos + 1));
+    if (last_seq.count(name) != 0 && seq != last_seq[name] + 1) {
+      *in_order = false;
+    }
+    last_seq[name] = seq;
+    counts[name]++;
+  }
+  return counts;
+}
+
+/**
+ * @brief 多个线程同时写日志，所有日志都应该完整、有序地写入文件
+ */
+void TestBlock() {
+  LOG_INFO(root_logger) << "TestBlock start";
+  std::string filename = "/tmp/test_async_log_block.txt";
+  unlink(filename.c_str());
+  auto logger = std::make_shared<wtsclwq::Logger>("async_block");
+  // 缓冲区很小，生产者会频繁等待刷盘线程
+  auto appender = std::make_shared<wtsclwq::AsyncLogAppender>(filename, 4096,
+                                                              wtsclwq::AsyncLogAppender::OverflowPolicy::Block);
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%N %m%n"));
+  logger->AddAppender(appender);
+
+  uint64_t start = wtsclwq::GetCurrMs();
+  std::vector<wtsclwq::Thread::s_ptr> threads;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    threads.push_back(std::make_shared<wtsclwq::Thread>(
+        [logger] {
+          for (int j = 0; j < LINE_COUNT; j++) {
+            LOG_INFO(logger) << j;
+          }
+        },
+        "async_" + std::to_string(i)));
+  }
+  for (auto &thread : threads) {
+    thread->Join();
+  }
+  appender->Flush();
+  LOG_INFO(root_logger) << THREAD_COUNT * LINE_COUNT << " lines in " << wtsclwq::GetCurrMs() - start << " ms";
+
+  bool in_order = false;
+  auto counts = CheckFile(filename, &in_order);
+  ASSERT(in_order);
+  ASSERT(counts.size() == THREAD_COUNT);
+  for (auto &count : counts) {
+    ASSERT(count.second == LINE_COUNT);
+  }
+  ASSERT(appender->GetDroppedCount() == 0);
+  LOG_INFO(root_logger) << "TestBlock end";
+}
+
+/**
+ * @brief 缓冲区写满时丢弃日志并计数，写入的行数加上丢弃的行数应该等于总行数
+ */
+void TestCountDropped() {
+  LOG_INFO(root_logger) << "TestCountDropped start";
+  std::string filename = "/tmp/test_async_log_count.txt";
+  unlink(filename.c_str());
+  uint64_t dropped_count = 0;
+  {
+    auto logger = std::make_shared<wtsclwq::Logger>("async_count");
+    auto appender = std::make_shared<wtsclwq::AsyncLogAppender>(
+        filename, 4096, wtsclwq::AsyncLogAppender::OverflowPolicy::CountDropped);
+    appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%N %m%n"));
+    logger->AddAppender(appender);
+    // 每条日志都超过缓冲区的一半，刷盘线程来不及写入时后面的日志会被丢弃
+    std::string padding(3000, 'x');
+    for (int j = 0; j < LINE_COUNT; j++) {
+      LOG_INFO(logger) << j << " " << padding;
+    }
+    dropped_count = appender->GetDroppedCount();
+    // 析构时会把剩余的日志写入文件
+  }
+  bool in_order = false;
+  auto counts = CheckFile(filename, &in_order);
+  int written = 0;
+  for (auto &count : counts) {
+    if (count.first != "AsyncLogAppender") {
+      written += count.second;
+    }
+  }
+  LOG_INFO(root_logger) << "written: " << written << ", dropped: " << dropped_count;
+  ASSERT(dropped_count > 0);
+  ASSERT(written + dropped_count == LINE_COUNT);
+  ASSERT(counts["AsyncLogAppender"] > 0);
+  LOG_INFO(root_logger) << "TestCountDropped end";
+}
+
+/**
+ * @brief 通过yaml配置异步文件日志
+ */
+void TestConfig() {
+  LOG_INFO(root_logger) << "TestConfig start";
+  std::string filename = "/tmp/test_async_log_config.txt";
+  unlink(filename.c_str());
+  YAML::Node root = YAML::Load(R"(
+loggers:
+    - name: async_config
+      level: info
+      appenders:
+          - type: File
+            file: /tmp/test_async_log_config.txt
+            pattern: "%N %m%n"
+            async: true
+            overflow: drop
+            buffer_size: 65536
+)");
+  wtsclwq::ConfigMgr::GetInstance()->LoadFromYaml(root);
+  auto logger = NAMED_LOGGER("async_config");
+  std::string config = logger->FlushConfigToYmal();
+  LOG_INFO(root_logger) << "\n" << config;
+  ASSERT(config.find("async: true") != std::string::npos);
+  ASSERT(config.find("overflow: drop") != std::string::npos);
+  for (int j = 0; j < 100; j++) {
+    LOG_INFO(logger) << j;
+  }
+  // 重新配置之后旧的输出目标析构，剩余的日志会被写入文件
+  logger->ClearAppenders();
+  bool in_order = false;
+  auto counts = CheckFile(filename, &in_order);
+  ASSERT(in_order);
+  ASSERT(counts.size() == 1 && counts.begin()->second == 100);
+  LOG_INFO(root_logger) << "TestConfig end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestBlock();
+  TestCountDropped();
+  TestConfig();
+  return 0;
+}
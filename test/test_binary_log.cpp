@@ -0,0 +1,208 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "server/binary_log.h"
+#include "server/config.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/thread.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int THREAD_COUNT = 4;
+constexpr int LINE_COUNT = 5000;
+
+auto FileSize(const std::string &filename) -> uint64_t {
+  struct stat st {};
+  stat(filename.c_str(), &st);
+  return st.st_size;
+}
+
+auto CountLines(const std::string &filename) -> int {
+  std::ifstream ifs(filename);
+  std::string line;
+  int count = 0;
+  while (std::getline(ifs, line)) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief 多个线程同时打印二进制日志和普通日志，解码之后的内容应该和文本日志一致
+ */
+void TestDecode() {
+  LOG_INFO(root_logger) << "TestDecode start";
+  std::string bin_file = "/tmp/test_binary_log.bin";
+  std::string text_file = "/tmp/test_binary_log.txt";
+  unlink(bin_file.c_str());
+  unlink(text_file.c_str());
+  auto logger = std::make_shared<wtsclwq::Logger>("binary");
+  auto bin_appender = std::make_shared<wtsclwq::BinaryLogAppender>(bin_file);
+  logger->AddAppender(bin_appender);
+  // 文本输出目标在打印日志的线程中把二进制日志还原为文本
+  auto text_appender = std::make_shared<wtsclwq::FileLogAppender>(text_file);
+  text_appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%N %m%n"));
+  logger->AddAppender(text_appender);
+
+  std::vector<wtsclwq::Thread::s_ptr> threads;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    threads.push_back(std::make_shared<wtsclwq::Thread>(
+        [logger, i] {
+          std::string name = "name_" + std::to_string(i);
+          for (int j = 0; j < LINE_COUNT; j++) {
+            BIN_LOG_INFO(logger, "seq {} thread {} pi {} ok {} c {} {} {{}}", j, i, 3.5, j % 2 == 0, 'x', name);
+          }
+          LOG_INFO(logger) << "stream " << i;
+          BIN_LOG_WARN(logger, "no args");
+          BIN_LOG_WARN(logger, "extra", -1, 2U);
+        },
+        "binary_" + std::to_string(i)));
+  }
+  for (auto &thread : threads) {
+    thread->Join();
+  }
+  bin_appender->Flush();
+
+  wtsclwq::BinaryLogReader reader(bin_file);
+  ASSERT(reader.IsOpen());
+  auto event = std::make_shared<wtsclwq::LogEvent>();
+  auto formatter = std::make_shared<wtsclwq::LogFormatter>("%N %m%n");
+  std::map<std::string, int> next_seq;
+  std::stringstream decoded;
+  int count = 0;
+  while (reader.Next(event.get())) {
+    count++;
+    std::string thread_name(event->GetThreadName());
+    std::string message(event->GetContent());
+    decoded << formatter->Format(event);
+    ASSERT(event->GetLoggerName() == "binary");
+    ASSERT(std::string(event->GetFile()) == __FILE__);
+    int i = std::stoi(thread_name.substr(thread_name.find('_') + 1));
+    int seq = next_seq[thread_name];
+    if (seq < LINE_COUNT) {
+      std::string expect = "seq " + std::to_string(seq) + " thread " + std::to_string(i) + " pi 3.5 ok " +
+                           (seq % 2 == 0 ? "1" : "0") + " c x name_" + std::to_string(i) + " {}";
+      ASSERT(message == expect);
+      ASSERT(event->GetLevel() == wtsclwq::LogLevel::INFO);
+    } else if (seq == LINE_COUNT) {
+      ASSERT(message == "stream " + std::to_string(i));
+    } else if (seq == LINE_COUNT + 1) {
+      ASSERT(message == "no args");
+      ASSERT(event->GetLevel() == wtsclwq::LogLevel::WARN);
+    } else {
+      ASSERT(message == "extra -1 2");
+    }
+    next_seq[thread_name]++;
+  }
+  ASSERT(!reader.HasError());
+  ASSERT(count == THREAD_COUNT * (LINE_COUNT + 3));
+
+  // 二进制日志解码之后的文本和在线程中直接还原的文本日志按线程比较，内容完全一致
+  std::map<std::string, std::string> decoded_lines;
+  std::map<std::string, std::string> text_lines;
+  std::ifstream ifs(text_file);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    text_lines[line.substr(0, line.find(' '))] += line + "\n";
+  }
+  while (std::getline(decoded, line)) {
+    decoded_lines[line.substr(0, line.find(' '))] += line + "\n";
+  }
+  ASSERT(decoded_lines == text_lines);
+
+  uint64_t bin_size = FileSize(bin_file);
+  LOG_INFO(root_logger) << count << " lines, binary size: " << bin_size << ", text size: " << FileSize(text_file);
+  LOG_INFO(root_logger) << "TestDecode end";
+}
+
+/**
+ * @brief 二进制日志比默认格式的文本日志小
+ */
+void TestSize() {
+  LOG_INFO(root_logger) << "TestSize start";
+  std::string bin_file = "/tmp/test_binary_log_size.bin";
+  std::string text_file = "/tmp/test_binary_log_size.txt";
+  unlink(bin_file.c_str());
+  unlink(text_file.c_str());
+  auto bin_logger = std::make_shared<wtsclwq::Logger>("binary_size");
+  auto bin_appender = std::make_shared<wtsclwq::BinaryLogAppender>(bin_file);
+  bin_logger->AddAppender(bin_appender);
+  auto text_logger = std::make_shared<wtsclwq::Logger>("binary_size");
+  text_logger->AddAppender(std::make_shared<wtsclwq::FileLogAppender>(text_file));
+  for (int i = 0; i < LINE_COUNT; i++) {
+    BIN_LOG_INFO(bin_logger, "request {} from {} took {} us", i, "127.0.0.1", i % 100);
+    LOG_INFO(text_logger) << "request " << i << " from " << "127.0.0.1" << " took " << i % 100 << " us";
+  }
+  bin_appender->Flush();
+  uint64_t bin_size = FileSize(bin_file);
+  uint64_t text_size = FileSize(text_file);
+  LOG_INFO(root_logger) << "binary size: " << bin_size << ", text size: " << text_size;
+  ASSERT(bin_size * 2 < text_size);
+  ASSERT(CountLines(text_file) == LINE_COUNT);
+  LOG_INFO(root_logger) << "TestSize end";
+}
+
+/**
+ * @brief 不完整的文件可以解码出完整的部分，并报告错误
+ */
+void TestTruncated() {
+  LOG_INFO(root_logger) << "TestTruncated start";
+  std::string bin_file = "/tmp/test_binary_log_truncated.bin";
+  unlink(bin_file.c_str());
+  {
+    auto logger = std::make_shared<wtsclwq::Logger>("binary_truncated");
+    logger->AddAppender(std::make_shared<wtsclwq::BinaryLogAppender>(bin_file));
+    for (int i = 0; i < 100; i++) {
+      BIN_LOG_INFO(logger, "line {}", i);
+    }
+    // 析构时把剩余的日志写入文件
+  }
+  ASSERT(truncate(bin_file.c_str(), static_cast<off_t>(FileSize(bin_file) - 3)) == 0);
+  wtsclwq::BinaryLogReader reader(bin_file);
+  auto event = std::make_shared<wtsclwq::LogEvent>();
+  int count = 0;
+  while (reader.Next(event.get())) {
+    ASSERT(event->GetContent() == "line " + std::to_string(count));
+    count++;
+  }
+  ASSERT(count == 99);
+  ASSERT(reader.HasError());
+  LOG_INFO(root_logger) << "TestTruncated end";
+}
+
+/**
+ * @brief 通过yaml配置二进制日志
+ */
+void TestConfig() {
+  LOG_INFO(root_logger) << "TestConfig start";
+  YAML::Node root = YAML::Load(R"(
+loggers:
+    - name: binary_config
+      level: info
+      appenders:
+          - type: Binary
+            file: /tmp/test_binary_log_config.bin
+            overflow: drop
+)");
+  wtsclwq::ConfigMgr::GetInstance()->LoadFromYaml(root);
+  std::string config = NAMED_LOGGER("binary_config")->FlushConfigToYmal();
+  LOG_INFO(root_logger) << "\n" << config;
+  ASSERT(config.find("type: Binary") != std::string::npos);
+  ASSERT(config.find("overflow: drop") != std::string::npos);
+  LOG_INFO(root_logger) << "TestConfig end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestDecode();
+  TestSize();
+  TestTruncated();
+  TestConfig();
+  return 0;
+}
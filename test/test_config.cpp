@@ -1,5 +1,9 @@
+#include <atomic>
+#include <chrono>
 #include "server/config.h"
 #include "server/env.h"
+#include "server/macro.h"
+#include "server/thread.h"
 
 auto root_logger = ROOT_LOGGER;
 
@@ -135,6 +139,93 @@ void TestConfig() {
   TestClass();
 }
 
+/**
+ * @brief 多个线程读取快照的同时不断修改配置项，读到的快照必须是某一次完整写入的值
+ */
+void TestSnapshot() {
+  constexpr int THREAD_COUNT = 4;
+  constexpr int READ_COUNT = 1000000;
+  constexpr int WRITE_COUNT = 1000;
+  auto item = wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem(
+      "test.snapshot", std::vector<int>(16, 0), "snapshot test");
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> total_ns{0};
+  std::vector<wtsclwq::Thread::s_ptr> readers;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    readers.push_back(std::make_shared<wtsclwq::Thread>(
+        [&item, &total_ns] {
+          auto begin = std::chrono::steady_clock::now();
+          for (int j = 0; j < READ_COUNT; j++) {
+            auto value = item->GetSnapshot();
+            ASSERT(value->size() == 16 && value->front() == value->back());
+          }
+          auto end = std::chrono::steady_clock::now();
+          total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        },
+        "snapshot_" + std::to_string(i)));
+  }
+  auto writer = std::make_shared<wtsclwq::Thread>(
+      [&item, &stop] {
+        for (int i = 1; i <= WRITE_COUNT && !stop; i++) {
+          item->SetValue(std::vector<int>(16, i));
+        }
+      },
+      "snapshot_writer");
+  for (auto &reader : readers) {
+    reader->Join();
+  }
+  stop = true;
+  writer->Join();
+  LOG_INFO(root_logger) << "GetSnapshot: " << total_ns / (THREAD_COUNT * READ_COUNT) << " ns/read";
+}
+
+/**
+ * @brief 反复修改配置项，没有读者持有的旧快照必须被回收，只有当前快照和各线程缓存的快照存活
+ */
+void TestSnapshotReclaim() {
+  constexpr int THREAD_COUNT = 4;
+  constexpr int WRITE_COUNT = 100000;
+  auto item = wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem(
+      "test.snapshot_reclaim", std::vector<int>(16, 0), "snapshot reclaim test");
+  std::weak_ptr<const std::vector<int>> first = item->GetSnapshot();
+  // 读者持有的快照在释放之前一直有效
+  auto held = item->GetSnapshot();
+  std::atomic<bool> stop{false};
+  std::vector<std::weak_ptr<const std::vector<int>>> seen;
+  std::vector<wtsclwq::Thread::s_ptr> readers;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    readers.push_back(std::make_shared<wtsclwq::Thread>(
+        [&item, &stop] {
+          while (!stop) {
+            auto value = item->GetSnapshot();
+            ASSERT(value->size() == 16 && value->front() == value->back());
+          }
+        },
+        "reclaim_" + std::to_string(i)));
+  }
+  for (int i = 1; i <= WRITE_COUNT; i++) {
+    item->SetValue(std::vector<int>(16, i));
+    if (i % (WRITE_COUNT / 100) == 0) {
+      seen.push_back(item->GetSnapshot());
+    }
+  }
+  stop = true;
+  for (auto &reader : readers) {
+    reader->Join();
+  }
+  ASSERT(held->front() == 0 && !first.expired());
+  held.reset();
+  // 本线程的缓存刷新到最新快照之后，旧快照不再有任何持有者
+  ASSERT(item->GetSnapshot()->front() == WRITE_COUNT);
+  ASSERT(first.expired());
+  size_t alive = 0;
+  for (auto &snapshot : seen) {
+    alive += snapshot.expired() ? 0 : 1;
+  }
+  LOG_INFO(root_logger) << "snapshots alive after " << WRITE_COUNT << " writes: " << alive;
+  ASSERT(alive == 1 && !seen.back().expired());
+}
+
 auto main(int argc, char **argv) -> int {
   // 设置g_int的配置变更回调函数
   g_int->AddListener([](const int &old_value, const int &new_value) {
@@ -158,5 +249,7 @@ auto main(int argc, char **argv) -> int {
                           << " typename=" << var->GetType() << " value=" << var->ToString();
   });
 
+  TestSnapshot();
+  TestSnapshotReclaim();
   return 0;
 }
\ No newline at end of file
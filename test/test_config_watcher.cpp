@@ -0,0 +1,166 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include "server/config.h"
+#include "server/config_watcher.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+static auto g_timeout =
+    wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem("watcher.timeout", 1000, "watcher test timeout");
+static auto g_name = wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem("watcher.name", std::string("init"),
+                                                                                  "watcher test name");
+
+static const std::string CONF_DIR = "/tmp/test_config_watcher";
+static const std::string CONF_FILE = CONF_DIR + "/watcher.yml";
+
+/**
+ * @brief 先写临时文件再重命名，和大多数编辑器保存文件的方式相同
+ */
+void WriteConfig(const std::string &content) {
+  std::string tmp = CONF_DIR + "/.watcher.tmp";
+  {
+    std::ofstream ofs(tmp);
+    ofs << content;
+  }
+  ASSERT(rename(tmp.c_str(), CONF_FILE.c_str()) == 0);
+}
+
+/**
+ * @brief 等待条件成立，最多等待两秒
+ */
+template <typename Cond>
+auto WaitFor(Cond cond) -> bool {
+  for (int i = 0; i < 200; i++) {
+    if (cond()) {
+      return true;
+    }
+    usleep(10 * 1000);
+  }
+  return cond();
+}
+
+void TestWatcher() {
+  LOG_INFO(root_logger) << "TestWatcher start";
+  mkdir(CONF_DIR.c_str(), 0755);
+  unlink(CONF_FILE.c_str());
+  g_timeout->SetValidator([](const int &value) { return value > 0; });
+  std::atomic<int> change_count{0};
+  g_timeout->AddListener([&change_count](const int &old_value, const int &new_value) {
+    LOG_INFO(root_logger) << "watcher.timeout changed from " << old_value << " to " << new_value;
+    ++change_count;
+  });
+
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "ConfigWatcher");
+  sc->Start();
+  auto watcher = std::make_shared<wtsclwq::ConfigWatcher>(sc, CONF_DIR);
+  ASSERT(watcher->Start());
+
+  // 正常修改
+  WriteConfig("watcher:\n  timeout: 2000\n  name: first\n");
+  ASSERT(WaitFor([&watcher] { return watcher->GetReloadCount() == 1; }));
+  ASSERT(g_timeout->GetValue() == 2000);
+  ASSERT(g_name->GetValue() == "first");
+  ASSERT(change_count == 1);
+
+  // 其中一个值不合法，整个文件都被拒绝，合法的name也不应用
+  WriteConfig("watcher:\n  timeout: -1\n  name: second\n");
+  ASSERT(WaitFor([&watcher] { return watcher->GetRejectCount() == 1; }));
+  ASSERT(g_timeout->GetValue() == 2000);
+  ASSERT(g_name->GetValue() == "first");
+
+  // 无法解析的文件
+  WriteConfig("watcher: [timeout: 3000\n");
+  ASSERT(WaitFor([&watcher] { return watcher->GetRejectCount() == 2; }));
+  ASSERT(g_name->GetValue() == "first");
+
+  // 快速连续修改多次，只加载最后一次
+  for (int i = 1; i <= 5; i++) {
+    WriteConfig("watcher:\n  timeout: " + std::to_string(3000 + i) + "\n  name: burst\n");
+    usleep(20 * 1000);
+  }
+  ASSERT(WaitFor([&watcher] { return watcher->GetReloadCount() == 2; }));
+  usleep(500 * 1000);
+  ASSERT(watcher->GetReloadCount() == 2);
+  ASSERT(g_timeout->GetValue() == 3005);
+  ASSERT(change_count == 2);
+
+  // 直接改写文件，内容不变时不触发回调
+  {
+    std::ofstream ofs(CONF_FILE);
+    ofs << "watcher:\n  timeout: 3005\n  name: burst\n";
+  }
+  ASSERT(WaitFor([&watcher] { return watcher->GetReloadCount() == 3; }));
+  ASSERT(change_count == 2);
+
+  watcher->Stop();
+  WriteConfig("watcher:\n  timeout: 4000\n");
+  usleep(500 * 1000);
+  ASSERT(g_timeout->GetValue() == 3005);
+  sc->Stop();
+  LOG_INFO(root_logger) << "TestWatcher end";
+}
+
+/**
+ * @brief 重新加载loggers时监听器创建新的文件appender并打开文件，加载作为普通任务运行，文件IO可以挂起等待
+ */
+void TestLoggerReload() {
+  LOG_INFO(root_logger) << "TestLoggerReload start";
+  const std::string log_file = CONF_DIR + "/watcher_logger.txt";
+  const std::string async_log_file = CONF_DIR + "/watcher_logger_async.txt";
+  const std::string logger_conf = CONF_DIR + "/log.yml";
+  mkdir(CONF_DIR.c_str(), 0755);
+  unlink(log_file.c_str());
+  unlink(async_log_file.c_str());
+  unlink(logger_conf.c_str());
+
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "ConfigWatcher");
+  sc->Start();
+  auto watcher = std::make_shared<wtsclwq::ConfigWatcher>(sc, CONF_DIR);
+  ASSERT(watcher->Start());
+  {
+    std::ofstream ofs(logger_conf);
+    ofs << "loggers:\n"
+           "  - name: watcher_logger\n"
+           "    level: info\n"
+           "    appenders:\n"
+           "      - type: File\n"
+           "        file: "
+        << log_file
+        << "\n"
+           "      - type: File\n"
+           "        async: true\n"
+           "        file: "
+        << async_log_file << "\n";
+  }
+  ASSERT(WaitFor([&watcher] { return watcher->GetReloadCount() == 1; }));
+  ASSERT(access(log_file.c_str(), F_OK) == 0);
+  ASSERT(access(async_log_file.c_str(), F_OK) == 0);
+
+  auto logger = NAMED_LOGGER("watcher_logger");
+  LOG_INFO(logger) << "written after reload";
+  ASSERT(WaitFor([&log_file] {
+    std::ifstream ifs(log_file);
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    return content.find("written after reload") != std::string::npos;
+  }));
+
+  watcher->Stop();
+  sc->Stop();
+  unlink(logger_conf.c_str());
+  LOG_INFO(root_logger) << "TestLoggerReload end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestWatcher();
+  TestLoggerReload();
+  return 0;
+}
@@ -0,0 +1,280 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "server/address.h"
+#include "server/config.h"
+#include "server/dns_resolver.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/thread.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int SLOW_REPLY_US = 100 * 1000;
+constexpr int DNS_TIMEOUT_MS = 200;
+
+/**
+ * @brief 监听在本地UDP端口上的域名服务器，只回答固定的几个域名，其他域名回答NXDOMAIN
+ * @details www.test有两条A记录，TTL为1秒；slow.test延迟应答；drop.test丢弃第一次查询；
+ * spoof.test先发送一个id不对的应答；v6.test有一条AAAA记录
+ */
+class StubDnsServer {
+ public:
+  StubDnsServer() {
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT(fd_ >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT(bind(fd_, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+    ASSERT(getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len) == 0);
+    port_ = ntohs(addr.sin_port);
+    // 定期醒来检查是否需要退出
+    timeval tv{0, 50 * 1000};
+    ASSERT(setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+    thread_ = std::make_unique<wtsclwq::Thread>([this] { Run(); }, "stub_dns");
+  }
+
+  ~StubDnsServer() {
+    stopping_ = true;
+    thread_->Join();
+    close(fd_);
+  }
+
+  auto GetAddress() const -> std::string { return "127.0.0.1:" + std::to_string(port_); }
+
+  auto GetQueryCount(const std::string &name) -> int {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return query_count_[name];
+  }
+
+ private:
+  void Run() {
+    uint8_t buf[512];
+    while (!stopping_) {
+      sockaddr_in peer{};
+      socklen_t peer_len = sizeof(peer);
+      ssize_t n = recvfrom(fd_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr *>(&peer), &peer_len);
+      if (n < 12) {
+        continue;
+      }
+      std::string name;
+      size_t pos = 12;
+      while (pos < static_cast<size_t>(n) && buf[pos] != 0) {
+        if (!name.empty()) {
+          name.push_back('.');
+        }
+        name.append(reinterpret_cast<char *>(buf + pos + 1), buf[pos]);
+        pos += buf[pos] + 1;
+      }
+      uint16_t qtype = buf[pos + 1] << 8 | buf[pos + 2];
+      std::string question(reinterpret_cast<char *>(buf + 12), pos + 5 - 12);
+      int count = 0;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count = ++query_count_[name];
+      }
+      uint16_t id = buf[0] << 8 | buf[1];
+      auto send_reply = [&](const std::string &reply) {
+        sendto(fd_, reply.data(), reply.size(), 0, reinterpret_cast<sockaddr *>(&peer), peer_len);
+      };
+      if (name == "drop.test" && count == 1) {
+        continue;
+      }
+      if (name == "slow.test") {
+        usleep(SLOW_REPLY_US);
+      }
+      if (name == "spoof.test") {
+        send_reply(BuildReply(id + 1, question, 0, {{"6.6.6.6", 60}}));
+      }
+      if (qtype == 1 && name == "www.test") {
+        send_reply(BuildReply(id, question, 0, {{"10.0.0.1", 1}, {"10.0.0.2", 1}}));
+      } else if (qtype == 1 && (name == "slow.test" || name == "drop.test" || name == "spoof.test")) {
+        send_reply(BuildReply(id, question, 0, {{"10.0.0.3", 60}}));
+      } else if (qtype == 28 && name == "v6.test") {
+        send_reply(BuildReply(id, question, 0, {{"fe80::1", 60}}));
+      } else {
+        send_reply(BuildReply(id, question, 3, {}));
+      }
+    }
+  }
+
+  static void Append16(std::string *out, uint16_t value) {
+    out->push_back(static_cast<char>(value >> 8));
+    out->push_back(static_cast<char>(value & 0xFF));
+  }
+
+  static void Append32(std::string *out, uint32_t value) {
+    Append16(out, value >> 16);
+    Append16(out, value & 0xFFFF);
+  }
+
+  /**
+   * @brief 构造应答，rcode为3时在授权部分附带一条SOA记录
+   */
+  static auto BuildReply(uint16_t id, const std::string &question, uint16_t rcode,
+                         const std::vector<std::pair<std::string, uint32_t>> &answers) -> std::string {
+    std::string reply;
+    Append16(&reply, id);
+    Append16(&reply, 0x8180 | rcode);
+    Append16(&reply, 1);
+    Append16(&reply, answers.size());
+    Append16(&reply, rcode == 3 ? 1 : 0);
+    Append16(&reply, 0);
+    reply += question;
+    for (const auto &[ip, ttl] : answers) {
+      in6_addr addr{};
+      bool is_ipv4 = inet_pton(AF_INET, ip.c_str(), &addr) == 1;
+      if (!is_ipv4) {
+        ASSERT(inet_pton(AF_INET6, ip.c_str(), &addr) == 1);
+      }
+      Append16(&reply, 0xC00C);
+      Append16(&reply, is_ipv4 ? 1 : 28);
+      Append16(&reply, 1);
+      Append32(&reply, ttl);
+      Append16(&reply, is_ipv4 ? 4 : 16);
+      reply.append(reinterpret_cast<char *>(&addr), is_ipv4 ? 4 : 16);
+    }
+    if (rcode == 3) {
+      Append16(&reply, 0xC00C);
+      Append16(&reply, 6);
+      Append16(&reply, 1);
+      Append32(&reply, 60);
+      Append16(&reply, 22);
+      reply.push_back('\0');
+      reply.push_back('\0');
+      for (int i = 0; i < 5; i++) {
+        Append32(&reply, 60);
+      }
+    }
+    return reply;
+  }
+
+  int fd_{-1};
+  uint16_t port_{0};
+  std::atomic<bool> stopping_{false};
+  std::mutex mutex_{};
+  std::map<std::string, int> query_count_{};
+  std::unique_ptr<wtsclwq::Thread> thread_{nullptr};
+};
+
+/**
+ * @brief 在单线程的IO调度器中运行func
+ */
+void RunInScheduler(const std::function<void(wtsclwq::SockIoScheduler *)> &func) {
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "DnsResolver");
+  sc->Start();
+  sc->Schedule([&] { func(sc.get()); });
+  sc->Stop();
+}
+
+/**
+ * @brief 解析结果按照TTL缓存，域名不区分大小写；过期之后重新查询
+ */
+void TestResolve(StubDnsServer *server) {
+  LOG_INFO(root_logger) << "TestResolve start";
+  RunInScheduler([&](wtsclwq::SockIoScheduler * /*sc*/) {
+    auto res = wtsclwq::Address::GetAllTypeAddrByHost("www.test:80", AF_INET, SOCK_STREAM);
+    ASSERT(res.size() == 2 && res[0]->ToString() == "10.0.0.1:80" && res[1]->ToString() == "10.0.0.2:80");
+    ASSERT(wtsclwq::Address::GetAnyOneAddrByHost("WWW.Test.", AF_INET)->ToString() == "10.0.0.1:0");
+    ASSERT(server->GetQueryCount("www.test") == 1);
+
+    sleep(2);
+    ASSERT(wtsclwq::Address::GetAllTypeAddrByHost("www.test", AF_INET, SOCK_STREAM).size() == 2);
+    ASSERT(server->GetQueryCount("www.test") == 2);
+
+    auto ipv6 = wtsclwq::Address::GetAnyOneIPByHost("v6.test:443", AF_INET6, SOCK_STREAM);
+    ASSERT(ipv6 != nullptr && *ipv6 == *wtsclwq::IPv6Address::CreateAddr("fe80::1", 443));
+
+    // 迟到或者伪造的应答被忽略
+    auto spoof = wtsclwq::DnsResolverMgr::GetInstance()->Resolve("spoof.test", AF_INET);
+    ASSERT(spoof.size() == 1 && spoof[0] == "10.0.0.3");
+
+    // /etc/hosts中的域名不需要查询
+    ASSERT(wtsclwq::Address::GetAnyOneAddrByHost("localhost:80", AF_INET) != nullptr);
+    ASSERT(server->GetQueryCount("localhost") == 0);
+  });
+  LOG_INFO(root_logger) << "TestResolve end";
+}
+
+/**
+ * @brief 不存在的域名按照SOA记录的TTL做否定缓存
+ */
+void TestNegativeCache(StubDnsServer *server) {
+  LOG_INFO(root_logger) << "TestNegativeCache start";
+  RunInScheduler([&](wtsclwq::SockIoScheduler * /*sc*/) {
+    ASSERT(wtsclwq::Address::GetAllTypeAddrByHost("missing.test", AF_INET).empty());
+    ASSERT(wtsclwq::Address::GetAllTypeAddrByHost("missing.test", AF_INET).empty());
+    ASSERT(server->GetQueryCount("missing.test") == 1);
+  });
+  LOG_INFO(root_logger) << "TestNegativeCache end";
+}
+
+/**
+ * @brief 同时解析同一个域名的协程共享一次查询；等待应答期间同一个调度线程上的其他协程继续运行
+ */
+void TestCoalesce(StubDnsServer *server) {
+  LOG_INFO(root_logger) << "TestCoalesce start";
+  constexpr int RESOLVER_COUNT = 8;
+  std::atomic<int> done{0};
+  std::atomic<int> ticks{0};
+  RunInScheduler([&](wtsclwq::SockIoScheduler *sc) {
+    for (int i = 0; i < RESOLVER_COUNT; i++) {
+      sc->Schedule([&] {
+        auto addr = wtsclwq::Address::GetAnyOneAddrByHost("slow.test:8080", AF_INET);
+        ASSERT(addr != nullptr && addr->ToString() == "10.0.0.3:8080");
+        ++done;
+      });
+    }
+    sc->Schedule([&] {
+      while (done < RESOLVER_COUNT) {
+        ++ticks;
+        usleep(1000);
+      }
+    });
+  });
+  ASSERT(done == RESOLVER_COUNT);
+  ASSERT(server->GetQueryCount("slow.test") == 1);
+  LOG_INFO(root_logger) << "ticks while resolving: " << ticks;
+  ASSERT(ticks > 0);
+  LOG_INFO(root_logger) << "TestCoalesce end";
+}
+
+/**
+ * @brief 没有应答时在超时之后重试
+ */
+void TestRetry(StubDnsServer *server) {
+  LOG_INFO(root_logger) << "TestRetry start";
+  RunInScheduler([&](wtsclwq::SockIoScheduler * /*sc*/) {
+    uint64_t begin = wtsclwq::GetCurrMs();
+    auto res = wtsclwq::DnsResolverMgr::GetInstance()->Resolve("drop.test", AF_INET);
+    ASSERT(res.size() == 1 && res[0] == "10.0.0.3");
+    ASSERT(wtsclwq::GetCurrMs() - begin >= DNS_TIMEOUT_MS);
+    ASSERT(server->GetQueryCount("drop.test") == 2);
+  });
+  LOG_INFO(root_logger) << "TestRetry end";
+}
+
+auto main(int argc, char **argv) -> int {
+  StubDnsServer server;
+  auto config = wtsclwq::ConfigMgr::GetInstance();
+  config->GetConfigItem<std::vector<std::string>>("dns.nameservers")->SetValue({server.GetAddress()});
+  config->GetConfigItem<int>("dns.timeout")->SetValue(DNS_TIMEOUT_MS);
+  TestResolve(&server);
+  TestNegativeCache(&server);
+  TestCoalesce(&server);
+  TestRetry(&server);
+  return 0;
+}
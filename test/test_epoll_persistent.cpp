@@ -0,0 +1,175 @@
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "server/log.h"
+#include "server/server.h"
+#include "server/sock_io_scheduler.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int ROUND_COUNT = 10000;
+
+std::atomic<uint64_t> epoll_ctl_count{0};
+
+/**
+ * @brief 覆盖libc中的epoll_ctl，统计调度器一共调用了多少次
+ */
+extern "C" auto epoll_ctl(int epfd, int op, int fd, epoll_event *event) noexcept -> int {
+  using epoll_ctl_func = int (*)(int, int, int, epoll_event *);
+  static auto real_epoll_ctl = reinterpret_cast<epoll_ctl_func>(dlsym(RTLD_NEXT, "epoll_ctl"));
+  ++epoll_ctl_count;
+  return real_epoll_ctl(epfd, op, fd, event);
+}
+
+/**
+ * @brief 两个协程通过一条TCP连接来回发送一个字节，每一轮双方都要在recv上等待一次
+ */
+void TestPingPong() {
+  LOG_INFO(root_logger) << "TestPingPong start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "PingPong",
+                                                       wtsclwq::SockIoScheduler::IoBackend::Epoll);
+  sc->Start();
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+  socklen_t len = sizeof(addr);
+  ASSERT(bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), len) == 0);
+  ASSERT(listen(listen_fd, 16) == 0);
+  ASSERT(getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+  // 主线程没有开启hook，手动纳入fd管理，这样调度器中的accept才会挂起协程而不是阻塞线程
+  wtsclwq::FdWrapperMgr::GetInstance()->Get(listen_fd, true);
+
+  std::atomic<uint64_t> warm_count{0};
+  std::atomic<int> error_count{0};
+  sc->Schedule([listen_fd, &error_count] {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    char c = 0;
+    for (int i = 0; i < ROUND_COUNT; i++) {
+      if (recv(fd, &c, 1, 0) != 1 || send(fd, &c, 1, 0) != 1) {
+        ++error_count;
+        break;
+      }
+    }
+    close(fd);
+    close(listen_fd);
+  });
+  sc->Schedule([addr, &warm_count, &error_count] {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) != 0) {
+      ++error_count;
+      close(fd);
+      return;
+    }
+    char c = 'x';
+    uint64_t steady_count = 0;
+    for (int i = 0; i < ROUND_COUNT; i++) {
+      // 前几轮之后两个fd都已经注册到epoll中，此后直到关闭都不应该再有epoll_ctl
+      // 最后一轮之后对端会关闭fd，关闭时的epoll_ctl不计入
+      if (i == 10) {
+        warm_count = epoll_ctl_count.load();
+      } else if (i == ROUND_COUNT - 1) {
+        steady_count = epoll_ctl_count.load();
+      }
+      if (send(fd, &c, 1, 0) != 1 || recv(fd, &c, 1, 0) != 1) {
+        ++error_count;
+        break;
+      }
+    }
+    LOG_INFO(root_logger) << "epoll_ctl calls: " << steady_count - warm_count << " in " << ROUND_COUNT - 11
+                          << " steady rounds";
+    ASSERT(steady_count == warm_count);
+    close(fd);
+  });
+  sc->Stop();
+  ASSERT(error_count == 0);
+  LOG_INFO(root_logger) << "TestPingPong end";
+}
+
+/**
+ * @brief 关闭一个正在被等待的fd，等待的协程应该被唤醒并返回EBADF
+ */
+void TestCloseWakesWaiter() {
+  LOG_INFO(root_logger) << "TestCloseWakesWaiter start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "CloseWaiter",
+                                                       wtsclwq::SockIoScheduler::IoBackend::Epoll);
+  sc->Start();
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  sc->Schedule([fds] {
+    // socketpair没有被hook，手动纳入fd管理
+    wtsclwq::FdWrapperMgr::GetInstance()->Get(fds[0], true);
+    wtsclwq::Scheduler::GetThreadScheduler()->Schedule([fds] {
+      usleep(100 * 1000);
+      close(fds[0]);
+    });
+    char c = 0;
+    ssize_t n = read(fds[0], &c, 1);
+    LOG_INFO(root_logger) << "read after close ret: " << n << ", errno: " << errno;
+    ASSERT(n == -1 && errno == EBADF);
+    close_f(fds[1]);
+  });
+  sc->Stop();
+  LOG_INFO(root_logger) << "TestCloseWakesWaiter end";
+}
+
+/**
+ * @brief 已经注册到epoll的socket被没有开启hook的线程关闭，编号被新的socket复用之后，新socket上的等待仍然能被唤醒
+ */
+void TestReuseAfterUnhookedClose() {
+  LOG_INFO(root_logger) << "TestReuseAfterUnhookedClose start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "Reuse", wtsclwq::SockIoScheduler::IoBackend::Epoll);
+  sc->Start();
+  std::atomic<bool> received{false};
+  sc->Schedule([&received] {
+    auto bind_loopback = [](int fd) {
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+      socklen_t len = sizeof(addr);
+      ASSERT(bind(fd, reinterpret_cast<sockaddr *>(&addr), len) == 0);
+      ASSERT(getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0);
+      return addr;
+    };
+    int old_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bind_loopback(old_fd);
+    // 等待一次读事件超时，fd留在epoll中
+    timeval tv{0, 20 * 1000};
+    ASSERT(setsockopt(old_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+    char c = 0;
+    ASSERT(recv(old_fd, &c, 1, 0) == -1 && errno == ETIMEDOUT);
+    std::thread([old_fd] { ASSERT(close(old_fd) == 0); }).join();
+
+    int new_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT(new_fd == old_fd);
+    sockaddr_in addr = bind_loopback(new_fd);
+    tv = {1, 0};
+    ASSERT(setsockopt(new_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+    wtsclwq::Scheduler::GetThreadScheduler()->Schedule([addr] {
+      int sender = socket(AF_INET, SOCK_DGRAM, 0);
+      ASSERT(sendto(sender, "x", 1, 0, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 1);
+      close(sender);
+    });
+    received = recv(new_fd, &c, 1, 0) == 1 && c == 'x';
+    close(new_fd);
+  });
+  sc->Stop();
+  ASSERT(received);
+  LOG_INFO(root_logger) << "TestReuseAfterUnhookedClose end";
+}
+
+auto main(int argc, char **argv) -> int {
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::ERROR);
+  TestPingPong();
+  TestCloseWakesWaiter();
+  TestReuseAfterUnhookedClose();
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "server/fd_context.h"
+#include "server/fd_manager.h"
+#include "server/fd_table.h"
+#include "server/hook.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/thread.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int THREAD_COUNT = 4;
+constexpr int FD_COUNT = 10000;
+
+/**
+ * @brief 多个线程同时访问还没有分配的块，每个fd只能得到同一个元素
+ */
+void TestConcurrentCreate() {
+  LOG_INFO(root_logger) << "TestConcurrentCreate start";
+  wtsclwq::FdTable<wtsclwq::FileDescContext> table;
+  ASSERT(table.Get(0) == nullptr);
+  ASSERT(table.Get(-1) == nullptr);
+  ASSERT(table.GetOrCreate(-1) == nullptr);
+  ASSERT(table.GetOrCreate(static_cast<int>(table.MAX_FD_COUNT)) == nullptr);
+
+  std::vector<std::vector<wtsclwq::FileDescContext *>> results(THREAD_COUNT);
+  std::vector<wtsclwq::Thread::s_ptr> threads;
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    threads.push_back(std::make_shared<wtsclwq::Thread>(
+        [&table, &results, i] {
+          // 每个线程以不同的顺序访问，尽量让多个线程同时分配同一个块
+          for (int j = 0; j < FD_COUNT; j++) {
+            int fd = i % 2 == 0 ? j : FD_COUNT - 1 - j;
+            results[i].push_back(table.GetOrCreate(fd));
+          }
+        },
+        "fd_table_" + std::to_string(i)));
+  }
+  for (auto &thread : threads) {
+    thread->Join();
+  }
+  for (int j = 0; j < FD_COUNT; j++) {
+    wtsclwq::FileDescContext *ctx = table.Get(j);
+    ASSERT(ctx != nullptr && ctx->sys_fd_ == j);
+    ASSERT(results[0][j] == ctx && results[2][j] == ctx);
+    ASSERT(results[1][FD_COUNT - 1 - j] == ctx && results[3][FD_COUNT - 1 - j] == ctx);
+  }
+  LOG_INFO(root_logger) << "TestConcurrentCreate end";
+}
+
+/**
+ * @brief 查找已经分配的元素只有两次加载
+ */
+void TestLookup() {
+  constexpr int ROUND_COUNT = 1000;
+  wtsclwq::FdTable<wtsclwq::FileDescContext> table;
+  for (int fd = 0; fd < FD_COUNT; fd++) {
+    table.GetOrCreate(fd);
+  }
+  int64_t sum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < ROUND_COUNT; i++) {
+    for (int fd = 0; fd < FD_COUNT; fd++) {
+      sum += table.Get(fd)->sys_fd_;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  ASSERT(sum == static_cast<int64_t>(ROUND_COUNT) * FD_COUNT * (FD_COUNT - 1) / 2);
+  LOG_INFO(root_logger) << "Get: "
+                        << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() /
+                               (static_cast<int64_t>(ROUND_COUNT) * FD_COUNT)
+                        << " ns/lookup";
+}
+
+/**
+ * @brief fd编号被复用时，表项原地重新初始化，代数加一，关闭之前取得的指针能看到编号已经被复用
+ */
+void TestReuse() {
+  LOG_INFO(root_logger) << "TestReuse start";
+  auto *mgr = wtsclwq::FdWrapperMgr::GetInstance();
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  ASSERT(mgr->Get(fds[0]) == nullptr);
+  wtsclwq::FileInfoWrapper *info = mgr->Get(fds[0], true);
+  ASSERT(info != nullptr && info->IsSocket() && !info->IsClosed());
+  ASSERT(mgr->Get(fds[0]) == info);
+  // socket在系统层面被设置为非阻塞，用户看到的仍然是阻塞的
+  ASSERT((fcntl_f(fds[0], F_GETFL) & O_NONBLOCK) != 0);
+  ASSERT((fcntl(fds[0], F_GETFL) & O_NONBLOCK) == 0);
+  uint32_t generation = info->GetGeneration();
+
+  info->SetClosed(true);
+  ASSERT(close(fds[0]) == 0);
+  mgr->Remove(fds[0]);
+  ASSERT(mgr->Get(fds[0]) == nullptr);
+  ASSERT(info->IsClosed());
+
+  // 新的fd复用了同一个编号，得到同一个表项
+  int new_fd = dup(fds[1]);
+  ASSERT(new_fd == fds[0]);
+  ASSERT(mgr->Get(new_fd, true) == info);
+  ASSERT(!info->IsClosed() && info->GetGeneration() != generation);
+  info->SetClosed(true);
+  close(new_fd);
+  mgr->Remove(new_fd);
+  close(fds[1]);
+  // 不是有效fd的编号不会被管理
+  ASSERT(mgr->Get(fds[1], true) == nullptr);
+  LOG_INFO(root_logger) << "TestReuse end";
+}
+
+/**
+ * @brief 一个调度器监听过的fd没有经过hook的close就被另一个调度器监听，后者丢弃前者留下的状态，仍能收到事件
+ */
+void TestSchedulerHandover() {
+  LOG_INFO(root_logger) << "TestSchedulerHandover start";
+  int fds[2];
+  ASSERT(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0);
+  for (int round = 0; round < 2; round++) {
+    auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "FdTable");
+    sc->Start();
+    std::atomic<int> fired{0};
+    std::atomic<bool> added{false};
+    sc->Schedule([&sc, &fds, &fired, &added] {
+      ASSERT(sc->AddEventListening(fds[0], wtsclwq::FileDescContext::Read, [&fired] { ++fired; }));
+      added = true;
+    });
+    while (!added) {
+      usleep(1000);
+    }
+    char c = 'x';
+    ASSERT(write(fds[1], &c, 1) == 1);
+    sc->Stop();
+    ASSERT(fired == 1);
+    ASSERT(read(fds[0], &c, 1) == 1);
+    // 第一个调度器的fd没有从epoll中移除就随调度器析构，第二个调度器重新注册
+  }
+  close(fds[0]);
+  close(fds[1]);
+  LOG_INFO(root_logger) << "TestSchedulerHandover end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestConcurrentCreate();
+  TestLookup();
+  TestReuse();
+  TestSchedulerHandover();
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "server/config.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr size_t FILE_SIZE = 16 * 1024 * 1024 + 123;
+constexpr int CHUNK_SIZE = 4096;
+
+static auto TempFileName() -> std::string { return "/tmp/test_file_io_" + std::to_string(getpid()); }
+
+/**
+ * @brief 大文件的读写被分成很多块交给线程池，期间同一个调度线程上的其他协程可以继续运行；
+ * 分块的边界不影响读写的结果
+ */
+void TestOffload() {
+  LOG_INFO(root_logger) << "TestOffload start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "FileIo");
+  sc->Start();
+  std::atomic<bool> io_done{false};
+  std::atomic<int> ticks{0};
+  std::atomic<int> ticks_during_io{0};
+  std::atomic<int> io_thread{-1};
+  std::atomic<int> ticker_thread{-1};
+
+  sc->Schedule([&] {
+    io_thread = wtsclwq::GetCurrSysThreadId();
+    std::string name = TempFileName();
+    std::vector<char> data(FILE_SIZE);
+    for (size_t i = 0; i < FILE_SIZE; i++) {
+      data[i] = static_cast<char>(i * 131 + 7);
+    }
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT(fd >= 0);
+    int begin_ticks = ticks;
+    ASSERT(write(fd, data.data(), FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+    ticks_during_io = ticks - begin_ticks;
+    ASSERT(fsync(fd) == 0);
+
+    struct stat st {};
+    ASSERT(stat(name.c_str(), &st) == 0);
+    ASSERT(static_cast<size_t>(st.st_size) == FILE_SIZE);
+
+    // 从不是块大小整数倍的位置读到文件末尾，得到的是短读
+    std::vector<char> buf(FILE_SIZE);
+    size_t offset = CHUNK_SIZE / 2 + 1;
+    ASSERT(pread(fd, buf.data(), FILE_SIZE, static_cast<off_t>(offset)) == static_cast<ssize_t>(FILE_SIZE - offset));
+    ASSERT(std::equal(buf.begin(), buf.begin() + static_cast<ssize_t>(FILE_SIZE - offset),
+                      data.begin() + static_cast<ssize_t>(offset)));
+
+    ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    ASSERT(read(fd, buf.data(), FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+    ASSERT(buf == data);
+    char c = 0;
+    ASSERT(read(fd, &c, 1) == 0);
+
+    ASSERT(pwrite(fd, "abc", 3, 10) == 3);
+    ASSERT(pread(fd, buf.data(), 3, 10) == 3 && std::string(buf.data(), 3) == "abc");
+    ASSERT(close(fd) == 0);
+    ASSERT(unlink(name.c_str()) == 0);
+
+    // 失败的操作设置了errno
+    ASSERT(open(name.c_str(), O_RDONLY) == -1 && errno == ENOENT);
+    ASSERT(stat(name.c_str(), &st) == -1 && errno == ENOENT);
+    io_done = true;
+  });
+  // 每毫秒计数一次的协程，只有调度线程没有被文件IO阻塞时才能计数
+  sc->Schedule([&] {
+    ticker_thread = wtsclwq::GetCurrSysThreadId();
+    while (!io_done) {
+      ++ticks;
+      usleep(1000);
+    }
+  });
+  sc->Stop();
+  ASSERT(io_done);
+  ASSERT(io_thread == ticker_thread);
+  LOG_INFO(root_logger) << "ticks while writing " << FILE_SIZE << " bytes: " << ticks_during_io;
+  ASSERT(ticks_during_io > 0);
+  LOG_INFO(root_logger) << "TestOffload end";
+}
+
+/**
+ * @brief Stop时还有文件操作在线程池中执行，调度器等待它完成并唤醒协程之后才退出
+ */
+void TestStopWaitsForIo() {
+  LOG_INFO(root_logger) << "TestStopWaitsForIo start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "FileIo");
+  sc->Start();
+  std::atomic<bool> io_done{false};
+  sc->Schedule([&io_done] {
+    std::string name = TempFileName();
+    std::vector<char> data(FILE_SIZE, 'x');
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, data.data(), FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+    close(fd);
+    unlink(name.c_str());
+    io_done = true;
+  });
+  uint64_t begin = wtsclwq::GetCurrMs();
+  sc->Stop();
+  ASSERT(io_done);
+  // 最后一个文件操作完成之后调度器立即退出，不必等到epoll_wait超时
+  ASSERT(wtsclwq::GetCurrMs() - begin < 3000);
+  LOG_INFO(root_logger) << "TestStopWaitsForIo end";
+}
+
+/**
+ * @brief 定时器回调在Idle协程中直接执行，其中的文件IO不能挂起Idle协程，只能阻塞完成
+ */
+void TestIoInTimer() {
+  LOG_INFO(root_logger) << "TestIoInTimer start";
+  constexpr size_t TIMER_FILE_SIZE = 64 * 1024 * 1024;
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "FileIo");
+  sc->Start();
+  std::atomic<bool> io_done{false};
+  sc->AddTimer(10, [&io_done] {
+    std::string name = TempFileName();
+    std::vector<char> data(TIMER_FILE_SIZE, 'y');
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT(fd >= 0);
+    ASSERT(write(fd, data.data(), TIMER_FILE_SIZE) == static_cast<ssize_t>(TIMER_FILE_SIZE));
+    struct stat st {};
+    ASSERT(stat(name.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) == TIMER_FILE_SIZE);
+    std::vector<char> buf(TIMER_FILE_SIZE);
+    ASSERT(pread(fd, buf.data(), TIMER_FILE_SIZE, 0) == static_cast<ssize_t>(TIMER_FILE_SIZE));
+    ASSERT(buf == data);
+    close(fd);
+    unlink(name.c_str());
+    io_done = true;
+  });
+  sc->Stop();
+  ASSERT(io_done);
+  LOG_INFO(root_logger) << "TestIoInTimer end";
+}
+
+auto main(int argc, char **argv) -> int {
+  wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem("file_io.chunk_size", 0)->SetValue(CHUNK_SIZE);
+  TestOffload();
+  TestStopWaitsForIo();
+  TestIoInTimer();
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include "server/fd_manager.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+
+// 统计全局的内存分配次数，用于验证hook的IO在等待就绪和超时时不会分配内存
+static std::atomic<uint64_t> alloc_count{0};
+
+auto operator new(size_t size) -> void * {
+  ++alloc_count;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t /*size*/) noexcept { std::free(p); }
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int ROUND_COUNT = 10000;
+constexpr int WARMUP_COUNT = 2000;
+
+/**
+ * @brief 创建一对由hook管理的socket，并设置读超时
+ */
+void CreatePair(int fds[2], uint64_t timeout_ms) {
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  for (int i = 0; i < 2; i++) {
+    wtsclwq::FdWrapperMgr::GetInstance()->Get(fds[i], true);
+    timeval tv{static_cast<time_t>(timeout_ms / 1000), static_cast<suseconds_t>(timeout_ms % 1000 * 1000)};
+    ASSERT(setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0);
+  }
+}
+
+/**
+ * @brief 两个协程通过两对socket互相传递一个字节，每次read都会先返回EAGAIN再等待就绪
+ * @return 除去预热之后的内存分配次数
+ */
+auto PingPong(const wtsclwq::SockIoScheduler::s_ptr &sc) -> uint64_t {
+  int ping[2];
+  int pong[2];
+  std::atomic<uint64_t> alloc_begin{0};
+  std::atomic<uint64_t> alloc_end{0};
+  std::atomic<int> done{0};
+  sc->Schedule([&] {
+    CreatePair(ping, 1000);
+    CreatePair(pong, 1000);
+    sc->Schedule([&] {
+      char c = 0;
+      for (int i = 0; i < WARMUP_COUNT + ROUND_COUNT; i++) {
+        ASSERT(read(ping[1], &c, 1) == 1);
+        ASSERT(write(pong[0], &c, 1) == 1);
+      }
+      ++done;
+    });
+    char c = 'x';
+    for (int i = 0; i < WARMUP_COUNT + ROUND_COUNT; i++) {
+      if (i == WARMUP_COUNT) {
+        alloc_begin = alloc_count.load();
+      }
+      ASSERT(write(ping[0], &c, 1) == 1);
+      ASSERT(read(pong[1], &c, 1) == 1);
+    }
+    alloc_end = alloc_count.load();
+    ++done;
+  });
+  while (done != 2) {
+    usleep(1000);
+  }
+  done = 0;
+  sc->Schedule([&] {
+    for (int fd : {ping[0], ping[1], pong[0], pong[1]}) {
+      close(fd);
+    }
+    ++done;
+  });
+  while (done != 1) {
+    usleep(1000);
+  }
+  return alloc_end - alloc_begin;
+}
+
+void TestPingPongAlloc() {
+  LOG_INFO(root_logger) << "TestPingPongAlloc start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "HookAlloc");
+  sc->Start();
+  // 第一轮中协程第一次销毁时栈池会分配自己的容器，只统计第二轮
+  PingPong(sc);
+  uint64_t allocs = PingPong(sc);
+  sc->Stop();
+  LOG_INFO(root_logger) << ROUND_COUNT << " ping pong rounds with read timeout, allocations: " << allocs;
+  ASSERT(allocs == 0);
+  LOG_INFO(root_logger) << "TestPingPongAlloc end";
+}
+
+/**
+ * @brief 没有数据可读时，read在超时之后返回ETIMEDOUT，超时本身也不分配内存
+ */
+void TestTimeoutAlloc() {
+  LOG_INFO(root_logger) << "TestTimeoutAlloc start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "HookAlloc");
+  sc->Start();
+  std::atomic<uint64_t> allocs{UINT64_MAX};
+  sc->Schedule([&allocs] {
+    int fds[2];
+    CreatePair(fds, 10);
+    char c = 0;
+    ASSERT(read(fds[1], &c, 1) == -1 && errno == ETIMEDOUT);
+    uint64_t begin = alloc_count;
+    for (int i = 0; i < 10; i++) {
+      ASSERT(read(fds[1], &c, 1) == -1 && errno == ETIMEDOUT);
+    }
+    allocs = alloc_count - begin;
+    close(fds[0]);
+    close(fds[1]);
+  });
+  sc->Stop();
+  LOG_INFO(root_logger) << "10 read timeouts, allocations: " << allocs;
+  ASSERT(allocs == 0);
+  LOG_INFO(root_logger) << "TestTimeoutAlloc end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestPingPongAlloc();
+  TestTimeoutAlloc();
+  return 0;
+}
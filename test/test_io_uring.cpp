@@ -0,0 +1,167 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include "server/log.h"
+#include "server/server.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int CLIENT_COUNT = 50;
+constexpr int ROUND_COUNT = 100;
+
+std::atomic<int> finished_count{0};
+std::atomic<int> error_count{0};
+
+/**
+ * @brief 创建一个监听在127.0.0.1随机端口上的socket
+ * @param[out] addr 实际监听的地址
+ */
+auto Listen(sockaddr_in *addr) -> int {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = 0;
+  inet_pton(AF_INET, "127.0.0.1", &addr->sin_addr.s_addr);
+  socklen_t len = sizeof(*addr);
+  if (bind(listen_fd, reinterpret_cast<sockaddr *>(addr), len) != 0 || listen(listen_fd, 128) != 0 ||
+      getsockname(listen_fd, reinterpret_cast<sockaddr *>(addr), &len) != 0) {
+    LOG_ERROR(root_logger) << "listen failed, errno: " << errno << ", errstr: " << strerror(errno);
+    ASSERT(false);
+  }
+  // 主线程没有开启hook，手动纳入fd管理，这样调度器中的accept才会挂起协程而不是阻塞线程
+  wtsclwq::FdWrapperMgr::GetInstance()->Get(listen_fd, true);
+  return listen_fd;
+}
+
+void Echo(int fd) {
+  char buf[256];
+  while (true) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      break;
+    }
+    if (write(fd, buf, n) != n) {
+      ++error_count;
+      break;
+    }
+  }
+  close(fd);
+}
+
+void Client(sockaddr_in addr, int id) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    LOG_ERROR(root_logger) << "connect failed, errno: " << errno << ", errstr: " << strerror(errno);
+    ++error_count;
+    close(fd);
+    return;
+  }
+  for (int i = 0; i < ROUND_COUNT; i++) {
+    std::string msg = "client " + std::to_string(id) + " round " + std::to_string(i);
+    char buf[256];
+    if (send(fd, msg.data(), msg.size(), 0) != static_cast<ssize_t>(msg.size())) {
+      ++error_count;
+      break;
+    }
+    // TCP是字节流，回显的数据可能被拆成多次到达
+    size_t received = 0;
+    while (received < msg.size()) {
+      ssize_t n = read(fd, buf + received, sizeof(buf) - received);
+      if (n <= 0) {
+        break;
+      }
+      received += n;
+    }
+    if (received != msg.size() || memcmp(buf, msg.data(), msg.size()) != 0) {
+      ++error_count;
+      break;
+    }
+  }
+  close(fd);
+  ++finished_count;
+}
+
+void TestEcho() {
+  LOG_INFO(root_logger) << "TestEcho start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(2, false, "IoUringEcho",
+                                                       wtsclwq::SockIoScheduler::IoBackend::IoUring);
+  ASSERT(sc->IsIoUringEnabled());
+  sc->Start();
+  sockaddr_in addr{};
+  int listen_fd = Listen(&addr);
+  sc->Schedule([listen_fd] {
+    for (int i = 0; i < CLIENT_COUNT; i++) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        ++error_count;
+        continue;
+      }
+      wtsclwq::Scheduler::GetThreadScheduler()->Schedule([fd] { Echo(fd); });
+    }
+    close(listen_fd);
+  });
+  uint64_t start = wtsclwq::GetCurrMs();
+  for (int i = 0; i < CLIENT_COUNT; i++) {
+    sc->Schedule([addr, i] { Client(addr, i); });
+  }
+  sc->Stop();
+  LOG_INFO(root_logger) << CLIENT_COUNT << " clients x " << ROUND_COUNT << " rounds finished in "
+                        << wtsclwq::GetCurrMs() - start << " ms";
+  ASSERT(finished_count == CLIENT_COUNT);
+  ASSERT(error_count == 0);
+  LOG_INFO(root_logger) << "TestEcho end";
+}
+
+void TestTimeoutAndCancel() {
+  LOG_INFO(root_logger) << "TestTimeoutAndCancel start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(2, false, "IoUringTimeout",
+                                                       wtsclwq::SockIoScheduler::IoBackend::IoUring);
+  sc->Start();
+  sockaddr_in addr{};
+  int listen_fd = Listen(&addr);
+  sc->Schedule([addr, listen_fd] {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT(connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == 0);
+    int peer_fd = accept(listen_fd, nullptr, nullptr);
+    ASSERT(peer_fd >= 0);
+
+    // 对端不发送数据，recv应该在超时之后以ETIMEDOUT失败
+    timeval tv{0, 100 * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buf[16];
+    uint64_t start = wtsclwq::GetCurrMs();
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    uint64_t elapsed = wtsclwq::GetCurrMs() - start;
+    LOG_INFO(root_logger) << "recv timeout ret: " << n << ", errno: " << errno << ", elapsed: " << elapsed << " ms";
+    ASSERT(n == -1 && errno == ETIMEDOUT && elapsed >= 90);
+
+    // 另一个协程关闭了fd，等待中的read应该以EBADF返回
+    wtsclwq::Scheduler::GetThreadScheduler()->Schedule([peer_fd] {
+      usleep(100 * 1000);
+      close(peer_fd);
+    });
+    n = read(peer_fd, buf, sizeof(buf));
+    LOG_INFO(root_logger) << "read after close ret: " << n << ", errno: " << errno;
+    ASSERT(n == -1 && errno == EBADF);
+    close(fd);
+    close(listen_fd);
+  });
+  sc->Stop();
+  LOG_INFO(root_logger) << "TestTimeoutAndCancel end";
+}
+
+auto main(int argc, char **argv) -> int {
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::ERROR);
+  TestEcho();
+  TestTimeoutAndCancel();
+  return 0;
+}
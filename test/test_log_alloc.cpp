@@ -0,0 +1,98 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include "server/log.h"
+#include "server/macro.h"
+
+// 统计当前线程的内存分配次数，用于验证稳态下打印日志不会分配内存
+// 异步输出目标的刷盘线程也会分配内存，所以只统计打印日志的线程
+static thread_local bool t_counting = false;
+static thread_local uint64_t t_alloc_count = 0;
+
+auto operator new(size_t size) -> void * {
+  if (t_counting) {
+    ++t_alloc_count;
+  }
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t /*size*/) noexcept { std::free(p); }
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int LINE_COUNT = 10000;
+
+/**
+ * @brief 打印各种类型的日志，包括嵌套的日志语句和超过内联缓冲区长度的日志
+ */
+void LogLines(const wtsclwq::Logger::s_ptr &logger, const std::string &long_message, int count) {
+  for (int i = 0; i < count; i++) {
+    LOG_INFO(logger) << "line " << i << " " << 3.14 << " " << 'c' << " " << std::hex << i << " " << true;
+    FMT_LOG_INFO(logger, "fmt line %d %s", i, "str");
+    LOG_WARN(logger) << long_message;
+    LOG_INFO(logger) << "outer " << [&logger, i] {
+      LOG_INFO(logger) << "inner " << i;
+      return i;
+    }();
+  }
+}
+
+/**
+ * @brief 预热之后，LOG_*和FMT_LOG_*都不应该再分配内存
+ */
+void TestNoAllocation(const wtsclwq::LogAppender::s_ptr &appender, const std::string &name) {
+  LOG_INFO(root_logger) << "TestNoAllocation " << name << " start";
+  auto logger = std::make_shared<wtsclwq::Logger>(name);
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>());
+  logger->AddAppender(appender);
+  std::string long_message(wtsclwq::LogStreamBuf::INLINE_SIZE * 3, 'x');
+
+  // 预热：创建线程局部的事件池、缓冲区，加载时区等
+  LogLines(logger, long_message, 10);
+
+  t_alloc_count = 0;
+  t_counting = true;
+  LogLines(logger, long_message, LINE_COUNT);
+  t_counting = false;
+  LOG_INFO(root_logger) << name << ": " << LINE_COUNT * 5 << " log lines, " << t_alloc_count << " allocations";
+  ASSERT(t_alloc_count == 0);
+  LOG_INFO(root_logger) << "TestNoAllocation " << name << " end";
+}
+
+/**
+ * @brief 日志事件被复用之后，上一条日志设置的流格式不应该影响下一条日志
+ */
+void TestReuse() {
+  LOG_INFO(root_logger) << "TestReuse start";
+  auto event = wtsclwq::LogEvent::Acquire();
+  event->Reset(wtsclwq::LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, "thread", "logger", 0);
+  event->GetStream() << std::hex << 255;
+  ASSERT(event->GetContent() == "ff");
+  wtsclwq::LogEvent *raw = event.get();
+  event.reset();
+  event = wtsclwq::LogEvent::Acquire();
+  ASSERT(event.get() == raw);
+  event->Reset(wtsclwq::LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, "thread", "logger", 0);
+  event->GetStream() << 255;
+  ASSERT(event->GetContent() == "255");
+  // 使用中的事件不会被再次取出
+  ASSERT(wtsclwq::LogEvent::Acquire().get() != raw);
+  LOG_INFO(root_logger) << "TestReuse end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestReuse();
+  TestNoAllocation(std::make_shared<wtsclwq::FileLogAppender>("/dev/null"), "file");
+  auto async_appender = std::make_shared<wtsclwq::AsyncLogAppender>(
+      "/dev/null", wtsclwq::AsyncLogAppender::DEFAULT_BUFFER_SIZE, wtsclwq::AsyncLogAppender::OverflowPolicy::Block);
+  TestNoAllocation(async_appender, "async");
+  return 0;
+}
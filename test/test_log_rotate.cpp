@@ -0,0 +1,225 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#include <zlib.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "server/config.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int LINE_COUNT = 5000;
+
+/**
+ * @brief 删除日志文件以及所有历史文件
+ */
+void RemoveFiles(const std::string &filename) {
+  unlink(filename.c_str());
+  for (int i = 1; i <= 10; i++) {
+    unlink((filename + "." + std::to_string(i)).c_str());
+    unlink((filename + "." + std::to_string(i) + ".gz").c_str());
+  }
+}
+
+auto FileExists(const std::string &filename) -> bool {
+  struct stat st {};
+  return stat(filename.c_str(), &st) == 0;
+}
+
+/**
+ * @brief 读取文件的全部内容，.gz结尾的文件先解压
+ */
+auto ReadFile(const std::string &filename) -> std::string {
+  std::string content;
+  if (filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0) {
+    gzFile gz = gzopen(filename.c_str(), "rb");
+    ASSERT(gz != nullptr);
+    char buf[4096];
+    int n = 0;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) {
+      content.append(buf, n);
+    }
+    gzclose(gz);
+    return content;
+  }
+  std::ifstream ifs(filename);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+/**
+ * @brief 等待后台的滚动线程处理完所有滚动任务：滚动次数在一段时间内不再变化
+ */
+void WaitRotateDone(const wtsclwq::LogFile::s_ptr &file) {
+  uint64_t count = file->GetRotateCount();
+  while (true) {
+    usleep(200 * 1000);
+    uint64_t new_count = file->GetRotateCount();
+    if (new_count == count) {
+      break;
+    }
+    count = new_count;
+  }
+}
+
+/**
+ * @brief 从最旧的历史文件到当前文件，日志的序号应该是连续的，并且以最后一条日志结束
+ * @return 检查的文件中日志的条数
+ */
+auto CheckSequence(const std::string &filename, int max_files, bool compressed) -> int {
+  std::vector<std::string> files;
+  for (int i = max_files; i >= 1; i--) {
+    std::string name = filename + "." + std::to_string(i) + (compressed ? ".gz" : "");
+    if (FileExists(name)) {
+      files.push_back(name);
+    }
+  }
+  files.push_back(filename);
+  int count = 0;
+  int last = -1;
+  for (auto &name : files) {
+    std::stringstream ss(ReadFile(name));
+    std::string line;
+    while (std::getline(ss, line)) {
+      int seq = std::stoi(line);
+      ASSERT(last == -1 || seq == last + 1);
+      last = seq;
+      count++;
+    }
+  }
+  ASSERT(last == LINE_COUNT - 1);
+  return count;
+}
+
+/**
+ * @brief 按大小滚动，只保留max_files个历史文件
+ */
+void TestSizeRotate() {
+  LOG_INFO(root_logger) << "TestSizeRotate start";
+  std::string filename = "/tmp/test_log_rotate_size.txt";
+  RemoveFiles(filename);
+  wtsclwq::LogRotatePolicy policy;
+  policy.max_size_ = 8192;
+  policy.max_files_ = 3;
+  auto logger = std::make_shared<wtsclwq::Logger>("rotate_size");
+  auto appender = std::make_shared<wtsclwq::FileLogAppender>(filename, policy);
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%m%n"));
+  logger->AddAppender(appender);
+  for (int i = 0; i < LINE_COUNT; i++) {
+    LOG_INFO(logger) << i << " " << std::string(32, 'x');
+  }
+  WaitRotateDone(appender->GetFile());
+
+  LOG_INFO(root_logger) << "rotate count: " << appender->GetFile()->GetRotateCount();
+  ASSERT(appender->GetFile()->GetRotateCount() > 3);
+  for (int i = 1; i <= 3; i++) {
+    ASSERT(FileExists(filename + "." + std::to_string(i)));
+  }
+  ASSERT(!FileExists(filename + ".4"));
+  int count = CheckSequence(filename, 3, false);
+  LOG_INFO(root_logger) << count << " lines kept";
+  ASSERT(count < LINE_COUNT);
+  LOG_INFO(root_logger) << "TestSizeRotate end";
+}
+
+/**
+ * @brief 异步输出目标按大小滚动，历史文件在后台压缩
+ */
+void TestCompress() {
+  LOG_INFO(root_logger) << "TestCompress start";
+  std::string filename = "/tmp/test_log_rotate_gzip.txt";
+  RemoveFiles(filename);
+  wtsclwq::LogRotatePolicy policy;
+  policy.max_size_ = 64 * 1024;
+  policy.max_files_ = 5;
+  policy.compress_ = true;
+  auto logger = std::make_shared<wtsclwq::Logger>("rotate_gzip");
+  auto appender = std::make_shared<wtsclwq::AsyncLogAppender>(filename, wtsclwq::AsyncLogAppender::DEFAULT_BUFFER_SIZE,
+                                                              wtsclwq::AsyncLogAppender::OverflowPolicy::Block, policy);
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%m%n"));
+  logger->AddAppender(appender);
+  for (int i = 0; i < LINE_COUNT; i++) {
+    LOG_INFO(logger) << i << " " << std::string(32, 'x');
+    if (i % 500 == 0) {
+      appender->Flush();
+    }
+  }
+  appender->Flush();
+  WaitRotateDone(appender->GetFile());
+
+  LOG_INFO(root_logger) << "rotate count: " << appender->GetFile()->GetRotateCount();
+  ASSERT(appender->GetFile()->GetRotateCount() > 0);
+  ASSERT(FileExists(filename + ".1.gz"));
+  ASSERT(!FileExists(filename + ".1"));
+  ASSERT(CheckSequence(filename, 5, true) == LINE_COUNT);
+  LOG_INFO(root_logger) << "TestCompress end";
+}
+
+/**
+ * @brief 按时间滚动，每秒滚动一次
+ */
+void TestIntervalRotate() {
+  LOG_INFO(root_logger) << "TestIntervalRotate start";
+  std::string filename = "/tmp/test_log_rotate_interval.txt";
+  RemoveFiles(filename);
+  wtsclwq::LogRotatePolicy policy;
+  policy.interval_ = 1;
+  policy.max_files_ = 10;
+  auto logger = std::make_shared<wtsclwq::Logger>("rotate_interval");
+  auto appender = std::make_shared<wtsclwq::FileLogAppender>(filename, policy);
+  appender->SetFormatter(std::make_shared<wtsclwq::LogFormatter>("%m%n"));
+  logger->AddAppender(appender);
+  for (int i = 0; i < LINE_COUNT; i++) {
+    LOG_INFO(logger) << i;
+    // 总共持续约2.5秒，至少跨过两个周期
+    usleep(500);
+  }
+  WaitRotateDone(appender->GetFile());
+
+  LOG_INFO(root_logger) << "rotate count: " << appender->GetFile()->GetRotateCount();
+  ASSERT(appender->GetFile()->GetRotateCount() >= 2);
+  ASSERT(CheckSequence(filename, 10, false) == LINE_COUNT);
+  LOG_INFO(root_logger) << "TestIntervalRotate end";
+}
+
+/**
+ * @brief 通过yaml配置日志滚动
+ */
+void TestConfig() {
+  LOG_INFO(root_logger) << "TestConfig start";
+  YAML::Node root = YAML::Load(R"(
+loggers:
+    - name: rotate_config
+      level: info
+      appenders:
+          - type: File
+            file: /tmp/test_log_rotate_config.txt
+            max_size: 1048576
+            rotate_interval: 86400
+            max_files: 5
+            compress: true
+)");
+  wtsclwq::ConfigMgr::GetInstance()->LoadFromYaml(root);
+  std::string config = NAMED_LOGGER("rotate_config")->FlushConfigToYmal();
+  LOG_INFO(root_logger) << "\n" << config;
+  ASSERT(config.find("max_size: 1048576") != std::string::npos);
+  ASSERT(config.find("rotate_interval: 86400") != std::string::npos);
+  ASSERT(config.find("max_files: 5") != std::string::npos);
+  ASSERT(config.find("compress: true") != std::string::npos);
+  LOG_INFO(root_logger) << "TestConfig end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestSizeRotate();
+  TestCompress();
+  TestIntervalRotate();
+  TestConfig();
+  return 0;
+}
@@ -0,0 +1,270 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "server/fd_manager.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int WRITE_DELAY_US = 50 * 1000;
+constexpr int WAIT_TIMEOUT_MS = 30;
+
+/**
+ * @brief 在单线程的IO调度器中运行wait，同时运行一个每毫秒计数一次的协程和一个延迟写入的协程；
+ * wait阻塞期间计数仍在增加，说明等待的只是协程而不是整个调度线程
+ */
+void RunWithTicker(const std::function<void(int read_fd)> &wait) {
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "PollHook");
+  sc->Start();
+  int fds[2];
+  ASSERT(pipe2(fds, O_CLOEXEC) == 0);
+  std::atomic<bool> wait_done{false};
+  std::atomic<int> ticks{0};
+  sc->Schedule([&] {
+    wait(fds[0]);
+    wait_done = true;
+    close(fds[0]);
+    close(fds[1]);
+  });
+  sc->Schedule([&] {
+    usleep(WRITE_DELAY_US);
+    ASSERT(write(fds[1], "x", 1) == 1);
+  });
+  sc->Schedule([&] {
+    while (!wait_done) {
+      ++ticks;
+      usleep(1000);
+    }
+  });
+  sc->Stop();
+  ASSERT(wait_done);
+  LOG_INFO(root_logger) << "ticks while waiting: " << ticks;
+  ASSERT(ticks > 0);
+}
+
+void TestPoll() {
+  LOG_INFO(root_logger) << "TestPoll start";
+  RunWithTicker([](int read_fd) {
+    struct pollfd pfd = {read_fd, POLLIN, 0};
+    ASSERT(poll(&pfd, 1, 5000) == 1 && (pfd.revents & POLLIN) != 0);
+    char c = 0;
+    ASSERT(read(read_fd, &c, 1) == 1 && c == 'x');
+
+    // 没有数据时在超时之后返回0
+    pfd.revents = 0;
+    uint64_t begin = wtsclwq::GetCurrMs();
+    ASSERT(poll(&pfd, 1, WAIT_TIMEOUT_MS) == 0 && pfd.revents == 0);
+    ASSERT(wtsclwq::GetCurrMs() - begin >= WAIT_TIMEOUT_MS);
+  });
+  LOG_INFO(root_logger) << "TestPoll end";
+}
+
+void TestSelect() {
+  LOG_INFO(root_logger) << "TestSelect start";
+  RunWithTicker([](int read_fd) {
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(read_fd, &read_set);
+    timeval tv{5, 0};
+    ASSERT(select(read_fd + 1, &read_set, nullptr, nullptr, &tv) == 1 && FD_ISSET(read_fd, &read_set));
+    // timeout中是剩余的时间
+    ASSERT(tv.tv_sec * 1000 + tv.tv_usec / 1000 < 5000);
+    char c = 0;
+    ASSERT(read(read_fd, &c, 1) == 1 && c == 'x');
+
+    FD_SET(read_fd, &read_set);
+    tv = {0, WAIT_TIMEOUT_MS * 1000};
+    uint64_t begin = wtsclwq::GetCurrMs();
+    ASSERT(select(read_fd + 1, &read_set, nullptr, nullptr, &tv) == 0 && !FD_ISSET(read_fd, &read_set));
+    ASSERT(wtsclwq::GetCurrMs() - begin >= WAIT_TIMEOUT_MS);
+    ASSERT(tv.tv_sec == 0 && tv.tv_usec == 0);
+  });
+  LOG_INFO(root_logger) << "TestSelect end";
+}
+
+void TestEpollWait() {
+  LOG_INFO(root_logger) << "TestEpollWait start";
+  RunWithTicker([](int read_fd) {
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT(epfd >= 0);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = read_fd;
+    ASSERT(epoll_ctl(epfd, EPOLL_CTL_ADD, read_fd, &event) == 0);
+    epoll_event ready[4];
+    ASSERT(epoll_wait(epfd, ready, 4, -1) == 1 && ready[0].data.fd == read_fd);
+    char c = 0;
+    ASSERT(read(read_fd, &c, 1) == 1 && c == 'x');
+
+    uint64_t begin = wtsclwq::GetCurrMs();
+    ASSERT(epoll_wait(epfd, ready, 4, WAIT_TIMEOUT_MS) == 0);
+    ASSERT(wtsclwq::GetCurrMs() - begin >= WAIT_TIMEOUT_MS);
+    close(epfd);
+  });
+  LOG_INFO(root_logger) << "TestEpollWait end";
+}
+
+/**
+ * @brief accept4等待连接到达；sendfile和splice在socket缓冲区满时挂起协程，等对端读走数据之后继续发送
+ */
+void TestAccept4AndZeroCopy() {
+  LOG_INFO(root_logger) << "TestAccept4AndZeroCopy start";
+  constexpr size_t FILE_SIZE = 4 * 1024 * 1024 + 7;
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "PollHook");
+  sc->Start();
+  std::atomic<int> done{0};
+  sc->Schedule([&] {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT(listen_fd >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT(bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+    ASSERT(listen(listen_fd, 16) == 0);
+    ASSERT(getsockname(listen_fd, reinterpret_cast<sockaddr *>(&addr), &addr_len) == 0);
+
+    std::vector<char> data(FILE_SIZE);
+    for (size_t i = 0; i < FILE_SIZE; i++) {
+      data[i] = static_cast<char>(i * 17 + 3);
+    }
+    // 接收端：accept4阻塞到客户端连接，再读完sendfile和splice发送的全部数据
+    sc->Schedule([&, listen_fd] {
+      int conn_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+      ASSERT(conn_fd >= 0);
+      std::vector<char> buf(FILE_SIZE + 3);
+      size_t received = 0;
+      while (received < buf.size()) {
+        ssize_t n = read(conn_fd, buf.data() + received, buf.size() - received);
+        ASSERT(n > 0);
+        received += n;
+      }
+      ASSERT(std::equal(data.begin(), data.end(), buf.begin()));
+      ASSERT(std::string(buf.data() + FILE_SIZE, 3) == "xyz");
+      close(conn_fd);
+
+      // 要求非阻塞的连接不会替用户等待
+      conn_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      ASSERT(conn_fd >= 0 && (fcntl(conn_fd, F_GETFL) & O_NONBLOCK) != 0);
+      char c = 0;
+      ASSERT(read(conn_fd, &c, 1) == -1 && errno == EAGAIN);
+      close(conn_fd);
+      close(listen_fd);
+      ++done;
+    });
+
+    std::string name = "/tmp/test_poll_hook_" + std::to_string(getpid());
+    int file_fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT(file_fd >= 0);
+    ASSERT(write(file_fd, data.data(), FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+
+    int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT(connect(client_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+    off_t offset = 0;
+    while (static_cast<size_t>(offset) < FILE_SIZE) {
+      ASSERT(sendfile(client_fd, file_fd, &offset, FILE_SIZE - offset) > 0);
+    }
+    int pipe_fds[2];
+    ASSERT(pipe2(pipe_fds, O_CLOEXEC) == 0);
+    ASSERT(write(pipe_fds[1], "xyz", 3) == 3);
+    ASSERT(splice(pipe_fds[0], nullptr, client_fd, nullptr, 3, 0) == 3);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(client_fd);
+    close(file_fd);
+    unlink(name.c_str());
+
+    client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT(connect(client_fd, reinterpret_cast<sockaddr *>(&addr), addr_len) == 0);
+    while (done == 0) {
+      usleep(1000);
+    }
+    close(client_fd);
+    ++done;
+  });
+  sc->Stop();
+  ASSERT(done == 2);
+  LOG_INFO(root_logger) << "TestAccept4AndZeroCopy end";
+}
+
+/**
+ * @brief 其他协程正在读的socket上poll，不能重复注册读事件，退回到阻塞的系统调用
+ */
+void TestPollWhileReading() {
+  LOG_INFO(root_logger) << "TestPollWhileReading start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "PollHook");
+  sc->Start();
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+  std::atomic<int> done{0};
+  sc->Schedule([&] {
+    // socketpair没有被hook，手动纳入fd管理
+    wtsclwq::FdWrapperMgr::GetInstance()->Get(fds[0], true);
+    char c = 0;
+    ASSERT(read(fds[0], &c, 1) == 1 && c == 'x');
+    ++done;
+  });
+  sc->Schedule([&] {
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    ASSERT(poll(&pfd, 1, WAIT_TIMEOUT_MS) == 0);
+    ASSERT(write(fds[1], "x", 1) == 1);
+    ++done;
+  });
+  sc->Stop();
+  ASSERT(done == 2);
+  close(fds[0]);
+  close(fds[1]);
+  LOG_INFO(root_logger) << "TestPollWhileReading end";
+}
+
+/**
+ * @brief 撤销监听时只撤销自己的注册，自己的注册触发之后其他任务重新注册的不受影响
+ */
+void TestRemoveOwnRegistration() {
+  LOG_INFO(root_logger) << "TestRemoveOwnRegistration start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(1, false, "PollHook");
+  sc->Start();
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+  std::atomic<int> fired{0};
+  sc->Schedule([&] {
+    int owner = 0;
+    int other = 0;
+    ASSERT(sc->TryAddEventListening(fds[0], wtsclwq::FileDescContext::Read, [] {}, &owner));
+    ASSERT(!sc->TryAddEventListening(fds[0], wtsclwq::FileDescContext::Read, [] {}, &other));
+    ASSERT(sc->RemoveAndTriggerEventListening(fds[0], wtsclwq::FileDescContext::Read));
+    ASSERT(sc->AddEventListening(fds[0], wtsclwq::FileDescContext::Read, [&fired] { ++fired; }));
+    ASSERT(!sc->RemoveEventListening(fds[0], wtsclwq::FileDescContext::Read, &owner));
+    ASSERT(write(fds[1], "x", 1) == 1);
+  });
+  sc->Stop();
+  ASSERT(fired == 1);
+  close(fds[0]);
+  close(fds[1]);
+  LOG_INFO(root_logger) << "TestRemoveOwnRegistration end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestPoll();
+  TestSelect();
+  TestEpollWait();
+  TestAccept4AndZeroCopy();
+  TestPollWhileReading();
+  TestRemoveOwnRegistration();
+  return 0;
+}
@@ -0,0 +1,261 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "server/fd_manager.h"
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+using ReactorMode = wtsclwq::SockIoScheduler::ReactorMode;
+
+constexpr size_t THREAD_COUNT = 4;
+constexpr size_t PIPE_COUNT = 64;
+constexpr int EVENTS_PER_PIPE = 2000;
+
+auto NowMs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief 一个自我驱动的管道：每次可读时读出一个字节再写回一个字节，直到处理完指定的事件数
+ */
+struct PingPipe {
+  int fds_[2]{-1, -1};
+  int owner_thread_{-1};  // 分配到的调度线程，共享模式下为-1
+  int count_{0};
+};
+
+/**
+ * @brief 等待管道可读，事件的回调在调度线程中重新注册，模拟一个长连接上的读循环
+ */
+void WaitPing(wtsclwq::SockIoScheduler *sc, PingPipe *pipe, std::atomic<int> *wrong_thread, std::atomic<int> *done) {
+  sc->AddEventListening(pipe->fds_[0], wtsclwq::FileDescContext::Read, [sc, pipe, wrong_thread, done] {
+    if (pipe->owner_thread_ != -1 && wtsclwq::GetCurrSysThreadId() != pipe->owner_thread_) {
+      ++*wrong_thread;
+    }
+    char c = 0;
+    while (read(pipe->fds_[0], &c, 1) == 1) {
+      if (++pipe->count_ == EVENTS_PER_PIPE) {
+        ++*done;
+        return;
+      }
+      ASSERT(write(pipe->fds_[1], &c, 1) == 1);
+    }
+    WaitPing(sc, pipe, wrong_thread, done);
+  });
+}
+
+/**
+ * @brief 在给定的模式下跑完所有管道，返回耗时
+ */
+auto RunPing(ReactorMode mode) -> int64_t {
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Reactor",
+                                                       wtsclwq::SockIoScheduler::IoBackend::Epoll, mode);
+  sc->Start();
+  ASSERT(sc->IsReactorPerThread() == (mode == ReactorMode::PerThread));
+  std::vector<PingPipe> pipes(PIPE_COUNT);
+  std::vector<int> worker_fd_count(sc->GetWorkerCount(), 0);
+  std::atomic<int> wrong_thread{0};
+  std::atomic<int> done{0};
+  for (auto &pipe : pipes) {
+    ASSERT(pipe2(pipe.fds_, O_NONBLOCK | O_CLOEXEC) == 0);
+    int worker_index = sc->AssignFdToWorker(pipe.fds_[0]);
+    if (worker_index >= 0) {
+      // 重复分配返回原来的线程
+      ASSERT(sc->AssignFdToWorker(pipe.fds_[0]) == worker_index);
+      worker_fd_count[worker_index]++;
+      pipe.owner_thread_ = sc->GetWorkerThreadId(worker_index);
+      sc->ScheduleOnWorker([&sc, &pipe, &wrong_thread, &done] { WaitPing(sc.get(), &pipe, &wrong_thread, &done); },
+                           worker_index);
+    } else {
+      sc->Schedule([&sc, &pipe, &wrong_thread, &done] { WaitPing(sc.get(), &pipe, &wrong_thread, &done); });
+    }
+  }
+  // 轮流分配时每个线程分到的fd数量相同
+  if (mode == ReactorMode::PerThread) {
+    for (auto count : worker_fd_count) {
+      ASSERT(count == static_cast<int>(PIPE_COUNT / THREAD_COUNT));
+    }
+  }
+
+  int64_t begin = NowMs();
+  for (auto &pipe : pipes) {
+    char c = 'x';
+    ASSERT(write(pipe.fds_[1], &c, 1) == 1);
+  }
+  while (done != static_cast<int>(PIPE_COUNT)) {
+    usleep(1000);
+  }
+  int64_t cost = NowMs() - begin;
+  ASSERT(wrong_thread == 0);
+
+  for (auto &pipe : pipes) {
+    sc->CloseEventListening(pipe.fds_[0]);
+    close(pipe.fds_[0]);
+    close(pipe.fds_[1]);
+  }
+  sc->Stop();
+  return cost;
+}
+
+/**
+ * @brief 调度线程添加的定时器由它自己的reactor触发
+ */
+void TestTimerAffinity() {
+  LOG_INFO(root_logger) << "TestTimerAffinity start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Reactor",
+                                                       wtsclwq::SockIoScheduler::IoBackend::Epoll,
+                                                       ReactorMode::PerThread);
+  sc->Start();
+  std::atomic<int> wrong_thread{0};
+  std::atomic<int> fired{0};
+  for (size_t i = 0; i < THREAD_COUNT; i++) {
+    sc->ScheduleOnWorker(
+        [&sc, &wrong_thread, &fired] {
+          int thread_id = wtsclwq::GetCurrSysThreadId();
+          sc->AddTimer(20, [thread_id, &wrong_thread, &fired] {
+            if (wtsclwq::GetCurrSysThreadId() != thread_id) {
+              ++wrong_thread;
+            }
+            ++fired;
+          });
+        },
+        i);
+  }
+  // 外部线程添加的定时器也能触发
+  sc->AddTimer(20, [&fired] { ++fired; });
+  sc->Stop();
+  ASSERT(fired == static_cast<int>(THREAD_COUNT) + 1);
+  ASSERT(wrong_thread == 0);
+  LOG_INFO(root_logger) << "TestTimerAffinity end";
+}
+
+/**
+ * @brief io_uring后端下协程在发起读写的线程上恢复执行，即使完成事件被其他线程收割
+ * @details 每对socket的两端分别由相邻两个线程上的协程读写，来回传递一个字节
+ */
+void TestIoUringAffinity() {
+  LOG_INFO(root_logger) << "TestIoUringAffinity start";
+  constexpr int ROUND_COUNT = 500;
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Reactor",
+                                                       wtsclwq::SockIoScheduler::IoBackend::IoUring,
+                                                       ReactorMode::PerThread);
+  ASSERT(sc->IsIoUringEnabled());
+  sc->Start();
+  std::atomic<int> wrong_thread{0};
+  std::atomic<int> done{0};
+  std::vector<std::array<int, 2>> socks(PIPE_COUNT);
+  for (size_t i = 0; i < PIPE_COUNT; i++) {
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socks[i].data()) == 0);
+    for (size_t side = 0; side < 2; side++) {
+      int fd = socks[i][side];
+      bool starter = side == 1;
+      sc->ScheduleOnWorker(
+          [fd, starter, &wrong_thread, &done] {
+            // socketpair没有被hook，手动纳入fd管理
+            wtsclwq::FdWrapperMgr::GetInstance()->Get(fd, true);
+            int thread_id = wtsclwq::GetCurrSysThreadId();
+            char c = 'x';
+            if (starter) {
+              ASSERT(write(fd, &c, 1) == 1);
+            }
+            for (int round = 0; round < ROUND_COUNT; round++) {
+              ASSERT(read(fd, &c, 1) == 1);
+              if (wtsclwq::GetCurrSysThreadId() != thread_id) {
+                ++wrong_thread;
+              }
+              if (!starter || round + 1 < ROUND_COUNT) {
+                ASSERT(write(fd, &c, 1) == 1);
+              }
+            }
+            ++done;
+          },
+          (i + side) % THREAD_COUNT);
+    }
+  }
+  sc->Stop();
+  for (auto &sock : socks) {
+    close(sock[0]);
+    close(sock[1]);
+  }
+  ASSERT(done == static_cast<int>(PIPE_COUNT * 2));
+  LOG_INFO(root_logger) << "resumed on wrong thread: " << wrong_thread;
+  ASSERT(wrong_thread == 0);
+  LOG_INFO(root_logger) << "TestIoUringAffinity end";
+}
+
+/**
+ * @brief 第一个调度线程一直忙碌时，其他线程提交的io_uring请求完成之后仍然能被及时收割
+ */
+void TestIoUringBusyFirstReactor() {
+  LOG_INFO(root_logger) << "TestIoUringBusyFirstReactor start";
+  constexpr int64_t BUSY_MS = 2000;
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(2, false, "Reactor",
+                                                       wtsclwq::SockIoScheduler::IoBackend::IoUring,
+                                                       ReactorMode::PerThread);
+  ASSERT(sc->IsIoUringEnabled());
+  sc->Start();
+  std::array<int, 2> sock{};
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sock.data()) == 0);
+  std::atomic<int64_t> read_ms{-1};
+  sc->ScheduleOnWorker(
+      [] {
+        int64_t start = NowMs();
+        while (NowMs() - start < BUSY_MS) {
+        }
+      },
+      0);
+  sc->ScheduleOnWorker(
+      [fd = sock[0], &read_ms] {
+        wtsclwq::FdWrapperMgr::GetInstance()->Get(fd, true);
+        int64_t start = NowMs();
+        char c = 0;
+        ASSERT(read(fd, &c, 1) == 1);
+        read_ms = NowMs() - start;
+      },
+      1);
+  std::thread writer([fd = sock[1]] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    char c = 'x';
+    ASSERT(write(fd, &c, 1) == 1);
+  });
+  writer.join();
+  // Stop会唤醒所有线程去收割，必须在这之前等到读取完成
+  int64_t wait_start = NowMs();
+  while (read_ms < 0 && NowMs() - wait_start < BUSY_MS) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  sc->Stop();
+  close(sock[0]);
+  close(sock[1]);
+  LOG_INFO(root_logger) << "read completed in " << read_ms << " ms";
+  ASSERT(read_ms >= 0 && read_ms < BUSY_MS / 2);
+  LOG_INFO(root_logger) << "TestIoUringBusyFirstReactor end";
+}
+
+void TestPing() {
+  LOG_INFO(root_logger) << "TestPing start";
+  int64_t shared_ms = RunPing(ReactorMode::Shared);
+  int64_t per_thread_ms = RunPing(ReactorMode::PerThread);
+  LOG_INFO(root_logger) << PIPE_COUNT * EVENTS_PER_PIPE << " events, shared: " << shared_ms
+                        << " ms, per_thread: " << per_thread_ms << " ms";
+  LOG_INFO(root_logger) << "TestPing end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestPing();
+  TestTimerAffinity();
+  TestIoUringAffinity();
+  TestIoUringBusyFirstReactor();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include "server/log.h"
+#include "server/scheduler.h"
+#include "server/server.h"
+
+// 统计全局的内存分配次数，用于验证稳态下调度任务不会分配内存
+static std::atomic<uint64_t> alloc_count{0};
+
+auto operator new(size_t size) -> void * {
+  ++alloc_count;
+  void *p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t /*size*/) noexcept { std::free(p); }
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int TASK_COUNT = 10000;
+
+std::atomic<int> done_count{0};
+
+/**
+ * @brief 预热：先让所有调度线程阻塞，再一次性提交所有任务，使全局队列扩容到之后可能达到的最大长度
+ */
+void Warmup(const wtsclwq::Scheduler::s_ptr &sc) {
+  std::atomic<bool> gate_open{false};
+  std::atomic<int> blocked{0};
+  for (size_t i = 0; i < sc->GetWorkerCount(); i++) {
+    sc->Schedule([&gate_open, &blocked] {
+      ++blocked;
+      while (!gate_open) {
+        sched_yield();
+      }
+    });
+  }
+  while (blocked < static_cast<int>(sc->GetWorkerCount())) {
+    sched_yield();
+  }
+  done_count = 0;
+  auto *done = &done_count;
+  for (int i = 0; i < TASK_COUNT * 2 + 1; i++) {
+    sc->Schedule([done] { ++*done; });
+  }
+  gate_open = true;
+  while (done_count < TASK_COUNT * 2 + 1) {
+    usleep(1000);
+  }
+}
+
+/**
+ * @brief 外部线程和调度线程各提交TASK_COUNT个任务，并等待它们全部执行完毕
+ * @return 这一轮中发生的内存分配次数
+ */
+auto ScheduleRound(const wtsclwq::Scheduler::s_ptr &sc) -> uint64_t {
+  done_count = 0;
+  uint64_t alloc_before = alloc_count;
+  // 捕获3个指针大小的变量，模拟常见的任务大小
+  int64_t a = 1;
+  int64_t b = 2;
+  auto *done = &done_count;
+  for (int i = 0; i < TASK_COUNT; i++) {
+    sc->Schedule([a, b, done] {
+      if (a + b == 3) {
+        ++*done;
+      }
+    });
+  }
+  // 从调度线程内部提交的任务会进入本地队列
+  sc->Schedule([sc, done] {
+    for (int i = 0; i < TASK_COUNT; i++) {
+      sc->Schedule([done] { ++*done; });
+    }
+  });
+  while (done_count < TASK_COUNT * 2) {
+    usleep(1000);
+  }
+  return alloc_count - alloc_before;
+}
+
+auto main(int argc, char **argv) -> int {
+  root_logger->SetLevel(wtsclwq::LogLevel::INFO);
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::FATAL);
+
+  auto sc = std::make_shared<wtsclwq::Scheduler>(2, false, "AllocTest");
+  sc->Start();
+
+  // 预热阶段完成任务队列扩容、调度线程创建任务协程等
+  Warmup(sc);
+  uint64_t first_allocs = ScheduleRound(sc);
+  uint64_t steady_allocs = ScheduleRound(sc);
+  sc->Stop();
+
+  LOG_INFO(root_logger) << "first round allocs: " << first_allocs << ", steady round allocs: " << steady_allocs;
+  if (steady_allocs != 0) {
+    LOG_ERROR(root_logger) << "Schedule() should not allocate in steady state";
+    return 1;
+  }
+  return 0;
+}
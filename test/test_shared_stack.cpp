@@ -0,0 +1,92 @@
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "server/config.h"
+#include "server/coroutine.h"
+#include "server/log.h"
+#include "server/scheduler.h"
+#include "server/server.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int COROUTINE_COUNT = 10000;
+
+std::atomic<int> finished_count{0};
+std::atomic<int> corrupted_count{0};
+
+/**
+ * @brief 在栈上放一些数据，挂起之后再检查数据是否完好
+ */
+void CheckLocals(int seed) {
+  int locals[64];
+  for (int i = 0; i < 64; i++) {
+    locals[i] = seed + i;
+  }
+  wtsclwq::Coroutine::GetThreadRunningCoroutine()->Yield();
+  for (int i = 0; i < 64; i++) {
+    if (locals[i] != seed + i) {
+      ++corrupted_count;
+      break;
+    }
+  }
+  ++finished_count;
+}
+
+void TestSingleThread() {
+  LOG_INFO(root_logger) << "TestSingleThread start";
+  wtsclwq::Coroutine::InitThreadToCoMod();
+  auto main_co = wtsclwq::Coroutine::GetThreadMainCoroutine();
+  std::vector<wtsclwq::Coroutine::s_ptr> coroutines;
+  coroutines.reserve(COROUTINE_COUNT);
+  for (int i = 0; i < COROUTINE_COUNT; i++) {
+    coroutines.emplace_back(
+        std::make_shared<wtsclwq::Coroutine>([i] { CheckLocals(i * 100); }, 0, true, main_co, true));
+  }
+  for (auto &co : coroutines) {
+    co->Resume();
+  }
+  // 此时所有协程都处于挂起状态，统计保存下来的栈大小
+  size_t saved_bytes = 0;
+  for (auto &co : coroutines) {
+    saved_bytes += co->GetSavedStackSize();
+  }
+  LOG_INFO(root_logger) << COROUTINE_COUNT << " suspended shared stack coroutines saved " << saved_bytes
+                        << " bytes of stack, " << saved_bytes / COROUTINE_COUNT << " bytes each";
+  for (auto &co : coroutines) {
+    co->Resume();
+  }
+  ASSERT(finished_count == COROUTINE_COUNT);
+  ASSERT(corrupted_count == 0);
+  LOG_INFO(root_logger) << "TestSingleThread end";
+}
+
+void TestScheduler() {
+  LOG_INFO(root_logger) << "TestScheduler start";
+  finished_count = 0;
+  wtsclwq::ConfigMgr::GetInstance()->GetOrAddDefaultConfigItem("scheduler.use_shared_stack", false)->SetValue(true);
+  auto sc = std::make_shared<wtsclwq::Scheduler>(3, false, "SharedStack");
+  sc->Start();
+  // 函数任务运行在共享栈协程中，把自己重新放回调度器之后挂起，再次执行时必须回到同一个线程
+  for (int i = 0; i < COROUTINE_COUNT; i++) {
+    sc->Schedule([i] {
+      int thread_id = wtsclwq::GetCurrSysThreadId();
+      wtsclwq::Scheduler::GetThreadScheduler()->Schedule(wtsclwq::Coroutine::GetThreadRunningCoroutine());
+      CheckLocals(i * 100);
+      if (thread_id != wtsclwq::GetCurrSysThreadId()) {
+        ++corrupted_count;
+      }
+    });
+  }
+  sc->Stop();
+  ASSERT(finished_count == COROUTINE_COUNT);
+  ASSERT(corrupted_count == 0);
+  LOG_INFO(root_logger) << "TestScheduler end";
+}
+
+auto main(int argc, char **argv) -> int {
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::ERROR);
+  TestSingleThread();
+  TestScheduler();
+  return 0;
+}
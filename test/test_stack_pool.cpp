@@ -0,0 +1,54 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+#include "server/coroutine.h"
+#include "server/log.h"
+#include "server/server.h"
+#include "server/stack_pool.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+void TestReuse() {
+  LOG_INFO(root_logger) << "TestReuse start";
+  wtsclwq::Coroutine::InitThreadToCoMod();
+  auto main_co = wtsclwq::Coroutine::GetThreadMainCoroutine();
+  // 第一轮创建的协程栈全部是新映射的，之后每一轮都应该命中缓存
+  for (int round = 0; round < 10; round++) {
+    std::vector<wtsclwq::Coroutine::s_ptr> coroutines;
+    for (int i = 0; i < 100; i++) {
+      coroutines.emplace_back(std::make_shared<wtsclwq::Coroutine>([] {}, 0, true, main_co));
+    }
+    for (auto &co : coroutines) {
+      co->Resume();
+    }
+  }
+  auto stats = wtsclwq::StackPool::GetInstance()->GetStats();
+  LOG_INFO(root_logger) << wtsclwq::StackPool::GetInstance()->ToString();
+  ASSERT(stats.in_use_count == 0);
+  ASSERT(stats.cached_count == 100);
+  ASSERT(stats.HitRate() >= 0.9);
+  LOG_INFO(root_logger) << "TestReuse end";
+}
+
+void TestGuardPage() {
+  LOG_INFO(root_logger) << "TestGuardPage start";
+  // 在子进程中写栈底之下的保护页，子进程应当被SIGSEGV终止
+  pid_t pid = fork();
+  if (pid == 0) {
+    auto *stack = static_cast<char *>(wtsclwq::StackPool::GetInstance()->Alloc(64 * 1024));
+    stack[-1] = 1;
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  ASSERT(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+  LOG_INFO(root_logger) << "TestGuardPage end, child killed by signal " << WTERMSIG(status);
+}
+
+auto main(int argc, char **argv) -> int {
+  NAMED_LOGGER("system")->SetLevel(wtsclwq::LogLevel::ERROR);
+  TestReuse();
+  TestGuardPage();
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/sock_io_scheduler.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr size_t THREAD_COUNT = 4;
+constexpr int ROUND_COUNT = 2000;
+
+auto NowNs() -> int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief 依次向每个空闲线程的信箱投递任务，任务必须由目标线程执行，统计从投递到执行的延迟
+ */
+void TestTargetedWakeup() {
+  LOG_INFO(root_logger) << "TestTargetedWakeup start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Tickle");
+  sc->Start();
+  std::atomic<int> done{0};
+  std::atomic<int> wrong_thread{0};
+  int64_t total_ns = 0;
+  for (int i = 0; i < ROUND_COUNT; i++) {
+    size_t worker_index = i % THREAD_COUNT;
+    int expect_thread = sc->GetWorkerThreadId(worker_index);
+    std::atomic<int64_t> run_ns{0};
+    int64_t begin = NowNs();
+    sc->ScheduleOnWorker(
+        [expect_thread, &run_ns, &done, &wrong_thread] {
+          run_ns = NowNs();
+          if (wtsclwq::GetCurrSysThreadId() != expect_thread) {
+            ++wrong_thread;
+          }
+          ++done;
+        },
+        worker_index);
+    while (done != i + 1) {
+    }
+    total_ns += run_ns - begin;
+  }
+  ASSERT(wrong_thread == 0);
+  LOG_INFO(root_logger) << "targeted wakeup latency: " << total_ns / ROUND_COUNT / 1000 << " us";
+  sc->Stop();
+  LOG_INFO(root_logger) << "TestTargetedWakeup end";
+}
+
+/**
+ * @brief 一次提交N个任务，空闲线程被依次唤醒，所有任务都能执行完
+ */
+void TestBulkWakeup() {
+  LOG_INFO(root_logger) << "TestBulkWakeup start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Tickle");
+  sc->Start();
+  std::atomic<int> done{0};
+  for (int round = 0; round < 100; round++) {
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < THREAD_COUNT; i++) {
+      tasks.emplace_back([&done] { ++done; });
+    }
+    sc->ScheduleBatch(tasks.begin(), tasks.end());
+    usleep(1000);
+  }
+  sc->Stop();
+  ASSERT(done == 100 * static_cast<int>(THREAD_COUNT));
+  LOG_INFO(root_logger) << "TestBulkWakeup end";
+}
+
+/**
+ * @brief Stop时还有任务在执行，任务结束之后其余空闲线程应该立即退出，而不是等待epoll_wait超时
+ */
+void TestStopLatency() {
+  LOG_INFO(root_logger) << "TestStopLatency start";
+  auto sc = std::make_shared<wtsclwq::SockIoScheduler>(THREAD_COUNT, false, "Tickle");
+  sc->Start();
+  usleep(100 * 1000);
+  sc->Schedule([] {
+    int64_t end = NowNs() + 200 * 1000 * 1000;
+    while (NowNs() < end) {
+    }
+  });
+  usleep(10 * 1000);
+  int64_t begin = NowNs();
+  sc->Stop();
+  int64_t stop_ms = (NowNs() - begin) / 1000 / 1000;
+  LOG_INFO(root_logger) << "Stop took " << stop_ms << " ms";
+  ASSERT(stop_ms < 1000);
+  LOG_INFO(root_logger) << "TestStopLatency end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestTargetedWakeup();
+  TestBulkWakeup();
+  TestStopLatency();
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <unistd.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "server/log.h"
+#include "server/macro.h"
+#include "server/timer.h"
+#include "server/utils.h"
+
+static auto root_logger = ROOT_LOGGER;
+
+constexpr int BENCH_TIMER_COUNT = 200000;
+
+/**
+ * @brief 定时器使用的时钟，单位ms
+ */
+auto Now() -> uint64_t { return static_cast<uint64_t>(wtsclwq::GetElapsedTime()); }
+
+/**
+ * @brief 不断取出到期的定时器回调并执行，直到定时器全部触发或者超过deadline
+ */
+void RunUntilEmpty(const wtsclwq::TimerManager::s_ptr &manager, uint64_t deadline) {
+  while (!manager->Empty() && Now() < deadline) {
+    for (auto &func : manager->GetAllTriggeringTimerFuncs()) {
+      func();
+    }
+    usleep(200);
+  }
+}
+
+/**
+ * @brief 大量添加、取消定时器，O(1)的时间轮应该在很短时间内完成
+ */
+void TestAddCancel() {
+  LOG_INFO(root_logger) << "TestAddCancel start";
+  auto manager = std::make_shared<wtsclwq::TimerManager>();
+  std::vector<wtsclwq::Timer::s_ptr> timers;
+  timers.reserve(BENCH_TIMER_COUNT);
+  uint64_t start = wtsclwq::GetCurrUs();
+  for (int i = 0; i < BENCH_TIMER_COUNT; i++) {
+    // 间隔覆盖时间轮的各个层级
+    timers.push_back(manager->AddTimer(1000 + (i * 7919ULL) % (1ULL << 30), [] {}));
+  }
+  uint64_t added = wtsclwq::GetCurrUs();
+  for (auto &timer : timers) {
+    ASSERT(timer->Cancel());
+  }
+  uint64_t cancelled = wtsclwq::GetCurrUs();
+  LOG_INFO(root_logger) << BENCH_TIMER_COUNT << " timers, add: " << added - start
+                        << " us, cancel: " << cancelled - added << " us";
+  ASSERT(manager->Empty());
+  ASSERT(manager->GetRecentTriggerTime() == UINT64_MAX);
+  // 重复取消应该失败
+  ASSERT(!timers.front()->Cancel());
+  LOG_INFO(root_logger) << "TestAddCancel end";
+}
+
+/**
+ * @brief 定时器应该按照触发时间的顺序触发，且不早于触发时间，包括需要从高层下降的定时器
+ */
+void TestOrder() {
+  LOG_INFO(root_logger) << "TestOrder start";
+  auto manager = std::make_shared<wtsclwq::TimerManager>();
+  std::vector<uint64_t> intervals = {1, 5, 30, 255, 256, 257, 300, 511, 600, 1000, 1500};
+  std::vector<uint64_t> fired;
+  int early_count = 0;
+  uint64_t start = Now();
+  for (auto it = intervals.rbegin(); it != intervals.rend(); ++it) {
+    uint64_t interval = *it;
+    manager->AddTimer(interval, [interval, start, &fired, &early_count] {
+      if (Now() < start + interval) {
+        ++early_count;
+      }
+      fired.push_back(interval);
+    });
+  }
+  RunUntilEmpty(manager, start + 3000);
+  ASSERT(early_count == 0);
+  ASSERT(fired == intervals);
+  LOG_INFO(root_logger) << "TestOrder end, elapsed: " << Now() - start << " ms";
+}
+
+/**
+ * @brief Refresh、Reset、循环定时器以及条件定时器
+ */
+void TestRefreshReset() {
+  LOG_INFO(root_logger) << "TestRefreshReset start";
+  auto manager = std::make_shared<wtsclwq::TimerManager>();
+  uint64_t start = Now();
+
+  // Reset到更早的时间，应该提前触发，且需要唤醒空闲线程
+  uint64_t reset_fire_time = 0;
+  auto reset_timer = manager->AddTimer(2000, [&reset_fire_time] { reset_fire_time = Now(); });
+  manager->GetRecentTriggerTime();
+  ASSERT(reset_timer->Reset(100, true));
+  ASSERT(manager->NeedTickle());
+
+  // Refresh之后从当前时间重新计时
+  uint64_t refresh_fire_time = 0;
+  auto refresh_timer =
+      manager->AddTimer(300, [&refresh_fire_time] { refresh_fire_time = Now(); });
+
+  // 循环定时器触发3次之后取消自己
+  int recurring_count = 0;
+  wtsclwq::Timer::s_ptr recurring_timer;
+  recurring_timer = manager->AddTimer(
+      50,
+      [&recurring_count, &recurring_timer] {
+        if (++recurring_count == 3) {
+          recurring_timer->Cancel();
+        }
+      },
+      true);
+
+  // 条件不满足的条件定时器不执行回调
+  int cond_count = 0;
+  auto cond = std::make_shared<int>(0);
+  std::weak_ptr<int> weak_cond(cond);
+  manager->AddConditionTimer(
+      100, [&cond_count] { ++cond_count; }, [weak_cond] { return weak_cond.lock() != nullptr; });
+  manager->AddConditionTimer(100, [&cond_count] { cond_count += 10; }, [] { return false; });
+
+  usleep(200 * 1000);
+  for (auto &func : manager->GetAllTriggeringTimerFuncs()) {
+    func();
+  }
+  uint64_t refresh_time = Now();
+  ASSERT(refresh_timer->Refresh());
+  RunUntilEmpty(manager, start + 3000);
+
+  LOG_INFO(root_logger) << "reset fired at " << reset_fire_time - start << " ms, refresh fired at "
+                        << refresh_fire_time - start << " ms";
+  ASSERT(reset_fire_time >= start + 100 && reset_fire_time < start + 2000);
+  ASSERT(refresh_fire_time >= refresh_time + 300);
+  ASSERT(recurring_count == 3);
+  ASSERT(cond_count == 1);
+  ASSERT(!reset_timer->Cancel());
+  ASSERT(!refresh_timer->Refresh());
+  LOG_INFO(root_logger) << "TestRefreshReset end";
+}
+
+/**
+ * @brief 长时间空闲之后添加的定时器相对于当前时间放置；只有高层定时器时，空闲线程一直睡到它们下降的时刻
+ */
+void TestIdleCatchUp() {
+  LOG_INFO(root_logger) << "TestIdleCatchUp start";
+  auto manager = std::make_shared<wtsclwq::TimerManager>();
+  usleep(600 * 1000);
+  uint64_t start = Now();
+  uint64_t fire_time = 0;
+  manager->AddTimer(100, [&fire_time] { fire_time = Now(); });
+  // 落后的next_tick_会让定时器落到高层，等待时间算成0，空闲线程立即醒来空转
+  uint64_t wait = manager->GetRecentTriggerTime();
+  ASSERT(wait > 0 && wait <= 100);
+  RunUntilEmpty(manager, start + 1000);
+  ASSERT(fire_time >= start + 100);
+
+  // 第3层的定时器在2^20ms的边界上下降，中间第0层的每一圈都不需要醒来
+  constexpr uint64_t LEVEL3_SPAN = 1ULL << 20;
+  auto far_timer = manager->AddTimer(30 * 60 * 1000, [] {});
+  uint64_t before = Now();
+  wait = manager->GetRecentTriggerTime();
+  uint64_t after = Now();
+  bool on_boundary = false;
+  for (uint64_t curr = before; curr <= after; curr++) {
+    on_boundary = on_boundary || (curr + wait) % LEVEL3_SPAN == 0;
+  }
+  LOG_INFO(root_logger) << "wait for a level 3 timer: " << wait << " ms";
+  ASSERT(on_boundary);
+  ASSERT(manager->GetAllTriggeringTimerFuncs().empty());
+  ASSERT(far_timer->Cancel());
+  LOG_INFO(root_logger) << "TestIdleCatchUp end";
+}
+
+auto main(int argc, char **argv) -> int {
+  TestAddCancel();
+  TestOrder();
+  TestRefreshReset();
+  TestIdleCatchUp();
+  return 0;
+}
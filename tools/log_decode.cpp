@@ -0,0 +1,62 @@
+/**
+ * @brief 把BinaryLogAppender写入的二进制日志文件还原为文本，输出到标准输出
+ * 用法：log_decode [-p pattern] file...
+ * pattern和日志配置中的pattern相同，默认使用LogFormatter的默认格式
+ */
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "server/binary_log.h"
+#include "server/log.h"
+
+auto main(int argc, char **argv) -> int {
+  std::string pattern;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      pattern = argv[++i];
+    } else if (strcmp(argv[i], "-h") == 0) {
+      files.clear();
+      break;
+    } else {
+      files.emplace_back(argv[i]);
+    }
+  }
+  if (files.empty()) {
+    std::cerr << "usage: " << argv[0] << " [-p pattern] file..." << std::endl;
+    return 1;
+  }
+
+  auto formatter =
+      pattern.empty() ? std::make_shared<wtsclwq::LogFormatter>() : std::make_shared<wtsclwq::LogFormatter>(pattern);
+  if (formatter->HasError()) {
+    std::cerr << "invalid pattern: " << pattern << std::endl;
+    return 1;
+  }
+  int ret = 0;
+  auto event = std::make_shared<wtsclwq::LogEvent>();
+  wtsclwq::LogStreamBuf buf;
+  for (auto &file : files) {
+    wtsclwq::BinaryLogReader reader(file);
+    if (!reader.IsOpen()) {
+      std::cerr << "open file " << file << " failed" << std::endl;
+      ret = 1;
+      continue;
+    }
+    while (reader.Next(event.get())) {
+      buf.Reset();
+      formatter->FormatTo(*event, &buf);
+      std::string_view text = buf.View();
+      std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    if (reader.HasError()) {
+      // 进程崩溃时文件末尾可能有不完整的记录
+      std::cerr << file << ": truncated or corrupted record" << std::endl;
+      ret = 1;
+    }
+  }
+  return ret;
+}